@@ -89,6 +89,8 @@ typedef enum
 
 
 extern void PipeServer();
+struct ScriptServerFunctions;
+extern void SocketServer(const ScriptServerFunctions *pFunctions);
 typedef DLL_IMPORT int (*tpExecScriptServerFunc)( wxString * pIn, wxString * pOut);
 static tpExecScriptServerFunc pScriptServerFn=NULL;
 
@@ -139,6 +141,15 @@ int DLL_API RegScriptServerFunc( tpExecScriptServerFunc pFn )
    return 4;
 }
 
+// And this one is for the binary protocol, on a socket.
+int DLL_API RegBinaryScriptServerFunc( const ScriptServerFunctions *pFns )
+{
+   if( pFns )
+      SocketServer( pFns );
+
+   return 4;
+}
+
 
 wxString Str2;
 wxArrayString aStr;
@@ -0,0 +1,363 @@
+// SocketServer.cpp
+//
+// Serves scripts in binary, on a Unix domain socket named
+// /tmp/audacity_script_socket.<uid>, for the sake of bulk automation and
+// of the transfer of samples.  The text pipes of PipeServer.cpp are
+// unchanged.
+//
+// Each request and each response is a frame:  a header of 12 bytes, all
+// little-endian, then the payload.
+//
+//    u32 length of the payload
+//    u32 request id, chosen by the client, and copied to the response
+//    u16 type
+//    u16 flags:  1 for the last frame of a response, 2 for an error,
+//                whose payload is a message in UTF-8
+//
+// Requests may be pipelined:  the client need not wait for one response
+// before sending the next request.  They are served in order.  A response
+// may be streamed as several frames, all but the last without flag 1.
+// The server writes each response before it reads the next request, so a
+// client that pipelines should not let too many requests go unread.
+//
+// Types of request, with their payloads and those of their responses:
+//
+//    1 Command   the command in UTF-8, as sent to the pipe
+//                -> the response in UTF-8, as received from the pipe
+//    2 Info      i32 channel
+//                -> i64 number of samples, f64 rate
+//    3 Read      i32 channel, i64 start, i64 count
+//                -> count f32 samples, in frames of at most 1 MB
+//    4 Write     i32 channel, i64 start, then f32 samples
+//                -> nothing
+//
+// Channels are numbered as by the "Channel" parameter of the Set Track
+// commands.  Samples are read directly from the blocks of one snapshot of
+// the track for each request, and written as one undoable change.  scripts/piped-work/socket_benchmark.py
+// is a client, which measures the rates of commands and of samples.
+
+#include "../../src/commands/ScriptCommandRelay.h"
+
+#if defined(WIN32)
+
+void SocketServer(const ScriptServerFunctions *)
+{
+   // Windows has the named pipes only
+}
+
+#else
+
+#include <wx/string.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+const char sockettmpl[] = "/tmp/audacity_script_socket.%d";
+
+enum : unsigned { CommandRequest = 1, InfoRequest, ReadRequest, WriteRequest };
+enum : unsigned { LastFrame = 1, ErrorFrame = 2 };
+
+const size_t HeaderSize = 12;
+// Bound the memory that one request may claim
+const size_t MaxPayload = 1u << 30;
+const size_t SamplesPerFrame = (1u << 20) / sizeof(float);
+
+struct Header
+{
+   uint32_t length;
+   uint32_t id;
+   uint16_t type;
+   uint16_t flags;
+};
+
+// Little-endian encoding, whatever the machine
+void Put(unsigned char *p, uint64_t value, size_t size)
+{
+   for (size_t i = 0; i < size; ++i, value >>= 8)
+      p[i] = (unsigned char)(value & 0xFF);
+}
+
+uint64_t Take(const unsigned char *p, size_t size)
+{
+   uint64_t value = 0;
+   for (size_t i = size; i-- > 0;)
+      value = (value << 8) | p[i];
+   return value;
+}
+
+bool ReadAll(int fd, void *data, size_t len)
+{
+   auto p = static_cast<char*>(data);
+   while (len > 0) {
+      auto n = recv(fd, p, len, 0);
+      if (n < 0 && errno == EINTR)
+         continue;
+      if (n <= 0)
+         return false;
+      p += n;
+      len -= n;
+   }
+   return true;
+}
+
+bool WriteAll(int fd, const void *data, size_t len)
+{
+#ifdef MSG_NOSIGNAL
+   const int flags = MSG_NOSIGNAL;
+#else
+   const int flags = 0;
+#endif
+   auto p = static_cast<const char*>(data);
+   while (len > 0) {
+      auto n = send(fd, p, len, flags);
+      if (n < 0 && errno == EINTR)
+         continue;
+      if (n <= 0)
+         return false;
+      p += n;
+      len -= n;
+   }
+   return true;
+}
+
+class Connection
+{
+public:
+   Connection(int fd, const ScriptServerFunctions &functions)
+      : mFd{ fd }, mFunctions{ functions }
+   {}
+
+   // Serve requests until the client closes the socket
+   void Serve()
+   {
+      std::vector<unsigned char> payload;
+      while (true) {
+         unsigned char bytes[HeaderSize];
+         if (!ReadAll(mFd, bytes, HeaderSize))
+            return;
+         Header header{
+            (uint32_t)Take(bytes, 4), (uint32_t)Take(bytes + 4, 4),
+            (uint16_t)Take(bytes + 8, 2), (uint16_t)Take(bytes + 10, 2) };
+         if (header.length > MaxPayload)
+            return;
+         payload.resize(header.length);
+         if (!ReadAll(mFd, payload.data(), payload.size()))
+            return;
+         if (!Handle(header, payload))
+            return;
+      }
+   }
+
+private:
+   bool Send(const Header &request, unsigned flags,
+             const void *data, size_t len)
+   {
+      unsigned char bytes[HeaderSize];
+      Put(bytes, len, 4);
+      Put(bytes + 4, request.id, 4);
+      Put(bytes + 8, request.type, 2);
+      Put(bytes + 10, flags, 2);
+      return WriteAll(mFd, bytes, HeaderSize) && WriteAll(mFd, data, len);
+   }
+
+   bool SendError(const Header &request, const char *message)
+   {
+      return Send(request, LastFrame | ErrorFrame, message, strlen(message));
+   }
+
+   struct ReadState
+   {
+      Connection &connection;
+      const Header &request;
+      long long remaining;
+      std::vector<unsigned char> bytes;
+      bool sendFailed{ false };
+   };
+
+   static bool SendSamples(void *context, const float *samples, size_t n)
+   {
+      auto &state = *static_cast<ReadState*>(context);
+      auto &bytes = state.bytes;
+      bytes.resize(n * 4);
+      for (size_t i = 0; i < n; ++i) {
+         uint32_t bits;
+         memcpy(&bits, &samples[i], sizeof(bits));
+         Put(&bytes[i * 4], bits, 4);
+      }
+      state.remaining -= n;
+      if (!state.connection.Send(state.request,
+            state.remaining > 0 ? 0 : LastFrame, bytes.data(), bytes.size())) {
+         state.sendFailed = true;
+         return false;
+      }
+      return true;
+   }
+
+   bool Handle(const Header &request, const std::vector<unsigned char> &payload)
+   {
+      const auto p = payload.data();
+      const auto len = payload.size();
+      switch (request.type) {
+      case CommandRequest: {
+         wxString in = wxString::FromUTF8((const char *)p, len), out;
+         in.Replace( wxT("\r"), wxT(""));
+         in.Replace( wxT("\n"), wxT(""));
+         mFunctions.execCommand(&in, &out);
+         const auto utf8 = out.ToUTF8();
+         return Send(request, LastFrame, utf8.data(), utf8.length());
+      }
+      case InfoRequest: {
+         if (len != 4)
+            return SendError(request, "Bad Info request");
+         long long length = 0;
+         double rate = 0;
+         if (!mFunctions.getChannelInfo((int32_t)Take(p, 4), &length, &rate))
+            return SendError(request, "No such wave channel");
+         unsigned char bytes[16];
+         Put(bytes, length, 8);
+         uint64_t rateBits;
+         memcpy(&rateBits, &rate, sizeof(rate));
+         Put(bytes + 8, rateBits, 8);
+         return Send(request, LastFrame, bytes, sizeof(bytes));
+      }
+      case ReadRequest: {
+         if (len != 20)
+            return SendError(request, "Bad Read request");
+         const int channel = (int32_t)Take(p, 4);
+         long long start = (int64_t)Take(p + 4, 8);
+         long long count = (int64_t)Take(p + 12, 8);
+         if (start < 0 || count < 0)
+            return SendError(request, "Bad Read request");
+         // The samples come from one snapshot of the channel, and each
+         // piece is sent as a frame, all but the last without flag 1
+         if (count == 0)
+            return Send(request, LastFrame, nullptr, 0);
+         ReadState state{ *this, request, count };
+         if (!mFunctions.readSamples(channel, start, count, SamplesPerFrame,
+               SendSamples, &state))
+            return !state.sendFailed &&
+               SendError(request, "Could not read the samples");
+         return true;
+      }
+      case WriteRequest: {
+         if (len < 12 || (len - 12) % 4 != 0)
+            return SendError(request, "Bad Write request");
+         const int channel = (int32_t)Take(p, 4);
+         const long long start = (int64_t)Take(p + 4, 8);
+         const size_t n = (len - 12) / 4;
+         std::vector<float> samples(n);
+         for (size_t i = 0; i < n; ++i) {
+            const uint32_t bits = (uint32_t)Take(p + 12 + i * 4, 4);
+            memcpy(&samples[i], &bits, sizeof(bits));
+         }
+         if (!mFunctions.writeSamples(channel, start, n, samples.data()))
+            return SendError(request, "Could not write the samples");
+         return Send(request, LastFrame, nullptr, 0);
+      }
+      default:
+         return SendError(request, "Unknown request type");
+      }
+   }
+
+   const int mFd;
+   const ScriptServerFunctions &mFunctions;
+};
+
+// Remove a socket left by an instance that is gone, but not one that a
+// live server still owns, nor anything but a socket of this user.  Returns
+// whether the name is free to bind.
+bool ClaimSocketName(const sockaddr_un &address)
+{
+   struct stat status;
+   if (lstat(address.sun_path, &status) != 0)
+      return errno == ENOENT;
+   if (!S_ISSOCK(status.st_mode) || status.st_uid != getuid())
+      return false;
+
+   int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (probe < 0)
+      return false;
+   const bool stale =
+      connect(probe, (const sockaddr *)&address, sizeof(address)) != 0 &&
+      errno == ECONNREFUSED;
+   close(probe);
+   if (!stale)
+      return false;
+
+   return unlink(address.sun_path) == 0 || errno == ENOENT;
+}
+
+}
+
+void SocketServer(const ScriptServerFunctions *pFunctions)
+{
+   char socketName[sizeof(sockaddr_un::sun_path)];
+   snprintf(socketName, sizeof(socketName), sockettmpl, (int)getuid());
+
+   sockaddr_un address{};
+   address.sun_family = AF_UNIX;
+   strncpy(address.sun_path, socketName, sizeof(address.sun_path) - 1);
+
+   if (!ClaimSocketName(address))
+   {
+      fprintf(stderr,
+         "Script socket %s is in use, or is not a socket\n", socketName);
+      // Don't spin in the loop of ScriptCommandRelay
+      pause();
+      return;
+   }
+
+   int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (listener < 0)
+   {
+      perror("Unable to create script socket");
+      pause();
+      return;
+   }
+
+   // Only this user may connect.  Nothing can connect before listen(), so
+   // the socket is restricted in between, without changing the umask of the
+   // whole process.
+   if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 ||
+       chmod(socketName, S_IRUSR | S_IWUSR) != 0 ||
+       listen(listener, 1) != 0)
+   {
+      perror("Unable to listen on script socket");
+      close(listener);
+      pause();
+      return;
+   }
+
+   while (true)
+   {
+      int fd = accept(listener, nullptr, nullptr);
+      if (fd < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         break;
+      }
+#ifdef SO_NOSIGPIPE
+      int on = 1;
+      setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+      Connection{ fd, *pFunctions }.Serve();
+      close(fd);
+   }
+
+   close(listener);
+   unlink(socketName);
+}
+
+#endif
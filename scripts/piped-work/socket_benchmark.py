@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""Measures the binary script socket of mod-script-pipe.
+
+Sends a batch of pipelined commands and reports commands per second, then,
+if the project has a wave track, reads and writes its first channel and
+reports megabytes per second.  The framing is described at the top of
+lib-src/mod-script-pipe/SocketServer.cpp.
+
+Make sure Audacity is running first and that mod-script-pipe is enabled
+before running this script.  Linux and Mac only.  Requires Python 3.
+
+    python3 socket_benchmark.py [commands] [seconds of samples to read]
+
+"""
+
+import array
+import collections
+import os
+import socket
+import struct
+import sys
+import time
+
+SOCKETNAME = '/tmp/audacity_script_socket.' + str(os.getuid())
+
+HEADER = struct.Struct('<IIHH')
+COMMAND, INFO, READ, WRITE = 1, 2, 3, 4
+LAST_FRAME, ERROR_FRAME = 1, 2
+
+
+class SocketClient():
+    """Sends requests, which may be pipelined, and collects responses."""
+
+    def __init__(self, name=SOCKETNAME):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(name)
+        self.next_id = 1
+
+    def send(self, kind, payload=b''):
+        """Send a request without waiting, and return its id."""
+        request_id = self.next_id
+        self.next_id += 1
+        self.sock.sendall(HEADER.pack(len(payload), request_id, kind, 0)
+                          + payload)
+        return request_id
+
+    def _read_exactly(self, size):
+        data = bytearray(size)
+        view = memoryview(data)
+        while size > 0:
+            got = self.sock.recv_into(view, size)
+            if got == 0:
+                raise EOFError('Audacity closed the socket')
+            view = view[got:]
+            size -= got
+        return data
+
+    def receive(self, request_id):
+        """Collect all frames of the response to the request."""
+        parts = []
+        while True:
+            length, got_id, _, flags = HEADER.unpack(
+                self._read_exactly(HEADER.size))
+            payload = self._read_exactly(length)
+            if got_id != request_id:
+                raise RuntimeError('Response out of order')
+            if flags & ERROR_FRAME:
+                raise RuntimeError(payload.decode('utf-8'))
+            parts.append(payload)
+            if flags & LAST_FRAME:
+                return b''.join(parts)
+
+    def command(self, text):
+        return self.receive(self.send(COMMAND, text.encode('utf-8'))) \
+            .decode('utf-8')
+
+    def info(self, channel):
+        return struct.unpack('<qd', self.receive(
+            self.send(INFO, struct.pack('<i', channel))))
+
+    def read(self, channel, start, count):
+        samples = array.array('f')
+        samples.frombytes(self.receive(
+            self.send(READ, struct.pack('<iqq', channel, start, count))))
+        if sys.byteorder != 'little':
+            samples.byteswap()
+        return samples
+
+    def write(self, channel, start, samples):
+        if sys.byteorder != 'little':
+            samples = array.array('f', samples)
+            samples.byteswap()
+        self.receive(self.send(
+            WRITE, struct.pack('<iq', channel, start) + samples.tobytes()))
+
+
+def benchmark_commands(client, count, window=64):
+    # Keep a bounded number of requests in flight, lest both ends block
+    # in writing, with the socket full of responses that nobody reads
+    start = time.perf_counter()
+    pending = collections.deque()
+    for _ in range(count):
+        if len(pending) == window:
+            client.receive(pending.popleft())
+        pending.append(client.send(COMMAND, b'Help: Command=Help'))
+    while pending:
+        client.receive(pending.popleft())
+    elapsed = time.perf_counter() - start
+    print('%d pipelined commands in %.3f s: %.0f commands/s'
+          % (count, elapsed, count / elapsed))
+
+
+def benchmark_samples(client, seconds):
+    try:
+        length, rate = client.info(0)
+    except RuntimeError:
+        print('No wave track; skipping the sample transfers')
+        return
+    count = min(length, int(seconds * rate))
+    if count == 0:
+        print('The track is empty; skipping the sample transfers')
+        return
+    megabytes = count * 4 / 1e6
+
+    start = time.perf_counter()
+    samples = client.read(0, 0, count)
+    elapsed = time.perf_counter() - start
+    print('Read %d samples in %.3f s: %.1f MB/s'
+          % (count, elapsed, megabytes / elapsed))
+
+    start = time.perf_counter()
+    client.write(0, 0, samples)
+    elapsed = time.perf_counter() - start
+    print('Wrote %d samples in %.3f s: %.1f MB/s'
+          % (count, elapsed, megabytes / elapsed))
+    # The samples are unchanged, but the write is an undoable step
+    client.command('Undo:')
+
+
+def main():
+    commands = int(sys.argv[1]) if len(sys.argv) > 1 else 1000
+    seconds = float(sys.argv[2]) if len(sys.argv) > 2 else 60.0
+    if not os.path.exists(SOCKETNAME):
+        print(SOCKETNAME + ' does not exist.  '
+              'Ensure Audacity is running with mod-script-pipe.')
+        sys.exit()
+    client = SocketClient()
+    benchmark_commands(client, commands)
+    benchmark_samples(client, seconds)
+
+
+if __name__ == '__main__':
+    main()
@@ -105,7 +105,9 @@
 
 // Don't change this unless the file format changes
 // in an irrevocable way
-#define AUDACITY_FILE_FORMAT_VERSION "1.3.0"
+// 1.3.1:  <packedblockfile> and <viewblockfile>, which older versions
+// would skip, losing their samples
+#define AUDACITY_FILE_FORMAT_VERSION "1.3.1"
 
 class wxWindow;
 
@@ -92,6 +92,7 @@ It handles initialization and termination by subclassing wxApp.
 #include "ProjectWindow.h"
 #include "Screenshot.h"
 #include "Sequence.h"
+#include "WaveClip.h"
 #include "WaveTrack.h"
 #include "prefs/PrefsDialog.h"
 #include "Theme.h"
@@ -535,6 +536,9 @@ static void QuitAudacity(bool bForce)
    //release ODManager Threads
    ODManager::Quit();
 
+   // and the thread of waveform columns, which posts events to the app
+   WaveClip::StopBackgroundWork();
+
    //print out profile if we have one by deleting it
    //temporarily commented out till it is added to all projects
    //DELETE Profiler::Instance();
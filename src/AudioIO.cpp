@@ -427,6 +427,8 @@ time warp info and AudioIOListener and whether the playback is looped.
 #include <math.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <chrono>
+#include <numeric>
 
 #ifdef __WXMSW__
 #include <malloc.h>
@@ -457,11 +459,13 @@ time warp info and AudioIOListener and whether the playback is looped.
 #include "Mix.h"
 #include "Resample.h"
 #include "RingBuffer.h"
+#include "ThreadPool.h"
 #include "prefs/GUISettings.h"
 #include "Prefs.h"
 #include "Project.h"
 #include "WaveTrack.h"
 #include "AutoRecovery.h"
+#include "blockfile/BlockWriter.h"
 
 #include "effects/RealtimeEffectManager.h"
 #include "prefs/QualityPrefs.h"
@@ -1491,6 +1495,8 @@ int AudioIO::StartStream(const TransportTracks &tracks,
    mLostCaptureIntervals.clear();
    mDetectDropouts =
       gPrefs->Read( WarningDialogKey(wxT("DropoutDetected")), true ) != 0;
+   if (!tracks.captureTracks.empty())
+      BlockWriter::Get().ResetStatistics();
    auto cleanup = finally ( [this] { ClearRecordingException(); } );
 
    if( IsBusy() )
@@ -1583,9 +1589,9 @@ int AudioIO::StartStream(const TransportTracks &tracks,
       }
    });
 
-   mPlaybackBuffers.reset();
+   mPlaybackBuffer.reset();
    mPlaybackMixers.reset();
-   mCaptureBuffers.reset();
+   mCaptureBuffer.reset();
    mResample.reset();
    mTimeQueue.mData.reset();
 
@@ -1886,7 +1892,13 @@ bool AudioIO::AllocateBuffers(
             auto playbackBufferSize =
                (size_t)lrint(mRate * mPlaybackRingBufferSecs);
 
-            mPlaybackBuffers.reinit(mPlaybackTracks.size());
+            mPlaybackBuffer = std::make_unique<InterleavedRingBuffer>(
+               floatSample, mPlaybackTracks.size(), playbackBufferSize);
+            mPlaybackFillTimes.assign(mPlaybackTracks.size(), {});
+            mPlaybackProcessed.assign(mPlaybackTracks.size(), 0);
+            mPlaybackFillOrder.resize(mPlaybackTracks.size());
+            std::iota(
+               mPlaybackFillOrder.begin(), mPlaybackFillOrder.end(), 0);
             mPlaybackMixers.reinit(mPlaybackTracks.size());
 
             const Mixer::WarpOptions &warpOptions =
@@ -1916,8 +1928,6 @@ bool AudioIO::AllocateBuffers(
                mPlaybackTracks[i]->SetOldChannelGain(0, 0.0);
                mPlaybackTracks[i]->SetOldChannelGain(1, 0.0);
 
-               mPlaybackBuffers[i] =
-                  std::make_unique<RingBuffer>(floatSample, playbackBufferSize);
                const auto timeQueueSize =
                   (playbackBufferSize + TimeQueueGrainSize - 1)
                      / TimeQueueGrainSize;
@@ -1969,14 +1979,16 @@ bool AudioIO::AllocateBuffers(
                return false;
             }
 
-            mCaptureBuffers.reinit(mCaptureTracks.size());
+            // The callback stores whole frames as the device delivers them;
+            // conversion to the formats of the tracks happens in
+            // FillBuffers
+            mCaptureBuffer = std::make_unique<InterleavedRingBuffer>(
+               mCaptureFormat, mNumCaptureChannels, captureBufferSize );
             mResample.reinit(mCaptureTracks.size());
             mFactor = sampleRate / mRate;
 
             for( unsigned int i = 0; i < mCaptureTracks.size(); i++ )
             {
-               mCaptureBuffers[i] = std::make_unique<RingBuffer>(
-                  mCaptureTracks[i]->GetSampleFormat(), captureBufferSize );
                mResample[i] =
                   std::make_unique<Resample>(true, mFactor, mFactor);
                   // constant rate resampling
@@ -2017,9 +2029,9 @@ void AudioIO::StartStreamCleanup(bool bOnlyBuffers)
       RealtimeEffectManager::Get().RealtimeFinalize();
    }
 
-   mPlaybackBuffers.reset();
+   mPlaybackBuffer.reset();
    mPlaybackMixers.reset();
-   mCaptureBuffers.reset();
+   mCaptureBuffer.reset();
    mResample.reset();
    mTimeQueue.mData.reset();
 
@@ -2328,7 +2340,8 @@ void AudioIO::StopStream()
 
       if (mPlaybackTracks.size() > 0)
       {
-         mPlaybackBuffers.reset();
+         LogPlaybackFillTimes();
+         mPlaybackBuffer.reset();
          mPlaybackMixers.reset();
          mTimeQueue.mData.reset();
       }
@@ -2338,7 +2351,7 @@ void AudioIO::StopStream()
       //
       if (mCaptureTracks.size() > 0)
       {
-         mCaptureBuffers.reset();
+         mCaptureBuffer.reset();
          mResample.reset();
 
          //
@@ -2371,6 +2384,8 @@ void AudioIO::StopStream()
             } );
          }
 
+         LogCaptureStatistics();
+
          for (auto &interval : mLostCaptureIntervals) {
             auto &start = interval.first;
             auto duration = interval.second;
@@ -2628,12 +2643,112 @@ MidiThread::ExitCode MidiThread::Entry()
 }
 #endif
 
+void AudioIO::FillPlaybackTracks(size_t frames, size_t toProcess)
+{
+   using Clock = std::chrono::steady_clock;
+
+   // Write all the tracks in place into the frames reserved in the ring
+   // buffer, then publish them together
+   const auto spans = mPlaybackBuffer->GetWritable(frames);
+   // wxASSERT(spans.Frames() == frames);
+   // but we can't assert in this thread
+
+   const auto numPlaybackTracks = mPlaybackTracks.size();
+   const auto fill = [&](size_t i) {
+      const auto start = Clock::now();
+
+      // The mixer here isn't actually mixing: it's just doing
+      // resampling, format conversion, and possibly time track
+      // warping
+      size_t processed = 0;
+      if ( toProcess )
+         processed = mPlaybackMixers[i]->Process( toProcess );
+      //wxASSERT(processed <= toProcess);
+
+      // Each job writes only its own entries, and its own mixer's buffer
+      mPlaybackProcessed[i] = processed;
+      auto &time = mPlaybackFillTimes[i];
+      time.last = std::chrono::duration<double>{ Clock::now() - start }.count();
+      time.total += time.last;
+      time.max = std::max(time.max, time.last);
+      ++time.count;
+   };
+
+   if (numPlaybackTracks > 2 && ThreadPool::DefaultThreadCount() > 0) {
+      if (!mFillPool)
+         mFillPool =
+            std::make_unique<ThreadPool>(ThreadPool::DefaultThreadCount());
+
+      // Start the tracks that were slowest last time first, so that the
+      // last to finish is a quick one, and the join comes soonest
+      std::sort(mPlaybackFillOrder.begin(), mPlaybackFillOrder.end(),
+         [this](size_t a, size_t b){
+            return mPlaybackFillTimes[a].last > mPlaybackFillTimes[b].last;
+         });
+      mFillPool->Run(mPlaybackFillOrder, fill);
+   }
+   else
+      for (size_t i = 0; i < numPlaybackTracks; i++)
+         fill(i);
+
+   // Interleave on this thread only, after the join, so that the jobs never
+   // write to the same cache lines
+   for (size_t i = 0; i < numPlaybackTracks; i++)
+      mPlaybackBuffer->PutChannel(spans, i,
+         mPlaybackMixers[i]->GetBuffer(), floatSample, mPlaybackProcessed[i]);
+
+   mPlaybackBuffer->CommitPut(spans.Frames());
+}
+
+void AudioIO::LogPlaybackFillTimes()
+{
+   const auto numPlaybackTracks =
+      std::min(mPlaybackTracks.size(), mPlaybackFillTimes.size());
+   if (numPlaybackTracks < 2)
+      return;
+
+   std::vector<size_t> order(numPlaybackTracks);
+   std::iota(order.begin(), order.end(), 0);
+   std::sort(order.begin(), order.end(), [this](size_t a, size_t b){
+      return mPlaybackFillTimes[a].total > mPlaybackFillTimes[b].total;
+   });
+
+   const size_t maxReported = 10;
+   wxLogMessage(wxT("Playback buffer fill times of the slowest tracks:"));
+   for (size_t ii = 0; ii < std::min(maxReported, order.size()); ++ii) {
+      const auto i = order[ii];
+      const auto &time = mPlaybackFillTimes[i];
+      if (time.count == 0)
+         break;
+      wxLogMessage(wxT("   %s: mean %.3f ms, max %.3f ms over %lld passes"),
+         mPlaybackTracks[i]->GetName(),
+         1000 * time.total / time.count, 1000 * time.max,
+         (long long)time.count);
+   }
+}
+
+void AudioIO::LogCaptureStatistics()
+{
+   wxLogMessage(wxT("Recording: %lld dropouts, %lld samples lost"),
+      (long long)mLostCaptureIntervals.size(), (long long)mLostSamples);
+
+   const auto stats = BlockWriter::Get().GetStatistics();
+   if (stats.batches == 0 && stats.synchronous == 0)
+      return;
+   wxLogMessage(wxT("   Block writer: %lld files in %lld batches, slowest %.1f ms"),
+      (long long)stats.written, (long long)stats.batches,
+      1000 * stats.maxWriteTime);
+   wxLogMessage(wxT("   Peak queue: %lld files, %.1f MB"),
+      (long long)stats.peakBlocks, stats.peakBytes / 1048576.0);
+   if (stats.synchronous > 0 || stats.failures > 0)
+      wxLogMessage(
+         wxT("   %lld files written while appending, the queue being full; %lld failed"),
+         (long long)stats.synchronous, (long long)stats.failures);
+}
+
 size_t AudioIO::GetCommonlyFreePlayback()
 {
-   auto commonlyAvail = mPlaybackBuffers[0]->AvailForPut();
-   for (unsigned i = 1; i < mPlaybackTracks.size(); ++i)
-      commonlyAvail = std::min(commonlyAvail,
-         mPlaybackBuffers[i]->AvailForPut());
+   auto commonlyAvail = mPlaybackBuffer->AvailForPut();
    // MB: subtract a few samples because the code in FillBuffers has rounding
    // errors
    return commonlyAvail - std::min(size_t(10), commonlyAvail);
@@ -2644,20 +2759,12 @@ size_t AudioIoCallback::GetCommonlyReadyPlayback()
    if (mPlaybackTracks.empty())
       return 0;
 
-   auto commonlyAvail = mPlaybackBuffers[0]->AvailForGet();
-   for (unsigned i = 1; i < mPlaybackTracks.size(); ++i)
-      commonlyAvail = std::min(commonlyAvail,
-         mPlaybackBuffers[i]->AvailForGet());
-   return commonlyAvail;
+   return mPlaybackBuffer->AvailForGet();
 }
 
 size_t AudioIO::GetCommonlyAvailCapture()
 {
-   auto commonlyAvail = mCaptureBuffers[0]->AvailForGet();
-   for (unsigned i = 1; i < mCaptureTracks.size(); ++i)
-      commonlyAvail = std::min(commonlyAvail,
-         mCaptureBuffers[i]->AvailForGet());
-   return commonlyAvail;
+   return mCaptureBuffer->AvailForGet();
 }
 
 // This method is the data gateway between the audio thread (which
@@ -2776,27 +2883,8 @@ void AudioIO::FillBuffers()
                (mPlaybackSchedule.Interactive() ? mScrubSpeed : 1.0),
                frames);
 
-            for (i = 0; i < mPlaybackTracks.size(); i++)
-            {
-               // The mixer here isn't actually mixing: it's just doing
-               // resampling, format conversion, and possibly time track
-               // warping
-               samplePtr warpedSamples;
-
-               if (frames > 0)
-               {
-                  size_t processed = 0;
-                  if ( toProcess )
-                     processed = mPlaybackMixers[i]->Process( toProcess );
-                  //wxASSERT(processed <= toProcess);
-                  warpedSamples = mPlaybackMixers[i]->GetBuffer();
-                  const auto put = mPlaybackBuffers[i]->Put(
-                     warpedSamples, floatSample, processed, frames - processed);
-                  // wxASSERT(put == frames);
-                  // but we can't assert in this thread
-                  wxUnusedVar(put);
-               }               
-            }
+            if (frames > 0)
+               FillPlaybackTracks(frames, toProcess);
 
             available -= frames;
             wxASSERT(available >= 0);
@@ -2896,12 +2984,32 @@ void AudioIO::FillBuffers()
             AutoSaveFile blockFileLog;
             auto numChannels = mCaptureTracks.size();
 
+            // All channels share one ring buffer, so leftward latency
+            // correction discards for all of them at once
+            size_t discarded = 0;
+            if (!mRecordingSchedule.mLatencyCorrected &&
+                mRecordingSchedule.TotalCorrection() < 0) {
+               size_t size = floor(
+                  mRecordingSchedule.ToDiscard() * mRate );
+
+               // The ring buffer might have grown concurrently -- don't discard more
+               // than the "avail" value noted above.
+               discarded = mCaptureBuffer->Discard(std::min(avail, size));
+
+               if (discarded < size)
+                  // We need to visit this again to complete the
+                  // discarding.
+                  latencyCorrected = false;
+            }
+
+            wxASSERT(discarded <= avail);
+            const size_t toConsume = avail - discarded;
+
             for( i = 0; i < numChannels; i++ )
             {
                sampleFormat trackFormat = mCaptureTracks[i]->GetSampleFormat();
 
                AutoSaveFile appendLog;
-               size_t discarded = 0;
 
                if (!mRecordingSchedule.mLatencyCorrected) {
                   const auto correction = mRecordingSchedule.TotalCorrection();
@@ -2915,21 +3023,6 @@ void AudioIO::FillBuffers()
                      mCaptureTracks[i]->Append(temp.ptr(), trackFormat,
                                                size, 1, &appendLog);
                   }
-                  else {
-                     // Leftward shift
-                     // discard some samples from the ring buffers.
-                     size_t size = floor(
-                        mRecordingSchedule.ToDiscard() * mRate );
-
-                     // The ring buffer might have grown concurrently -- don't discard more
-                     // than the "avail" value noted above.
-                     discarded = mCaptureBuffers[i]->Discard(std::min(avail, size));
-
-                     if (discarded < size)
-                        // We need to visit this again to complete the
-                        // discarding.
-                        latencyCorrected = false;
-                  }
                }
 
                const float *pCrossfadeSrc = nullptr;
@@ -2948,8 +3041,7 @@ void AudioIO::FillBuffers()
                   }
                }
 
-               wxASSERT(discarded <= avail);
-               size_t toGet = avail - discarded;
+               size_t toGet = toConsume;
                SampleBuffer temp;
                size_t size;
                sampleFormat format;
@@ -2964,7 +3056,7 @@ void AudioIO::FillBuffers()
                      format = trackFormat;
                   temp.Allocate(size, format);
                   const auto got =
-                     mCaptureBuffers[i]->Get(temp.ptr(), format, toGet);
+                     mCaptureBuffer->GetChannel(i, temp.ptr(), format, toGet);
                   // wxASSERT(got == toGet);
                   // but we can't assert in this thread
                   wxUnusedVar(got);
@@ -2978,7 +3070,7 @@ void AudioIO::FillBuffers()
                   SampleBuffer temp1(toGet, floatSample);
                   temp.Allocate(size, format);
                   const auto got =
-                     mCaptureBuffers[i]->Get(temp1.ptr(), floatSample, toGet);
+                     mCaptureBuffer->GetChannel(i, temp1.ptr(), floatSample, toGet);
                   // wxASSERT(got == toGet);
                   // but we can't assert in this thread
                   wxUnusedVar(got);
@@ -3030,6 +3122,9 @@ void AudioIO::FillBuffers()
                }
             } // end loop over capture channels
 
+            // All channels have been read
+            mCaptureBuffer->Discard(toConsume);
+
             // Now update the recording shedule position
             mRecordingSchedule.mPosition += avail / mRate;
             mRecordingSchedule.mLatencyCorrected = latencyCorrected;
@@ -3913,13 +4008,14 @@ bool AudioIoCallback::FillOutputBuffers(
 
       if (dropQuickly)
       {
-         len = mPlaybackBuffers[t]->Discard(framesPerBuffer);
+         // Nothing to copy; the frames are consumed for all tracks below
+         len = toGet;
          // keep going here.  
          // we may still need to issue a paComplete.
       }
       else
       {
-         len = mPlaybackBuffers[t]->Get((samplePtr)tempBufs[chanCnt],
+         len = mPlaybackBuffer->GetChannel(t, (samplePtr)tempBufs[chanCnt],
                                                    floatSample,
                                                    toGet);
          // wxASSERT( len == toGet );
@@ -3984,6 +4080,10 @@ bool AudioIoCallback::FillOutputBuffers(
       chanCnt = 0;
    }
 
+   // Consume the frames of all tracks together
+   if (numPlaybackTracks > 0)
+      mPlaybackBuffer->Discard(toGet);
+
    // Poke: If there are no playback tracks, then the earlier check
    // about the time indicator being past the end won't happen;
    // do it here instead (but not if looping or scrubbing)
@@ -4055,9 +4155,8 @@ void AudioIoCallback::FillInputBuffers(
    // So we have not decided to enable this extra detection yet in
    // production
 
-   size_t len = framesPerBuffer;
-   for(unsigned t = 0; t < numCaptureChannels; t++)
-      len = std::min( len, mCaptureBuffers[t]->AvailForPut() );
+   size_t len = std::min<size_t>(
+      framesPerBuffer, mCaptureBuffer->AvailForPut() );
 
    if (mSimulateRecordingErrors && 100LL * rand() < RAND_MAX)
       // Make spurious errors for purposes of testing the error
@@ -4066,7 +4165,7 @@ void AudioIoCallback::FillInputBuffers(
 
    // A different symptom is that len < framesPerBuffer because
    // the other thread, executing FillBuffers, isn't consuming fast
-   // enough from mCaptureBuffers; maybe it's CPU-bound, or maybe the
+   // enough from mCaptureBuffer; maybe it's CPU-bound, or maybe the
    // storage device it writes is too slow
    if (mDetectDropouts &&
          ((mDetectUpstreamDropouts && inputError) ||
@@ -4089,52 +4188,18 @@ void AudioIoCallback::FillInputBuffers(
    if (len <= 0) 
       return;
 
-   // We have an ASSERT in the AudioIO constructor to alert us to 
-   // possible issues with the (short*) cast.  We'd have a problem if
-   // sizeof(short) > sizeof(float) since our buffers are sized for floats.
-   for(unsigned t = 0; t < numCaptureChannels; t++) {
-
-      // dmazzoni:
-      // Un-interleave.  Ugly special-case code required because the
-      // capture channels could be in three different sample formats;
-      // it'd be nice to be able to call CopySamples, but it can't
-      // handle multiplying by the gain and then clipping.  Bummer.
-
-      switch(mCaptureFormat) {
-         case floatSample: {
-            float *inputFloats = (float *)inputBuffer;
-            for(unsigned i = 0; i < len; i++)
-               tempFloats[i] =
-                  inputFloats[numCaptureChannels*i+t];
-         } break;
-         case int24Sample:
-            // We should never get here. Audacity's int24Sample format
-            // is different from PortAudio's sample format and so we
-            // make PortAudio return float samples when recording in
-            // 24-bit samples.
-            wxASSERT(false);
-            break;
-         case int16Sample: {
-            short *inputShorts = (short *)inputBuffer;
-            short *tempShorts = (short *)tempFloats;
-            for( unsigned i = 0; i < len; i++) {
-               float tmp = inputShorts[numCaptureChannels*i+t];
-               tmp = wxClip( -32768, tmp, 32767 );
-               tempShorts[i] = (short)(tmp);
-            }
-         } break;
-      } // switch
-
-      // JKC: mCaptureFormat must be for samples with sizeof(float) or
-      // fewer bytes (because tempFloats is sized for floats).  All 
-      // formats are 2 or 4 bytes, so we are OK.
-      const auto put =
-         mCaptureBuffers[t]->Put(
-            (samplePtr)tempFloats, mCaptureFormat, len);
-      // wxASSERT(put == len);
-      // but we can't assert in this thread
-      wxUnusedVar(put);
-   }
+   // Store the interleaved frames as they are.  De-interleaving and
+   // conversion to the formats of the tracks happen in FillBuffers, not in
+   // this real-time thread.
+   // Audacity's int24Sample format is different from PortAudio's sample
+   // format, so we make PortAudio return float samples when recording in
+   // 24-bit samples.
+   wxASSERT(mCaptureFormat != int24Sample);
+   const auto put =
+      mCaptureBuffer->Put( (samplePtr)inputBuffer, len );
+   // wxASSERT(put == len);
+   // but we can't assert in this thread
+   wxUnusedVar(put);
 }
 
 
@@ -4489,10 +4554,12 @@ PaStreamCallbackResult AudioIoCallback::CallbackDoSeek()
    {
       const bool skipping = true;
       mPlaybackMixers[i]->Reposition( time, skipping );
+   }
+   if (numPlaybackTracks > 0) {
       const auto toDiscard =
-         mPlaybackBuffers[i]->AvailForGet();
+         mPlaybackBuffer->AvailForGet();
       const auto discarded =
-         mPlaybackBuffers[i]->Discard( toDiscard );
+         mPlaybackBuffer->Discard( toDiscard );
       // wxASSERT( discarded == toDiscard );
       // but we can't assert in this thread
       wxUnusedVar(discarded);
@@ -21,6 +21,7 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 #include <wx/atomic.h> // member variable
 
 #ifdef USE_MIDI
@@ -48,10 +49,11 @@ using NoteTrackConstArray = std::vector < std::shared_ptr< const NoteTrack > >;
 class wxArrayString;
 class AudioIOBase;
 class AudioIO;
-class RingBuffer;
+class InterleavedRingBuffer;
 class Mixer;
 class Resample;
 class AudioThread;
+class ThreadPool;
 class SelectedRegion;
 
 class AudacityProject;
@@ -419,9 +421,11 @@ public:
 #endif
 #endif
    ArrayOf<std::unique_ptr<Resample>> mResample;
-   ArrayOf<std::unique_ptr<RingBuffer>> mCaptureBuffers;
+   // One channel for each capture track, in the capture format
+   std::unique_ptr<InterleavedRingBuffer> mCaptureBuffer;
    WaveTrackArray      mCaptureTracks;
-   ArrayOf<std::unique_ptr<RingBuffer>> mPlaybackBuffers;
+   // One channel for each playback track
+   std::unique_ptr<InterleavedRingBuffer> mPlaybackBuffer;
    WaveTrackArray      mPlaybackTracks;
 
    ArrayOf<std::unique_ptr<Mixer>> mPlaybackMixers;
@@ -782,6 +786,45 @@ private:
      *
      * If bOnlyBuffers is specified, it only cleans up the buffers. */
    void StartStreamCleanup(bool bOnlyBuffers = false);
+
+   /** \brief Read, resample and apply gain for all playback tracks, in
+    * parallel when there are several, writing into the reserved frames of
+    * the playback buffer */
+   void FillPlaybackTracks(size_t frames, size_t toProcess);
+
+   /** \brief Write the fill times of the slowest playback tracks to the log */
+   void LogPlaybackFillTimes();
+
+   /** \brief Write the dropouts of the recording, and the statistics of
+    * the background writing of its block files, to the log */
+   void LogCaptureStatistics();
+
+   // Workers for FillPlaybackTracks, made when first needed
+   std::unique_ptr<ThreadPool> mFillPool;
+   // Samples produced by each playback mixer in the current pass
+   std::vector<size_t> mPlaybackProcessed;
+
+public:
+   /// Time spent filling the playback buffer for one track
+   struct FillTime {
+      double last{ 0 };  // seconds, in the most recent pass
+      double total{ 0 }; // seconds
+      double max{ 0 };   // seconds
+      size_t count{ 0 }; // passes
+   };
+
+   /** \brief Fill times of the playback tracks of the current or most
+    * recent stream, in the order of the tracks.
+    *
+    * Only meaningful while the audio thread is not filling buffers */
+   const std::vector<FillTime> &GetPlaybackFillTimes() const
+   { return mPlaybackFillTimes; }
+
+private:
+   std::vector<FillTime> mPlaybackFillTimes;
+   // Track indices, slowest first by the previous pass, which is the order
+   // in which to start them
+   std::vector<size_t> mPlaybackFillOrder;
 };
 
 static constexpr unsigned ScrubPollInterval_ms = 50;
@@ -69,7 +69,8 @@ int RecordingRecoveryHandler::FindTrack() const
 bool RecordingRecoveryHandler::HandleXMLTag(const wxChar *tag,
                                             const wxChar **attrs)
 {
-   if (wxStrcmp(tag, wxT("simpleblockfile")) == 0)
+   if (wxStrcmp(tag, wxT("simpleblockfile")) == 0 ||
+       wxStrcmp(tag, wxT("packedblockfile")) == 0)
    {
       // Check if we have a valid channel and numchannels
       if (mChannel < 0 || mNumChannels < 0 || mChannel >= mNumChannels)
@@ -163,7 +164,8 @@ bool RecordingRecoveryHandler::HandleXMLTag(const wxChar *tag,
 
 void RecordingRecoveryHandler::HandleXMLEndTag(const wxChar *tag)
 {
-   if (wxStrcmp(tag, wxT("simpleblockfile")) == 0)
+   if (wxStrcmp(tag, wxT("simpleblockfile")) == 0 ||
+       wxStrcmp(tag, wxT("packedblockfile")) == 0)
       // Still in inner loop
       return;
 
@@ -189,7 +191,8 @@ void RecordingRecoveryHandler::HandleXMLEndTag(const wxChar *tag)
 
 XMLTagHandler* RecordingRecoveryHandler::HandleXMLChild(const wxChar *tag)
 {
-   if (wxStrcmp(tag, wxT("simpleblockfile")) == 0)
+   if (wxStrcmp(tag, wxT("simpleblockfile")) == 0 ||
+       wxStrcmp(tag, wxT("packedblockfile")) == 0)
       return this; // HandleXMLTag also handles <simpleblockfile>
 
    return NULL;
@@ -406,6 +409,17 @@ bool AutoSaveFile::Append(wxFFile & file) const
    return success;
 }
 
+std::vector<char> AutoSaveFile::GetAppendBytes() const
+{
+   std::vector<char> bytes;
+   for (const auto buf : { mDict.GetOutputStreamBuffer(),
+                           mBuffer.GetOutputStreamBuffer() }) {
+      const auto start = static_cast<const char*>(buf->GetBufferStart());
+      bytes.insert(bytes.end(), start, start + buf->GetIntPosition());
+   }
+   return bytes;
+}
+
 void AutoSaveFile::CheckSpace(wxMemoryOutputStream & os)
 {
    wxStreamBuffer *buf = os.GetOutputStreamBuffer();
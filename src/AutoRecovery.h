@@ -16,6 +16,7 @@
 #include <wx/mstream.h> // member variables
 
 #include <unordered_map>
+#include <vector>
 #include "audacity/Types.h"
 
 class wxFFile;
@@ -86,6 +87,8 @@ public:
 
    bool Write(wxFFile & file) const;
    bool Append(wxFFile & file) const;
+   // The bytes that Append() writes, to be written later
+   std::vector<char> GetAppendBytes() const;
 
    bool IsEmpty() const;
 
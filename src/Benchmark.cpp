@@ -40,6 +40,7 @@ of the BlockFile system.
 #include "WaveClip.h"
 #include "WaveTrack.h"
 #include "Sequence.h"
+#include "blockfile/MappedFileCache.h"
 #include "Prefs.h"
 #include "ProjectSettings.h"
 #include "ViewInfo.h"
@@ -564,6 +565,35 @@ void BenchmarkDialog::OnRun( wxCommandEvent & WXUNUSED(event))
    Printf( XO("At 44100 Hz, 16-bits per sample, the estimated number of\n simultaneous tracks that could be played at once: %.1f\n" )
       .Format( (nChunks*chunkSize/44100.0)/(elapsed/1000.0) ) );
 
+   {
+      // Compare reading through libsndfile with reading from memory
+      // mappings of the block files
+      const bool wasMapped = MappedFileCache::IsEnabled();
+      auto restoreMapping = finally( [&] {
+         MappedFileCache::SetEnabled(wasMapped);
+      } );
+
+      const double megabytes = nChunks*chunkSize*sizeof(short)/1048576.0;
+      for (const bool mapped : { false, true }) {
+         MappedFileCache::SetEnabled(mapped);
+
+         wxTheApp->Yield();
+         FlushPrint();
+
+         timer.Start();
+         for (size_t i = 0; i < nChunks; i++)
+            t->Get((samplePtr)block.get(), int16Sample,
+                   i * chunkSize, chunkSize);
+         elapsed = timer.Time();
+
+         Printf( ( mapped
+            ? XO("Time to read all data with memory mapping: %ld ms (%.1f MB/s)\n")
+            : XO("Time to read all data with libsndfile: %ld ms (%.1f MB/s)\n") )
+               .Format( elapsed,
+                  megabytes / std::max(elapsed, 1L) * 1000.0 ) );
+      }
+   }
+
    goto success;
 
  fail:
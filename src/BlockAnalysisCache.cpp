@@ -0,0 +1,153 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockAnalysisCache.cpp
+
+*******************************************************************//**
+
+\class BlockAnalysisCache
+\brief Remembers what effects learned by reading blocks, so that they
+need not read them again.
+
+The summary of each block already holds its minimum, maximum and RMS.
+This adds the sum of the samples, for Normalize's DC offset, and the
+runs of clipped samples, for Find Clipping.  Blocks are immutable, so a
+measurement stays good for the life of the block.
+
+Measurements that do not decompose into blocks, such as the gated
+loudness of EBU R128, are kept instead under a key naming exactly the
+blocks and samples analysed.  Blocks are named by serial number, never
+reused, so a key can never name different audio.
+
+Both lists are bounded, and the least recently used entries are
+evicted first.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "BlockAnalysisCache.h"
+
+#include <cmath>
+
+#include "BlockFile.h"
+
+namespace {
+// Entries are small, unless a block is badly clipped
+constexpr size_t MaxAnalyses = 16384;
+constexpr size_t MaxResults = 64;
+}
+
+BlockAnalysisCache &BlockAnalysisCache::Get()
+{
+   // Never destroyed, because block files may outlive other statics
+   static auto theCache = safenew BlockAnalysisCache;
+   return *theCache;
+}
+
+auto BlockAnalysisCache::Analyse(const BlockFile &file, bool mayThrow)
+   -> AnalysisPtr
+{
+   const auto serial = file.GetSerial();
+   {
+      ODLocker locker{ &mLock };
+      auto iter = mIndex.find(serial);
+      if (iter != mIndex.end()) {
+         // Move to the front
+         mEntries.splice(mEntries.begin(), mEntries, iter->second);
+         return iter->second->second;
+      }
+   }
+
+   if (!file.IsDataAvailable())
+      return {};
+
+   // Read and measure without the lock
+   const auto len = file.GetLength();
+   Floats buffer{ len };
+   if (file.ReadData((samplePtr)buffer.get(), floatSample, 0, len, mayThrow)
+       != len)
+      return {};
+
+   auto analysis = std::make_shared<Analysis>();
+   analysis->length = len;
+   double sum = 0.0;
+   bool clipping = false;
+   for (size_t ii = 0; ii < len; ++ii) {
+      const auto v = buffer[ii];
+      sum += v;
+      if (fabs(v) >= MAX_AUDIO) {
+         if (clipping)
+            ++analysis->clipRuns.back().second;
+         else
+            analysis->clipRuns.emplace_back(ii, 1);
+         clipping = true;
+      }
+      else
+         clipping = false;
+   }
+   analysis->sum = sum;
+
+   ODLocker locker{ &mLock };
+   if (mIndex.count(serial))
+      // Another thread was quicker
+      return analysis;
+
+   mEntries.emplace_front(serial, analysis);
+   mIndex[serial] = mEntries.begin();
+   if (mEntries.size() > MaxAnalyses) {
+      mIndex.erase(mEntries.back().first);
+      mEntries.pop_back();
+   }
+   return analysis;
+}
+
+bool BlockAnalysisCache::FindResult(const ContentKey &key, double &result)
+{
+   ODLocker locker{ &mLock };
+   auto iter = mResultIndex.find(key);
+   if (iter == mResultIndex.end())
+      return false;
+
+   mResults.splice(mResults.begin(), mResults, iter->second);
+   result = iter->second->second;
+   return true;
+}
+
+void BlockAnalysisCache::InsertResult(const ContentKey &key, double result)
+{
+   ODLocker locker{ &mLock };
+   if (mResultIndex.count(key))
+      return;
+
+   mResults.emplace_front(key, result);
+   mResultIndex[key] = mResults.begin();
+   if (mResults.size() > MaxResults) {
+      mResultIndex.erase(mResults.back().first);
+      mResults.pop_back();
+   }
+}
+
+void BlockAnalysisCache::Invalidate(const BlockFile &file)
+{
+   // Results of many blocks are left to age out, because their keys can
+   // never match again
+   ODLocker locker{ &mLock };
+   if (mIndex.empty())
+      return;
+
+   auto iter = mIndex.find(file.GetSerial());
+   if (iter != mIndex.end()) {
+      mEntries.erase(iter->second);
+      mIndex.erase(iter);
+   }
+}
+
+void BlockAnalysisCache::Clear()
+{
+   ODLocker locker{ &mLock };
+   mIndex.clear();
+   mEntries.clear();
+   mResultIndex.clear();
+   mResults.clear();
+}
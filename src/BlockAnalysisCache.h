@@ -0,0 +1,78 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockAnalysisCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_ANALYSIS_CACHE__
+#define __AUDACITY_BLOCK_ANALYSIS_CACHE__
+
+#include "Audacity.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "ondemand/ODTaskThread.h"
+
+class BlockFile;
+
+/// Process-wide cache of measurements of whole blocks, that the block
+/// summaries do not hold, and of results of analyses of many blocks
+class AUDACITY_DLL_API BlockAnalysisCache final
+{
+ public:
+   /// Start and length of each maximal run of samples whose magnitude is
+   /// at least MAX_AUDIO, relative to the start of the block
+   using ClipRuns = std::vector< std::pair<size_t, size_t> >;
+
+   /// Measurements of one block; immutable once cached
+   struct Analysis {
+      size_t length{ 0 };
+      double sum{ 0.0 }; // of the samples, for the DC offset
+      ClipRuns clipRuns;
+   };
+   using AnalysisPtr = std::shared_ptr<const Analysis>;
+
+   /// Names the contents of a stretch of audio: the serial numbers of the
+   /// blocks, and the placement and extent of the samples used
+   using ContentKey = std::vector<unsigned long long>;
+
+   static BlockAnalysisCache &Get();
+
+   BlockAnalysisCache() = default;
+   BlockAnalysisCache(const BlockAnalysisCache&) PROHIBITED;
+   BlockAnalysisCache &operator= (const BlockAnalysisCache&) PROHIBITED;
+
+   /// Measure the block, or find the measurements made before.
+   /// Returns null if the block's data are not available, or it could
+   /// not be read and !mayThrow
+   AnalysisPtr Analyse(const BlockFile &file, bool mayThrow);
+
+   /// Find the result of an analysis of the content named by key
+   bool FindResult(const ContentKey &key, double &result);
+   void InsertResult(const ContentKey &key, double result);
+
+   /// Must be called when the block file is destroyed
+   void Invalidate(const BlockFile &file);
+
+   /// Discard all entries
+   void Clear();
+
+ private:
+   // Keyed by serial number of the block file
+   using Entries = std::list< std::pair< unsigned long long, AnalysisPtr > >;
+   using Results = std::list< std::pair< ContentKey, double > >;
+
+   ODLock mLock;
+   Entries mEntries; // most recently used first
+   std::unordered_map< unsigned long long, Entries::iterator > mIndex;
+   Results mResults; // most recently used first
+   std::map< ContentKey, Results::iterator > mResultIndex;
+};
+
+#endif
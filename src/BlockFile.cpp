@@ -53,6 +53,9 @@ out.
 #include "sndfile.h"
 #include "FileException.h"
 #include "FileFormats.h"
+#include "BlockAnalysisCache.h"
+#include "SampleStats.h"
+#include "SampleBlockCache.h"
 
 // msmeyer: Define this to add debug output via wxPrintf()
 //#define DEBUG_BLOCKFILE
@@ -86,6 +89,11 @@ SummaryInfo::SummaryInfo(size_t samples)
 
 ArrayOf<char> BlockFile::fullSummary;
 
+namespace {
+// Block files may be made in worker threads
+std::atomic<unsigned long long> sNextSerial{ 0 };
+}
+
 /// Initializes the base BlockFile data.  The block is initially
 /// unlocked and its reference count is 1.
 ///
@@ -98,6 +106,7 @@ ArrayOf<char> BlockFile::fullSummary;
 /// @param samples  The number of samples this BlockFile contains.
 BlockFile::BlockFile(wxFileNameWrapper &&fileName, size_t samples):
    mLockCount(0),
+   mSerial(++sNextSerial),
    mFileName(std::move(fileName)),
    mLen(samples),
    mSummaryInfo(samples)
@@ -106,7 +115,7 @@ BlockFile::BlockFile(wxFileNameWrapper &&fileName, size_t samples):
 }
 
 // static
-unsigned long BlockFile::gBlockFileDestructionCount { 0 };
+std::atomic<unsigned long> BlockFile::gBlockFileDestructionCount { 0 };
 
 BlockFile::~BlockFile()
 {
@@ -114,9 +123,20 @@ BlockFile::~BlockFile()
       // PRL: what should be done if this fails?
       wxRemoveFile(mFileName.GetFullPath());
 
+   SampleBlockCache::Get().Invalidate(*this);
+   BlockAnalysisCache::Get().Invalidate(*this);
+
    ++gBlockFileDestructionCount;
 }
 
+void BlockFile::ContentsChanged()
+{
+   SampleBlockCache::Get().Invalidate(*this);
+   BlockAnalysisCache::Get().Invalidate(*this);
+   // Results of analyses that included the old contents can't match again
+   mSerial = ++sNextSerial;
+}
+
 /// Returns the file name of the disk file associated with this
 /// BlockFile.  Not all BlockFiles store their sample data here,
 /// but most BlockFiles have at least their summary data here.
@@ -214,7 +234,6 @@ void BlockFile::CalcSummaryFromBuffer(const float *fbuffer, size_t len,
    decltype(len) sumLen;
 
    float min, max;
-   float sumsq;
    double totalSquares = 0.0;
    double fraction { 0.0 };
 
@@ -223,28 +242,19 @@ void BlockFile::CalcSummaryFromBuffer(const float *fbuffer, size_t len,
    int summaries = 256;
 
    for (decltype(sumLen) i = 0; i < sumLen; i++) {
-      min = fbuffer[i * 256];
-      max = fbuffer[i * 256];
-      sumsq = ((float)min) * ((float)min);
       decltype(len) jcount = 256;
       if (jcount > len - i * 256) {
          jcount = len - i * 256;
          fraction = 1.0 - (jcount / 256.0);
       }
-      for (decltype(jcount) j = 1; j < jcount; j++) {
-         float f1 = fbuffer[i * 256 + j];
-         sumsq += ((float)f1) * ((float)f1);
-         if (f1 < min)
-            min = f1;
-         else if (f1 > max)
-            max = f1;
-      }
+      const auto values =
+         ComputeMinMaxSumsqFromFirst(fbuffer + i * 256, jcount);
 
-      totalSquares += sumsq;
-      float rms = (float)sqrt(sumsq / jcount);
+      totalSquares += values.sumsq;
+      float rms = (float)sqrt(values.sumsq / jcount);
 
-      summary256[i * 3] = min;
-      summary256[i * 3 + 1] = max;
+      summary256[i * 3] = values.min;
+      summary256[i * 3 + 1] = values.max;
       summary256[i * 3 + 2] = rms;  // The rms is correct, but this may be for less than 256 samples in last loop.
    }
    for (auto i = sumLen; i < mSummaryInfo.frames256; i++) {
@@ -263,24 +273,15 @@ void BlockFile::CalcSummaryFromBuffer(const float *fbuffer, size_t len,
    sumLen = (len + 65535) / 65536;
 
    for (decltype(sumLen) i = 0; i < sumLen; i++) {
-      min = summary256[3 * i * 256];
-      max = summary256[3 * i * 256 + 1];
-      sumsq = (float)summary256[3 * i * 256 + 2];
-      sumsq *= sumsq;
-      for (decltype(len) j = 1; j < 256; j++) {   // we can overflow the useful summary256 values here, but have put non-harmful values in them
-         if (summary256[3 * (i * 256 + j)] < min)
-            min = summary256[3 * (i * 256 + j)];
-         if (summary256[3 * (i * 256 + j) + 1] > max)
-            max = summary256[3 * (i * 256 + j) + 1];
-         float r1 = summary256[3 * (i * 256 + j) + 2];
-         sumsq += r1*r1;
-      }
+      // we can overflow the useful summary256 values here, but have put non-harmful values in them
+      const auto values =
+         CombineSummaryTriplesFromFirst(summary256 + 3 * i * 256, 256);
 
       double denom = (i < sumLen - 1) ? 256.0 : summaries - fraction;
-      float rms = (float)sqrt(sumsq / denom);
+      float rms = (float)sqrt(values.sumsq / denom);
 
-      summary64K[i * 3] = min;
-      summary64K[i * 3 + 1] = max;
+      summary64K[i * 3] = values.min;
+      summary64K[i * 3 + 1] = values.max;
       summary64K[i * 3 + 2] = rms;
    }
    for (auto i = sumLen; i < mSummaryInfo.frames64K; i++) {
@@ -382,22 +383,10 @@ auto BlockFile::GetMinMaxRMS(size_t start, size_t len, bool mayThrow)
 
    this->ReadData(blockData.ptr(), floatSample, start, len, mayThrow);
 
-   float min = FLT_MAX;
-   float max = -FLT_MAX;
-   float sumsq = 0;
-
-   for( decltype(len) i = 0; i < len; i++ )
-   {
-      float sample = ((float*)blockData.ptr())[i];
-
-      if( sample > max )
-         max = sample;
-      if( sample < min )
-         min = sample;
-      sumsq += (sample*sample);
-   }
+   const auto values =
+      ComputeMinMaxSumsq((const float *)blockData.ptr(), len);
 
-   return { min, max, (float)sqrt(sumsq/len) };
+   return { values.min, values.max, (float)sqrt(values.sumsq/len) };
 }
 
 /// Retrieves the minimum, maximum, and maximum RMS of this entire
@@ -507,7 +496,7 @@ auto BlockFile::SetMissingAliasFileFound( MissingAliasFileFoundHook hook )
 
 size_t BlockFile::CommonReadData(
    bool mayThrow,
-   const wxFileName &fileName, bool &mSilentLog,
+   const wxFileName &fileName, std::atomic<bool> &mSilentLog,
    const AliasBlockFile *pAliasFile, sampleCount origin, unsigned channel,
    samplePtr data, sampleFormat format, size_t start, size_t len,
    const sampleFormat *pLegacyFormat, size_t legacyLen)
@@ -18,6 +18,7 @@
 
 #include "ondemand/ODTaskThread.h"
 
+#include <atomic>
 #include <functional>
 
 class XMLWriter;
@@ -65,7 +66,8 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
    BlockFile(wxFileNameWrapper &&fileName, size_t samples);
    virtual ~BlockFile();
 
-   static unsigned long gBlockFileDestructionCount;
+   // Block files may be destroyed in worker threads
+   static std::atomic<unsigned long> gBlockFileDestructionCount;
 
    // Reading
 
@@ -123,6 +125,11 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
    size_t GetLength() const { return mLen; }
    void SetLength(size_t newLen) { mLen = newLen; }
 
+   /// A number that no other BlockFile in this process has, or will have,
+   /// so that caches may name the contents of blocks that are gone.  It
+   /// changes when Recover() replaces the contents.
+   unsigned long long GetSerial() const { return mSerial; }
+
    /// Locks this BlockFile, to prevent it from being moved
    virtual void Lock();
    /// Unlock this BlockFile, allowing it to be moved
@@ -145,6 +152,10 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
    /// Returns TRUE if this block references another disk file
    virtual bool IsAlias() const { return false; }
 
+   /// Returns TRUE if this block's data are stored in a BlockPack, not in
+   /// a file of its own
+   virtual bool IsPacked() const { return false; }
+
    /// Returns TRUE if this block's complete summary has been computed and is ready (for OD)
    virtual bool IsSummaryAvailable() const {return true;}
 
@@ -161,6 +172,10 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
    using DiskByteCount = unsigned long long;
    virtual DiskByteCount GetSpaceUsage() const = 0;
 
+   /// The block whose storage holds the samples; not this one, if this
+   /// one only views part of another
+   virtual const BlockFile &GetStorage() const { return *this; }
+
    /// if the on-disk state disappeared, either recover it (if it was
    //summary only), write out a placeholder of silence data (missing
    //.au) or mark the blockfile to deal some other way without spewing
@@ -230,22 +245,28 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
 
    static size_t CommonReadData(
       bool mayThrow,
-      const wxFileName &fileName, bool &mSilentLog,
+      const wxFileName &fileName, std::atomic<bool> &mSilentLog,
       const AliasBlockFile *pAliasFile, sampleCount origin, unsigned channel,
       samplePtr data, sampleFormat format, size_t start, size_t len,
       const sampleFormat *pLegacyFormat = nullptr, size_t legacyLen = 0);
 
  private:
    int mLockCount;
+   unsigned long long mSerial;
 
    static ArrayOf<char> fullSummary;
 
  protected:
+   /// Discard what the caches hold of the old contents, which Recover()
+   /// replaced, and take a NEW serial number
+   void ContentsChanged();
+
    wxFileNameWrapper mFileName;
    size_t mLen;
    SummaryInfo mSummaryInfo;
    float mMin, mMax, mRMS;
-   mutable bool mSilentLog;
+   // Blocks may be read by several threads at once
+   mutable std::atomic<bool> mSilentLog;
 };
 
 /// A BlockFile that refers to data in an existing file
@@ -301,7 +322,7 @@ class AliasBlockFile /* not final */ : public BlockFile
    wxFileNameWrapper mAliasedFileName;
    sampleCount mAliasStart;
    const int         mAliasChannel;
-   mutable bool        mSilentAliasLog;
+   mutable std::atomic<bool> mSilentAliasLog;
 };
 
 #endif
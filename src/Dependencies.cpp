@@ -211,10 +211,7 @@ static void RemoveDependencies(AudacityProject *project,
             // and so we can allow exceptions from ReadData too
             f->ReadData(buffer.ptr(), format, 0, len);
             newBlockFile =
-               dirManager.NewBlockFile( [&]( wxFileNameWrapper filePath ) {
-                  return make_blockfile<SimpleBlockFile>(
-                     std::move(filePath), buffer.ptr(), len, format);
-               } );
+               dirManager.NewSimpleBlockFile( buffer.ptr(), len, format );
          }
 
          // Update our hash so we know what block files we've done
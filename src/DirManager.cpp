@@ -87,6 +87,10 @@
 
 #include "BlockFile.h"
 #include "FileNames.h"
+#include "blockfile/BlockWriter.h"
+#include "blockfile/PackedBlockFile.h"
+#include "blockfile/SimpleBlockFile.h"
+#include "blockfile/ViewBlockFile.h"
 #include "InconsistencyException.h"
 #include "Prefs.h"
 #include "Project.h"
@@ -418,6 +422,8 @@ DirManager::DirManager()
 
    mMaxSamples = ~size_t(0);
 
+   gPrefs->Read(wxT("/Directories/PackBlockFiles"), &mPackBlockFiles, false);
+
    // toplevel pool hash is fully populated to begin
    {
       // We can bypass the accessor function while initializing
@@ -785,6 +791,10 @@ void DirManager::ProjectSetter::Impl::Commit()
       // and mercilessly remove them, in addition to removing the directories.
 
       auto cleanupLoc1 = oldFull.empty() ? dirManager.mytemp : oldFull;
+      // All packed blocks now read from the packs adopted into the NEW
+      // directory
+      if (cleanupLoc1 != dirManager.GetDataFilesDir())
+         BlockPack::RemoveFiles(cleanupLoc1);
       CleanDir(
          cleanupLoc1, 
          wxEmptyString, // EmptyString => ALL directories.
@@ -998,7 +1008,7 @@ auto DirManager::GetBalanceInfo() -> BalanceInfo &
    // see whether any block files have disappeared,
    // and if so update
 
-   auto count = BlockFile::gBlockFileDestructionCount;
+   unsigned long count = BlockFile::gBlockFileDestructionCount;
    if ( mLastBlockFileDestructionCount != count ) {
       auto it = mBlockFileHash.begin(), end = mBlockFileHash.end();
       while (it != end)
@@ -1185,8 +1195,9 @@ wxFileNameWrapper DirManager::MakeBlockFileName()
 
       baseFileName.Printf(wxT("e%02x%02x%03x"),topnum,midnum,filenum);
 
-      if (!ContainsBlockFile(baseFileName)) {
-         // not in the hash, good.
+      if (!ContainsBlockFile(baseFileName) &&
+          !mReservedBlockFileNames.count(baseFileName)) {
+         // not in the hash, nor being written, good.
          if (!this->AssignFile(ret, baseFileName, true))
          {
             // this indicates an on-disk collision, likely due to an
@@ -1207,11 +1218,77 @@ wxFileNameWrapper DirManager::MakeBlockFileName()
    return ret;
 }
 
+wxFileNameWrapper DirManager::MakePackedBlockFileName()
+{
+   // Blocks may be shared with other projects through the clipboard, so
+   // qualify the serial number with a random tag for this session
+   if (mPackedBlockTag == 0)
+      mPackedBlockTag = 1 + (unsigned)(65535.*rand()/(RAND_MAX+1.));
+
+   wxString baseFileName;
+   do
+      baseFileName.Printf(wxT("p%04x%07lx"),
+         mPackedBlockTag, ++mPackedBlockCount);
+   while (ContainsBlockFile(baseFileName));
+
+   wxFileNameWrapper ret;
+   ret.Assign(GetDataFilesDir(), baseFileName);
+   return ret;
+}
+
+BlockFilePtr DirManager::NewSimpleBlockFile(
+   samplePtr sampleData, size_t sampleLen, sampleFormat format,
+   bool allowDeferredWrite)
+{
+   if (!mPackBlockFiles) {
+      std::shared_ptr<SimpleBlockFile> pFile;
+      auto result = NewBlockFile( [&]( wxFileNameWrapper filePath ) {
+         return pFile = make_blockfile<SimpleBlockFile>(
+            std::move(filePath), sampleData, sampleLen, format,
+            allowDeferredWrite);
+      } );
+      // If the file was made for the writer, write it in the background
+      if (allowDeferredWrite && pFile->WaitsForWriter())
+         BlockWriter::Get().Write(pFile);
+      return result;
+   }
+
+   wxFileNameWrapper filePath;
+   {
+      ODLocker locker{ &mBlockFileLock };
+      filePath = MakePackedBlockFileName();
+   }
+   // The serial number in the name is never used again, and the pack has
+   // its own lock, so the samples are written without the lock of the hash
+   const wxString fileName{ filePath.GetName() };
+   auto newBlockFile = make_blockfile<PackedBlockFile>(
+      std::move(filePath), BlockPack::Get(GetDataFilesDir()),
+      sampleData, sampleLen, format);
+   ODLocker locker{ &mBlockFileLock };
+   mBlockFileHash[fileName] = newBlockFile;
+   return newBlockFile;
+}
+
 BlockFilePtr DirManager::NewBlockFile( const BlockFileFactory &factory )
 {
-   wxFileNameWrapper filePath{ MakeBlockFileName() };
+   // Reserve the name under the lock, but write the file without it, so
+   // that tracks written in parallel don't wait on each other's disk
+   wxFileNameWrapper filePath;
+   {
+      ODLocker locker{ &mBlockFileLock };
+      filePath = MakeBlockFileName();
+      mReservedBlockFileNames.insert( filePath.GetName() );
+   }
    const wxString fileName{ filePath.GetName() };
+   auto cleanup = finally( [&] {
+      ODLocker locker{ &mBlockFileLock };
+      mReservedBlockFileNames.erase( fileName );
+   } );
+
    auto newBlockFile = factory( std::move(filePath) );
+
+   // Publish the file
+   ODLocker locker{ &mBlockFileLock };
    mBlockFileHash[fileName] = newBlockFile;
    auto &aliasName = newBlockFile->GetExternalFileName();
    if ( aliasName.IsOk() )
@@ -1250,6 +1327,19 @@ BlockFilePtr DirManager::CopyBlockFile(const BlockFilePtr &b)
    if (!b)
       THROW_INCONSISTENCY_EXCEPTION;
 
+   if (auto pView = dynamic_cast<ViewBlockFile*>(b.get())) {
+      // Register or copy the viewed block instead; the view has no file
+      const auto &base = pView->GetBase();
+      auto base2 = CopyBlockFile(base);
+      if (base2 == base && !b->IsLocked())
+         return b;
+      // Share the summary, but not the lock count
+      auto b2 = b->Copy(wxFileNameWrapper{});
+      static_cast<ViewBlockFile&>(*b2).SetBase(base2);
+      return b2;
+   }
+
+   ODLocker locker{ &mBlockFileLock };
    auto result = b->GetFileName();
    const auto &fn = result.name;
 
@@ -1270,6 +1360,15 @@ BlockFilePtr DirManager::CopyBlockFile(const BlockFilePtr &b)
       // Block files with uninitialized filename (i.e. SilentBlockFile)
       // just need an in-memory copy.
       b2 = b->Copy(wxFileNameWrapper{});
+   else if (b->IsPacked())
+   {
+      // Packed data are immutable, so the copy can share them
+      wxFileNameWrapper newFile{ MakePackedBlockFileName() };
+      const wxString newName{ newFile.GetName() };
+      result.mLocker.reset();
+      b2 = b->Copy(std::move(newFile));
+      mBlockFileHash[newName] = b2;
+   }
    else
    {
       wxFileNameWrapper newFile{ MakeBlockFileName() };
@@ -1331,6 +1430,19 @@ bool DirManager::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
 
    BlockFilePtr pBlockFile {};
 
+   if (!wxStrcmp(tag, wxT("viewblockfile"))) {
+      if (mLoadingView)
+         // Views of views are never written
+         return false;
+      // The view is complete only when the enclosed tag is handled
+      mLoadingView = ViewBlockFile::BuildFromXML(attrs);
+      mLoadingViewTarget = mLoadingTarget;
+      mLoadingViewBase.reset();
+      mLoadingTarget =
+         [this] () -> BlockFilePtr& { return mLoadingViewBase; };
+      return true;
+   }
+
    BlockFilePtr &target = mLoadingTarget();
    mLoadingTarget = nullptr;
    
@@ -1344,11 +1456,20 @@ bool DirManager::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
       // BuildFromXML failed, or we didn't find a valid blockfile tag.
       return false;
 
+   pBlockFile = RegisterLoadedBlockFile(pBlockFile);
+   if (!pBlockFile)
+      return false;
+
+   target = pBlockFile;
+   return true;
+}
+
+BlockFilePtr DirManager::RegisterLoadedBlockFile(const BlockFilePtr &pBlockFile)
+{
    if (!pBlockFile->GetFileName().name.IsOk()) {
      // Silent blocks don't actually have a file associated, so
      // we don't need to worry about the hash table at all
-     target = pBlockFile;
-     return true;
+     return pBlockFile;
    }
 
    // Check the length here so we don't have to do it in each BuildFromXML method.
@@ -1358,10 +1479,8 @@ bool DirManager::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
       // See http://bugzilla.audacityteam.org/show_bug.cgi?id=451#c13.
       // Lock pBlockFile so that the ~BlockFile() will not DELETE the file on disk.
       pBlockFile->Lock();
-      return false;
+      return {};
    }
-   else
-      target = pBlockFile;
 
    //
    // If the block we loaded is already in the hash table, then the
@@ -1369,25 +1488,45 @@ bool DirManager::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
    // return a reference to the existing object instead.
    //
 
-   wxString name = target->GetFileName().name.GetName();
+   wxString name = pBlockFile->GetFileName().name.GetName();
    auto &wRetrieved = mBlockFileHash[name];
    BlockFilePtr retrieved = wRetrieved.lock();
    if (retrieved) {
       // Lock it in order to DELETE it safely, i.e. without having
       // it DELETE the file, too...
-      target->Lock();
+      pBlockFile->Lock();
 
-      target = retrieved;
-      return true;
+      return retrieved;
    }
 
    // This is a NEW object
-   wRetrieved = target;
+   wRetrieved = pBlockFile;
+   if (pBlockFile->IsPacked())
+      // Continue in the storage scheme the project already uses
+      mPackBlockFiles = true;
    // MakeBlockFileName wasn't used so we must add the directory
    // balancing information
    BalanceInfoAdd(name);
 
-   return true;
+   return pBlockFile;
+}
+
+void DirManager::HandleXMLEndTag(const wxChar *tag)
+{
+   if (!mLoadingView || wxStrcmp(tag, wxT("viewblockfile")))
+      return;
+
+   auto view = std::move(mLoadingView);
+   auto target = std::move(mLoadingViewTarget);
+   mLoadingView.reset();
+   mLoadingViewTarget = nullptr;
+   mLoadingTarget = nullptr;
+
+   // If the base is missing or too short, leave the target null, and the
+   // sequence will substitute silence
+   if (view->SetBase(mLoadingViewBase))
+      target() = view;
+   mLoadingViewBase.reset();
 }
 
 std::pair<bool, FilePath> DirManager::LinkOrCopyToNewProjectDirectory(
@@ -1414,6 +1553,16 @@ std::pair<bool, FilePath> DirManager::LinkOrCopyToNewProjectDirectory(
 
    newPath = newFileName.GetFullPath();
 
+   if (f->IsPacked()) {
+      // There is no file for this block; instead make sure its pack file is
+      // in the NEW directory too, linking or copying the pack only once
+      auto pack = BlockPack::Get(GetDataFilesDir());
+      result.mLocker.reset();
+      if (!static_cast< PackedBlockFile* >( f )->CopyToPack( pack, link ))
+         return { false, {} };
+      return { true, newPath };
+   }
+
    if (newFileName != oldFileNameRef) {
       //check to see that summary exists before we copy.
       bool summaryExisted = f->IsSummaryAvailable();
@@ -1664,7 +1813,15 @@ void DirManager::FindMissingAUs(
       // TODO key can be empty in doing a ProjectFSK
       // In which case MakeFilePath will fail.  Bail out?
       if (b) {
-         if (!b->IsAlias())
+         if (b->IsPacked())
+         {
+            if (!static_cast< PackedBlockFile* >( &*b )->IsExtentAvailable())
+            {
+               missingAUHash[key] = b;
+               wxLogWarning(_("Missing data of packed block: '%s'"), key);
+            }
+         }
+         else if (!b->IsAlias())
          {
             wxFileNameWrapper fileName{ MakeBlockFilePath(key) };
             fileName.SetName(key);
@@ -1744,6 +1901,36 @@ void DirManager::RemoveOrphanBlockfiles()
       wxRemoveFile(orphan);
 }
 
+void DirManager::CompactPackFiles()
+{
+   auto pack = BlockPack::Get(GetDataFilesDir());
+   const auto sparse = pack->FindSparseFiles();
+   if (sparse.empty())
+      return;
+
+   std::vector<BlockFilePtr> blocks;
+   for (const auto &pair : mBlockFileHash)
+      if (auto b = pair.second.lock())
+         if (b->IsPacked())
+            blocks.push_back(b);
+
+   PackedBlockFile::MovedExtents moved;
+   GuardedCall( [&] {
+         for (const auto &b : blocks)
+            static_cast< PackedBlockFile* >( &*b )
+               ->MoveFromSparseFile( *pack, sparse, moved );
+      },
+      MakeSimpleGuard(),
+      // Saving goes on without the compaction
+      [](void*){}
+   );
+}
+
+void DirManager::RemoveUnusedPackFiles()
+{
+   BlockPack::Get(GetDataFilesDir())->RemoveUnusedFiles();
+}
+
 void DirManager::FillBlockfilesCache()
 {
 #ifdef DEPRECATED_AUDIO_CACHE
@@ -1801,6 +1988,9 @@ void DirManager::FillBlockfilesCache()
 
 void DirManager::WriteCacheToDisk()
 {
+   // Let the background writer finish first; it is quicker
+   BlockWriter::Get().Flush();
+
    BlockHash::iterator iter;
    int numNeed = 0;
 
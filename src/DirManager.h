@@ -17,14 +17,17 @@
 #include <functional>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "ClientData.h"
+#include "ondemand/ODTaskThread.h"
 
 class wxFileNameWrapper;
 class AudacityProject;
 class BlockArray;
 class BlockFile;
 class ProgressDialog;
+class ViewBlockFile;
 
 using DirHash = std::unordered_map<int, int>;
 
@@ -142,6 +145,17 @@ class PROFILE_DLL_API DirManager final
    using BlockFileFactory = std::function< BlockFilePtr( wxFileNameWrapper ) >;
    BlockFilePtr NewBlockFile( const BlockFileFactory &factory );
 
+   // Makes a SimpleBlockFile, or a PackedBlockFile if the project stores
+   // its blocks in pack files
+   BlockFilePtr NewSimpleBlockFile(
+      samplePtr sampleData, size_t sampleLen, sampleFormat format,
+      bool allowDeferredWrite = false);
+
+   // Whether NEW blocks of this project go into pack files.  Initially
+   // from preferences; turned on when loading a project that has any.
+   bool GetPackBlockFiles() const { return mPackBlockFiles; }
+   void SetPackBlockFiles(bool pack) { mPackBlockFiles = pack; }
+
    /// Returns true if the blockfile pointed to by b is contained by the DirManager
    bool ContainsBlockFile(const BlockFile *b) const;
    /// Check for existing using filename using complete filename
@@ -181,8 +195,14 @@ class PROFILE_DLL_API DirManager final
    void SetLoadingMaxSamples(size_t max) { mMaxSamples = max; }
 
    bool HandleXMLTag(const wxChar *tag, const wxChar **attrs) override;
+   // Register a block file built while loading a project, as HandleXMLTag()
+   // does.  Returns the block file to use, which is an equal one already
+   // loaded if there is one, or null if the file is rejected.
+   BlockFilePtr RegisterLoadedBlockFile(const BlockFilePtr &pBlockFile);
+   void HandleXMLEndTag(const wxChar *tag) override;
+   // Only a view block file has a child, the block file that it views
    XMLTagHandler *HandleXMLChild(const wxChar * WXUNUSED(tag)) override
-      { return NULL; }
+      { return mLoadingView ? this : NULL; }
    bool AssignFile(wxFileNameWrapper &filename, const wxString &value, bool check);
 
    // Clean the temp dir. Note that now where we have auto recovery the temp
@@ -214,6 +234,13 @@ class PROFILE_DLL_API DirManager final
    // project and thus worthless anyway.
    void RemoveOrphanBlockfiles();
 
+   // Before saving:  copy the extents of packed blocks out of the pack files
+   // that are mostly unused, to the end of the pack.  Stops quietly at the
+   // first failure, because every block remains readable.
+   void CompactPackFiles();
+   // After saving:  remove the pack files that no block uses
+   void RemoveUnusedPackFiles();
+
    // Get directory where data files are in. Note that projects are normally
    // not interested in this information, but it is important for the
    // auto-save functionality
@@ -238,9 +265,20 @@ class PROFILE_DLL_API DirManager final
 
    wxFileNameWrapper MakeBlockFileName();
    wxFileNameWrapper MakeBlockFilePath(const wxString &value);
+   // Packed blocks need unique names, but no directories
+   wxFileNameWrapper MakePackedBlockFileName();
 
    BlockHash mBlockFileHash; // repository for blockfiles
 
+   // Names of NEW block files that are still being written, and so are not
+   // yet in the hash
+   std::unordered_set< wxString > mReservedBlockFileNames;
+
+   // Serializes the naming of NEW block files, which may happen in several
+   // threads at once when effects process tracks in parallel.  Guards the
+   // hash, the reserved names and the balance info, but not the writing.
+   ODLock mBlockFileLock;
+
    // Hashes for management of the sub-directory tree of _data
    struct BalanceInfo
    {
@@ -266,11 +304,20 @@ class PROFILE_DLL_API DirManager final
    FilePaths aliasList;
 
    LoadingTarget mLoadingTarget;
+   // A view block file being loaded, awaiting the tag of its base, and
+   // where to put it then
+   std::shared_ptr<ViewBlockFile> mLoadingView;
+   LoadingTarget mLoadingViewTarget;
+   BlockFilePtr mLoadingViewBase;
    sampleFormat mLoadingFormat;
    size_t mLoadingBlockLen;
 
    size_t mMaxSamples; // max samples per block
 
+   bool mPackBlockFiles;
+   unsigned mPackedBlockTag{ 0 };
+   unsigned long mPackedBlockCount{ 0 };
+
    unsigned long mLastBlockFileDestructionCount { 0 };
 
    static wxString globaltemp;
@@ -45,6 +45,7 @@ and get deterministic behaviour.
 // (Note: this file should be included first)
 #include "float_cast.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
@@ -54,6 +55,12 @@ and get deterministic behaviour.
 
 #include <wx/defs.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DITHER_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 //////////////////////////////////////////////////////////////////////////
 
 // Constants for the noise shaping buffer
@@ -64,7 +71,27 @@ const int Dither::BUF_SIZE = 8;
 const float Dither::SHAPED_BS[] = { 2.033f, -2.165f, 1.959f, -1.590f, 0.6149f };
 
 // This is supposed to produce white noise and no dc
-#define DITHER_NOISE (rand() / (float)RAND_MAX - 0.5f)
+#define DITHER_NOISE (NextNoise() - 0.5f)
+
+namespace {
+
+// A xorshift generator is much cheaper than rand(), which takes a lock
+// in some C libraries, and it is plenty random for dither.  Each thread
+// has its own, so that threads converting at once do not contend.
+thread_local uint32_t sNoiseState = 0x9E3779B9u;
+
+// Uniform in [0, 1)
+inline float NextNoise()
+{
+   auto x = sNoiseState;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   sNoiseState = x;
+   return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+}
 
 // The following is a rather ugly, but fast implementation
 // of a dither loop. The macro "DITHER" is expanded to an implementation
@@ -207,6 +234,118 @@ const float Dither::SHAPED_BS[] = { 2.033f, -2.165f, 1.959f, -1.590f, 0.6149f };
     } while (0)
 
 
+namespace {
+
+// Conversions of contiguous samples that need no dither.  Where SSE2 is
+// available, they do four or eight samples at a time, with exactly the
+// results of the one-at-a-time loops in Dither::Apply(), except that NaN
+// always becomes zero.
+
+void Int16ToFloat(const short *s, float *d, unsigned int len)
+{
+   unsigned int i = 0;
+#ifdef DITHER_USE_SSE2
+   const __m128 scale = _mm_set1_ps(1.0f / CONVERT_DIV16);
+   for (; i + 8 <= len; i += 8) {
+      const __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+      // Sign extend to 32 bits
+      const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      _mm_storeu_ps(d + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+      _mm_storeu_ps(d + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+   }
+#endif
+   for (; i < len; ++i)
+      d[i] = FROM_INT16(s + i);
+}
+
+void Int24ToFloat(const int *s, float *d, unsigned int len)
+{
+   unsigned int i = 0;
+#ifdef DITHER_USE_SSE2
+   const __m128 scale = _mm_set1_ps(1.0f / CONVERT_DIV24);
+   for (; i + 4 <= len; i += 4) {
+      const __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+      _mm_storeu_ps(d + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+   }
+#endif
+   for (; i < len; ++i)
+      d[i] = FROM_INT24(s + i);
+}
+
+void Int16ToInt24(const short *s, int *d, unsigned int len)
+{
+   unsigned int i = 0;
+#ifdef DITHER_USE_SSE2
+   for (; i + 8 <= len; i += 8) {
+      const __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+      const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      _mm_storeu_si128((__m128i*)(d + i), _mm_slli_epi32(lo, 8));
+      _mm_storeu_si128((__m128i*)(d + i + 4), _mm_slli_epi32(hi, 8));
+   }
+#endif
+   for (; i < len; ++i)
+      d[i] = ((int)s[i]) << 8;
+}
+
+// Clip to [-1, 1] as FROM_FLOAT does, and make NaN zero
+inline float ClipFloat(float f)
+{
+   return f > 1.0f ? 1.0f : f < -1.0f ? -1.0f : f == f ? f : 0.0f;
+}
+
+#ifdef DITHER_USE_SSE2
+inline __m128 ClipFloat(__m128 v)
+{
+   // The mask of lanes that are not NaN
+   v = _mm_and_ps(v, _mm_cmpord_ps(v, v));
+   return _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+#endif
+
+void FloatToInt16(const float *s, short *d, unsigned int len)
+{
+   unsigned int i = 0;
+#ifdef DITHER_USE_SSE2
+   const __m128 scale = _mm_set1_ps(CONVERT_DIV16);
+   for (; i + 8 <= len; i += 8) {
+      // Round to nearest, as lrintf() does
+      const __m128i lo = _mm_cvtps_epi32(
+         _mm_mul_ps(ClipFloat(_mm_loadu_ps(s + i)), scale));
+      const __m128i hi = _mm_cvtps_epi32(
+         _mm_mul_ps(ClipFloat(_mm_loadu_ps(s + i + 4)), scale));
+      // Saturation makes 32768 into 32767
+      _mm_storeu_si128((__m128i*)(d + i), _mm_packs_epi32(lo, hi));
+   }
+#endif
+   int x;
+   for (; i < len; ++i)
+      STORE_INT16(d + i, PROMOTE_TO_INT16(ClipFloat(s[i])));
+}
+
+void FloatToInt24(const float *s, int *d, unsigned int len)
+{
+   unsigned int i = 0;
+#ifdef DITHER_USE_SSE2
+   const __m128 scale = _mm_set1_ps(CONVERT_DIV24);
+   const __m128i maxValue = _mm_set1_epi32(8388607);
+   for (; i + 4 <= len; i += 4) {
+      __m128i v = _mm_cvtps_epi32(
+         _mm_mul_ps(ClipFloat(_mm_loadu_ps(s + i)), scale));
+      // Only 8388608 can be out of bounds
+      const __m128i over = _mm_cmpgt_epi32(v, maxValue);
+      v = _mm_or_si128(_mm_andnot_si128(over, v), _mm_and_si128(over, maxValue));
+      _mm_storeu_si128((__m128i*)(d + i), v);
+   }
+#endif
+   int x;
+   for (; i < len; ++i)
+      STORE_INT24(d + i, PROMOTE_TO_INT24(ClipFloat(s[i])));
+}
+
+}
+
 Dither::Dither()
 {
     // On startup, initialize dither by resetting values
@@ -301,6 +440,15 @@ void Dither::Apply(enum DitherType ditherType,
         // No clipping should be necessary.
         float* d = (float*)dest;
 
+        if (sourceStride == 1 && destStride == 1)
+        {
+            if (sourceFormat == int16Sample)
+                Int16ToFloat((short*)source, d, len);
+            else if (sourceFormat == int24Sample)
+                Int24ToFloat((int*)source, d, len);
+            else
+                wxASSERT(false); // source format unknown
+        } else
         if (sourceFormat == int16Sample)
         {
             short* s = (short*)source;
@@ -321,15 +469,26 @@ void Dither::Apply(enum DitherType ditherType,
         // Special case when promoting 16 bit to 24 bit
         int* d = (int*)dest;
         short* s = (short*)source;
-        for (i = 0; i < len; i++, d += destStride, s += sourceStride)
-            *d = ((int)*s) << 8;
+        if (sourceStride == 1 && destStride == 1)
+            Int16ToInt24(s, d, len);
+        else
+            for (i = 0; i < len; i++, d += destStride, s += sourceStride)
+                *d = ((int)*s) << 8;
     } else
     {
         // We must do dithering
         switch (ditherType)
         {
         case DitherType::none:
-            DITHER(NoDither, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
+            if (sourceStride == 1 && destStride == 1 &&
+                sourceFormat == floatSample && destFormat == int16Sample)
+                FloatToInt16((float*)source, (short*)dest, len);
+            else
+            if (sourceStride == 1 && destStride == 1 &&
+                sourceFormat == floatSample && destFormat == int24Sample)
+                FloatToInt24((float*)source, (int*)dest, len);
+            else
+                DITHER(NoDither, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
             break;
         case DitherType::rectangle:
             DITHER(RectangleDither, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
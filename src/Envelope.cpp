@@ -847,24 +847,28 @@ void Envelope::BinarySearchForTime( int &Lo, int &Hi, double t ) const
 {
    // Optimizations for the usual pattern of repeated calls with
    // small increases of t.
+   // Several threads may read the envelope at once, so work on a copy of
+   // the guess.
    {
-      if (mSearchGuess >= 0 && mSearchGuess < (int)mEnv.size()) {
-         if (t >= mEnv[mSearchGuess].GetT() &&
-             (1 + mSearchGuess == (int)mEnv.size() ||
-              t < mEnv[1 + mSearchGuess].GetT())) {
-            Lo = mSearchGuess;
-            Hi = 1 + mSearchGuess;
+      int guess = mSearchGuess.load(std::memory_order_relaxed);
+      if (guess >= 0 && guess < (int)mEnv.size()) {
+         if (t >= mEnv[guess].GetT() &&
+             (1 + guess == (int)mEnv.size() ||
+              t < mEnv[1 + guess].GetT())) {
+            Lo = guess;
+            Hi = 1 + guess;
             return;
          }
       }
 
-      ++mSearchGuess;
-      if (mSearchGuess >= 0 && mSearchGuess < (int)mEnv.size()) {
-         if (t >= mEnv[mSearchGuess].GetT() &&
-             (1 + mSearchGuess == (int)mEnv.size() ||
-              t < mEnv[1 + mSearchGuess].GetT())) {
-            Lo = mSearchGuess;
-            Hi = 1 + mSearchGuess;
+      ++guess;
+      if (guess >= 0 && guess < (int)mEnv.size()) {
+         if (t >= mEnv[guess].GetT() &&
+             (1 + guess == (int)mEnv.size() ||
+              t < mEnv[1 + guess].GetT())) {
+            Lo = guess;
+            Hi = 1 + guess;
+            mSearchGuess.store(guess, std::memory_order_relaxed);
             return;
          }
       }
@@ -884,7 +888,7 @@ void Envelope::BinarySearchForTime( int &Lo, int &Hi, double t ) const
    }
    wxASSERT( Hi == ( Lo+1 ));
 
-   mSearchGuess = Lo;
+   mSearchGuess.store(Lo, std::memory_order_relaxed);
 }
 
 // relative time
@@ -906,7 +910,7 @@ void Envelope::BinarySearchForTime_LeftLimit( int &Lo, int &Hi, double t ) const
    }
    wxASSERT( Hi == ( Lo+1 ));
 
-   mSearchGuess = Lo;
+   mSearchGuess.store(Lo, std::memory_order_relaxed);
 }
 
 /// GetInterpolationStartValueAtPoint() is used to select either the
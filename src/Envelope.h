@@ -13,6 +13,7 @@
 
 #include <stdlib.h>
 #include <algorithm>
+#include <atomic>
 #include <vector>
 
 #include "xml/XMLTagHandler.h"
@@ -267,7 +268,7 @@ private:
    bool mDragPointValid { false };
    int mDragPoint { -1 };
 
-   mutable int mSearchGuess { -2 };
+   mutable std::atomic<int> mSearchGuess { -2 };
 };
 
 inline void EnvPoint::SetVal( Envelope *pEnvelope, double val )
@@ -102,6 +102,8 @@ void Internat::Init()
    // or to directories
    auto forbid = wxFileName::GetForbiddenChars(format);
 
+   // Init() may be called again, after a change of locale
+   exclude.clear();
    for(auto cc: forbid)
       exclude.push_back(wxString{ cc });
 
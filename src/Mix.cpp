@@ -38,8 +38,15 @@
 #include "TimeTrack.h"
 #include "float_cast.h"
 
+#include "ThreadPool.h"
 #include "widgets/ProgressDialog.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIX_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 //TODO-MB: wouldn't it make more sense to DELETE the time track after 'mix and render'?
 void MixAndRender(TrackList *tracks, TrackFactory *trackFactory,
                   double rate, sampleFormat format,
@@ -151,6 +158,7 @@ void MixAndRender(TrackList *tracks, TrackFactory *trackFactory,
       Mixer::WarpOptions(timeTrack ? timeTrack->GetEnvelope() : nullptr),
       startTime, endTime, mono ? 1 : 2, maxBlockLen, false,
       rate, format);
+   mixer.MixInParallel();
 
    ::wxSafeYield();
 
@@ -241,7 +249,6 @@ Mixer::Mixer(const WaveTrackConstArray &inputTracks,
    , mSampleQueue{ mNumInputTracks, mQueueMaxLen }
 
    , mNumChannels{ numOutChannels }
-   , mGains{ mNumChannels }
 
    , mMayThrow{ mayThrow }
 {
@@ -286,7 +293,6 @@ Mixer::Mixer(const WaveTrackConstArray &inputTracks,
       mBuffer[c].Allocate(mInterleavedBufferSize, mFormat);
       mTemp[c].Allocate(mInterleavedBufferSize, floatSample);
    }
-   mFloatBuffer = Floats{ mInterleavedBufferSize };
 
    // But cut the queue into blocks of this finer size
    // for variable rate resampling.  Each block is resampled at some
@@ -328,13 +334,22 @@ Mixer::Mixer(const WaveTrackConstArray &inputTracks,
    MakeResamplers();
 
    const auto envLen = std::max(mQueueMaxLen, mInterleavedBufferSize);
-   mEnvValues.reinit(envLen);
+   mScratch = Scratch{ mNumChannels, mInterleavedBufferSize, envLen };
+   mScratch.warp = mEnvelope;
 }
 
 Mixer::~Mixer()
 {
 }
 
+Mixer::Scratch::Scratch(
+   unsigned numChannels, size_t bufferSize, size_t envLen)
+   : floatBuffer{ bufferSize }
+   , envValues{ envLen }
+   , gains{ numChannels }
+{
+}
+
 void Mixer::MakeResamplers()
 {
    for (size_t i = 0; i < mNumInputTracks; i++)
@@ -346,6 +361,11 @@ void Mixer::ApplyTrackGains(bool apply)
    mApplyTrackGains = apply;
 }
 
+void Mixer::MixInParallel(bool parallel)
+{
+   mParallel = parallel;
+}
+
 void Mixer::Clear()
 {
    for (unsigned int c = 0; c < mNumBuffers; c++) {
@@ -353,30 +373,82 @@ void Mixer::Clear()
    }
 }
 
+namespace {
+
+// Add src * gain into interleaved stereo, both channels, four frames at a
+// time where SSE2 is available
+void MixStereoInterleaved(const float *gains,
+   const float * __restrict src, const double * __restrict envelope,
+   float * __restrict dest, int len)
+{
+   int j = 0;
+#ifdef MIX_USE_SSE2
+   const __m128 gain = _mm_setr_ps(gains[0], gains[1], gains[0], gains[1]);
+   for (; j + 4 <= len; j += 4) {
+      __m128 s = _mm_loadu_ps(src + j);
+      if (envelope) {
+         // Multiply in double precision and round to float, as the
+         // scalar loop does
+         const __m128d lo = _mm_mul_pd(
+            _mm_cvtps_pd(s), _mm_loadu_pd(envelope + j));
+         const __m128d hi = _mm_mul_pd(
+            _mm_cvtps_pd(_mm_movehl_ps(s, s)), _mm_loadu_pd(envelope + j + 2));
+         s = _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+      }
+      // Duplicate each sample for the two channels of its frame
+      const __m128 lo = _mm_unpacklo_ps(s, s);
+      const __m128 hi = _mm_unpackhi_ps(s, s);
+      float *const d = dest + 2 * j;
+      _mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(d), _mm_mul_ps(lo, gain)));
+      _mm_storeu_ps(d + 4,
+         _mm_add_ps(_mm_loadu_ps(d + 4), _mm_mul_ps(hi, gain)));
+   }
+#endif
+   for (; j < len; j++) {
+      const float sample = envelope ? float(src[j] * envelope[j]) : src[j];
+      dest[2 * j] += sample * gains[0];
+      dest[2 * j + 1] += sample * gains[1];
+   }
+}
+
+}
+
 void MixBuffers(unsigned numChannels, int *channelFlags, float *gains,
                 samplePtr src, SampleBuffer *dests,
-                int len, bool interleaved)
+                int len, bool interleaved, const double *envelope)
 {
+   const float *const temp = (const float *)src;
+
+   if (interleaved && numChannels == 2 && channelFlags[0] && channelFlags[1]) {
+      // The common case of a mono track panned into stereo
+      MixStereoInterleaved(
+         gains, temp, envelope, (float *)dests[0].ptr(), len);
+      return;
+   }
+
    for (unsigned int c = 0; c < numChannels; c++) {
       if (!channelFlags[c])
          continue;
 
-      samplePtr destPtr;
-      unsigned skip;
+      const float gain = gains[c];
 
-      if (interleaved) {
-         destPtr = dests[0].ptr() + c*SAMPLE_SIZE(floatSample);
-         skip = numChannels;
-      } else {
-         destPtr = dests[c].ptr();
-         skip = 1;
+      if (!interleaved) {
+         // Contiguous, so the compiler can vectorize these loops
+         float * __restrict dest = (float *)dests[c].ptr();
+         if (envelope)
+            for (int j = 0; j < len; j++)
+               dest[j] += float(temp[j] * envelope[j]) * gain;
+         else
+            for (int j = 0; j < len; j++)
+               dest[j] += temp[j] * gain;
+         continue;
       }
 
-      float gain = gains[c];
-      float *dest = (float *)destPtr;
-      float *temp = (float *)src;
+      float *dest = (float *)dests[0].ptr() + c;
+      const unsigned skip = numChannels;
       for (int j = 0; j < len; j++) {
-         *dest += temp[j] * gain;   // the actual mixing process
+         const float sample = envelope ? float(temp[j] * envelope[j]) : temp[j];
+         *dest += sample * gain;   // the actual mixing process
          dest += skip;
       }
    }
@@ -405,7 +477,8 @@ double ComputeWarpFactor(const Envelope &env, double t0, double t1)
 size_t Mixer::MixVariableRates(int *channelFlags, WaveTrackCache &cache,
                                     sampleCount *pos, float *queue,
                                     int *queueStart, int *queueLen,
-                                    Resample * pResample)
+                                    Resample * pResample,
+                                    Scratch &scratch, SampleBuffer *dests)
 {
    const WaveTrack *const track = cache.GetTrack().get();
    const double trackRate = track->GetRate();
@@ -458,7 +531,7 @@ size_t Mixer::MixVariableRates(int *channelFlags, WaveTrackCache &cache,
                else
                   memset(&queue[*queueLen], 0, sizeof(float) * getLen);
 
-               track->GetEnvelopeValues(mEnvValues.get(),
+               track->GetEnvelopeValues(scratch.envValues.get(),
                                         getLen,
                                         (*pos - (getLen- 1)).as_double() / trackRate);
                *pos -= getLen;
@@ -470,7 +543,7 @@ size_t Mixer::MixVariableRates(int *channelFlags, WaveTrackCache &cache,
                else
                   memset(&queue[*queueLen], 0, sizeof(float) * getLen);
 
-               track->GetEnvelopeValues(mEnvValues.get(),
+               track->GetEnvelopeValues(scratch.envValues.get(),
                                         getLen,
                                         (*pos).as_double() / trackRate);
 
@@ -478,7 +551,7 @@ size_t Mixer::MixVariableRates(int *channelFlags, WaveTrackCache &cache,
             }
 
             for (decltype(getLen) i = 0; i < getLen; i++) {
-               queue[(*queueLen) + i] *= mEnvValues[i];
+               queue[(*queueLen) + i] *= scratch.envValues[i];
             }
 
             if (backwards)
@@ -504,10 +577,10 @@ size_t Mixer::MixVariableRates(int *channelFlags, WaveTrackCache &cache,
          //         without changing the way the resampler works, because the number of input samples that will be used
          //         is unpredictable. Maybe it can be compensated later though.
          if (backwards)
-            factor *= ComputeWarpFactor( *mEnvelope,
+            factor *= ComputeWarpFactor( *scratch.warp,
                t - (double)thisProcessLen / trackRate + tstep, t + tstep);
          else
-            factor *= ComputeWarpFactor( *mEnvelope,
+            factor *= ComputeWarpFactor( *scratch.warp,
                t, t + (double)thisProcessLen / trackRate);
       }
 
@@ -515,7 +588,7 @@ size_t Mixer::MixVariableRates(int *channelFlags, WaveTrackCache &cache,
                                       &queue[*queueStart],
                                       thisProcessLen,
                                       last,
-                                      &mFloatBuffer[out],
+                                      &scratch.floatBuffer[out],
                                       mMaxOut - out);
 
       const auto input_used = results.first;
@@ -531,18 +604,18 @@ size_t Mixer::MixVariableRates(int *channelFlags, WaveTrackCache &cache,
 
    for (size_t c = 0; c < mNumChannels; c++) {
       if (mApplyTrackGains) {
-         mGains[c] = track->GetChannelGain(c);
+         scratch.gains[c] = track->GetChannelGain(c);
       }
       else {
-         mGains[c] = 1.0;
+         scratch.gains[c] = 1.0;
       }
    }
 
    MixBuffers(mNumChannels,
               channelFlags,
-              mGains.get(),
-              (samplePtr)mFloatBuffer.get(),
-              mTemp.get(),
+              scratch.gains.get(),
+              (samplePtr)scratch.floatBuffer.get(),
+              dests,
               out,
               mInterleaved);
 
@@ -550,7 +623,8 @@ size_t Mixer::MixVariableRates(int *channelFlags, WaveTrackCache &cache,
 }
 
 size_t Mixer::MixSameRate(int *channelFlags, WaveTrackCache &cache,
-                               sampleCount *pos)
+                               sampleCount *pos,
+                               Scratch &scratch, SampleBuffer *dests)
 {
    const WaveTrack *const track = cache.GetTrack().get();
    const double t = ( *pos ).as_double() / track->GetRate();
@@ -576,41 +650,169 @@ size_t Mixer::MixSameRate(int *channelFlags, WaveTrackCache &cache,
    if (backwards) {
       auto results = cache.Get(floatSample, *pos - (slen - 1), slen, mMayThrow);
       if (results)
-         memcpy(mFloatBuffer.get(), results, sizeof(float) * slen);
+         memcpy(scratch.floatBuffer.get(), results, sizeof(float) * slen);
       else
-         memset(mFloatBuffer.get(), 0, sizeof(float) * slen);
-      track->GetEnvelopeValues(mEnvValues.get(), slen, t - (slen - 1) / mRate);
+         memset(scratch.floatBuffer.get(), 0, sizeof(float) * slen);
+      track->GetEnvelopeValues(scratch.envValues.get(), slen, t - (slen - 1) / mRate);
       for(decltype(slen) i = 0; i < slen; i++)
-         mFloatBuffer[i] *= mEnvValues[i]; // Track gain control will go here?
-      ReverseSamples((samplePtr)mFloatBuffer.get(), floatSample, 0, slen);
+         scratch.floatBuffer[i] *= scratch.envValues[i]; // Track gain control will go here?
+      ReverseSamples((samplePtr)scratch.floatBuffer.get(), floatSample, 0, slen);
 
       *pos -= slen;
    }
    else {
       auto results = cache.Get(floatSample, *pos, slen, mMayThrow);
       if (results)
-         memcpy(mFloatBuffer.get(), results, sizeof(float) * slen);
+         memcpy(scratch.floatBuffer.get(), results, sizeof(float) * slen);
       else
-         memset(mFloatBuffer.get(), 0, sizeof(float) * slen);
-      track->GetEnvelopeValues(mEnvValues.get(), slen, t);
-      for(decltype(slen) i = 0; i < slen; i++)
-         mFloatBuffer[i] *= mEnvValues[i]; // Track gain control will go here?
+         memset(scratch.floatBuffer.get(), 0, sizeof(float) * slen);
+      // The envelope is applied below, while mixing
+      track->GetEnvelopeValues(scratch.envValues.get(), slen, t);
 
       *pos += slen;
    }
 
    for(size_t c=0; c<mNumChannels; c++)
       if (mApplyTrackGains)
-         mGains[c] = track->GetChannelGain(c);
+         scratch.gains[c] = track->GetChannelGain(c);
       else
-         mGains[c] = 1.0;
+         scratch.gains[c] = 1.0;
 
-   MixBuffers(mNumChannels, channelFlags, mGains.get(),
-              (samplePtr)mFloatBuffer.get(), mTemp.get(), slen, mInterleaved);
+   MixBuffers(mNumChannels, channelFlags, scratch.gains.get(),
+              (samplePtr)scratch.floatBuffer.get(), dests, slen, mInterleaved,
+              backwards ? nullptr : scratch.envValues.get());
 
    return slen;
 }
 
+void Mixer::GetChannelFlags(size_t iTrack, int *channelFlags) const
+{
+   const WaveTrack *const track = mInputTrack[iTrack].GetTrack().get();
+   for(size_t j=0; j<mNumChannels; j++)
+      channelFlags[j] = 0;
+
+   if( mMixerSpec ) {
+      //ignore left and right when downmixing is not required
+      for(size_t j = 0; j < mNumChannels; j++ )
+         channelFlags[ j ] = mMixerSpec->mMap[ iTrack ][ j ] ? 1 : 0;
+   }
+   else {
+      switch(track->GetChannel()) {
+      case Track::MonoChannel:
+      default:
+         for(size_t j=0; j<mNumChannels; j++)
+            channelFlags[j] = 1;
+         break;
+      case Track::LeftChannel:
+         channelFlags[0] = 1;
+         break;
+      case Track::RightChannel:
+         if (mNumChannels >= 2)
+            channelFlags[1] = 1;
+         else
+            channelFlags[0] = 1;
+         break;
+      }
+   }
+}
+
+size_t Mixer::MixTrack(size_t iTrack, Scratch &scratch, SampleBuffer *dests)
+{
+   const WaveTrack *const track = mInputTrack[iTrack].GetTrack().get();
+   ArrayOf<int> channelFlags{ mNumChannels };
+   GetChannelFlags(iTrack, channelFlags.get());
+
+   if (mbVariableRates || track->GetRate() != mRate)
+      return MixVariableRates(channelFlags.get(), mInputTrack[iTrack],
+         &mSamplePos[iTrack], mSampleQueue[iTrack].get(),
+         &mQueueStart[iTrack], &mQueueLen[iTrack], mResample[iTrack].get(),
+         scratch, dests);
+   else
+      return MixSameRate(channelFlags.get(), mInputTrack[iTrack],
+         &mSamplePos[iTrack], scratch, dests);
+}
+
+void Mixer::UpdateTime(size_t iTrack)
+{
+   const WaveTrack *const track = mInputTrack[iTrack].GetTrack().get();
+   double t = mSamplePos[iTrack].as_double() / (double)track->GetRate();
+   if (mT0 > mT1)
+      // backwards (as possibly in scrubbing)
+      mTime = std::max(std::min(t, mTime), mT1);
+   else
+      // forwards (the usual)
+      mTime = std::min(std::max(t, mTime), mT1);
+}
+
+namespace {
+
+void AddPartial(float * __restrict dest, const float * __restrict src,
+   size_t len)
+{
+   for (size_t j = 0; j < len; j++)
+      dest[j] += src[j];
+}
+
+}
+
+bool Mixer::MixTracksInParallel(size_t &maxOut)
+{
+   const auto nThreads = ThreadPool::SharedThreadCount();
+   if (nThreads == 0)
+      return false;
+
+   if (!mPartial) {
+      mPartial.reinit(mNumInputTracks);
+      for (size_t i = 0; i < mNumInputTracks; i++) {
+         mPartial[i].reinit(mNumBuffers);
+         for (unsigned int c = 0; c < mNumBuffers; c++)
+            mPartial[i][c].Allocate(mInterleavedBufferSize, floatSample);
+      }
+   }
+
+   // Partition the tracks among the threads, each with its own scratch.
+   // Each track has its own cache, position, queue and resampler already.
+   const size_t nGroups = std::min<size_t>(
+      nThreads + 1, mNumInputTracks);
+   const auto envLen = std::max(mQueueMaxLen, mInterleavedBufferSize);
+   while (mPoolScratch.size() < nGroups) {
+      auto pScratch = std::make_unique<Scratch>(
+         mNumChannels, mInterleavedBufferSize, envLen);
+      if (mEnvelope) {
+         pScratch->warpCopy = std::make_unique<Envelope>(*mEnvelope);
+         pScratch->warp = pScratch->warpCopy.get();
+      }
+      mPoolScratch.push_back(std::move(pScratch));
+   }
+
+   const auto width = mInterleaved ? mNumChannels : 1;
+   const auto clearLen = mMaxOut * width * SAMPLE_SIZE(floatSample);
+   std::vector<size_t> outs(mNumInputTracks);
+   // If another mixer has the pool, the groups run on this thread
+   ThreadPool::RunShared(nGroups, [&](size_t group){
+      auto &scratch = *mPoolScratch[group];
+      for (auto i = group; i < mNumInputTracks; i += nGroups) {
+         const auto dests = mPartial[i].get();
+         for (unsigned int c = 0; c < mNumBuffers; c++)
+            memset(dests[c].ptr(), 0, clearLen);
+         outs[i] = MixTrack(i, scratch, dests);
+      }
+   });
+
+   // Add the partial mixes in track order.  Each holds 0 + x for each
+   // contribution x of its track, which is exactly x, so the sums are the
+   // same to the bit as when mixing all tracks into one buffer.
+   for (size_t i = 0; i < mNumInputTracks; i++) {
+      maxOut = std::max(maxOut, outs[i]);
+      UpdateTime(i);
+      for (unsigned int c = 0; c < mNumBuffers; c++)
+         AddPartial((float*)mTemp[c].ptr(),
+            (const float*)mPartial[i][c].ptr(), outs[i] * width);
+   }
+
+   return true;
+}
+
 size_t Mixer::Process(size_t maxToProcess)
 {
    // MB: this is wrong! mT represented warped time, and mTime is too inaccurate to use
@@ -619,55 +821,15 @@ size_t Mixer::Process(size_t maxToProcess)
    //   return 0;
 
    decltype(Process(0)) maxOut = 0;
-   ArrayOf<int> channelFlags{ mNumChannels };
 
    mMaxOut = maxToProcess;
 
    Clear();
-   for(size_t i=0; i<mNumInputTracks; i++) {
-      const WaveTrack *const track = mInputTrack[i].GetTrack().get();
-      for(size_t j=0; j<mNumChannels; j++)
-         channelFlags[j] = 0;
-
-      if( mMixerSpec ) {
-         //ignore left and right when downmixing is not required
-         for(size_t j = 0; j < mNumChannels; j++ )
-            channelFlags[ j ] = mMixerSpec->mMap[ i ][ j ] ? 1 : 0;
+   if (!(mParallel && mNumInputTracks > 1 && MixTracksInParallel(maxOut))) {
+      for(size_t i=0; i<mNumInputTracks; i++) {
+         maxOut = std::max(maxOut, MixTrack(i, mScratch, mTemp.get()));
+         UpdateTime(i);
       }
-      else {
-         switch(track->GetChannel()) {
-         case Track::MonoChannel:
-         default:
-            for(size_t j=0; j<mNumChannels; j++)
-               channelFlags[j] = 1;
-            break;
-         case Track::LeftChannel:
-            channelFlags[0] = 1;
-            break;
-         case Track::RightChannel:
-            if (mNumChannels >= 2)
-               channelFlags[1] = 1;
-            else
-               channelFlags[0] = 1;
-            break;
-         }
-      }
-      if (mbVariableRates || track->GetRate() != mRate)
-         maxOut = std::max(maxOut,
-            MixVariableRates(channelFlags.get(), mInputTrack[i],
-               &mSamplePos[i], mSampleQueue[i].get(),
-               &mQueueStart[i], &mQueueLen[i], mResample[i].get()));
-      else
-         maxOut = std::max(maxOut,
-            MixSameRate(channelFlags.get(), mInputTrack[i], &mSamplePos[i]));
-
-      double t = mSamplePos[i].as_double() / (double)track->GetRate();
-      if (mT0 > mT1)
-         // backwards (as possibly in scrubbing)
-         mTime = std::max(std::min(t, mTime), mT1);
-      else
-         // forwards (the usual)
-         mTime = std::min(std::max(t, mTime), mT1);
    }
    if(mInterleaved) {
       for(size_t c=0; c<mNumChannels; c++) {
@@ -26,6 +26,7 @@
 class Resample;
 class DirManager;
 class BoundedEnvelope;
+class Envelope;
 class TrackFactory;
 class TrackList;
 class WaveTrack;
@@ -50,9 +51,12 @@ void MixAndRender(TrackList * tracks, TrackFactory *factory,
                   std::shared_ptr<WaveTrack> &uLeft,
                   std::shared_ptr<WaveTrack> &uRight);
 
+/// Add src, times the envelope if not null, times gains[c], into each
+/// channel c that is flagged
 void MixBuffers(unsigned numChannels, int *channelFlags, float *gains,
                 samplePtr src,
-                samplePtr *dests, int len, bool interleaved);
+                SampleBuffer *dests, int len, bool interleaved,
+                const double *envelope = nullptr);
 
 class AUDACITY_DLL_API MixerSpec
 {
@@ -114,6 +118,10 @@ class AUDACITY_DLL_API Mixer {
 
    void ApplyTrackGains(bool apply = true); // True by default
 
+   /// Mix the input tracks on several threads, for offline uses such as
+   /// export.  The output is the same as when mixing on one thread.
+   void MixInParallel(bool parallel = true); // False by default
+
    //
    // Processing
    //
@@ -149,14 +157,39 @@ class AUDACITY_DLL_API Mixer {
 
  private:
 
+   // Working space for mixing one track at a time
+   struct Scratch
+   {
+      Scratch() = default;
+      Scratch(unsigned numChannels, size_t bufferSize, size_t envLen);
+
+      Floats           floatBuffer;
+      Doubles          envValues;
+      Floats           gains;
+      // The time warp, or a copy of it for use on another thread, because
+      // Envelope keeps a mutable search position
+      const Envelope   *warp{};
+      std::unique_ptr<Envelope> warpCopy;
+   };
+
    void Clear();
+   void GetChannelFlags(size_t iTrack, int *channelFlags) const;
+   /// Mix track iTrack into dests, returning the number of samples
+   size_t MixTrack(size_t iTrack, Scratch &scratch, SampleBuffer *dests);
+   void UpdateTime(size_t iTrack);
+   /// Mix each track into its own buffer on the thread pool, then add them
+   /// into mTemp in track order; returns false if the pool is busy
+   bool MixTracksInParallel(size_t &maxOut);
+
    size_t MixSameRate(int *channelFlags, WaveTrackCache &cache,
-                           sampleCount *pos);
+                           sampleCount *pos,
+                           Scratch &scratch, SampleBuffer *dests);
 
    size_t MixVariableRates(int *channelFlags, WaveTrackCache &cache,
                                 sampleCount *pos, float *queue,
                                 int *queueStart, int *queueLen,
-                                Resample * pResample);
+                                Resample * pResample,
+                                Scratch &scratch, SampleBuffer *dests);
 
    void MakeResamplers();
 
@@ -169,7 +202,6 @@ class AUDACITY_DLL_API Mixer {
    const BoundedEnvelope *mEnvelope;
    ArrayOf<sampleCount> mSamplePos;
    bool             mApplyTrackGains;
-   Doubles          mEnvValues;
    double           mT0; // Start time
    double           mT1; // Stop time (none if mT0==mT1)
    double           mTime;  // Current time (renamed from mT to mTime for consistency with AudioIO - mT represented warped time there)
@@ -184,20 +216,25 @@ class AUDACITY_DLL_API Mixer {
    // Output
    size_t              mMaxOut;
    unsigned         mNumChannels;
-   Floats           mGains;
    unsigned         mNumBuffers;
    size_t              mBufferSize;
    size_t              mInterleavedBufferSize;
    sampleFormat     mFormat;
    bool             mInterleaved;
    ArrayOf<SampleBuffer> mBuffer, mTemp;
-   Floats           mFloatBuffer;
+   Scratch          mScratch;
    double           mRate;
    double           mSpeed;
    bool             mHighQuality;
    std::vector<double> mMinFactor, mMaxFactor;
 
    bool             mMayThrow;
+
+   // For mixing in parallel, allocated when first needed:
+   // a buffer for each track, and scratch for each thread
+   bool             mParallel{ false };
+   ArraysOf<SampleBuffer> mPartial;
+   std::vector<std::unique_ptr<Scratch>> mPoolScratch;
 };
 
 #endif
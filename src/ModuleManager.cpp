@@ -47,6 +47,7 @@ i.e. an alternative to the usual interface, for Audacity.
 #define initFnName      "ExtensionModuleInit"
 #define versionFnName   "GetVersionString"
 #define scriptFnName    "RegScriptServerFunc"
+#define binaryScriptFnName "RegBinaryScriptServerFunc"
 #define mainPanelFnName "MainPanelFunc"
 
 typedef wxWindow * pwxWindow;
@@ -82,6 +83,8 @@ wxWindow * MakeHijackPanel()
 // This variable will hold the address of a subroutine in a DLL that
 // starts a thread and reads script commands.
 static tpRegScriptServerFunc scriptFn;
+// Likewise, for a server of scripts in binary
+static tpRegBinaryScriptServerFunc binaryScriptFn;
 
 Module::Module(const FilePath & name)
 {
@@ -328,6 +331,11 @@ void ModuleManager::Initialize(CommandHandler &cmdHandler)
             {
                scriptFn = (tpRegScriptServerFunc)(module->GetSymbol(wxT(scriptFnName)));
             }
+            if (binaryScriptFn == NULL)
+            {
+               binaryScriptFn = (tpRegBinaryScriptServerFunc)
+                  (module->GetSymbol(wxT(binaryScriptFnName)));
+            }
 
             // (b) for hijacking the entire Audacity panel.
             if (pPanelHijack == NULL)
@@ -336,7 +344,8 @@ void ModuleManager::Initialize(CommandHandler &cmdHandler)
             }
          }
 
-         if (!module->HasDispatch() && !scriptFn && !pPanelHijack)
+         if (!module->HasDispatch() && !scriptFn && !binaryScriptFn &&
+             !pPanelHijack)
          {
             auto ShortName = wxFileName(files[i]).GetName();
             AudacityMessageBox(
@@ -363,6 +372,10 @@ void ModuleManager::Initialize(CommandHandler &cmdHandler)
    {
       ScriptCommandRelay::StartScriptServer(scriptFn);
    }
+   if(binaryScriptFn)
+   {
+      ScriptCommandRelay::StartBinaryScriptServer(binaryScriptFn);
+   }
 }
 
 // static
@@ -13,6 +13,9 @@ Paul Licameli split from ProjectManager.cpp
 
 #include "Experimental.h"
 
+#include <wx/app.h>
+#include <wx/ffile.h>
+#include <wx/filefn.h>
 #include <wx/frame.h>
 #include <wx/statusbr.h>
 
@@ -32,6 +35,7 @@ Paul Licameli split from ProjectManager.cpp
 #include "TrackPanelAx.h"
 #include "ViewInfo.h"
 #include "WaveTrack.h"
+#include "blockfile/BlockWriter.h"
 #include "toolbars/ToolManager.h"
 #include "prefs/TracksPrefs.h"
 #include "tracks/ui/Scrubbing.h"
@@ -926,18 +930,29 @@ You are saving directly to a slow external storage device\n\
 void ProjectAudioManager::OnAudioIONewBlockFiles(
    const AutoSaveFile & blockFileLog)
 {
-   auto &project = mProject;
-   auto &projectFileIO = ProjectFileIO::Get( project );
-   // New blockfiles have been created, so add them to the auto-save file
-   const auto &autoSaveFileName = projectFileIO.GetAutoSaveFileName();
-   if ( !autoSaveFileName.empty() )
+   // New blockfiles have been created, so add them to the auto-save file,
+   // but only once they are written, lest recovery after a crash find them
+   // missing.  Append on the main thread, where AutoSave() replaces the
+   // file, so that the two don't race; the project may be gone by then.
+   std::weak_ptr< ProjectAudioManager > wThis = shared_from_this();
+   BlockWriter::Get().AfterWrites(
+      [wThis, bytes = blockFileLog.GetAppendBytes()]
    {
-      wxFFile f{ autoSaveFileName, wxT("ab") };
-      if (!f.IsOpened())
-         return; // Keep recording going, there's not much we can do here
-      blockFileLog.Append(f);
-      f.Close();
-   }
+      wxTheApp->CallAfter( [wThis, bytes] {
+         auto pThis = wThis.lock();
+         if (!pThis)
+            return;
+         const auto &autoSaveFileName =
+            ProjectFileIO::Get( pThis->mProject ).GetAutoSaveFileName();
+         // Append to the file that is current now, but never create one
+         wxFFile f;
+         if ( autoSaveFileName.empty() || !wxFileExists(autoSaveFileName) ||
+              !f.Open( autoSaveFileName, wxT("r+b") ) || !f.SeekEnd() )
+            return; // Keep recording going, there's not much we can do here
+         f.Write(bytes.data(), bytes.size());
+         f.Close();
+      } );
+   } );
 }
 
 void ProjectAudioManager::OnCommitRecording()
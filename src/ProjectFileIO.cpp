@@ -21,6 +21,7 @@ Paul Licameli split from AudacityProject.cpp
 #include "Tags.h"
 #include "ViewInfo.h"
 #include "WaveTrack.h"
+#include "blockfile/BlockWriter.h"
 #include "widgets/AudacityMessageBox.h"
 #include "widgets/NumericTextCtrl.h"
 
@@ -595,6 +596,9 @@ void ProjectFileIO::AutoSave()
    wxString fn = wxFileName(FileNames::AutoSaveDir(),
       projName + wxString(wxT(" - ")) + CreateUniqueName()).GetFullPath();
 
+   // The blocks of a recording that the auto-save names must exist first
+   BlockWriter::Get().Flush();
+
    // PRL:  I found a try-catch and rewrote it,
    // but this guard is unnecessary because AutoSaveFile does not throw
    bool success = GuardedCall< bool >( [&]
@@ -59,6 +59,7 @@ Paul Licameli split from AudacityProject.cpp
 #include "widgets/ErrorDialog.h"
 #include "widgets/FileHistory.h"
 #include "widgets/Warning.h"
+#include "xml/XMLBinary.h"
 #include "xml/XMLFileReader.h"
 
 static const AudacityProject::AttachedObjects::RegisteredFactory sFileManagerKey{
@@ -168,8 +169,6 @@ auto ProjectFileManager::ReadProjectFile( const FilePath &fileName )
    /// Parse project file
    ///
 
-   XMLFileReader xmlFile;
-
 #ifdef EXPERIMENTAL_OD_DATA
    // 'Lossless copy' projects have dependencies. We need to always copy-in
    // these dependencies when converting to a normal project.
@@ -193,7 +192,20 @@ auto ProjectFileManager::ReadProjectFile( const FilePath &fileName )
    } );
 #endif
 
-   bool bParseSuccess = xmlFile.Parse(&projectFileIO, fileName);
+   bool bParseSuccess;
+   TranslatableString errorStr, libraryErrorStr;
+   if (XMLBinaryReader::IsBinary(fileName)) {
+      XMLBinaryReader binaryFile;
+      bParseSuccess = binaryFile.Parse(&projectFileIO, fileName);
+      errorStr = binaryFile.GetErrorStr();
+      libraryErrorStr = binaryFile.GetLibraryErrorStr();
+   }
+   else {
+      XMLFileReader xmlFile;
+      bParseSuccess = xmlFile.Parse(&projectFileIO, fileName);
+      errorStr = xmlFile.GetErrorStr();
+      libraryErrorStr = xmlFile.GetLibraryErrorStr();
+   }
    
    bool err = false;
 
@@ -223,8 +235,8 @@ auto ProjectFileManager::ReadProjectFile( const FilePath &fileName )
    }
 
    return {
-      false, bParseSuccess, err, xmlFile.GetErrorStr(),
-      FindHelpUrl( xmlFile.GetLibraryErrorStr() )
+      false, bParseSuccess, err, errorStr,
+      FindHelpUrl( libraryErrorStr )
    };
 }
 
@@ -489,6 +501,11 @@ bool ProjectFileManager::DoSave (const bool fromSaveAs,
          return false;
    }
 
+   // Reclaim the space of deleted packed blocks.  The extents that the
+   // .aup names must be in place first.
+   if (!bWantSaveCopy)
+      dirManager.CompactPackFiles();
+
    // Write the .aup now, before DirManager::SetProject,
    // because it's easier to clean up the effects of successful write of .aup
    // followed by failed SetProject, than the other way about.
@@ -496,9 +513,18 @@ bool ProjectFileManager::DoSave (const bool fromSaveAs,
    // not done.
    // (SetProject, when it fails, cleans itself up.)
    XMLFileWriter saveFile{ fileName, XO("Error Saving Project") };
+   const bool binary =
+      gPrefs->ReadBool(wxT("/Directories/BinaryProjectFiles"), false);
    success = GuardedCall< bool >( [&] {
-         projectFileIO.WriteXMLHeader(saveFile);
-         projectFileIO.WriteXML(saveFile, bWantSaveCopy ? &strOtherNamesArray : nullptr);
+         if (binary) {
+            XMLBinaryWriter binaryFile;
+            projectFileIO.WriteXML(binaryFile, bWantSaveCopy ? &strOtherNamesArray : nullptr);
+            binaryFile.WriteTo(saveFile);
+         }
+         else {
+            projectFileIO.WriteXMLHeader(saveFile);
+            projectFileIO.WriteXML(saveFile, bWantSaveCopy ? &strOtherNamesArray : nullptr);
+         }
          // Flushes files, forcing space exhaustion errors before trying
          // SetProject():
          saveFile.PreCommit();
@@ -602,6 +628,10 @@ bool ProjectFileManager::DoSave (const bool fromSaveAs,
       }
 
       UndoManager::Get( proj ).StateSaved();
+
+      // No saved project refers any more to the extents that no block in
+      // memory uses
+      dirManager.RemoveUnusedPackFiles();
    }
 
    // If we get here, saving the project was successful, so we can DELETE
@@ -1318,7 +1348,8 @@ void ProjectFileManager::OpenFile(const FilePath &fileNameArg, bool addtohistory
    }
 
    // FIXME: //v Surely we could be smarter about this, like checking much earlier that this is a .aup file.
-   if (temp.Mid(0, 6) != wxT("<?xml ")) {
+   if (temp.Mid(0, 6) != wxT("<?xml ") &&
+       !XMLBinaryReader::IsBinary(fileName)) {
       // If it's not XML, try opening it as any other form of audio
 
 #ifdef EXPERIMENTAL_DRAG_DROP_PLUG_INS
@@ -22,11 +22,30 @@
   AvailForPut and AvailForGet may underestimate but will never
   overestimate.
 
+*//*******************************************************************//*!
+
+\class InterleavedRingBuffer
+\brief Holds streamed audio samples of several channels, interleaved.
+
+  The same single-writer, single-reader discipline as for RingBuffer
+  applies.  One pair of atomic positions serves all channels, so all
+  channels are transferred with one synchronization, and the amounts
+  available are the same for every channel.
+
+  The writer may reserve frames and fill them in place, one channel at a
+  time, before publishing all of them together.  The reader may likewise
+  copy out each channel before consuming.
+
+  Storage is aligned to a cache line.
+
 *//*******************************************************************/
 
 
 #include "RingBuffer.h"
 
+#include <cstdint>
+#include <cstring>
+
 RingBuffer::RingBuffer(sampleFormat format, size_t size)
    : mFormat{ format }
    , mBufferSize{ std::max<size_t>(size, 64) }
@@ -194,3 +213,147 @@ size_t RingBuffer::Discard(size_t samplesToDiscard)
 
    return samplesToDiscard;
 }
+
+InterleavedRingBuffer::InterleavedRingBuffer(
+   sampleFormat format, unsigned channels, size_t size)
+   : mFormat{ format }
+   , mChannels{ std::max(1u, channels) }
+   , mFrameBytes{ mChannels * SAMPLE_SIZE(format) }
+   , mBufferSize{ std::max<size_t>(size, 64) }
+   , mStorage{ mBufferSize * mFrameBytes + CacheLine }
+{
+   const auto address = reinterpret_cast<uintptr_t>(mStorage.get());
+   mBuffer = mStorage.get() + (CacheLine - address % CacheLine) % CacheLine;
+}
+
+InterleavedRingBuffer::~InterleavedRingBuffer()
+{
+}
+
+size_t InterleavedRingBuffer::Filled( size_t start, size_t end )
+{
+   return (end + mBufferSize - start) % mBufferSize;
+}
+
+size_t InterleavedRingBuffer::Free( size_t start, size_t end )
+{
+   return std::max<size_t>(mBufferSize - Filled( start, end ), 4) - 4;
+}
+
+auto InterleavedRingBuffer::MakeSpans( size_t pos, size_t frames ) -> Spans
+{
+   Spans spans;
+   const auto firstFrames = std::min( frames, mBufferSize - pos );
+   spans.first = { mBuffer + pos * mFrameBytes, firstFrames };
+   if ( firstFrames < frames )
+      spans.second = { mBuffer, frames - firstFrames };
+   return spans;
+}
+
+//
+// For the writer only; see the comments for RingBuffer about memory order
+//
+
+size_t InterleavedRingBuffer::AvailForPut()
+{
+   auto start = mStart.load( std::memory_order_relaxed );
+   auto end = mEnd.load( std::memory_order_relaxed );
+   return Free( start, end );
+}
+
+auto InterleavedRingBuffer::GetWritable(size_t frames) -> Spans
+{
+   auto start = mStart.load( std::memory_order_acquire );
+   auto end = mEnd.load( std::memory_order_relaxed );
+   return MakeSpans( end, std::min( frames, Free( start, end ) ) );
+}
+
+void InterleavedRingBuffer::PutChannel(const Spans &spans, unsigned channel,
+   samplePtr buffer, sampleFormat format, size_t samples)
+{
+   const auto offset = channel * SAMPLE_SIZE(mFormat);
+   auto src = buffer;
+   for (auto &span : { spans.first, spans.second }) {
+      if (!span.frames)
+         continue;
+      const auto dst = span.ptr + offset;
+      const auto copied = std::min( samples, span.frames );
+      CopySamples(src, format, dst, mFormat, copied, true, 1, mChannels);
+      src += copied * SAMPLE_SIZE(format);
+      samples -= copied;
+      // Clear the channel after the given samples
+      for (auto frame = copied; frame < span.frames; ++frame)
+         memset( dst + frame * mFrameBytes, 0, SAMPLE_SIZE(mFormat) );
+   }
+}
+
+void InterleavedRingBuffer::CommitPut(size_t frames)
+{
+   auto end = mEnd.load( std::memory_order_relaxed );
+   // Release, so the nonatomic writes to the buffer don't get reordered after
+   mEnd.store( (end + frames) % mBufferSize, std::memory_order_release );
+}
+
+size_t InterleavedRingBuffer::Put(samplePtr buffer, size_t frames)
+{
+   const auto spans = GetWritable( frames );
+   auto src = buffer;
+   for (auto &span : { spans.first, spans.second }) {
+      if (!span.frames)
+         continue;
+      const auto bytes = span.frames * mFrameBytes;
+      memcpy( span.ptr, src, bytes );
+      src += bytes;
+   }
+   CommitPut( spans.Frames() );
+   return spans.Frames();
+}
+
+//
+// For the reader only
+//
+
+size_t InterleavedRingBuffer::AvailForGet()
+{
+   auto end = mEnd.load( std::memory_order_relaxed ); // get away with it here
+   auto start = mStart.load( std::memory_order_relaxed );
+   return Filled( start, end );
+}
+
+auto InterleavedRingBuffer::GetReadable(size_t frames) -> Spans
+{
+   // Must match the writer's release with acquire for well defined reads of
+   // the buffer
+   auto end = mEnd.load( std::memory_order_acquire );
+   auto start = mStart.load( std::memory_order_relaxed );
+   return MakeSpans( start, std::min( frames, Filled( start, end ) ) );
+}
+
+size_t InterleavedRingBuffer::GetChannel(unsigned channel,
+   samplePtr buffer, sampleFormat format, size_t samples)
+{
+   const auto spans = GetReadable( samples );
+   const auto offset = channel * SAMPLE_SIZE(mFormat);
+   auto dst = buffer;
+   for (auto &span : { spans.first, spans.second }) {
+      if (!span.frames)
+         continue;
+      CopySamples(span.ptr + offset, mFormat, dst, format, span.frames,
+                  true, mChannels, 1);
+      dst += span.frames * SAMPLE_SIZE(format);
+   }
+   return spans.Frames();
+}
+
+size_t InterleavedRingBuffer::Discard(size_t frames)
+{
+   auto end = mEnd.load( std::memory_order_relaxed ); // get away with it here
+   auto start = mStart.load( std::memory_order_relaxed );
+   frames = std::min( frames, Filled( start, end ) );
+
+   // Communicate to writer that we have consumed some data, with release
+   // order because the frames may have been read in place
+   mStart.store( (start + frames) % mBufferSize, std::memory_order_release );
+
+   return frames;
+}
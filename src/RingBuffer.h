@@ -12,6 +12,7 @@
 #define __AUDACITY_RING_BUFFER__
 
 #include "SampleFormat.h"
+#include "MemoryX.h"
 #include <atomic>
 
 class RingBuffer {
@@ -58,4 +59,75 @@ class RingBuffer {
    SampleBuffer  mBuffer;
 };
 
+/// A RingBuffer of interleaved frames of several channels, all moving
+/// together under one pair of atomic positions
+class InterleavedRingBuffer {
+ public:
+   /// A contiguous run of interleaved frames within the buffer
+   struct Span {
+      samplePtr ptr{};
+      size_t frames{ 0 };
+   };
+   /// A range of frames, which may wrap around the end of the buffer
+   struct Spans {
+      Span first, second;
+      size_t Frames() const { return first.frames + second.frames; }
+   };
+
+   InterleavedRingBuffer(sampleFormat format, unsigned channels, size_t size);
+   ~InterleavedRingBuffer();
+
+   sampleFormat GetFormat() const { return mFormat; }
+   unsigned GetChannels() const { return mChannels; }
+
+   //
+   // For the writer only:
+   //
+
+   size_t AvailForPut();
+   /// Reserve up to the given number of free frames, for writing in place.
+   /// The reader does not see them until CommitPut().
+   Spans GetWritable(size_t frames);
+   /// Copy samples of one channel into reserved frames, with format
+   /// conversion, and clear that channel in the rest of them
+   void PutChannel(const Spans &spans, unsigned channel,
+                   samplePtr buffer, sampleFormat format, size_t samples);
+   /// Publish frames previously reserved
+   void CommitPut(size_t frames);
+   /// Copy whole interleaved frames, which must be in the buffer's format
+   size_t Put(samplePtr buffer, size_t frames);
+
+   //
+   // For the reader only:
+   //
+
+   size_t AvailForGet();
+   /// The first frames available, for reading in place, without consuming
+   Spans GetReadable(size_t frames);
+   /// Copy one channel of the first frames available, with format
+   /// conversion, without consuming them
+   size_t GetChannel(unsigned channel,
+                     samplePtr buffer, sampleFormat format, size_t samples);
+   /// Consume frames, for all channels at once
+   size_t Discard(size_t frames);
+
+ private:
+   size_t Filled( size_t start, size_t end );
+   size_t Free( size_t start, size_t end );
+   Spans MakeSpans( size_t pos, size_t frames );
+
+   enum : size_t { CacheLine = 64 };
+
+   alignas(CacheLine) std::atomic<size_t> mStart { 0 };
+   alignas(CacheLine) std::atomic<size_t> mEnd{ 0 };
+
+   const sampleFormat mFormat;
+   const unsigned     mChannels;
+   const size_t       mFrameBytes;
+   const size_t       mBufferSize; // in frames
+
+   ArrayOf<char> mStorage;
+   samplePtr     mBuffer; // aligned to a cache line within mStorage
+};
+
 #endif /*  __AUDACITY_RING_BUFFER__ */
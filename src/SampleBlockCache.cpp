@@ -0,0 +1,140 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleBlockCache.cpp
+
+*******************************************************************//**
+
+\class SampleBlockCache
+\brief Holds recently read sample blocks in memory, up to a total size
+given by the preference "/Directories/SampleCacheSize" in megabytes.
+
+Sequence::Read() consults it, so it serves everything that reads
+samples: Sequence::Get(), WaveTrackCache and so the Mixer, and the
+waveform and spectrogram displays.  On a miss the whole block is read
+and cached, so neighbouring reads hit.
+
+Entries are keyed by the identity of the BlockFile, which is immutable,
+and by the requested sample format.  The least recently used entries are
+evicted first.  Each BlockFile removes its own entries when destroyed,
+so an address is never confused with that of an older block.
+
+A budget of zero disables the cache.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "SampleBlockCache.h"
+
+#include "Prefs.h"
+
+namespace {
+// Default budget in megabytes
+constexpr long DefaultBudget = 256;
+}
+
+SampleBlockCache &SampleBlockCache::Get()
+{
+   // Never destroyed, because block files may outlive other statics
+   static auto theCache = safenew SampleBlockCache;
+   return *theCache;
+}
+
+SampleBlockCache::SampleBlockCache()
+{
+   UpdatePrefs();
+}
+
+void SampleBlockCache::UpdatePrefs()
+{
+   long budget = DefaultBudget;
+   if (gPrefs)
+      budget = gPrefs->Read(wxT("/Directories/SampleCacheSize"), DefaultBudget);
+   if (budget < 0)
+      budget = 0;
+
+   ODLocker locker{ &mLock };
+   mBudget = (size_t)budget << 20;
+   Trim();
+}
+
+auto SampleBlockCache::Find(const BlockFile &file, sampleFormat format)
+   -> EntryPtr
+{
+   ODLocker locker{ &mLock };
+   auto iter = mIndex.find({ &file, format });
+   if (iter == mIndex.end()) {
+      ++mStatistics.misses;
+      return {};
+   }
+
+   ++mStatistics.hits;
+   // Move to the front
+   mEntries.splice(mEntries.begin(), mEntries, iter->second);
+   return iter->second->second;
+}
+
+void SampleBlockCache::Insert(
+   const BlockFile &file, sampleFormat format, EntryPtr entry)
+{
+   const auto bytes = Bytes(*entry, format);
+   if (!Admits(bytes))
+      return;
+
+   ODLocker locker{ &mLock };
+   const Key key{ &file, format };
+   if (mIndex.count(key))
+      // Another thread was quicker
+      return;
+
+   mEntries.emplace_front(key, std::move(entry));
+   mIndex[key] = mEntries.begin();
+   mBytes += bytes;
+   Trim();
+}
+
+void SampleBlockCache::Invalidate(const BlockFile &file)
+{
+   ODLocker locker{ &mLock };
+   if (mIndex.empty())
+      return;
+
+   for (auto format : { int16Sample, int24Sample, floatSample }) {
+      auto iter = mIndex.find({ &file, format });
+      if (iter != mIndex.end()) {
+         mBytes -= Bytes(*iter->second->second, format);
+         mEntries.erase(iter->second);
+         mIndex.erase(iter);
+      }
+   }
+}
+
+void SampleBlockCache::Clear()
+{
+   ODLocker locker{ &mLock };
+   mIndex.clear();
+   mEntries.clear();
+   mBytes = 0;
+}
+
+auto SampleBlockCache::GetStatistics() -> Statistics
+{
+   ODLocker locker{ &mLock };
+   auto result = mStatistics;
+   result.entries = mEntries.size();
+   result.bytes = mBytes;
+   result.budget = mBudget;
+   return result;
+}
+
+void SampleBlockCache::Trim()
+{
+   while (!mEntries.empty() && mBytes > mBudget) {
+      auto &entry = mEntries.back();
+      mBytes -= Bytes(*entry.second, entry.first.second);
+      mIndex.erase(entry.first);
+      mEntries.pop_back();
+      ++mStatistics.evictions;
+   }
+}
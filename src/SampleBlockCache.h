@@ -0,0 +1,98 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleBlockCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_BLOCK_CACHE__
+#define __AUDACITY_SAMPLE_BLOCK_CACHE__
+
+#include "Audacity.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "SampleFormat.h"
+#include "ondemand/ODTaskThread.h"
+
+class BlockFile;
+
+/// Process-wide cache of the decoded samples of whole blocks, limited by a
+/// byte budget, shared by all Sequences
+class AUDACITY_DLL_API SampleBlockCache final
+{
+ public:
+   /// Samples of one block, in one format; immutable once cached
+   struct Entry {
+      Entry(size_t len, sampleFormat format)
+         : buffer{ len, format }, length{ len } {}
+      SampleBuffer buffer;
+      const size_t length;
+   };
+   using EntryPtr = std::shared_ptr<const Entry>;
+
+   struct Statistics {
+      unsigned long long hits{ 0 };
+      unsigned long long misses{ 0 };
+      unsigned long long evictions{ 0 };
+      size_t entries{ 0 };
+      size_t bytes{ 0 };
+      size_t budget{ 0 };
+   };
+
+   static SampleBlockCache &Get();
+
+   SampleBlockCache();
+   SampleBlockCache(const SampleBlockCache&) PROHIBITED;
+   SampleBlockCache &operator= (const SampleBlockCache&) PROHIBITED;
+
+   /// Reread the budget from preferences, evicting as needed
+   void UpdatePrefs();
+
+   bool IsEnabled() const { return mBudget > 0; }
+
+   /// Whether a block of this many bytes may ever be cached
+   bool Admits(size_t bytes) const { return bytes <= mBudget / 4; }
+
+   /// Returns null, and counts a miss, if the block is not cached in
+   /// the given format
+   EntryPtr Find(const BlockFile &file, sampleFormat format);
+
+   /// Add samples just read from the file, evicting others as needed
+   void Insert(const BlockFile &file, sampleFormat format, EntryPtr entry);
+
+   /// Must be called when the block file is destroyed
+   void Invalidate(const BlockFile &file);
+
+   /// Discard all entries
+   void Clear();
+
+   Statistics GetStatistics();
+
+ private:
+   using Key = std::pair< const BlockFile*, sampleFormat >;
+   struct KeyHash {
+      size_t operator () (const Key &key) const
+      {
+         return std::hash<const void*>{}(key.first) ^ (size_t)key.second;
+      }
+   };
+   using Entries = std::list< std::pair< Key, EntryPtr > >;
+
+   static size_t Bytes(const Entry &entry, sampleFormat format)
+   { return entry.length * SAMPLE_SIZE(format); }
+   void Trim();
+
+   ODLock mLock;
+   Entries mEntries; // most recently used first
+   std::unordered_map< Key, Entries::iterator, KeyHash > mIndex;
+   size_t mBytes{ 0 };
+   std::atomic<size_t> mBudget{ 0 };
+   Statistics mStatistics;
+};
+
+#endif
@@ -0,0 +1,288 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleStats.cpp
+
+*******************************************************************//*!
+
+\file SampleStats.cpp
+\brief The one reduction of samples to minimum, maximum, and sum of
+squares, used by the summaries of block files and by the wave displays
+of sequences and clips.
+
+*//*******************************************************************/
+
+#include "SampleStats.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SAMPLESTATS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// As in Dither.cpp; powers of two, so that scaling is exact
+const float Int16Scale = 1.0f / float(1 << 15);
+const float Int24Scale = 1.0f / float(1 << 23);
+
+inline void Accumulate(MinMaxSumsq &result, float v)
+{
+   if (v < result.min)
+      result.min = v;
+   if (v > result.max)
+      result.max = v;
+   result.sumsq += v * v;
+}
+
+#ifdef SAMPLESTATS_USE_SSE2
+struct Accumulator
+{
+   __m128 min = _mm_set1_ps(FLT_MAX);
+   __m128 max = _mm_set1_ps(-FLT_MAX);
+   __m128 sumsq = _mm_setzero_ps();
+
+   void Add(__m128 v)
+   {
+      // The second operand is the result if either is NaN, so NaN samples
+      // are skipped
+      min = _mm_min_ps(v, min);
+      max = _mm_max_ps(v, max);
+      sumsq = _mm_add_ps(sumsq, _mm_mul_ps(v, v));
+   }
+
+   void Merge(const Accumulator &other)
+   {
+      min = _mm_min_ps(other.min, min);
+      max = _mm_max_ps(other.max, max);
+      sumsq = _mm_add_ps(sumsq, other.sumsq);
+   }
+
+   MinMaxSumsq Reduce() const
+   {
+      float mins[4], maxes[4], sums[4];
+      _mm_storeu_ps(mins, min);
+      _mm_storeu_ps(maxes, max);
+      _mm_storeu_ps(sums, sumsq);
+      MinMaxSumsq result;
+      for (int i = 0; i < 4; ++i) {
+         if (mins[i] < result.min)
+            result.min = mins[i];
+         if (maxes[i] > result.max)
+            result.max = maxes[i];
+      }
+      result.sumsq = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+      return result;
+   }
+};
+#endif
+
+}
+
+MinMaxSumsq ComputeMinMaxSumsq(
+   const float *samples, size_t len, size_t stride)
+{
+   MinMaxSumsq result;
+   size_t i = 0;
+#ifdef SAMPLESTATS_USE_SSE2
+   if (stride == 1 && len >= 8) {
+      // Two accumulators, so that the additions of one need not wait for
+      // those of the other
+      Accumulator a, b;
+      for (; i + 8 <= len; i += 8) {
+         a.Add(_mm_loadu_ps(samples + i));
+         b.Add(_mm_loadu_ps(samples + i + 4));
+      }
+      a.Merge(b);
+      result = a.Reduce();
+   }
+#endif
+   for (; i < len; ++i)
+      Accumulate(result, samples[i * stride]);
+   return result;
+}
+
+MinMaxSumsq ComputeMinMaxSumsq(
+   const short *samples, size_t len, size_t stride)
+{
+   MinMaxSumsq result;
+   size_t i = 0;
+#ifdef SAMPLESTATS_USE_SSE2
+   if (stride == 1 && len >= 8) {
+      // Compare as integers; square without scaling, and scale the sum,
+      // which by powers of two changes no bits of the mantissas
+      __m128i min = _mm_set1_epi16(32767);
+      __m128i max = _mm_set1_epi16(-32768);
+      __m128 sumLo = _mm_setzero_ps(), sumHi = _mm_setzero_ps();
+      for (; i + 8 <= len; i += 8) {
+         const __m128i v = _mm_loadu_si128((const __m128i*)(samples + i));
+         min = _mm_min_epi16(min, v);
+         max = _mm_max_epi16(max, v);
+         const __m128 lo =
+            _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+         const __m128 hi =
+            _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+         sumLo = _mm_add_ps(sumLo, _mm_mul_ps(lo, lo));
+         sumHi = _mm_add_ps(sumHi, _mm_mul_ps(hi, hi));
+      }
+      short mins[8], maxes[8];
+      float sums[4];
+      _mm_storeu_si128((__m128i*)mins, min);
+      _mm_storeu_si128((__m128i*)maxes, max);
+      _mm_storeu_ps(sums, _mm_add_ps(sumLo, sumHi));
+      short least = mins[0], greatest = maxes[0];
+      for (int j = 1; j < 8; ++j) {
+         least = std::min(least, mins[j]);
+         greatest = std::max(greatest, maxes[j]);
+      }
+      result.min = least * Int16Scale;
+      result.max = greatest * Int16Scale;
+      result.sumsq = ((sums[0] + sums[1]) + (sums[2] + sums[3])) *
+         (Int16Scale * Int16Scale);
+   }
+#endif
+   for (; i < len; ++i)
+      Accumulate(result, samples[i * stride] * Int16Scale);
+   return result;
+}
+
+MinMaxSumsq ComputeMinMaxSumsqInt24(
+   const int *samples, size_t len, size_t stride)
+{
+   MinMaxSumsq result;
+   size_t i = 0;
+#ifdef SAMPLESTATS_USE_SSE2
+   if (stride == 1 && len >= 8) {
+      // Every 24 bit value converts to float exactly
+      const __m128 scale = _mm_set1_ps(Int24Scale);
+      Accumulator a, b;
+      for (; i + 8 <= len; i += 8) {
+         a.Add(_mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_loadu_si128((const __m128i*)(samples + i))), scale));
+         b.Add(_mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_loadu_si128((const __m128i*)(samples + i + 4))), scale));
+      }
+      a.Merge(b);
+      result = a.Reduce();
+   }
+#endif
+   for (; i < len; ++i)
+      Accumulate(result, samples[i * stride] * Int24Scale);
+   return result;
+}
+
+MinMaxSumsq ComputeMinMaxSumsq(
+   samplePtr samples, sampleFormat format, size_t len, size_t stride)
+{
+   switch (format) {
+   case int16Sample:
+      return ComputeMinMaxSumsq((const short *)samples, len, stride);
+   case int24Sample:
+      return ComputeMinMaxSumsqInt24((const int *)samples, len, stride);
+   default:
+   case floatSample:
+      return ComputeMinMaxSumsq((const float *)samples, len, stride);
+   }
+}
+
+MinMaxSumsq CombineSummaryTriples(const float *triples, size_t count)
+{
+   MinMaxSumsq result;
+   size_t i = 0;
+#ifdef SAMPLESTATS_USE_SSE2
+   if (count >= 4) {
+      // Four triples fill three vectors, whose lanes hold in turn
+      //    min max rms min | max rms min max | rms min max rms
+      // Accumulate everything in every lane, and take from each lane only
+      // what belongs to it
+      Accumulator a[3];
+      for (; i + 4 <= count; i += 4) {
+         const float *p = triples + 3 * i;
+         a[0].Add(_mm_loadu_ps(p));
+         a[1].Add(_mm_loadu_ps(p + 4));
+         a[2].Add(_mm_loadu_ps(p + 8));
+      }
+      float mins[12], maxes[12], sums[12];
+      for (int k = 0; k < 3; ++k) {
+         _mm_storeu_ps(mins + 4 * k, a[k].min);
+         _mm_storeu_ps(maxes + 4 * k, a[k].max);
+         _mm_storeu_ps(sums + 4 * k, a[k].sumsq);
+      }
+      for (int j = 0; j < 12; ++j) {
+         switch (j % 3) {
+         case 0:
+            if (mins[j] < result.min)
+               result.min = mins[j];
+            break;
+         case 1:
+            if (maxes[j] > result.max)
+               result.max = maxes[j];
+            break;
+         default:
+            result.sumsq += sums[j];
+            break;
+         }
+      }
+   }
+#endif
+   for (triples += 3 * i; i < count; ++i, triples += 3) {
+      if (triples[0] < result.min)
+         result.min = triples[0];
+      if (triples[1] > result.max)
+         result.max = triples[1];
+      result.sumsq += triples[2] * triples[2];
+   }
+   return result;
+}
+
+namespace {
+
+// Whether min and max might not be those of loops that began at the first
+// value:  if that was NaN, or if nothing was below FLT_MAX or above -FLT_MAX
+inline bool Unseeded(const MinMaxSumsq &result, float firstMin, float firstMax)
+{
+   return firstMin != firstMin || firstMax != firstMax ||
+      !(result.min < FLT_MAX) || !(result.max > -FLT_MAX);
+}
+
+}
+
+MinMaxSumsq ComputeMinMaxSumsqFromFirst(const float *samples, size_t len)
+{
+   auto result = ComputeMinMaxSumsq(samples, len);
+   if (len > 0 && Unseeded(result, samples[0], samples[0])) {
+      // Rarely; do it as the loops did
+      result = { samples[0], samples[0], 0.0f };
+      for (size_t i = 0; i < len; ++i)
+         Accumulate(result, samples[i]);
+   }
+   return result;
+}
+
+MinMaxSumsq ComputeMinMaxSumsqFromFirst(
+   samplePtr samples, sampleFormat format, size_t len)
+{
+   // Only floats can be NaN or infinite
+   if (format == floatSample)
+      return ComputeMinMaxSumsqFromFirst((const float *)samples, len);
+   return ComputeMinMaxSumsq(samples, format, len);
+}
+
+MinMaxSumsq CombineSummaryTriplesFromFirst(const float *triples, size_t count)
+{
+   auto result = CombineSummaryTriples(triples, count);
+   if (count > 0 && Unseeded(result, triples[0], triples[1])) {
+      result = { triples[0], triples[1], 0.0f };
+      for (size_t i = 0; i < count; ++i, triples += 3) {
+         if (triples[0] < result.min)
+            result.min = triples[0];
+         if (triples[1] > result.max)
+            result.max = triples[1];
+         result.sumsq += triples[2] * triples[2];
+      }
+   }
+   return result;
+}
@@ -0,0 +1,56 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleStats.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_STATS__
+#define __AUDACITY_SAMPLE_STATS__
+
+#include "audacity/Types.h" // for samplePtr, sampleFormat
+
+#include <cfloat>
+#include <cstddef>
+
+/// Minimum, maximum, and sum of squares of a range of samples.  An empty
+/// range has min FLT_MAX and max -FLT_MAX, so that it combines harmlessly.
+/// NaN samples are skipped by min and max, as by the comparisons of the
+/// loops that these functions replace; but see the FromFirst functions.
+struct MinMaxSumsq
+{
+   float min{ FLT_MAX };
+   float max{ -FLT_MAX };
+   float sumsq{ 0.0f };
+};
+
+/// Samples are every stride-th value.  Where SSE2 is available, contiguous
+/// samples are done eight at a time; the sum of squares is then added in
+/// another order, so it may differ from the scalar result in the last bits.
+MinMaxSumsq ComputeMinMaxSumsq(
+   const float *samples, size_t len, size_t stride = 1);
+
+/// As for floats converted by CopySamples(), without converting them first
+MinMaxSumsq ComputeMinMaxSumsq(
+   const short *samples, size_t len, size_t stride = 1);
+MinMaxSumsq ComputeMinMaxSumsqInt24(
+   const int *samples, size_t len, size_t stride = 1);
+
+MinMaxSumsq ComputeMinMaxSumsq(
+   samplePtr samples, sampleFormat format, size_t len, size_t stride = 1);
+
+/// From count summary triples of min, max, and rms:  the least min, the
+/// greatest max, and the sum of the squares of the rms values
+MinMaxSumsq CombineSummaryTriples(const float *triples, size_t count);
+
+/// As the loops of the summaries of block files and of the display of the
+/// append buffer, which began min and max at the first value, not at
+/// FLT_MAX:  a leading NaN makes them NaN, and infinities are kept where no
+/// value is finite.  len and count must be positive.
+MinMaxSumsq ComputeMinMaxSumsqFromFirst(const float *samples, size_t len);
+MinMaxSumsq ComputeMinMaxSumsqFromFirst(
+   samplePtr samples, sampleFormat format, size_t len);
+MinMaxSumsq CombineSummaryTriplesFromFirst(const float *triples, size_t count);
+
+#endif
@@ -0,0 +1,974 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SelfTests.cpp
+
+*******************************************************************//*!
+
+\file SelfTests.cpp
+\brief Checks of the faster paths for samples and project files against
+the code that they replaced, for alpha builds.
+
+Each check keeps a copy of the old code where it needs one, compares the
+results, and logs the times of both.  The messages are for developers, so
+they are not translated.
+
+*//*******************************************************************/
+
+#include "SelfTests.h"
+
+#ifdef IS_ALPHA
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <wx/ffile.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+#include <wx/stopwatch.h>
+#include <wx/utils.h>
+
+#include "AudacityException.h"
+#include "AudacityLogger.h"
+#include "DirManager.h"
+#include "Dither.h"
+#include "FileFormats.h"
+#include "FileNames.h"
+#include "Internat.h"
+#include "Prefs.h"
+#include "ProjectSettings.h"
+#include "SampleFormat.h"
+#include "SampleStats.h"
+#include "Tags.h"
+#include "ViewInfo.h"
+#include "WaveTrack.h"
+#include "import/Import.h"
+#include "xml/XMLBinary.h"
+#include "xml/XMLFileReader.h"
+
+namespace {
+
+// Samples in the test track, and in the buffers of the sample checks
+constexpr size_t TestLength = 4 * 1024 * 1024;
+
+FilePath TempFileName(const wxChar *name)
+{
+   return wxFileName(FileNames::TempDir(), name).GetFullPath();
+}
+
+std::vector<char> ReadFileBytes(const FilePath &name)
+{
+   std::vector<char> bytes;
+   wxFFile file{ name, wxT("rb") };
+   if (file.IsOpened()) {
+      bytes.resize(file.Length());
+      bytes.resize(file.Read(bytes.data(), bytes.size()));
+   }
+   return bytes;
+}
+
+// Writes the document to a file in the text or binary form
+bool SaveXML(const FilePath &name, bool binary,
+   const std::function< void(XMLWriter &) > &write)
+{
+   bool saved = false;
+   GuardedCall( [&] {
+      XMLFileWriter file{ name, XO("Error Saving Project") };
+      if (binary) {
+         XMLBinaryWriter writer;
+         write(writer);
+         writer.WriteTo(file);
+      }
+      else {
+         file.Write(wxT("<?xml version=\"1.0\" standalone=\"no\" ?>\n"));
+         write(file);
+      }
+      file.Commit();
+      saved = true;
+   } );
+   return saved;
+}
+
+// The loops that SampleStats replaced, as they were
+
+// BlockFile::CalcSummaryFromBuffer(), for 256 samples
+MinMaxSumsq OldSummary256(const float *fbuffer, size_t jcount)
+{
+   float min = fbuffer[0];
+   float max = fbuffer[0];
+   float sumsq = ((float)min) * ((float)min);
+   for (size_t j = 1; j < jcount; j++) {
+      float f1 = fbuffer[j];
+      sumsq += ((float)f1) * ((float)f1);
+      if (f1 < min)
+         min = f1;
+      else if (f1 > max)
+         max = f1;
+   }
+   return { min, max, sumsq };
+}
+
+// BlockFile::CalcSummaryFromBuffer(), for 64K samples from 256 triples
+MinMaxSumsq OldSummary64K(const float *summary256)
+{
+   float min = summary256[0];
+   float max = summary256[1];
+   float sumsq = summary256[2];
+   sumsq *= sumsq;
+   for (size_t j = 1; j < 256; j++) {
+      if (summary256[3 * j] < min)
+         min = summary256[3 * j];
+      if (summary256[3 * j + 1] > max)
+         max = summary256[3 * j + 1];
+      float r1 = summary256[3 * j + 2];
+      sumsq += r1*r1;
+   }
+   return { min, max, sumsq };
+}
+
+// BlockFile::GetMinMaxRMS(), and Sequence::GetWaveDisplay() for samples
+MinMaxSumsq OldMinMaxSumsq(const float *pv, size_t count)
+{
+   float min = FLT_MAX, max = -FLT_MAX, sumsq = 0.0f;
+   while (count--) {
+      float v = *pv++;
+      if (v < min)
+         min = v;
+      if (v > max)
+         max = v;
+      sumsq += v * v;
+   }
+   return { min, max, sumsq };
+}
+
+// Sequence::GetWaveDisplay() for triples
+MinMaxSumsq OldCombineTriples(const float *pv, size_t count)
+{
+   float min = FLT_MAX, max = -FLT_MAX, sumsq = 0.0f;
+   while (count--) {
+      float v = *pv++;
+      if (v < min)
+         min = v;
+      v = *pv++;
+      if (v > max)
+         max = v;
+      v = *pv++;
+      sumsq += v * v;
+   }
+   return { min, max, sumsq };
+}
+
+// WaveClip::GetWaveDisplay(), for the append buffer
+MinMaxSumsq OldAppendBufferMinMaxSumsq(
+   samplePtr samples, sampleFormat format, size_t len)
+{
+   Floats b;
+   const float *pb{};
+   if (format == floatSample)
+      pb = (const float *)samples;
+   else {
+      b.reinit(len);
+      CopySamples(samples, format, (samplePtr)b.get(), floatSample, len);
+      pb = b.get();
+   }
+
+   float theMax, theMin, sumsq;
+   {
+      const float val = pb[0];
+      theMax = theMin = val;
+      sumsq = val * val;
+   }
+   for(decltype(len) j = 1; j < len; j++) {
+      const float val = pb[j];
+      theMax = std::max(theMax, val);
+      theMin = std::min(theMin, val);
+      sumsq += val * val;
+   }
+   return { theMin, theMax, sumsq };
+}
+
+// XMLWriter as it was before it composed UTF-8 itself: everything is
+// formatted as a wxString, then converted as XMLFileWriter::Write() did.
+// The self test requires the same bytes from the present writer.
+class OldXMLWriter final : public XMLWriter
+{
+public:
+   using XMLWriter::WriteAttr;
+
+   void StartTag(const wxString &name) override
+   {
+      if (mInTag) {
+         Write(wxT(">\n"));
+         mInTag = false;
+      }
+      for (int i = 0; i < mDepth; i++)
+         Write(wxT("\t"));
+      Write(wxString::Format(wxT("<%s"), name));
+      mTagstack.insert(mTagstack.begin(), name);
+      mHasKids[0] = true;
+      mHasKids.insert(mHasKids.begin(), false);
+      mDepth++;
+      mInTag = true;
+   }
+
+   void EndTag(const wxString &name) override
+   {
+      if (mTagstack.size() > 0) {
+         if (mTagstack[0] == name) {
+            if (mHasKids[1]) {
+               if (mInTag)
+                  Write(wxT("/>\n"));
+               else {
+                  for (int i = 0; i < mDepth - 1; i++)
+                     Write(wxT("\t"));
+                  Write(wxString::Format(wxT("</%s>\n"), name));
+               }
+            }
+            else
+               Write(wxT(">\n"));
+            mTagstack.erase( mTagstack.begin() );
+            mHasKids.erase(mHasKids.begin());
+         }
+      }
+      mDepth--;
+      mInTag = false;
+   }
+
+   void WriteAttr(const wxString &name, const wxString &value) override
+   {
+      Write(wxString::Format(wxT(" %s=\"%s\""), name, OldXMLEsc(value)));
+   }
+   void WriteAttr(const wxString &name, const wxChar *value) override
+   {
+      WriteAttr(name, wxString(value));
+   }
+   void WriteAttr(const wxString &name, int value) override
+   {
+      Write(wxString::Format(wxT(" %s=\"%d\""), name, value));
+   }
+   void WriteAttr(const wxString &name, bool value) override
+   {
+      Write(wxString::Format(wxT(" %s=\"%d\""), name, value));
+   }
+   void WriteAttr(const wxString &name, long value) override
+   {
+      Write(wxString::Format(wxT(" %s=\"%ld\""), name, value));
+   }
+   void WriteAttr(const wxString &name, long long value) override
+   {
+      Write(wxString::Format(wxT(" %s=\"%lld\""), name, value));
+   }
+   void WriteAttr(const wxString &name, size_t value) override
+   {
+      Write(wxString::Format(wxT(" %s=\"%lld\""), name, (long long) value));
+   }
+   void WriteAttr(const wxString &name, float value, int digits) override
+   {
+      Write(wxString::Format(wxT(" %s=\"%s\""),
+         name, Internat::ToString(value, digits)));
+   }
+   void WriteAttr(const wxString &name, double value, int digits) override
+   {
+      Write(wxString::Format(wxT(" %s=\"%s\""),
+         name, Internat::ToString(value, digits)));
+   }
+
+   void WriteData(const wxString &value) override
+   {
+      for (int i = 0; i < mDepth; i++)
+         Write(wxT("\t"));
+      Write(OldXMLEsc(value));
+   }
+
+   void WriteSubTree(const wxString &value) override
+   {
+      if (mInTag) {
+         Write(wxT(">\n"));
+         mInTag = false;
+         mHasKids[0] = true;
+      }
+      Write(value);
+   }
+
+   void Write(const wxString &data) override
+   {
+      const auto utf8 = data.utf8_str();
+      mBytes.insert(mBytes.end(), utf8.data(), utf8.data() + utf8.length());
+   }
+
+   const std::vector<char> &GetBytes() const { return mBytes; }
+
+private:
+   static wxString OldXMLEsc(const wxString &s)
+   {
+      wxString result;
+      int len = s.length();
+      for (int i = 0; i < len; i++) {
+         wxUChar c = s.GetChar(i);
+         switch (c) {
+            case wxT('\''): result += wxT("&apos;"); break;
+            case wxT('"'): result += wxT("&quot;"); break;
+            case wxT('&'): result += wxT("&amp;"); break;
+            case wxT('<'): result += wxT("&lt;"); break;
+            case wxT('>'): result += wxT("&gt;"); break;
+            default:
+               if (sizeof(c) == 2 && c >= 0xD800 && c <= 0xDBFF && i < len - 1) {
+                  wxUChar c2 = s.GetChar(++i);
+                  if (c2 >= 0xDC00 && c2 <= 0xDFFF) {
+                     result += c;
+                     result += c2;
+                  }
+                  else
+                     i--;
+               }
+               else if (!wxIsprint(c)) {
+                  // Of the controls, only tab, newline and return survive
+                  if ((c > 0x1F || c == 0x09 || c == 0x0A || c == 0x0D) &&
+                        (c < 0xD800 || c > 0xDFFF) &&
+                        c != 0xFFFE && c != 0xFFFF)
+                     result += wxString::Format(wxT("&#x%04x;"), c);
+               }
+               else
+                  result += c;
+            break;
+         }
+      }
+      return result;
+   }
+
+   std::vector<char> mBytes;
+};
+
+// Tags with what is hardest to format alike
+void WriteXMLCases(XMLWriter &out)
+{
+   out.StartTag(wxT("cases"));
+   out.WriteAttr(wxT("markup"), wxT("<a href=\"x\">'&amp;'</a>"));
+   out.WriteAttr(wxT("controls"), wxT("\ttab\nline\rreturn\x01\x1f\x7f"));
+   out.WriteAttr(wxT("unicode"), wxString::FromUTF8(
+      // e acute, euro sign, a supplementary character, and a noncharacter
+      "\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80 \xEF\xBF\xBE"));
+   out.WriteAttr(wxT("intmin"), std::numeric_limits<int>::min());
+   out.WriteAttr(wxT("intmax"), std::numeric_limits<int>::max());
+   out.WriteAttr(wxT("longmin"), std::numeric_limits<long>::min());
+   out.WriteAttr(wxT("longlongmin"), std::numeric_limits<long long>::min());
+   out.WriteAttr(wxT("longlongmax"), std::numeric_limits<long long>::max());
+   out.WriteAttr(wxT("sizemax"), std::numeric_limits<size_t>::max());
+   out.WriteAttr(wxT("true"), true);
+   out.WriteAttr(wxT("false"), false);
+
+   const double doubles[] = { 0.0, -0.0, 0.1, 1.0 / 3, -2.5, 1e-7,
+      123456789.125, 44100.0, 1e20, 1e300,
+      std::numeric_limits<double>::max(),
+      std::numeric_limits<double>::infinity(),
+      std::numeric_limits<double>::quiet_NaN() };
+   int nn = 0;
+   for (const auto value : doubles) {
+      out.StartTag(wxT("double"));
+      for (const auto digits : { -1, 0, 3, 10 })
+         out.WriteAttr(wxString::Format(wxT("d%d_%d"), nn, digits + 1),
+            value, digits);
+      out.WriteAttr(wxT("float"), (float)value);
+      out.EndTag(wxT("double"));
+      ++nn;
+   }
+
+   out.StartTag(wxT("data"));
+   out.WriteData(wxT("1 < 2 && \"quoted\""));
+   out.EndTag(wxT("data"));
+   out.StartTag(wxT("subtree"));
+   out.WriteSubTree(wxT("<inner value=\"raw\"/>\n"));
+   out.EndTag(wxT("subtree"));
+   out.StartTag(wxT("empty"));
+   out.EndTag(wxT("empty"));
+   out.EndTag(wxT("cases"));
+}
+
+// Records what a reader passes to it.  It ignores the children named
+// "ignored", and refuses the tags and blobs named "refused", as handlers
+// do that don't understand what they find.
+class XMLRecorder final : public XMLTagHandler
+{
+public:
+   bool HandleXMLTag(const wxChar *tag, const wxChar **attrs) override
+   {
+      if (wxStrcmp(tag, wxT("refused")) == 0)
+         return false;
+      wxString event = tag;
+      while (attrs[0] && attrs[1]) {
+         event += wxString::Format(wxT(" %s=%s"), attrs[0], attrs[1]);
+         attrs += 2;
+      }
+      mEvents.push_back(event);
+      return true;
+   }
+
+   void HandleXMLEndTag(const wxChar *tag) override
+   {
+      mEvents.push_back(wxString{ wxT("/") } + tag);
+   }
+
+   bool HandleXMLBlob(
+      const wxChar *name, const void *, size_t len) override
+   {
+      mEvents.push_back(
+         wxString::Format(wxT("blob %s %ld"), name, (long)len));
+      return wxStrcmp(name, wxT("refused")) != 0;
+   }
+
+   XMLTagHandler *HandleXMLChild(const wxChar *tag) override
+   {
+      return wxStrcmp(tag, wxT("ignored")) == 0 ? nullptr : this;
+   }
+
+   std::vector<wxString> mEvents;
+};
+
+// Names first used within elements that the reader skips are used again
+// after them
+void WriteSkippedNames(XMLWriter &out)
+{
+   out.StartTag(wxT("root"));
+   out.StartTag(wxT("ignored"));
+   out.WriteAttr(wxT("first"), 1);
+   out.StartTag(wxT("nested"));
+   out.WriteAttr(wxT("second"), wxT("a"));
+   out.EndTag(wxT("nested"));
+   out.EndTag(wxT("ignored"));
+   out.StartTag(wxT("refused"));
+   out.WriteAttr(wxT("third"), 3.5, 1);
+   out.StartTag(wxT("fourth"));
+   out.EndTag(wxT("fourth"));
+   out.EndTag(wxT("refused"));
+   if (out.AcceptsBlobs()) {
+      out.StartTag(wxT("blobs"));
+      out.WriteBlob(wxT("accepted"), "ab", 2);
+      out.WriteBlob(wxT("refused"), "c", 1);
+      out.StartTag(wxT("fifth"));
+      out.EndTag(wxT("fifth"));
+      out.EndTag(wxT("blobs"));
+   }
+   out.StartTag(wxT("used"));
+   out.WriteAttr(wxT("first"), 2);
+   out.WriteAttr(wxT("second"), wxT("b"));
+   out.WriteAttr(wxT("third"), 4.5, 1);
+   out.StartTag(wxT("fourth"));
+   out.EndTag(wxT("fourth"));
+   out.StartTag(wxT("fifth"));
+   out.EndTag(wxT("fifth"));
+   out.EndTag(wxT("used"));
+   out.EndTag(wxT("root"));
+}
+
+}
+
+bool SelfTests::CheckConversions(size_t count)
+{
+   // Compare the conversions of contiguous samples, which may be
+   // vectorized, with the same conversions of every other sample, which
+   // take the original loops of Dither::Apply(); then time the dithers
+   Floats floats{ count };
+   ArrayOf<short> shorts{ count };
+   ArrayOf<int> ints{ count };
+   for (size_t i = 0; i < count; i++) {
+      // Some floats are out of range, to be clipped
+      floats[i] = short(rand()) / 30000.0f;
+      shorts[i] = short(rand());
+      ints[i] = (rand() % (1 << 24)) - (1 << 23);
+   }
+   // Include the extremes, and halves of the last bits, which must round
+   // alike
+   const float edges[] = { 1.0f, -1.0f, 0.5f / 32768, -1.5f / 32768,
+      2.5f / 8388608, -0.5f / 8388608, 32767.5f / 32768 };
+   for (size_t i = 0; i < std::min(count, WXSIZEOF(edges)); i++)
+      floats[i] = edges[i];
+
+   struct Conversion {
+      samplePtr source;
+      sampleFormat sourceFormat, destFormat;
+   };
+   const Conversion conversions[] = {
+      { (samplePtr)shorts.get(), int16Sample, floatSample },
+      { (samplePtr)ints.get(), int24Sample, floatSample },
+      { (samplePtr)shorts.get(), int16Sample, int24Sample },
+      { (samplePtr)floats.get(), floatSample, int16Sample },
+      { (samplePtr)floats.get(), floatSample, int24Sample },
+   };
+
+   Dither dither;
+   wxStopWatch timer;
+   for (const auto &conversion : conversions) {
+      const auto sourceSize = SAMPLE_SIZE(conversion.sourceFormat);
+      const auto destSize = SAMPLE_SIZE(conversion.destFormat);
+      SampleBuffer dest{ count, conversion.destFormat };
+      SampleBuffer spreadSource{ 2 * count, conversion.sourceFormat };
+      SampleBuffer spreadDest{ 2 * count, conversion.destFormat };
+      for (size_t i = 0; i < count; i++)
+         memcpy(spreadSource.ptr() + 2 * i * sourceSize,
+            conversion.source + i * sourceSize, sourceSize);
+
+      timer.Start();
+      dither.Apply(DitherType::none,
+         conversion.source, conversion.sourceFormat,
+         dest.ptr(), conversion.destFormat, count);
+      const long contiguous = timer.Time();
+
+      timer.Start();
+      dither.Apply(DitherType::none,
+         spreadSource.ptr(), conversion.sourceFormat,
+         spreadDest.ptr(), conversion.destFormat, count, 2, 2);
+      const long strided = timer.Time();
+
+      wxLogMessage(wxT("Convert %s to %s: %ld ms, one at a time: %ld ms"),
+         GetSampleFormatStr(conversion.sourceFormat).Debug(),
+         GetSampleFormatStr(conversion.destFormat).Debug(),
+         contiguous, strided);
+
+      for (size_t i = 0; i < count; i++)
+         if (0 != memcmp(dest.ptr() + i * destSize,
+               spreadDest.ptr() + 2 * i * destSize, destSize)) {
+            wxLogMessage(wxT("Contiguous conversion differs at sample %ld"),
+               (long)i);
+            return false;
+         }
+   }
+
+   SampleBuffer dest{ count, int16Sample };
+   for (const auto ditherType :
+        { DitherType::rectangle, DitherType::triangle, DitherType::shaped }) {
+      dither.Reset();
+      timer.Start();
+      dither.Apply(ditherType, (samplePtr)floats.get(), floatSample,
+         dest.ptr(), int16Sample, count);
+      wxLogMessage(wxT("Dither to 16 bits (%d): %ld ms"),
+         (int)ditherType, timer.Time());
+   }
+
+   return true;
+}
+
+bool SelfTests::CheckSummaries(size_t count)
+{
+   // Compare SampleStats with copies of the loops that it replaced, on
+   // noise, in windows of 256 as for the summaries of block files.  The
+   // floats include NaN, some at the starts of windows, and infinities.
+   const size_t nWindows = (count + 255) / 256;
+   Floats noise{ count };
+   ArrayOf<short> shorts{ count };
+   ArrayOf<int> ints{ count };
+   for (size_t i = 0; i < count; i++) {
+      noise[i] = short(rand()) / 32768.0f;
+      shorts[i] = short(rand());
+      ints[i] = (rand() % (1 << 24)) - (1 << 23);
+   }
+   for (size_t i = 0; i < count; i += 997)
+      noise[i] = std::numeric_limits<float>::quiet_NaN();
+   for (size_t i = 5; i < count; i += 1999)
+      noise[i] = (i % 2 ? 1 : -1) * std::numeric_limits<float>::infinity();
+   for (size_t i = 0; i < std::min<size_t>(count, 256); i++)
+      noise[i] = std::numeric_limits<float>::infinity();
+
+   // Min and max must be the same, NaN included; the sums of squares are
+   // added in different orders
+   const auto identical = [](float a, float b)
+      { return a == b || (a != a && b != b); };
+   const auto similar = [&](double a, double b)
+      { return identical(a, b) ||
+         fabs(a - b) <= 1e-5 * std::max(fabs(a), fabs(b)); };
+   const auto agree = [&](const MinMaxSumsq &a, const MinMaxSumsq &b)
+      { return identical(a.min, b.min) && identical(a.max, b.max) &&
+         similar(a.sumsq, b.sumsq); };
+   const auto differ = [](const wxChar *what, size_t where) {
+      wxLogMessage(wxT("Vectorized %s differ from the old at %ld"),
+         what, (long)where);
+      return false;
+   };
+
+   wxStopWatch timer;
+   Floats triples[2] = { Floats{ 3 * nWindows }, Floats{ 3 * nWindows } };
+   long times[2];
+   for (const bool old : { true, false }) {
+      auto pTriple = triples[old].get();
+      timer.Start();
+      for (size_t i = 0; i < count; i += 256, pTriple += 3) {
+         const auto len = std::min<size_t>(256, count - i);
+         const auto values = old
+            ? OldSummary256(&noise[i], len)
+            : ComputeMinMaxSumsqFromFirst(&noise[i], len);
+         pTriple[0] = values.min;
+         pTriple[1] = values.max;
+         pTriple[2] = sqrt(values.sumsq / len);
+      }
+      times[old] = timer.Time();
+   }
+   wxLogMessage(wxT("Summarize all data, vectorized: %ld ms, as before: %ld ms"),
+      times[0], times[1]);
+   for (size_t i = 0; i < 3 * nWindows; i += 3)
+      if (!(identical(triples[0][i], triples[1][i]) &&
+            identical(triples[0][i + 1], triples[1][i + 1]) &&
+            similar(triples[0][i + 2], triples[1][i + 2])))
+         return differ(wxT("256-sample summaries"), i / 3);
+
+   // The 64K summaries combine 256 triples at a time; pad the last
+   // harmlessly, as BlockFile does
+   const size_t nPadded = (nWindows + 255) / 256 * 256;
+   Floats padded{ 3 * nPadded };
+   std::copy(triples[1].get(), triples[1].get() + 3 * nWindows,
+      padded.get());
+   for (size_t i = nWindows; i < nPadded; i++) {
+      padded[3 * i] = FLT_MAX;
+      padded[3 * i + 1] = -FLT_MAX;
+      padded[3 * i + 2] = 0.0f;
+   }
+   for (size_t i = 0; i < nPadded; i += 256)
+      if (!agree(OldSummary64K(&padded[3 * i]),
+            CombineSummaryTriplesFromFirst(&padded[3 * i], 256)))
+         return differ(wxT("64K-sample summaries"), i / 256);
+
+   // The displays of sequences began at FLT_MAX instead
+   for (size_t i = 0; i < count; i += 256) {
+      const auto len = std::min<size_t>(256, count - i);
+      if (!agree(OldMinMaxSumsq(&noise[i], len),
+            ComputeMinMaxSumsq(&noise[i], len)))
+         return differ(wxT("sample displays"), i);
+   }
+   for (size_t i = 0; i < nWindows; i += 256) {
+      const auto len = std::min<size_t>(256, nWindows - i);
+      if (!agree(OldCombineTriples(&triples[1][3 * i], len),
+            CombineSummaryTriples(&triples[1][3 * i], len)))
+         return differ(wxT("summary displays"), i);
+   }
+
+   // The display of the append buffer converted other formats to float
+   // first; the other displays read floats converted by CopySamples()
+   const std::pair<samplePtr, sampleFormat> formats[] = {
+      { (samplePtr)shorts.get(), int16Sample },
+      { (samplePtr)ints.get(), int24Sample },
+      { (samplePtr)noise.get(), floatSample },
+   };
+   Floats converted{ 256 };
+   for (const auto &format : formats) {
+      const auto size = SAMPLE_SIZE(format.second);
+      for (const bool old : { true, false }) {
+         float total = 0;
+         timer.Start();
+         for (size_t i = 0; i < count; i += 256) {
+            const auto len = std::min<size_t>(256, count - i);
+            total += ( old
+               ? OldAppendBufferMinMaxSumsq(
+                  format.first + i * size, format.second, len)
+               : ComputeMinMaxSumsqFromFirst(
+                  format.first + i * size, format.second, len) ).sumsq;
+         }
+         times[old] = timer.Time();
+         // Use the result, so the loop isn't optimized away
+         if (total < 0)
+            return false;
+      }
+      wxLogMessage(wxT("Reduce all %s data, vectorized: %ld ms, as before: %ld ms"),
+         GetSampleFormatStr(format.second).Debug(), times[0], times[1]);
+
+      for (size_t i = 0; i < count; i += 256) {
+         const auto len = std::min<size_t>(256, count - i);
+         if (!agree(OldAppendBufferMinMaxSumsq(
+                  format.first + i * size, format.second, len),
+               ComputeMinMaxSumsqFromFirst(
+                  format.first + i * size, format.second, len)))
+            return differ(wxT("append buffer displays"), i);
+         CopySamples(format.first + i * size, format.second,
+            (samplePtr)converted.get(), floatSample, len);
+         if (!agree(OldMinMaxSumsq(converted.get(), len),
+               ComputeMinMaxSumsq(format.first + i * size, format.second, len)))
+            return differ(wxT("converted displays"), i);
+      }
+   }
+
+   return true;
+}
+
+bool SelfTests::CheckBinaryProjectFiles(const WaveTrack &track)
+{
+   // Save the track as XML text, and in binary; rewrite each form as
+   // the other and back; all the text must be alike to the byte
+   const auto xmlName = TempFileName(wxT("selftest.xml"));
+   const auto binaryName = TempFileName(wxT("selftest.bin"));
+   const auto convertedName = TempFileName(wxT("selftest2.bin"));
+   const auto fromBinaryName = TempFileName(wxT("selftest2.xml"));
+   const auto fromConvertedName = TempFileName(wxT("selftest3.xml"));
+   auto removeFiles = finally( [&] {
+      for (const auto &name : { xmlName, binaryName, convertedName,
+           fromBinaryName, fromConvertedName })
+         wxRemoveFile(name);
+   } );
+
+   const auto writeTrack = [&](XMLWriter &out){ track.WriteXML(out); };
+   wxStopWatch timer;
+   if (!SaveXML(xmlName, false, writeTrack))
+      return false;
+   const long xmlTime = timer.Time();
+   timer.Start();
+   if (!SaveXML(binaryName, true, writeTrack))
+      return false;
+   const long binaryTime = timer.Time();
+   wxLogMessage(wxT("Save the track as XML: %ld ms, in binary: %ld ms"),
+      xmlTime, binaryTime);
+
+   bool converted = false;
+   XMLBinaryReader reader;
+   GuardedCall( [&] {
+      converted = reader.ConvertToXML(binaryName, fromBinaryName) &&
+         reader.ConvertFromXML(xmlName, convertedName) &&
+         reader.ConvertToXML(convertedName, fromConvertedName);
+   } );
+   if (!converted) {
+      wxLogMessage(wxT("Conversion failed: %s"),
+         reader.GetErrorStr().Debug());
+      return false;
+   }
+
+   const auto xmlBytes = ReadFileBytes(xmlName);
+   if (xmlBytes.empty() ||
+       xmlBytes != ReadFileBytes(fromBinaryName) ||
+       xmlBytes != ReadFileBytes(fromConvertedName)) {
+      wxLogMessage(wxT("Project files differ after conversion"));
+      return false;
+   }
+
+   // Skipped elements, and elements after refused blobs, must not lose
+   // the names that later elements use
+   if (!(SaveXML(xmlName, false, WriteSkippedNames) &&
+         SaveXML(binaryName, true, WriteSkippedNames)))
+      return false;
+   XMLRecorder fromText, fromBinary;
+   XMLFileReader textReader;
+   if (!(textReader.Parse(&fromText, xmlName) &&
+         reader.Parse(&fromBinary, binaryName))) {
+      wxLogMessage(wxT("Could not read the skipped names: %s%s"),
+         textReader.GetErrorStr().Debug(), reader.GetErrorStr().Debug());
+      return false;
+   }
+   // Only the binary file has the blobs; the element with the refused
+   // one ends without its child or its end tag
+   auto expected = fromText.mEvents;
+   const auto used = std::find(expected.begin(), expected.end(),
+      wxT("used first=2 second=b third=4.5"));
+   expected.insert(used, { wxT("blobs"), wxT("blob accepted 2"),
+      wxT("blob refused 1") });
+   if (fromBinary.mEvents != expected) {
+      wxLogMessage(wxT("Binary and text files read differently"));
+      return false;
+   }
+
+   return true;
+}
+
+bool SelfTests::CheckXMLWriter(const WaveTrack &track)
+{
+   // Write the track and the hard cases with XMLFileWriter, and with the
+   // old writer, which must agree to the byte.  This is in the locale of
+   // the program; run it in one with a comma for the decimal separator to
+   // check that too.
+   const auto xmlName = TempFileName(wxT("selftest.xml"));
+   auto removeFile = finally( [&] { wxRemoveFile(xmlName); } );
+
+   wxStopWatch timer;
+   OldXMLWriter oldWriter;
+   track.WriteXML(oldWriter);
+   WriteXMLCases(oldWriter);
+   const long oldTime = timer.Time();
+
+   timer.Start();
+   if (!SaveXML(xmlName, false, [&](XMLWriter &out){
+         track.WriteXML(out);
+         WriteXMLCases(out);
+      }))
+      return false;
+   const long newTime = timer.Time();
+
+   wxLogMessage(wxT("Write the track as XML (decimal separator '%c'): %ld ms, formatting with wxString: %ld ms"),
+      Internat::GetDecimalSeparator(), newTime, oldTime);
+
+   // The old writer had no header
+   const wxString header{
+      wxT("<?xml version=\"1.0\" standalone=\"no\" ?>\n") };
+   auto bytes = ReadFileBytes(xmlName);
+   const auto headerLength = header.utf8_str().length();
+   if (bytes.size() < headerLength ||
+       !std::equal(oldWriter.GetBytes().begin(), oldWriter.GetBytes().end(),
+          bytes.begin() + headerLength, bytes.end())) {
+      wxLogMessage(wxT("XML differs from that of the old writer"));
+      return false;
+   }
+
+   return true;
+}
+
+bool SelfTests::CheckImport(AudacityProject &project, const WaveTrack &track)
+{
+   // Write the track to 16 bit WAV files, mono and stereo, and import
+   // them with each choice of sample format for new tracks; the tracks
+   // must hold the same samples, converted to that format
+   const auto count = track.TimeToLongSamples(track.GetEndTime()).as_size_t();
+   ArrayOf<short> shorts{ count * 2 };
+   track.Get((samplePtr)shorts.get(), int16Sample, 0, count);
+   const FilePath names[] = {
+      TempFileName(wxT("selftest1.wav")),
+      TempFileName(wxT("selftest2.wav")),
+   };
+
+   const wxString formatKey{
+      wxT("/SamplingRate/DefaultProjectSampleFormatChoice") };
+   wxString oldFormat;
+   const bool hadFormat = gPrefs->Read(formatKey, &oldFormat);
+   auto restore = finally( [&] {
+      if (hadFormat)
+         gPrefs->Write(formatKey, oldFormat);
+      else
+         gPrefs->DeleteEntry(formatKey);
+      for (const auto &name : names)
+         wxRemoveFile(name);
+   } );
+
+   for (int nChannels = 1; nChannels <= 2; nChannels++) {
+      // The right channel is the complement of the left
+      if (nChannels == 2)
+         for (size_t i = count; i--;) {
+            shorts[2 * i] = shorts[i];
+            shorts[2 * i + 1] = ~shorts[i];
+         }
+      const auto &name = names[nChannels - 1];
+      SF_INFO info{};
+      info.samplerate = 44100;
+      info.channels = nChannels;
+      info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+      wxFile f;
+      SFFile sf;
+      if (f.Open(name, wxFile::write))
+         sf.reset(SFCall<SNDFILE*>(sf_open_fd, f.fd(), SFM_WRITE, &info, FALSE));
+      if (!(sf &&
+            SFCall<sf_count_t>(sf_writef_short, sf.get(), shorts.get(),
+               (sf_count_t)count) == (sf_count_t)count &&
+            sf.close() == 0)) {
+         wxLogMessage(wxT("Could not write %s"), name);
+         return false;
+      }
+   }
+
+   ZoomInfo zoomInfo(0.0, ZoomInfo::GetDefaultZoom());
+   TrackFactory factory{
+      ProjectSettings::Get( project ), DirManager::Create(), &zoomInfo };
+   wxStopWatch timer;
+   Floats samples{ count };
+   for (const auto format : { int16Sample, int24Sample, floatSample }) {
+      gPrefs->Write(formatKey,
+         format == int16Sample ? wxT("Format16Bit")
+         : format == int24Sample ? wxT("Format24Bit")
+         : wxT("Format32BitFloat"));
+
+      for (int nChannels = 1; nChannels <= 2; nChannels++) {
+         TrackHolders tracks;
+         Tags tags;
+         TranslatableString errorMessage;
+
+         timer.Start();
+         const bool imported = Importer::Get().Import( project,
+            names[nChannels - 1], &factory,
+            tracks, &tags, errorMessage );
+         const long elapsed = timer.Time();
+
+         if (!imported || tracks.size() != 1 ||
+             tracks[0].size() != (size_t)nChannels) {
+            wxLogMessage(wxT("Could not import %s: %s"),
+               names[nChannels - 1], errorMessage.Debug());
+            return false;
+         }
+
+         wxLogMessage(wxT("Import %d channel(s) as %s: %ld ms"),
+            nChannels, GetSampleFormatStr(format).Debug(), elapsed);
+
+         // Whole 16 bit samples are exact as float and int24 values, but
+         // the conversion from float to int24 dithers
+         const float tolerance = (format == int24Sample) ? 1e-5f : 0.0f;
+         for (int c = 0; c < nChannels; c++) {
+            const auto &channel = tracks[0][c];
+            const auto length =
+               channel->TimeToLongSamples(channel->GetEndTime());
+            if (channel->GetSampleFormat() != format || length != count) {
+               wxLogMessage(wxT("Imported track has format %s and %lld samples"),
+                  GetSampleFormatStr(channel->GetSampleFormat()).Debug(),
+                  length.as_long_long());
+               return false;
+            }
+            channel->Get((samplePtr)samples.get(), floatSample, 0, count);
+            for (size_t i = 0; i < count; i++) {
+               const auto expected = shorts[2 * i + c] / 32768.0f;
+               if (!(fabs(samples[i] - expected) <= tolerance)) {
+                  wxLogMessage(wxT("Imported sample %ld of channel %d is %f, not %f"),
+                     (long)i, c, samples[i], expected);
+                  return false;
+               }
+            }
+         }
+      }
+   }
+
+   return true;
+}
+
+void SelfTests::Run(AudacityProject &project)
+{
+   ZoomInfo zoomInfo(0.0, ZoomInfo::GetDefaultZoom());
+   auto dd = DirManager::Create();
+   TrackFactory factory{ ProjectSettings::Get( project ), dd, &zoomInfo };
+   const auto track = factory.NewWaveTrack(int16Sample);
+   {
+      ArrayOf<short> noise{ TestLength };
+      for (size_t i = 0; i < TestLength; i++)
+         noise[i] = short(rand());
+      track->Append((samplePtr)noise.get(), int16Sample, TestLength);
+      track->Flush();
+   }
+
+   struct Check {
+      const wxChar *name;
+      std::function< bool() > check;
+   };
+   const Check checks[] = {
+      { wxT("sample conversions"),
+        []{ return CheckConversions(TestLength); } },
+      { wxT("summaries"),
+        []{ return CheckSummaries(TestLength); } },
+      { wxT("XML writer"),
+        [&]{ return CheckXMLWriter(*track); } },
+      { wxT("binary project files"),
+        [&]{ return CheckBinaryProjectFiles(*track); } },
+      { wxT("import"),
+        [&]{ return CheckImport(project, *track); } },
+   };
+
+   wxBusyCursor busy;
+   int failures = 0;
+   for (const auto &check : checks) {
+      bool passed = false;
+      GuardedCall( [&]{ passed = check.check(); } );
+      wxLogMessage(wxT("Self test of %s: %s"),
+         check.name, passed ? wxT("passed") : wxT("FAILED"));
+      if (!passed)
+         ++failures;
+   }
+   wxLogMessage(wxT("Self tests completed, %d failed"), failures);
+
+   if (auto logger = AudacityLogger::Get())
+      logger->Show();
+}
+
+#endif
@@ -0,0 +1,38 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SelfTests.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SELF_TESTS__
+#define __AUDACITY_SELF_TESTS__
+
+#include "Audacity.h" // for IS_ALPHA
+
+#ifdef IS_ALPHA
+
+#include <cstddef>
+
+class AudacityProject;
+class WaveTrack;
+
+/// Checks that faster paths give what the code that they replaced gave,
+/// and times both.  Messages go to the log, untranslated; each check
+/// returns whether it passed.  Only in alpha builds.
+namespace SelfTests
+{
+   bool CheckConversions(size_t count);
+   bool CheckSummaries(size_t count);
+   bool CheckXMLWriter(const WaveTrack &track);
+   bool CheckBinaryProjectFiles(const WaveTrack &track);
+   bool CheckImport(AudacityProject &project, const WaveTrack &track);
+
+   /// Runs all checks on a track of noise, and shows the log
+   void Run(AudacityProject &project);
+}
+
+#endif
+
+#endif
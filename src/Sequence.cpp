@@ -34,18 +34,24 @@
 #include <algorithm>
 #include <float.h>
 #include <math.h>
+#include <typeinfo>
 
 #include <wx/intl.h>
 #include <wx/filefn.h>
 #include <wx/ffile.h>
 #include <wx/log.h>
 
+#include "BlockAnalysisCache.h"
 #include "DirManager.h"
+#include "SampleBlockCache.h"
+#include "SampleStats.h"
 
 #include "blockfile/SilentBlockFile.h"
 #include "blockfile/SimpleBlockFile.h"
+#include "blockfile/ViewBlockFile.h"
 
 #include "InconsistencyException.h"
+#include "xml/XMLBinary.h"
 
 #include "widgets/AudacityMessageBox.h"
 
@@ -383,6 +389,152 @@ float Sequence::GetRMS(sampleCount start, sampleCount len, bool mayThrow) const
    return sqrt(sumsq / length.as_double() );
 }
 
+double Sequence::GetSum(sampleCount start, sampleCount len, bool mayThrow) const
+{
+   if (len <= 0 || mBlock.size() == 0)
+      return 0.0;
+
+   if (start < 0 || start + len > mNumSamples) {
+      if (mayThrow)
+         THROW_INCONSISTENCY_EXCEPTION;
+      return 0.0;
+   }
+
+   auto &cache = BlockAnalysisCache::Get();
+   double sum = 0.0;
+   Floats buffer;
+   size_t bufferSize = 0;
+
+   int b = FindBlock(start);
+   while (len > 0) {
+      const SeqBlock &block = mBlock[b];
+      const auto &theFile = block.f;
+      const auto fileLen = theFile->GetLength();
+      // start is in block
+      const auto bstart = (start - block.start).as_size_t();
+      const auto blen = limitSampleBufferSize(fileLen - bstart, len);
+
+      BlockAnalysisCache::AnalysisPtr analysis;
+      if (blen == fileLen)
+         analysis = cache.Analyse(*theFile, mayThrow);
+      if (analysis)
+         sum += analysis->sum;
+      else {
+         // Part of a block, or a block not yet available
+         if (bufferSize < blen)
+            buffer.reinit(bufferSize = blen);
+         Read((samplePtr)buffer.get(), floatSample, block, bstart, blen,
+            mayThrow);
+         for (size_t ii = 0; ii < blen; ++ii)
+            sum += buffer[ii];
+      }
+
+      len -= blen;
+      start += blen;
+      ++b;
+   }
+
+   return sum;
+}
+
+void Sequence::GetClipRuns(sampleCount start, sampleCount len,
+   ClipRuns &runs, bool mayThrow) const
+{
+   if (len <= 0 || mBlock.size() == 0)
+      return;
+
+   if (start < 0 || start + len > mNumSamples) {
+      if (mayThrow)
+         THROW_INCONSISTENCY_EXCEPTION;
+      return;
+   }
+
+   const auto addRun = [&runs](sampleCount pos, sampleCount count) {
+      // Join runs that continue across blocks
+      if (!runs.empty() && runs.back().first + runs.back().second == pos)
+         runs.back().second += count;
+      else
+         runs.emplace_back(pos, count);
+   };
+
+   auto &cache = BlockAnalysisCache::Get();
+   Floats buffer;
+   size_t bufferSize = 0;
+
+   int b = FindBlock(start);
+   while (len > 0) {
+      const SeqBlock &block = mBlock[b];
+      const auto &theFile = block.f;
+      const auto fileLen = theFile->GetLength();
+      // start is in block
+      const auto bstart = (start - block.start).as_size_t();
+      const auto blen = limitSampleBufferSize(fileLen - bstart, len);
+
+      bool clipped = true;
+      if (theFile->IsSummaryAvailable()) {
+         auto results = theFile->GetMinMaxRMS(mayThrow);
+         clipped = !(results.min > -MAX_AUDIO && results.max < MAX_AUDIO);
+      }
+
+      if (clipped) {
+         BlockAnalysisCache::AnalysisPtr analysis;
+         if (blen == fileLen)
+            analysis = cache.Analyse(*theFile, mayThrow);
+         if (analysis) {
+            for (const auto &run : analysis->clipRuns)
+               addRun(block.start + run.first, run.second);
+         }
+         else {
+            // Part of a block, or a block not yet available
+            if (bufferSize < blen)
+               buffer.reinit(bufferSize = blen);
+            Read((samplePtr)buffer.get(), floatSample, block, bstart, blen,
+               mayThrow);
+            for (size_t ii = 0; ii < blen; ++ii) {
+               if (fabs(buffer[ii]) >= MAX_AUDIO)
+                  addRun(start + ii, 1);
+            }
+         }
+      }
+
+      len -= blen;
+      start += blen;
+      ++b;
+   }
+}
+
+bool Sequence::AppendContentKey(sampleCount start, sampleCount len,
+   std::vector<unsigned long long> &key) const
+{
+   if (len <= 0 || mBlock.size() == 0)
+      return true;
+
+   if (start < 0 || start + len > mNumSamples)
+      return false;
+
+   int b = FindBlock(start);
+   while (len > 0) {
+      const SeqBlock &block = mBlock[b];
+      const auto &theFile = block.f;
+      if (!theFile->IsDataAvailable())
+         return false;
+      // start is in block
+      const auto bstart = (start - block.start).as_size_t();
+      const auto blen =
+         limitSampleBufferSize(theFile->GetLength() - bstart, len);
+
+      key.push_back(theFile->GetSerial());
+      key.push_back(bstart);
+      key.push_back(blen);
+
+      len -= blen;
+      start += blen;
+      ++b;
+   }
+
+   return true;
+}
+
 std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
 {
    auto dest = std::make_unique<Sequence>(mDirManager, mSampleFormat);
@@ -416,10 +568,16 @@ std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
       blocklen =
          ( std::min(s1, block0.start + file->GetLength()) - s0 ).as_size_t();
       wxASSERT(file->IsAlias() || (blocklen <= (int)mMaxSamples)); // Vaughan, 2012-02-29
-      ensureSampleBufferSize(buffer, mSampleFormat, bufferSize, blocklen);
-      Get(b0, buffer.ptr(), mSampleFormat, s0, blocklen, true);
+      if (auto part = ShareBlockFile(
+            block0, ( s0 - block0.start ).as_size_t(), blocklen))
+         AppendBlock(*dest->mDirManager, dest->mBlock, dest->mNumSamples,
+            SeqBlock(part, 0));
+      else {
+         ensureSampleBufferSize(buffer, mSampleFormat, bufferSize, blocklen);
+         Get(b0, buffer.ptr(), mSampleFormat, s0, blocklen, true);
 
-      dest->Append(buffer.ptr(), mSampleFormat, blocklen);
+         dest->Append(buffer.ptr(), mSampleFormat, blocklen);
+      }
    }
    else
       --b0;
@@ -437,9 +595,14 @@ std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
       blocklen = (s1 - block.start).as_size_t();
       wxASSERT(file->IsAlias() || (blocklen <= (int)mMaxSamples)); // Vaughan, 2012-02-29
       if (blocklen < (int)file->GetLength()) {
-         ensureSampleBufferSize(buffer, mSampleFormat, bufferSize, blocklen);
-         Get(b1, buffer.ptr(), mSampleFormat, block.start, blocklen, true);
-         dest->Append(buffer.ptr(), mSampleFormat, blocklen);
+         if (auto part = ShareBlockFile(block, 0, blocklen))
+            AppendBlock(*dest->mDirManager, dest->mBlock, dest->mNumSamples,
+               SeqBlock(part, 0));
+         else {
+            ensureSampleBufferSize(buffer, mSampleFormat, bufferSize, blocklen);
+            Get(b1, buffer.ptr(), mSampleFormat, block.start, blocklen, true);
+            dest->Append(buffer.ptr(), mSampleFormat, blocklen);
+         }
       }
       else
          // Special case, copy exactly
@@ -463,13 +626,36 @@ namespace {
                                     sampleFormat format,
                                     bool allowDeferredWrite = false)
    {
-      return dm.NewBlockFile( [&]( wxFileNameWrapper filePath ) {
-         return make_blockfile<SimpleBlockFile>(
-            std::move(filePath), sampleData, sampleLen, format, allowDeferredWrite);
-      } );
+      return dm.NewSimpleBlockFile(
+         sampleData, sampleLen, format, allowDeferredWrite);
    }
 }
 
+BlockFilePtr Sequence::ShareBlockFile(
+   const SeqBlock &b, size_t start, size_t len) const
+{
+   const auto &f = b.f;
+   wxASSERT(len > 0 && start + len <= f->GetLength());
+   // Smaller pieces are copied, and merged with their neighbours, as
+   // before; else edits would fragment the sequence into tiny blocks, each
+   // keeping all the storage of its base
+   if (len < mMinSamples)
+      return {};
+   if (dynamic_cast<const SilentBlockFile*>(f.get()))
+      return make_blockfile<SilentBlockFile>(len);
+   if (ViewBlockFile::CanView(*f))
+      return make_blockfile<ViewBlockFile>(f, start, len);
+   return {};
+}
+
+bool Sequence::CanShareParts(
+   const SeqBlock &b, size_t len0, size_t len1) const
+{
+   const auto shareable = [this](size_t len)
+      { return len == 0 || len >= mMinSamples; };
+   return ViewBlockFile::CanView(*b.f) && shareable(len0) && shareable(len1);
+}
+
 void Sequence::Paste(sampleCount s, const Sequence *src)
 // STRONG-GUARANTEE
 {
@@ -537,6 +723,38 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
    wxASSERT((b >= 0) && (b < (int)numBlocks));
    SeqBlock *const pBlock = &mBlock[b];
    const auto length = pBlock->f->GetLength();
+
+   if (CanShareParts(*pBlock, ( s - pBlock->start ).as_size_t(),
+                     ( pBlock->start + length - s ).as_size_t())) {
+      // Split the block at the insertion point into two that share its
+      // storage, and insert the pasted blocks between; write no samples
+      const SeqBlock &splitBlock = *pBlock;
+      // s lies within splitBlock, or at its end
+      const auto splitPoint = ( s - splitBlock.start ).as_size_t();
+
+      BlockArray newBlock;
+      newBlock.reserve(numBlocks + srcNumBlocks + 1);
+      newBlock.insert(newBlock.end(), mBlock.begin(), mBlock.begin() + b);
+      if (splitPoint > 0)
+         newBlock.push_back( SeqBlock(
+            ShareBlockFile(splitBlock, 0, splitPoint), splitBlock.start ) );
+      for (const auto &block : srcBlock)
+         // AppendBlock may throw for limited disk space, if pasting from
+         // one project into another.
+         newBlock.push_back( SeqBlock(
+            mDirManager->CopyBlockFile(block.f), block.start + s ) );
+      if (splitPoint < length)
+         newBlock.push_back( SeqBlock(
+            ShareBlockFile(splitBlock, splitPoint, length - splitPoint),
+            s + addedLen ) );
+      for (auto i = b + 1; i < (int)numBlocks; i++)
+         newBlock.push_back(mBlock[i].Plus(addedLen));
+
+      CommitChangesIfConsistent
+         (newBlock, mNumSamples + addedLen, wxT("Paste branch sharing"));
+      return;
+   }
+
    const auto largerBlockLen = addedLen + length;
    // PRL: when insertion point is the first sample of a block,
    // and the following test fails, perhaps we could test
@@ -777,6 +995,118 @@ size_t Sequence::GetBestBlockSize(sampleCount start) const
    return result;
 }
 
+namespace {
+// Binary project files hold runs of the commonest kinds of block as a table,
+// with a row for each, instead of a pair of tags for each
+const wxChar *const BlockTableName = wxT("blocktable");
+
+enum : unsigned char { SimpleRow, SilentRow };
+
+struct BlockRow {
+   long long start;
+   unsigned char kind;
+   uint32_t len;
+   float min, max, rms;
+   wxString name;
+};
+
+template<typename T> void PutValue(std::vector<char> &table, T value)
+{
+   value = XMLBinaryLittleEndian(value);
+   auto bytes = reinterpret_cast<const char*>(&value);
+   table.insert(table.end(), bytes, bytes + sizeof(value));
+}
+
+// Returns false if the block must be written as tags
+bool AppendBlockRow(std::vector<char> &table, const SeqBlock &block)
+{
+   const auto &file = *block.f;
+   unsigned char kind;
+   if (typeid(file) == typeid(SimpleBlockFile))
+      kind = SimpleRow;
+   else if (typeid(file) == typeid(SilentBlockFile))
+      kind = SilentRow;
+   else
+      return false;
+
+   PutValue<int64_t>(table, block.start.as_long_long());
+   PutValue<unsigned char>(table, kind);
+   PutValue<uint32_t>(table, file.GetLength());
+   if (kind == SimpleRow) {
+      const auto results = file.GetMinMaxRMS();
+      PutValue<float>(table, results.min);
+      PutValue<float>(table, results.max);
+      PutValue<float>(table, results.RMS);
+      const auto name = file.GetFileName().name.GetFullName().ToUTF8();
+      PutValue<uint16_t>(table, name.length());
+      table.insert(table.end(), name.data(), name.data() + name.length());
+   }
+   return true;
+}
+
+// Calls visit for each row; returns false if the table is damaged
+template<typename Visitor>
+bool VisitBlockRows(const void *data, size_t len, const Visitor &visit)
+{
+   auto p = static_cast<const char*>(data);
+   const auto end = p + len;
+   auto get = [&](auto &value) {
+      if (sizeof(value) > (size_t)(end - p))
+         return false;
+      memcpy(&value, p, sizeof(value));
+      value = XMLBinaryLittleEndian(value);
+      p += sizeof(value);
+      return true;
+   };
+
+   BlockRow row;
+   while (p < end) {
+      int64_t start;
+      if (!(get(start) && get(row.kind) && get(row.len)))
+         return false;
+      row.start = start;
+      if (row.kind == SimpleRow) {
+         uint16_t nameLen;
+         if (!(get(row.min) && get(row.max) && get(row.rms) &&
+               get(nameLen)) ||
+             nameLen > (size_t)(end - p))
+            return false;
+         row.name = wxString::FromUTF8(p, nameLen);
+         p += nameLen;
+      }
+      else if (row.kind != SilentRow)
+         return false;
+      visit(row);
+   }
+   return true;
+}
+
+// Write the table as the tags that a text project file has instead
+XMLBinaryReader::RegisteredBlobExpander sExpandBlockTable{ BlockTableName,
+   [](const void *data, size_t len, XMLWriter &xmlFile) {
+      VisitBlockRows(data, len, [&](const BlockRow &row) {
+         xmlFile.StartTag(wxT("waveblock"));
+         xmlFile.WriteAttr(wxT("start"), row.start);
+         if (row.kind == SimpleRow) {
+            xmlFile.StartTag(wxT("simpleblockfile"));
+            xmlFile.WriteAttr(wxT("filename"), row.name);
+            xmlFile.WriteAttr(wxT("len"), (size_t)row.len);
+            xmlFile.WriteAttr(wxT("min"), row.min);
+            xmlFile.WriteAttr(wxT("max"), row.max);
+            xmlFile.WriteAttr(wxT("rms"), row.rms);
+            xmlFile.EndTag(wxT("simpleblockfile"));
+         }
+         else {
+            xmlFile.StartTag(wxT("silentblockfile"));
+            xmlFile.WriteAttr(wxT("len"), (size_t)row.len);
+            xmlFile.EndTag(wxT("silentblockfile"));
+         }
+         xmlFile.EndTag(wxT("waveblock"));
+      });
+   }
+};
+}
+
 bool Sequence::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
 {
    /* handle waveblock tag and its attributes */
@@ -912,11 +1242,45 @@ bool Sequence::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
    return false;
 }
 
+bool Sequence::HandleXMLBlob(
+   const wxChar *name, const void *data, size_t len)
+{
+   if (wxStrcmp(name, BlockTableName) != 0)
+      return false;
+
+   // Build the blocks without formatting and parsing attributes.  Rows
+   // that fail leave null blocks, to be replaced with silence at the end.
+   auto &dm = *mDirManager;
+   bool good = true;
+   const bool complete = VisitBlockRows(data, len, [&](const BlockRow &row) {
+      if (row.start < 0 || row.len == 0) {
+         good = false;
+         return;
+      }
+      BlockFilePtr f;
+      if (row.kind == SimpleRow)
+         f = dm.RegisterLoadedBlockFile( SimpleBlockFile::BuildFromTable(
+            dm, row.name, row.len, row.min, row.max, std::max(0.0f, row.rms)) );
+      else
+         f = make_blockfile<SilentBlockFile>(row.len);
+      mBlock.push_back(SeqBlock(f, row.start));
+   });
+
+   if (!(complete && good)) {
+      mErrorOpening = true;
+      wxLogWarning(
+         wxT("   Sequence has a damaged block table."));
+   }
+   return true;
+}
+
 void Sequence::HandleXMLEndTag(const wxChar *tag)
 {
    if (wxStrcmp(tag, wxT("sequence")) != 0)
       return;
 
+   mSummaryPyramid.Invalidate();
+
    // Make sure that the sequence is valid.
    // First, replace missing blockfiles with SilentBlockFiles
    for (unsigned b = 0, nn = mBlock.size(); b < nn; b++) {
@@ -1004,6 +1368,15 @@ void Sequence::WriteXML(XMLWriter &xmlFile) const
    xmlFile.WriteAttr(wxT("sampleformat"), (size_t)mSampleFormat);
    xmlFile.WriteAttr(wxT("numsamples"), mNumSamples.as_long_long() );
 
+   const bool useTable = xmlFile.AcceptsBlobs();
+   std::vector<char> table;
+   auto writeTable = [&] {
+      if (!table.empty()) {
+         xmlFile.WriteBlob(BlockTableName, table.data(), table.size());
+         table.clear();
+      }
+   };
+
    for (b = 0; b < mBlock.size(); b++) {
       const SeqBlock &bb = mBlock[b];
 
@@ -1029,6 +1402,10 @@ void Sequence::WriteXML(XMLWriter &xmlFile) const
          bb.f->SetLength(mMaxSamples);
       }
 
+      if (useTable && AppendBlockRow(table, bb))
+         continue;
+      writeTable();
+
       xmlFile.StartTag(wxT("waveblock"));
       xmlFile.WriteAttr(wxT("start"), bb.start.as_long_long() );
 
@@ -1036,21 +1413,29 @@ void Sequence::WriteXML(XMLWriter &xmlFile) const
 
       xmlFile.EndTag(wxT("waveblock"));
    }
+   writeTable();
 
    xmlFile.EndTag(wxT("sequence"));
 }
 
 int Sequence::FindBlock(sampleCount pos) const
 {
-   wxASSERT(pos >= 0 && pos < mNumSamples);
+   return FindBlock(mBlock, mNumSamples, pos);
+}
+
+//static
+int Sequence::FindBlock
+   (const BlockArray &blocks, sampleCount numSamples, sampleCount pos)
+{
+   wxASSERT(pos >= 0 && pos < numSamples);
 
    if (pos == 0)
       return 0;
 
-   int numBlocks = mBlock.size();
+   int numBlocks = blocks.size();
 
    size_t lo = 0, hi = numBlocks, guess;
-   sampleCount loSamples = 0, hiSamples = mNumSamples;
+   sampleCount loSamples = 0, hiSamples = numSamples;
 
    while (true) {
       //this is not a binary search, but a
@@ -1059,7 +1444,7 @@ int Sequence::FindBlock(sampleCount pos) const
       const double frac = (pos - loSamples).as_double() /
          (hiSamples - loSamples).as_double();
       guess = std::min(hi - 1, lo + size_t(frac * (hi - lo)));
-      const SeqBlock &block = mBlock[guess];
+      const SeqBlock &block = blocks[guess];
 
       wxASSERT(block.f->GetLength() > 0);
       wxASSERT(lo <= guess && guess < hi && lo < hi);
@@ -1083,8 +1468,8 @@ int Sequence::FindBlock(sampleCount pos) const
 
    const int rval = guess;
    wxASSERT(rval >= 0 && rval < numBlocks &&
-            pos >= mBlock[rval].start &&
-            pos < mBlock[rval].start + mBlock[rval].f->GetLength());
+            pos >= blocks[rval].start &&
+            pos < blocks[rval].start + blocks[rval].f->GetLength());
 
    return rval;
 }
@@ -1098,6 +1483,34 @@ bool Sequence::Read(samplePtr buffer, sampleFormat format,
 
    wxASSERT(blockRelativeStart + len <= f->GetLength());
 
+   // Serve the read from the shared cache of whole blocks if possible.
+   // Blocks not yet decoded, and silence, are not worth caching.
+   auto &cache = SampleBlockCache::Get();
+   const auto blockLen = f->GetLength();
+   const auto sampleSize = SAMPLE_SIZE(format);
+   if (cache.IsEnabled() && cache.Admits(blockLen * sampleSize) &&
+       f->IsDataAvailable() &&
+       !dynamic_cast<const SilentBlockFile*>(f.get())) {
+      auto entry = cache.Find(*f, format);
+      if (!entry) {
+         auto newEntry =
+            std::make_shared<SampleBlockCache::Entry>(blockLen, format);
+         if (newEntry->buffer.ptr() &&
+             f->ReadData(newEntry->buffer.ptr(), format, 0, blockLen, false)
+                == blockLen) {
+            entry = newEntry;
+            cache.Insert(*f, format, entry);
+         }
+      }
+      if (entry) {
+         memcpy(buffer,
+            entry->buffer.ptr() + blockRelativeStart * sampleSize,
+            len * sampleSize);
+         return true;
+      }
+      // else fall through, to read only what was asked and report errors
+   }
+
    // Either throws, or of !mayThrow, tells how many were really read
    auto result = f->ReadData(buffer, format, blockRelativeStart, len, mayThrow);
 
@@ -1262,62 +1675,59 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
 
 namespace {
 
-struct MinMaxSumsq
+MinMaxSumsq GetMinMaxSumsq(const float *pv, int count, int divisor)
 {
-   MinMaxSumsq(const float *pv, int count, int divisor)
-   {
-      min = FLT_MAX, max = -FLT_MAX, sumsq = 0.0f;
-      while (count--) {
-         float v;
-         switch (divisor) {
-         default:
-         case 1:
-            // array holds samples
-            v = *pv++;
-            if (v < min)
-               min = v;
-            if (v > max)
-               max = v;
-            sumsq += v * v;
-            break;
-         case 256:
-         case 65536:
-            // array holds triples of min, max, and rms values
-            v = *pv++;
-            if (v < min)
-               min = v;
-            v = *pv++;
-            if (v > max)
-               max = v;
-            v = *pv++;
-            sumsq += v * v;
-            break;
-         }
-      }
-   }
-
-   float min;
-   float max;
-   float sumsq;
-};
+   if (divisor == 1)
+      // array holds samples
+      return ComputeMinMaxSumsq(pv, count);
+   else
+      // array holds triples of min, max, and rms values
+      return CombineSummaryTriples(pv, count);
+}
 
 }
 
 bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
                               size_t len, const sampleCount *where) const
+{
+   return GetWaveDisplay(mBlock, mNumSamples, mMaxSamples, &mSummaryPyramid,
+      min, max, rms, bl, len, where);
+}
+
+//static
+bool Sequence::GetWaveDisplay(const BlockArray &blocks,
+                              sampleCount numSamples, size_t maxSamples,
+                              float *min, float *max, float *rms, int* bl,
+                              size_t len, const sampleCount *where)
+{
+   return GetWaveDisplay(blocks, numSamples, maxSamples, nullptr,
+      min, max, rms, bl, len, where);
+}
+
+//static
+bool Sequence::GetWaveDisplay(const BlockArray &blocks,
+                              sampleCount numSamples, size_t maxSamples,
+                              SummaryPyramid *pPyramid,
+                              float *min, float *max, float *rms, int* bl,
+                              size_t len, const sampleCount *where)
 {
    wxASSERT(len > 0);
    const auto s0 = std::max(sampleCount(0), where[0]);
-   if (s0 >= mNumSamples)
+   if (s0 >= numSamples)
       // None of the samples asked for are in range. Abandon.
       return false;
 
    // In case where[len - 1] == where[len], raise the limit by one,
    // so we load at least one pixel for column len - 1
-   // ... unless the mNumSamples ceiling applies, and then there are other defenses
+   // ... unless the numSamples ceiling applies, and then there are other defenses
    const auto s1 =
-      std::min(mNumSamples, std::max(1 + where[len - 1], where[len]));
-   Floats temp{ mMaxSamples };
+      std::min(numSamples, std::max(1 + where[len - 1], where[len]));
+
+   if (GetWaveDisplayFromPyramid(blocks, numSamples, maxSamples, pPyramid,
+         min, max, rms, bl, len, where, s0, s1))
+      return true;
+
+   Floats temp{ maxSamples };
 
    decltype(len) pixel = 0;
 
@@ -1329,8 +1739,8 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
    decltype(whereNow) whereNext = 0;
    // Loop over block files, opening and reading and closing each
    // not more than once
-   unsigned nBlocks = mBlock.size();
-   const unsigned int block0 = FindBlock(s0);
+   unsigned nBlocks = blocks.size();
+   const unsigned int block0 = FindBlock(blocks, numSamples, s0);
    for (unsigned int b = block0; b < nBlocks; ++b) {
       if (b > block0)
          srcX = nextSrcX;
@@ -1339,7 +1749,7 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
 
       // Find the range of sample values for this block that
       // are in the display.
-      const SeqBlock &seqBlock = mBlock[b];
+      const SeqBlock &seqBlock = blocks[b];
       const auto start = seqBlock.start;
       nextSrcX = std::min(s1, start + seqBlock.f->GetLength());
 
@@ -1389,7 +1799,7 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
          std::max(sampleCount(0), (srcX - start) / divisor).as_size_t();
       const size_t inclusiveEndPosition =
          // nextSrcX - 1 and start are in the same block
-         std::min((sampleCount(mMaxSamples) / divisor) - 1,
+         std::min((sampleCount(maxSamples) / divisor) - 1,
                   (nextSrcX - 1 - start) / divisor).as_size_t();
       const auto num = 1 + inclusiveEndPosition - startPosition;
       if (num <= 0) {
@@ -1445,7 +1855,7 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
          auto midPosition = ((whereNow - start) / divisor).as_size_t();
          int diff(midPosition - filePosition);
          if (diff > 0) {
-            MinMaxSumsq values(temp.get(), diff, divisor);
+            const auto values = GetMinMaxSumsq(temp.get(), diff, divisor);
             const int lastPixel = pixel - 1;
             float &lastMin = min[lastPixel];
             lastMin = std::min(lastMin, values.min);
@@ -1486,7 +1896,7 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
          wxASSERT(rmsDenom > 0);
          const float *const pv =
             temp.get() + (filePosition - startPosition) * (divisor == 1 ? 1 : 3);
-         MinMaxSumsq values(pv, std::max(0, rmsDenom), divisor);
+         const auto values = GetMinMaxSumsq(pv, std::max(0, rmsDenom), divisor);
 
          // Assign results
          std::fill(&min[pixel], &min[pixelX], values.min);
@@ -1510,6 +1920,47 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
    return true;
 }
 
+//static
+bool Sequence::GetWaveDisplayFromPyramid(const BlockArray &blocks,
+   sampleCount numSamples, size_t maxSamples, SummaryPyramid *pPyramid,
+   float *min, float *max, float *rms, int* bl,
+   size_t len, const sampleCount *where,
+   sampleCount s0, sampleCount s1)
+{
+   // Each column must span at least one block, except that the last may
+   // be cut short by the end of the sequence
+   for (size_t pixel = 0; pixel < len; ++pixel) {
+      const auto a = std::max(s0, where[pixel]);
+      const auto b = std::min(s1, where[pixel + 1]);
+      if (b - a < (pixel + 1 < len ? maxSamples : 1))
+         return false;
+   }
+
+   for (size_t pixel = 0; pixel < len; ++pixel) {
+      const auto a = std::max(s0, where[pixel]);
+      const auto b = std::min(s1, where[pixel + 1]);
+
+      // The column takes the blocks that start within it, or else the one
+      // block that contains it
+      const auto b0 = FindBlock(blocks, numSamples, a);
+      const auto b1 = FindBlock(blocks, numSamples, b - 1);
+      auto first = blocks[b0].start >= a ? b0 : b0 + 1;
+      if (first > b1)
+         first = b0;
+      const auto last = std::max(first, b1) + 1;
+      const auto summary = pPyramid
+         ? pPyramid->Query(blocks, first, last)
+         : SummaryPyramid::Combine(blocks, first, last);
+
+      min[pixel] = summary.min;
+      max[pixel] = summary.max;
+      rms[pixel] = summary.RMS();
+      bl[pixel] = summary.available ? first : -1 - first;
+   }
+
+   return true;
+}
+
 size_t Sequence::GetIdealAppendLen() const
 {
    int numBlocks = mBlock.size();
@@ -1573,8 +2024,7 @@ void Sequence::Append(samplePtr buffer, sampleFormat format,
 
       if (blockFileLog)
          // shouldn't throw, because XMLWriter is not XMLFileWriter
-         static_cast< SimpleBlockFile * >( &*newLastBlock.f )
-            ->SaveXML( *blockFileLog );
+         newLastBlock.f->SaveXML( *blockFileLog );
 
       newBlock.push_back( newLastBlock );
 
@@ -1601,7 +2051,7 @@ void Sequence::Append(samplePtr buffer, sampleFormat format,
 
       if (blockFileLog)
          // shouldn't throw, because XMLWriter is not XMLFileWriter
-         static_cast< SimpleBlockFile * >( &*pFile )->SaveXML( *blockFileLog );
+         pFile->SaveXML( *blockFileLog );
 
       newBlock.push_back(SeqBlock(pFile, newNumSamples));
 
@@ -1621,6 +2071,46 @@ void Sequence::Append(samplePtr buffer, sampleFormat format,
 #endif
 }
 
+void Sequence::AppendBlocks(samplePtr buffer, sampleFormat format, size_t len)
+// STRONG-GUARANTEE
+{
+   if (len == 0)
+      return;
+
+   // Quick check to make sure that it doesn't overflow
+   if (Overflows(mNumSamples.as_double() + ((double)len)))
+      THROW_INCONSISTENCY_EXCEPTION;
+
+   BlockArray newBlock;
+   sampleCount newNumSamples = mNumSamples;
+   const auto idealSamples = GetIdealBlockSize();
+   newBlock.reserve((len + idealSamples - 1) / idealSamples);
+   SampleBuffer buffer2;
+   if (format != mSampleFormat)
+      buffer2.Allocate(std::min(idealSamples, len), mSampleFormat);
+   while (len) {
+      const auto addedLen = std::min(idealSamples, len);
+      BlockFilePtr pFile;
+      if (format == mSampleFormat) {
+         pFile = NewSimpleBlockFile( *mDirManager,
+            buffer, addedLen, mSampleFormat, true );
+      }
+      else {
+         CopySamples(buffer, format, buffer2.ptr(), mSampleFormat, addedLen);
+         pFile = NewSimpleBlockFile( *mDirManager,
+            buffer2.ptr(), addedLen, mSampleFormat, true );
+      }
+      newBlock.push_back(SeqBlock(pFile, newNumSamples));
+
+      buffer += addedLen * SAMPLE_SIZE(format);
+      newNumSamples += addedLen;
+      len -= addedLen;
+   }
+
+   AppendBlocksIfConsistent(newBlock, false,
+                            newNumSamples, wxT("AppendBlocks"));
+}
+
 void Sequence::Blockify
    (DirManager &mDirManager, size_t mMaxSamples, sampleFormat mSampleFormat,
     BlockArray &list, sampleCount start, samplePtr buffer, size_t len)
@@ -1675,9 +2165,12 @@ void Sequence::Delete(sampleCount start, sampleCount len)
 
    // Special case: if the samples to DELETE are all within a single
    // block and the resulting length is not too small, perform the
-   // deletion within this block:
+   // deletion within this block -- unless the block can be shared by
+   // the parts on either side, as below, which writes no samples:
    if (b0 == b1 &&
-       (length = (pBlock = &mBlock[b0])->f->GetLength()) - len >= mMinSamples) {
+       (length = (pBlock = &mBlock[b0])->f->GetLength()) - len >= mMinSamples &&
+       !CanShareParts(*pBlock, ( start - pBlock->start ).as_size_t(),
+          ( pBlock->start + length - (start + len) ).as_size_t())) {
       SeqBlock &b = *pBlock;
       // start is within block
       auto pos = ( start - b.start ).as_size_t();
@@ -1738,7 +2231,9 @@ void Sequence::Delete(sampleCount start, sampleCount len)
    // start is within preBlock
    auto preBufferLen = ( start - preBlock.start ).as_size_t();
    if (preBufferLen) {
-      if (preBufferLen >= mMinSamples || b0 == 0) {
+      if (auto pFile = ShareBlockFile(preBlock, 0, preBufferLen))
+         newBlock.push_back(SeqBlock(pFile, preBlock.start));
+      else if (preBufferLen >= mMinSamples || b0 == 0) {
          if (!scratch.ptr())
             scratch.Allocate(scratchSize, mSampleFormat);
          ensureSampleBufferSize(scratch, mSampleFormat, scratchSize, preBufferLen);
@@ -1782,7 +2277,11 @@ void Sequence::Delete(sampleCount start, sampleCount len)
        (postBlock.start + postBlock.f->GetLength()) - (start + len)
    ).as_size_t();
    if (postBufferLen) {
-      if (postBufferLen >= mMinSamples || b1 == numBlocks - 1) {
+      // start + len - 1 lies within postBlock
+      const auto postPos = (start + len - postBlock.start).as_size_t();
+      if (auto file = ShareBlockFile(postBlock, postPos, postBufferLen))
+         newBlock.push_back(SeqBlock(file, start));
+      else if (postBufferLen >= mMinSamples || b1 == numBlocks - 1) {
          if (!scratch.ptr())
             // Last use of scratch, can ask for smaller
             scratch.Allocate(postBufferLen, mSampleFormat);
@@ -1890,6 +2389,13 @@ void Sequence::CommitChangesIfConsistent
    // now commit
    // use NOFAIL-GUARANTEE
 
+   // Keep the summaries of the leading blocks that did not change
+   size_t same = 0;
+   for (const auto nn = std::min(mBlock.size(), newBlock.size());
+        same < nn && mBlock[same].f == newBlock[same].f; ++same)
+      ;
+   mSummaryPyramid.Invalidate(same);
+
    mBlock.swap(newBlock);
    mNumSamples = numSamples;
 }
@@ -1913,6 +2419,7 @@ void Sequence::AppendBlocksIfConsistent
    }
 
    auto prevSize = mBlock.size();
+   mSummaryPyramid.Invalidate(prevSize);
 
    bool consistent = false;
    auto cleanup = finally( [&] {
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "SampleFormat.h"
+#include "SummaryPyramid.h"
 #include "xml/XMLTagHandler.h"
 #include "ondemand/ODTaskThread.h"
 
@@ -100,6 +101,13 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    bool GetWaveDisplay(float *min, float *max, float *rms, int* bl,
                        size_t len, const sampleCount *where) const;
 
+   // The same, for a copy of the block array of a sequence.  It touches no
+   // Sequence, so another thread may call it while the sequence is edited.
+   static bool GetWaveDisplay(const BlockArray &blocks,
+                       sampleCount numSamples, size_t maxSamples,
+                       float *min, float *max, float *rms, int* bl,
+                       size_t len, const sampleCount *where);
+
    // Return non-null, or else throw!
    std::unique_ptr<Sequence> Copy(sampleCount s0, sampleCount s1) const;
    void Paste(sampleCount s0, const Sequence *src);
@@ -107,6 +115,11 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    size_t GetIdealAppendLen() const;
    void Append(samplePtr buffer, sampleFormat format, size_t len,
                XMLWriter* blockFileLog=NULL);
+   // Append samples as NEW blocks of the ideal size, but the last, made and
+   // summarized from the buffer directly if it is in the sequence's format,
+   // else from a converted copy, and written in the background where
+   // possible.  Unlike Append(), does not enlarge a short last block.
+   void AppendBlocks(samplePtr buffer, sampleFormat format, size_t len);
    void Delete(sampleCount start, sampleCount len);
 
    using BlockFileFactory =
@@ -135,6 +148,9 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    bool HandleXMLTag(const wxChar *tag, const wxChar **attrs) override;
    void HandleXMLEndTag(const wxChar *tag) override;
    XMLTagHandler *HandleXMLChild(const wxChar *tag) override;
+   // The table of blocks in binary project files
+   bool HandleXMLBlob(
+      const wxChar *name, const void *data, size_t len) override;
    void WriteXML(XMLWriter &xmlFile) const /* not override */;
 
    bool GetErrorOpening() { return mErrorOpening; }
@@ -169,6 +185,24 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
       sampleCount start, sampleCount len, bool mayThrow) const;
    float GetRMS(sampleCount start, sampleCount len, bool mayThrow) const;
 
+   // Sum of the samples.  Whole blocks are read only the first time.
+   double GetSum(sampleCount start, sampleCount len, bool mayThrow) const;
+
+   // Start and length of each run of samples whose magnitude is at least
+   // MAX_AUDIO
+   using ClipRuns = std::vector< std::pair<sampleCount, sampleCount> >;
+   // Appends the runs in the range, at positions in this sequence.  Whole
+   // blocks are read only the first time, and not at all if the summary
+   // shows no clipping.
+   void GetClipRuns(sampleCount start, sampleCount len, ClipRuns &runs,
+      bool mayThrow) const;
+
+   // Appends to key what names the samples in the range, so that equal keys
+   // mean equal samples.  Returns false if some of them are not yet
+   // available.
+   bool AppendContentKey(sampleCount start, sampleCount len,
+      std::vector<unsigned long long> &key) const;
+
    //
    // Getting block size and alignment information
    //
@@ -236,11 +270,16 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    ///To block the Delete() method against the ODCalcSummaryTask::Update() method
    ODLock   mDeleteUpdateMutex;
 
+   // Summaries of runs of blocks, for GetWaveDisplay() when zoomed out
+   mutable SummaryPyramid mSummaryPyramid;
+
    //
    // Private methods
    //
 
    int FindBlock(sampleCount pos) const;
+   static int FindBlock
+      (const BlockArray &blocks, sampleCount numSamples, sampleCount pos);
 
    static void AppendBlock
       (DirManager &dirManager,
@@ -250,6 +289,16 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
              const SeqBlock &b,
              size_t blockRelativeStart, size_t len, bool mayThrow);
 
+   // A block of len samples of b from start, sharing the storage of b, so
+   // that no samples are written; or null if b can't be shared, or if len
+   // is less than the minimum block size
+   BlockFilePtr ShareBlockFile(
+      const SeqBlock &b, size_t start, size_t len) const;
+
+   // Whether ShareBlockFile() would share both parts of b, of lengths len0
+   // and len1, either of which may be zero
+   bool CanShareParts(const SeqBlock &b, size_t len0, size_t len1) const;
+
    // Accumulate NEW block files onto the end of a block array.
    // Does not change this sequence.  The intent is to use
    // CommitChangesIfConsistent later.
@@ -260,6 +309,19 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    bool Get(int b, samplePtr buffer, sampleFormat format,
       sampleCount start, size_t len, bool mayThrow) const;
 
+   // Uses the pyramid, if given, when zoomed far out
+   static bool GetWaveDisplay(const BlockArray &blocks,
+      sampleCount numSamples, size_t maxSamples, SummaryPyramid *pPyramid,
+      float *min, float *max, float *rms, int* bl,
+      size_t len, const sampleCount *where);
+
+   // Succeeds only if each column spans at least one whole block
+   static bool GetWaveDisplayFromPyramid(const BlockArray &blocks,
+      sampleCount numSamples, size_t maxSamples, SummaryPyramid *pPyramid,
+      float *min, float *max, float *rms, int* bl,
+      size_t len, const sampleCount *where,
+      sampleCount s0, sampleCount s1);
+
 public:
 
    //
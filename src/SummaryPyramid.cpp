@@ -0,0 +1,174 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SummaryPyramid.cpp
+
+*******************************************************************//**
+
+\class SummaryPyramid
+\brief Min, max and RMS over runs of blocks of a Sequence, in
+power-of-two levels.
+
+Each block file already keeps the min, max and RMS of all of its
+samples in memory, and in the project file, so the pyramid is made
+without reading any sample or summary file.  When a view is zoomed out
+so far that each pixel column spans several blocks, each column costs
+one query, instead of a read of the 64K summary of every block.
+
+The owning Sequence calls Invalidate() with the first block that an edit
+changed, and the next query remakes only the entries from there on.
+Blocks whose summaries were still being computed on demand are
+remembered and looked at again on each query.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "SummaryPyramid.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "BlockFile.h"
+#include "Sequence.h"
+
+namespace {
+
+SummaryPyramid::Summary BlockSummary(const BlockFile &file)
+{
+   SummaryPyramid::Summary result;
+   if (!file.IsSummaryAvailable()) {
+      result.min = result.max = 0;
+      result.available = false;
+      return result;
+   }
+
+   // In memory; no reading of files
+   const auto values = file.GetMinMaxRMS(false);
+   const double len = file.GetLength();
+   result.min = values.min;
+   result.max = values.max;
+   result.sumsq = (double)values.RMS * values.RMS * len;
+   result.count = len;
+   return result;
+}
+
+}
+
+SummaryPyramid::Summary::Summary()
+   : min{ FLT_MAX }, max{ -FLT_MAX }, sumsq{ 0 }, count{ 0 }
+   , available{ true }
+{
+}
+
+auto SummaryPyramid::Summary::operator += (const Summary &other) -> Summary &
+{
+   min = std::min(min, other.min);
+   max = std::max(max, other.max);
+   sumsq += other.sumsq;
+   count += other.count;
+   available = available && other.available;
+   return *this;
+}
+
+float SummaryPyramid::Summary::RMS() const
+{
+   return count > 0 ? sqrt(sumsq / count) : 0;
+}
+
+void SummaryPyramid::Invalidate(size_t b)
+{
+   mValid = std::min(mValid, b);
+}
+
+auto SummaryPyramid::Query(const BlockArray &blocks, size_t b0, size_t b1)
+   -> Summary
+{
+   Update(blocks);
+
+   Summary result;
+   b1 = std::min(b1, blocks.size());
+   for (size_t level = 0; b0 < b1; ++level, b0 >>= 1, b1 >>= 1) {
+      const auto &entries = mLevels[level];
+      if (b0 & 1)
+         result += entries[b0++];
+      if (b1 & 1)
+         result += entries[--b1];
+   }
+   return result;
+}
+
+auto SummaryPyramid::Combine(const BlockArray &blocks, size_t b0, size_t b1)
+   -> Summary
+{
+   Summary result;
+   b1 = std::min(b1, blocks.size());
+   for (; b0 < b1; ++b0)
+      result += BlockSummary(*blocks[b0].f);
+   return result;
+}
+
+void SummaryPyramid::Update(const BlockArray &blocks)
+{
+   const auto nBlocks = blocks.size();
+   const auto from = std::min(mValid, nBlocks);
+
+   // Find blocks that were summarized on demand since the last update
+   std::vector<size_t> changed;
+   {
+      auto pending = std::move(mPending);
+      mPending.clear();
+      for (auto b : pending) {
+         if (b >= from)
+            // Remade below anyway
+            continue;
+         if (blocks[b].f->IsSummaryAvailable())
+            changed.push_back(b);
+         else
+            mPending.push_back(b);
+      }
+   }
+
+   if (from == nBlocks && changed.empty() &&
+       !mLevels.empty() && mLevels[0].size() == nBlocks)
+      return;
+
+   // Remake the leaves
+   if (mLevels.empty())
+      mLevels.emplace_back();
+   auto &leaves = mLevels[0];
+   leaves.resize(nBlocks);
+   for (auto b : changed)
+      leaves[b] = BlockSummary(*blocks[b].f);
+   for (auto b = from; b < nBlocks; ++b) {
+      leaves[b] = BlockSummary(*blocks[b].f);
+      if (!leaves[b].available)
+         mPending.push_back(b);
+   }
+
+   // Remake the entries above them
+   size_t level = 1;
+   for (; mLevels[level - 1].size() > 1; ++level) {
+      if (mLevels.size() <= level)
+         mLevels.emplace_back();
+      const auto &below = mLevels[level - 1];
+      auto &entries = mLevels[level];
+      entries.resize((below.size() + 1) / 2);
+
+      const auto combine = [&](size_t ii) {
+         auto &entry = entries[ii] = below[2 * ii];
+         if (2 * ii + 1 < below.size())
+            entry += below[2 * ii + 1];
+      };
+      for (auto &b : changed) {
+         b >>= 1;
+         combine(b);
+      }
+      for (auto ii = from >> level; ii < entries.size(); ++ii)
+         combine(ii);
+   }
+   mLevels.resize(level);
+
+   mValid = nBlocks;
+}
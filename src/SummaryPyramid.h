@@ -0,0 +1,62 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SummaryPyramid.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SUMMARY_PYRAMID__
+#define __AUDACITY_SUMMARY_PYRAMID__
+
+#include "Audacity.h"
+
+#include <vector>
+
+class BlockArray;
+
+/// Min, max and RMS of each block of a Sequence, and of each run of
+/// 2, 4, 8... neighbouring blocks, so that any run of blocks is summarized
+/// in logarithmic time
+class AUDACITY_DLL_API SummaryPyramid final
+{
+ public:
+   struct Summary {
+      float min;
+      float max;
+      double sumsq;
+      double count;
+      // False if any block's summary is still being computed on demand
+      bool available;
+
+      Summary();
+      Summary &operator += (const Summary &other);
+      float RMS() const;
+   };
+
+   /// Forget the summaries of block b and all after it, because the blocks
+   /// there are no longer the same.  Blocks appended later need no call.
+   void Invalidate(size_t b = 0);
+
+   /// Combined summary of blocks [b0, b1), updating the pyramid first
+   Summary Query(const BlockArray &blocks, size_t b0, size_t b1);
+
+   /// Combined summary of blocks [b0, b1), visiting each; needs no
+   /// pyramid, so it may be used on any thread
+   static Summary Combine(const BlockArray &blocks, size_t b0, size_t b1);
+
+ private:
+   void Update(const BlockArray &blocks);
+
+   // Level 0 has one entry per block; each entry of level k + 1 combines
+   // two of level k
+   std::vector< std::vector<Summary> > mLevels;
+
+   // The number of leading blocks whose summaries are up to date
+   size_t mValid{ 0 };
+
+   // Blocks among those that were not yet summarized
+   std::vector<size_t> mPending;
+};
+
+#endif
@@ -0,0 +1,183 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ThreadPool.cpp
+
+*******************************************************************//**
+
+\class ThreadPool
+\brief A fixed set of worker threads that run batches of independent jobs.
+
+The thread that calls Run() takes jobs too, so a pool of N workers
+gives N + 1 way parallelism, and a pool of no workers simply runs the
+jobs in order.
+
+Jobs start in the order given, so a caller that knows which jobs take
+longest can start them first, and the batch finishes sooner.
+
+One pool is shared by the spectrograms, the mixers and the on-demand
+tasks, so that they don't each keep threads for all the cores.  A caller
+that finds it in use by another runs its jobs itself rather than wait.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+#include "MemoryX.h"
+
+namespace {
+// Whether some caller is running jobs on the shared pool
+std::atomic<bool> sSharedBusy{ false };
+}
+
+unsigned ThreadPool::DefaultThreadCount()
+{
+   // Leave one core for the rest of the application, and don't bother
+   // with very many
+   const auto cores = std::thread::hardware_concurrency();
+   return std::min(4u, std::max(1u, cores) - 1);
+}
+
+ThreadPool::ThreadPool(unsigned nThreads)
+{
+   mThreads.reserve(nThreads);
+   for (unsigned ii = 0; ii < nThreads; ++ii)
+      mThreads.emplace_back( [this]{ Work(); } );
+}
+
+ThreadPool::~ThreadPool()
+{
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      mStop = true;
+   }
+   mStart.notify_all();
+   for (auto &thread : mThreads)
+      thread.join();
+}
+
+void ThreadPool::Run(const std::vector<size_t> &indices, const Job &job)
+{
+   if (indices.empty())
+      return;
+
+   std::unique_lock<std::mutex> lock{ mMutex };
+   mIndices = &indices;
+   mJob = &job;
+   mNext = 0;
+   mUnfinished = indices.size();
+   mException = nullptr;
+
+   if (indices.size() > 1)
+      mStart.notify_all();
+
+   RunJobs(lock);
+   mFinish.wait(lock, [this]{ return mUnfinished == 0; });
+
+   mIndices = nullptr;
+   mJob = nullptr;
+   auto exception = mException;
+   mException = nullptr;
+   lock.unlock();
+
+   if (exception)
+      std::rethrow_exception(exception);
+}
+
+void ThreadPool::Run(size_t count, const Job &job)
+{
+   std::vector<size_t> indices(count);
+   std::iota(indices.begin(), indices.end(), 0);
+   Run(indices, job);
+}
+
+ThreadPool *ThreadPool::Shared()
+{
+   // Never destroyed, like the other process-wide caches
+   static auto pPool = DefaultThreadCount() > 0
+      ? safenew ThreadPool{ DefaultThreadCount() }
+      : nullptr;
+   return pPool;
+}
+
+unsigned ThreadPool::SharedThreadCount()
+{
+   const auto pPool = Shared();
+   return pPool ? pPool->GetThreadCount() : 0;
+}
+
+void ThreadPool::RunShared(
+   const std::vector<size_t> &indices, const Job &job)
+{
+   // A flag, not a mutex, because a job on the calling thread may call
+   // again
+   const auto pPool = Shared();
+   if (pPool && indices.size() > 1 && !sSharedBusy.exchange(true)) {
+      auto cleanup = finally( []{ sSharedBusy = false; } );
+      pPool->Run(indices, job);
+      return;
+   }
+
+   // Finish all, and rethrow the first exception, as Run() does
+   std::exception_ptr exception;
+   for (const auto index : indices) {
+      try {
+         job(index);
+      }
+      catch (...) {
+         if (!exception)
+            exception = std::current_exception();
+      }
+   }
+   if (exception)
+      std::rethrow_exception(exception);
+}
+
+void ThreadPool::RunShared(size_t count, const Job &job)
+{
+   std::vector<size_t> indices(count);
+   std::iota(indices.begin(), indices.end(), 0);
+   RunShared(indices, job);
+}
+
+void ThreadPool::Work()
+{
+   std::unique_lock<std::mutex> lock{ mMutex };
+   while (true) {
+      mStart.wait(lock, [this]{
+         return mStop || (mIndices && mNext < mIndices->size());
+      });
+      if (mStop)
+         return;
+      RunJobs(lock);
+   }
+}
+
+void ThreadPool::RunJobs(std::unique_lock<std::mutex> &lock)
+{
+   while (mIndices && mNext < mIndices->size()) {
+      const auto index = (*mIndices)[mNext++];
+      const auto &job = *mJob;
+
+      lock.unlock();
+      std::exception_ptr exception;
+      try {
+         job(index);
+      }
+      catch (...) {
+         exception = std::current_exception();
+      }
+      lock.lock();
+
+      if (exception && !mException)
+         mException = exception;
+      if (--mUnfinished == 0)
+         mFinish.notify_all();
+   }
+}
@@ -0,0 +1,83 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ThreadPool.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_THREAD_POOL__
+#define __AUDACITY_THREAD_POOL__
+
+#include "Audacity.h"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A fixed set of worker threads that run batches of independent jobs
+class AUDACITY_DLL_API ThreadPool final
+{
+ public:
+   using Job = std::function< void(size_t) >;
+
+   /// A reasonable number of workers for a pool that shares the machine
+   /// with the rest of the application
+   static unsigned DefaultThreadCount();
+
+   explicit ThreadPool(unsigned nThreads);
+   ThreadPool(const ThreadPool&) PROHIBITED;
+   ThreadPool &operator= (const ThreadPool&) PROHIBITED;
+   ~ThreadPool();
+
+   unsigned GetThreadCount() const { return mThreads.size(); }
+
+   /// Call job(index) for each of the indices, starting them in the given
+   /// order, on the workers and on the calling thread too.  Returns when
+   /// all have finished.  If any throws, the first exception is rethrown
+   /// here after all have finished.
+   /// Only one thread at a time may call Run().
+   void Run(const std::vector<size_t> &indices, const Job &job);
+
+   /// Call job(index) for each index in [0, count)
+   void Run(size_t count, const Job &job);
+
+   /// Workers of the pool that the application shares, or zero if there
+   /// is none
+   static unsigned SharedThreadCount();
+
+   /// Run the jobs as Run() does, on the shared pool if no other caller is
+   /// using it, else in order on the calling thread.  So jobs may call this
+   /// in turn, and any thread may call it.
+   static void RunShared(const std::vector<size_t> &indices, const Job &job);
+   static void RunShared(size_t count, const Job &job);
+
+ private:
+   /// Created on first use and never destroyed; null if
+   /// DefaultThreadCount() is zero
+   static ThreadPool *Shared();
+
+   void Work();
+   /// Run jobs of the current batch until none are left to start;
+   /// the lock is held on entry and exit
+   void RunJobs(std::unique_lock<std::mutex> &lock);
+
+   std::mutex mMutex;
+   std::condition_variable mStart;
+   std::condition_variable mFinish;
+
+   // The current batch
+   const std::vector<size_t> *mIndices{};
+   const Job *mJob{};
+   size_t mNext{ 0 };
+   size_t mUnfinished{ 0 };
+   std::exception_ptr mException;
+
+   bool mStop{ false };
+   std::vector<std::thread> mThreads;
+};
+
+#endif
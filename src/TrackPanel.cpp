@@ -442,6 +442,10 @@ void TrackPanel::OnTimer(wxTimerEvent& )
       UpdateSelectionDisplay();
    }
 
+   // Four times a second is often enough to follow scrolling and playback
+   if ((mTimeCount % 5) == 0)
+      DemandVisibleTracks();
+
    // Notify listeners for timer ticks
    {
       wxCommandEvent e(EVT_TRACK_PANEL_TIMER);
@@ -654,6 +658,49 @@ bool TrackPanel::IsAudioActive()
    return ProjectAudioIO::Get( *p ).IsAudioActive();
 }
 
+void TrackPanel::DemandVisibleTracks()
+{
+   if (!ODManager::IsInstanceCreated() ||
+       ODManager::Instance()->GetTotalNumTasks() == 0)
+      return;
+
+   auto gAudioIO = AudioIO::Get();
+   const bool playing =
+      IsAudioActive() && gAudioIO->GetNumPlaybackChannels() > 0;
+   const double t0 = mViewInfo->h;
+   const double width = mViewInfo->GetScreenEndTime() - t0;
+   const double playPos = playing ? gAudioIO->GetStreamTime() : 0.0;
+
+   int panelWidth, panelHeight;
+   GetSize(&panelWidth, &panelHeight);
+
+   std::vector<ODManager::Demand> demands;
+   int trackTop = 0;
+   for (auto leader : GetTracks()->Leaders()) {
+      auto channels = TrackList::Channels(leader);
+      const int trackHeight = channels.sum( TrackView::GetTrackHeight );
+      const bool visible = trackTop < mViewInfo->vpos + panelHeight &&
+         trackTop + trackHeight > mViewInfo->vpos;
+      trackTop += trackHeight;
+
+      for (auto channel : channels) {
+         auto wt = track_cast<WaveTrack*>(channel);
+         if (!wt)
+            continue;
+         // What is played is wanted soonest, then what is seen
+         if (playing)
+            demands.push_back({ wt, playPos, playPos + width,
+               ODManager::PlayingPriority });
+         else if (visible)
+            demands.push_back({ wt, t0, t0 + width,
+               ODManager::VisiblePriority });
+         else
+            demands.push_back({ wt, 0.0, 0.0, ODManager::NoPriority });
+      }
+   }
+   ODManager::Instance()->DemandTracks(demands);
+}
+
 void TrackPanel::UpdateStatusMessage( const TranslatableString &st )
 {
    auto status = st;
@@ -138,6 +138,9 @@ public:
 protected:
    void UpdateSelectionDisplay();
 
+   // Tell the on-demand tasks which tracks are shown and played, and where
+   void DemandVisibleTracks();
+
 public:
    void MakeParentRedrawScrollbars();
 
@@ -109,19 +109,20 @@ namespace {
             auto blocks = clip->GetSequenceBlockArray();
             for (const auto &block : *blocks)
             {
-               const auto &file = block.f;
+               // A view of part of a block uses the space of that block
+               const auto &file = block.f->GetStorage();
 
                // Accumulate space used by the file if the file was not
                // yet seen
-               if ( !seen || (seen->count( &*file ) == 0 ) )
+               if ( !seen || (seen->count( &file ) == 0 ) )
                {
-                  unsigned long long usage{ file->GetSpaceUsage() };
+                  unsigned long long usage{ file.GetSpaceUsage() };
                   result += usage;
                }
 
                // Add file to current set
                if (seen)
-                  seen->insert( &*file );
+                  seen->insert( &file );
             }
          }
       }
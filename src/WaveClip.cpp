@@ -17,6 +17,11 @@
 \class WaveCache
 \brief Cache used with WaveClip to cache wave information (for drawing).
 
+The cache is wider than the display, by neighbouring columns on each side.
+Edits of samples invalidate only their columns.  Invalid columns, and the
+neighbours, are computed on a worker thread from a copy of the block
+array; until they arrive, drawing shows the columns as they were.
+
 *//*******************************************************************/
 
 #include "WaveClip.h"
@@ -24,8 +29,15 @@
 #include "Experimental.h"
 
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <mutex>
+#include <thread>
 #include <vector>
+#include <wx/app.h>
 #include <wx/log.h>
 
 #include "Sequence.h"
@@ -33,11 +45,14 @@
 #include "Prefs.h"
 #include "Envelope.h"
 #include "Resample.h"
+#include "SampleStats.h"
+#include "ThreadPool.h"
 #include "WaveTrack.h"
 #include "Profiler.h"
 #include "InconsistencyException.h"
 #include "UserException.h"
 
+#include "ondemand/ODManager.h"
 #include "prefs/SpectrogramSettings.h"
 #include "widgets/ProgressDialog.h"
 
@@ -45,6 +60,12 @@
 #include <omp.h>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAVECLIP_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 class WaveCache {
 public:
    WaveCache()
@@ -52,6 +73,7 @@ public:
       , start(-1)
       , pps(0)
       , rate(-1)
+      , visibleStart(-1)
       , where(0)
       , min(0)
       , max(0)
@@ -61,12 +83,16 @@ public:
    {
    }
 
-   WaveCache(size_t len_, double pixelsPerSecond, double rate_, double t0, int dirty_)
+   WaveCache(size_t len_, double pixelsPerSecond, double rate_, double t0, int dirty_,
+             double visibleStart_ = 0, size_t margin_ = 0, size_t visibleLen_ = 0)
       : dirty(dirty_)
       , len(len_)
       , start(t0)
       , pps(pixelsPerSecond)
       , rate(rate_)
+      , visibleStart(visibleStart_)
+      , margin(margin_)
+      , visibleLen(visibleLen_)
       , where(1 + len)
       , min(len)
       , max(len)
@@ -79,6 +105,36 @@ public:
       numODPixels = CountODPixels(0, len);
    }
 
+   // Copy the cache for one clip, while others share the original.
+   // Columns that the worker is computing for the original are invalid in
+   // the copy, because the worker gives its results to the original only.
+   WaveCache(const WaveCache &orig)
+      : dirty(orig.dirty)
+      , len(orig.len)
+      , start(orig.start)
+      , pps(orig.pps)
+      , rate(orig.rate)
+      , visibleStart(orig.visibleStart)
+      , margin(orig.margin)
+      , visibleLen(orig.visibleLen)
+      , where(orig.where)
+      , min(orig.min)
+      , max(orig.max)
+      , rms(orig.rms)
+      , bl(orig.bl)
+      , numODPixels(orig.numODPixels)
+   {
+      std::vector<InvalidRegion> requested;
+      {
+         ODLocker locker(&orig.mRegionsMutex);
+         mRegions = orig.mRegions;
+         mResults = orig.mResults;
+         requested = orig.mRequested;
+      }
+      for (const auto &region : requested)
+         AddInvalidColumns(region.start, region.end);
+   }
+
    ~WaveCache()
    {
       ClearInvalidRegions();
@@ -89,6 +145,12 @@ public:
    const double start;
    const double pps;
    const int    rate;
+   // The time requested for the first visible column, which is column
+   // margin; the other columns are neighbours that are computed in the
+   // background, ready for scrolling
+   const double visibleStart;
+   const size_t margin { 0 };
+   const size_t visibleLen { 0 };
    std::vector<sampleCount> where;
    std::vector<float> min;
    std::vector<float> max;
@@ -107,6 +169,16 @@ public:
      size_t end;
    };
 
+   // Columns [start, start + min.size()) computed by the worker
+   struct Columns
+   {
+      size_t start;
+      std::vector<float> min;
+      std::vector<float> max;
+      std::vector<float> rms;
+      std::vector<int> bl;
+   };
+
 
    //Thread safe call to add a NEW region to invalidate.  If it overlaps with other regions, it unions the them.
    void AddInvalidRegion(sampleCount sampleStart, sampleCount sampleEnd)
@@ -137,7 +209,12 @@ public:
       else if(invalEnd > (long)len)
          invalEnd = len;
 
+      AddInvalidColumns(invalStart, invalEnd);
+   }
 
+   //Thread safe call to invalidate columns [invalStart, invalEnd)
+   void AddInvalidColumns(long invalStart, long invalEnd)
+   {
       ODLocker locker(&mRegionsMutex);
 
       //look thru the region array for a place to insert.  We could make this more spiffy than a linear search
@@ -219,51 +296,371 @@ public:
       mRegions.clear();
    }
 
-   void LoadInvalidRegion(int ii, Sequence *sequence, bool updateODCount)
+   int CountODPixels(size_t startIn, size_t endIn)
    {
-      const auto invStart = GetInvalidRegionStart(ii);
-      const auto invEnd = GetInvalidRegionEnd(ii);
-
-      //before check number of ODPixels
-      int regionODPixels = 0;
-      if (updateODCount)
-         regionODPixels = CountODPixels(invStart, invEnd);
-
-      sequence->GetWaveDisplay(&min[invStart],
-         &max[invStart],
-         &rms[invStart],
-         &bl[invStart],
-         invEnd - invStart,
-         &where[invStart]);
-
-      //after check number of ODPixels
-      if (updateODCount)
+      using namespace std;
+      const int *begin = &bl[0];
+      return count_if(begin + startIn, begin + endIn, bind2nd(less<int>(), 0));
+   }
+
+   // Copy from another cache, whose column oldX0 + x is our column x,
+   // columns [copyBegin, copyEnd) of ours.  Its invalid regions and results
+   // not yet copied in carry over.
+   void CopyColumns(const WaveCache &oldCache, int oldX0,
+                    size_t copyBegin, size_t copyEnd)
+   {
+      const int length = copyEnd - copyBegin;
+      const size_t sizeFloats = length * sizeof(float);
+      const int srcIdx = (int)copyBegin + oldX0;
+      memcpy(&min[copyBegin], &oldCache.min[srcIdx], sizeFloats);
+      memcpy(&max[copyBegin], &oldCache.max[srcIdx], sizeFloats);
+      memcpy(&rms[copyBegin], &oldCache.rms[srcIdx], sizeFloats);
+      memcpy(&bl[copyBegin], &oldCache.bl[srcIdx], length * sizeof(int));
+
+      std::vector<InvalidRegion> regions;
+      std::vector<Columns> results;
       {
-         const int regionODPixelsAfter = CountODPixels(invStart, invEnd);
-         numODPixels -= (regionODPixels - regionODPixelsAfter);
+         ODLocker locker(&oldCache.mRegionsMutex);
+         regions = oldCache.mRegions;
+         regions.insert(regions.end(),
+            oldCache.mRequested.begin(), oldCache.mRequested.end());
+         results = oldCache.mResults;
       }
+
+      // Translate a range of old columns, and clip it to the copied range
+      const auto translate = [&](size_t &s, size_t &e){
+         s = std::max<long>(copyBegin, (long)s - oldX0);
+         e = std::min<long>(copyEnd, (long)e - oldX0);
+         return s < e;
+      };
+
+      for (auto &columns : results) {
+         size_t s = columns.start, e = s + columns.min.size();
+         const size_t offset = s;
+         if (translate(s, e)) {
+            const auto from = s + oldX0 - offset;
+            std::copy(&columns.min[from], &columns.min[from] + (e - s), &min[s]);
+            std::copy(&columns.max[from], &columns.max[from] + (e - s), &max[s]);
+            std::copy(&columns.rms[from], &columns.rms[from] + (e - s), &rms[s]);
+            std::copy(&columns.bl[from], &columns.bl[from] + (e - s), &bl[s]);
+         }
+      }
+
+      for (auto region : regions)
+         if (translate(region.start, region.end))
+            AddInvalidColumns(region.start, region.end);
+
+      numODPixels = CountODPixels(0, len);
    }
 
-   void LoadInvalidRegions(Sequence *sequence, bool updateODCount)
+   // Copy in what the worker has finished.  Call only for a cache
+   // that no other clip shares.
+   void ApplyResults()
    {
-      //invalid regions are kept in a sorted array.
-      for (int i = 0; i < GetNumInvalidRegions(); i++)
-         LoadInvalidRegion(i, sequence, updateODCount);
+      std::vector<Columns> results;
+      {
+         ODLocker locker(&mRegionsMutex);
+         results.swap(mResults);
+      }
+      for (auto &columns : results) {
+         const auto s = columns.start, e = s + columns.min.size();
+         const int regionODPixels = CountODPixels(s, e);
+         std::copy(columns.min.begin(), columns.min.end(), &min[s]);
+         std::copy(columns.max.begin(), columns.max.end(), &max[s]);
+         std::copy(columns.rms.begin(), columns.rms.end(), &rms[s]);
+         std::copy(columns.bl.begin(), columns.bl.end(), &bl[s]);
+         numODPixels -= (regionODPixels - CountODPixels(s, e));
+      }
    }
 
-   int CountODPixels(size_t startIn, size_t endIn)
+   // Remove the invalid regions, to be given to the worker, in pieces
+   // of at most maxColumns; it reports each with Deliver() or Abandon()
+   std::vector<InvalidRegion> TakeInvalidRegions(size_t maxColumns)
    {
-      using namespace std;
-      const int *begin = &bl[0];
-      return count_if(begin + startIn, begin + endIn, bind2nd(less<int>(), 0));
+      std::vector<InvalidRegion> regions;
+      ODLocker locker(&mRegionsMutex);
+      for (const auto &region : mRegions)
+         for (auto s = region.start; s < region.end; s += maxColumns)
+            regions.emplace_back(s, std::min(region.end, s + maxColumns));
+      mRegions.clear();
+      mRequested.insert(mRequested.end(), regions.begin(), regions.end());
+      return regions;
+   }
+
+   // Called by the worker
+   void Deliver(const InvalidRegion &region, Columns &&columns)
+   {
+      ODLocker locker(&mRegionsMutex);
+      EraseRequested(region);
+      mResults.push_back(std::move(columns));
+   }
+
+   // Called by the worker when it could not compute the region
+   void Abandon(const InvalidRegion &region)
+   {
+      {
+         ODLocker locker(&mRegionsMutex);
+         EraseRequested(region);
+      }
+      AddInvalidColumns(region.start, region.end);
    }
 
 protected:
+   void EraseRequested(const InvalidRegion &region)
+   {
+      auto end = mRequested.end();
+      auto iter = std::find_if(mRequested.begin(), end,
+         [&](const InvalidRegion &other){
+            return other.start == region.start && other.end == region.end; });
+      if (iter != end)
+         mRequested.erase(iter);
+   }
+
    std::vector<InvalidRegion> mRegions;
-   ODLock mRegionsMutex;
+   // Regions given to the worker
+   std::vector<InvalidRegion> mRequested;
+   std::vector<Columns> mResults;
+   mutable ODLock mRegionsMutex;
+
+};
+
+namespace {
+
+// Columns of a wave cache to compute on the worker thread, from a copy of
+// the blocks, which the clip may change meanwhile
+struct WaveColumnsJob
+{
+   struct Chunk
+   {
+      WaveCache::InvalidRegion region;
+      // where[] of the cache for the columns of the region, and one more
+      std::vector<sampleCount> where;
+   };
 
+   std::weak_ptr<WaveCache> cache;
+   BlockArray blocks;
+   sampleCount numSamples;
+   size_t maxSamples;
+   std::vector<Chunk> chunks;
 };
 
+// Regions are split into pieces of this many columns, so that the first
+// pieces are drawn before the last are computed
+constexpr size_t WaveColumnsChunk = 256;
+
+// One thread that computes the columns of wave caches in the background.
+// A waveform display shows the old columns until it is told to redraw.
+class WaveColumnsWorker
+{
+public:
+   static WaveColumnsWorker &Get()
+   {
+      // Destroyed at exit, which stops and joins the thread, if
+      // WaveClip::StopBackgroundWork() did not already
+      static WaveColumnsWorker theWorker;
+      return theWorker;
+   }
+
+   ~WaveColumnsWorker()
+   {
+      Stop();
+   }
+
+   void Enqueue(WaveColumnsJob &&job)
+   {
+      {
+         std::lock_guard<std::mutex> lock{ mMutex };
+         if (mStopping)
+            return;
+         mJobs.push_back(std::move(job));
+      }
+      mAvailable.notify_one();
+   }
+
+   // Abandon the queued jobs, and wait for the thread to finish the column
+   // chunk that it is computing
+   void Stop()
+   {
+      {
+         std::lock_guard<std::mutex> lock{ mMutex };
+         mStopping = true;
+         mJobs.clear();
+      }
+      mAvailable.notify_one();
+      if (mThread.joinable())
+         mThread.join();
+   }
+
+private:
+   WaveColumnsWorker()
+      : mThread{ [this]{ Work(); } }
+   {}
+
+   void Work()
+   {
+      while (true) {
+         WaveColumnsJob job;
+         {
+            std::unique_lock<std::mutex> lock{ mMutex };
+            mAvailable.wait(lock,
+               [this]{ return mStopping || !mJobs.empty(); });
+            if (mStopping)
+               return;
+            // The newest job is for the newest view, so do it first
+            job = std::move(mJobs.back());
+            mJobs.pop_back();
+         }
+         Compute(job);
+      }
+   }
+
+   void Compute(WaveColumnsJob &job)
+   {
+      for (auto &chunk : job.chunks) {
+         if (mStopping || job.cache.expired())
+            // No clip wants the results any more
+            return;
+
+         const auto &region = chunk.region;
+         const auto len = region.end - region.start;
+         WaveCache::Columns columns;
+         bool success = true;
+         try {
+            columns.start = region.start;
+            columns.min.resize(len);
+            columns.max.resize(len);
+            columns.rms.resize(len);
+            columns.bl.resize(len);
+            if (!Sequence::GetWaveDisplay(job.blocks,
+                  job.numSamples, job.maxSamples,
+                  &columns.min[0], &columns.max[0], &columns.rms[0],
+                  &columns.bl[0], len, &chunk.where[0]))
+               // The columns are past the end of the samples; leave
+               // them blank
+               std::fill(columns.bl.begin(), columns.bl.end(), 1);
+         }
+         catch (...) {
+            success = false;
+         }
+
+         auto pCache = job.cache.lock();
+         if (!pCache)
+            return;
+         if (!success) {
+            pCache->Abandon(region);
+            continue;
+         }
+         pCache->Deliver(region, std::move(columns));
+
+         // The application is stopped before it goes away
+         if (mStopping)
+            return;
+         if (auto pApp = wxTheApp) {
+            wxCommandEvent event( EVT_ODTASK_UPDATE );
+            pApp->AddPendingEvent(event);
+         }
+      }
+   }
+
+   std::mutex mMutex;
+   std::condition_variable mAvailable;
+   std::deque<WaveColumnsJob> mJobs;
+   std::atomic<bool> mStopping{ false };
+
+   // Last, so that it starts after the other members are made
+   std::thread mThread;
+};
+
+// Give the invalid columns of the cache to the worker, those nearest to
+// the visible columns first
+void RequestWaveColumns(
+   const std::shared_ptr<WaveCache> &pCache, const Sequence &sequence)
+{
+   auto regions = pCache->TakeInvalidRegions(WaveColumnsChunk);
+   if (regions.empty())
+      return;
+
+   const auto v0 = pCache->margin, v1 = v0 + pCache->visibleLen;
+   const auto distance = [=](const WaveCache::InvalidRegion &region){
+      return region.end <= v0 ? v0 - region.end
+         : region.start >= v1 ? region.start - v1
+         : 0;
+   };
+   std::stable_sort(regions.begin(), regions.end(),
+      [&](const WaveCache::InvalidRegion &a, const WaveCache::InvalidRegion &b){
+         return distance(a) < distance(b); });
+
+   WaveColumnsJob job;
+   job.cache = pCache;
+   job.blocks = sequence.GetBlockArray();
+   job.numSamples = sequence.GetNumSamples();
+   job.maxSamples = sequence.GetMaxBlockSize();
+   for (const auto &region : regions) {
+      const auto where = pCache->where.begin();
+      job.chunks.push_back( { region,
+         { where + region.start, where + region.end + 1 } } );
+   }
+   WaveColumnsWorker::Get().Enqueue(std::move(job));
+}
+
+// Before changing a cache, copy it if other clips share it
+WaveCache &UnshareWaveCache(std::shared_ptr<WaveCache> &pCache)
+{
+   if (pCache.use_count() > 1)
+      pCache = std::make_shared<WaveCache>(*pCache);
+   return *pCache;
+}
+
+}
+
+// Replace powers with decibels, and powers that are not positive,
+// or not numbers, with -160 dB
+static void PowersToDecibels(float * __restrict values, size_t len)
+{
+   size_t i = 0;
+#ifdef WAVECLIP_USE_SSE2
+   // Four at a time:  for x = m * 2^e with m in [1, 2),
+   // log2(x) = e + (2 / ln 2) atanh(t), where t = (m - 1) / (m + 1) is less
+   // than 1/3, so five terms of the series for atanh leave an error of a
+   // few millionths of a decibel
+   const __m128i mantissaMask = _mm_set1_epi32(0x007FFFFF);
+   const __m128i exponentBias = _mm_set1_epi32(127);
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 scale = _mm_set1_ps(float(10.0 * log10(2.0)));
+   const __m128 atanhScale = _mm_set1_ps(float(2.0 / log(2.0)));
+   const __m128 silence = _mm_set1_ps(-160.0f);
+   for (; i + 4 <= len; i += 4) {
+      const __m128 x = _mm_loadu_ps(values + i);
+      const __m128i bits = _mm_castps_si128(x);
+      const __m128 e = _mm_cvtepi32_ps(
+         _mm_sub_epi32(_mm_srli_epi32(bits, 23), exponentBias));
+      const __m128 m = _mm_or_ps(
+         _mm_castsi128_ps(_mm_and_si128(bits, mantissaMask)), one);
+      const __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+      const __m128 t2 = _mm_mul_ps(t, t);
+      __m128 series = _mm_set1_ps(1.0f / 9);
+      series = _mm_add_ps(_mm_mul_ps(series, t2), _mm_set1_ps(1.0f / 7));
+      series = _mm_add_ps(_mm_mul_ps(series, t2), _mm_set1_ps(1.0f / 5));
+      series = _mm_add_ps(_mm_mul_ps(series, t2), _mm_set1_ps(1.0f / 3));
+      series = _mm_add_ps(_mm_mul_ps(series, t2), one);
+      series = _mm_mul_ps(series, t);
+      const __m128 decibels =
+         _mm_mul_ps(_mm_add_ps(e, _mm_mul_ps(series, atanhScale)), scale);
+      const __m128 positive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+      _mm_storeu_ps(values + i, _mm_or_ps(
+         _mm_and_ps(positive, decibels), _mm_andnot_ps(positive, silence)));
+   }
+#endif
+   for (; i < len; ++i) {
+      float &power = values[i];
+      // NaN too, as in the vector loop
+      if (!(power > 0))
+         power = -160.0;
+      else
+         power = 10.0*log10f(power);
+   }
+}
+
 static void ComputeSpectrumUsingRealFFTf
    (float * __restrict buffer, const FFTParam *hFFT,
     const float * __restrict window, size_t len, float * __restrict out)
@@ -277,20 +674,13 @@ static void ComputeSpectrumUsingRealFFTf
       buffer[i] = 0; // zero pad as needed
    RealFFTf(buffer, hFFT);
    // Handle the (real-only) DC
-   float power = buffer[0] * buffer[0];
-   if(power <= 0)
-      out[0] = -160.0;
-   else
-      out[0] = 10.0 * log10f(power);
+   out[0] = buffer[0] * buffer[0];
    for(i = 1; i < hFFT->Points; i++) {
       const int index = hFFT->BitReversed[i];
       const float re = buffer[index], im = buffer[index + 1];
-      power = re * re + im * im;
-      if(power <= 0)
-         out[i] = -160.0;
-      else
-         out[i] = 10.0*log10f(power);
+      out[i] = re * re + im * im;
    }
+   PowersToDecibels(out, hFFT->Points);
 }
 
 WaveClip::WaveClip(const std::shared_ptr<DirManager> &projDirManager,
@@ -302,7 +692,7 @@ WaveClip::WaveClip(const std::shared_ptr<DirManager> &projDirManager,
 
    mEnvelope = std::make_unique<Envelope>(true, 1e-7, 2.0, 1.0);
 
-   mWaveCache = std::make_unique<WaveCache>();
+   mWaveCache = std::make_shared<WaveCache>();
    mSpecCache = std::make_unique<SpecCache>();
    mSpecPxCache = std::make_unique<SpecPxCache>(1);
 }
@@ -322,7 +712,19 @@ WaveClip::WaveClip(const WaveClip& orig,
 
    mEnvelope = std::make_unique<Envelope>(*orig.mEnvelope);
 
-   mWaveCache = std::make_unique<WaveCache>();
+   {
+      // The samples are the same, so share the display cache, until one
+      // clip changes it; but not if on-demand loading is still to update
+      // it, because that updates only the original
+      ODLocker locker(&orig.mWaveCacheMutex);
+      if (orig.mWaveCache->dirty == orig.mDirty &&
+          orig.mWaveCache->numODPixels == 0) {
+         mWaveCache = orig.mWaveCache;
+         mDirty = orig.mDirty;
+      }
+      else
+         mWaveCache = std::make_shared<WaveCache>();
+   }
    mSpecCache = std::make_unique<SpecCache>();
    mSpecPxCache = std::make_unique<SpecPxCache>(1);
 
@@ -345,7 +747,7 @@ WaveClip::WaveClip(const WaveClip& orig,
    mRate = orig.mRate;
    mColourIndex = orig.mColourIndex;
 
-   mWaveCache = std::make_unique<WaveCache>();
+   mWaveCache = std::make_shared<WaveCache>();
    mSpecCache = std::make_unique<SpecCache>();
    mSpecPxCache = std::make_unique<SpecPxCache>(1);
 
@@ -406,7 +808,27 @@ void WaveClip::SetSamples(samplePtr buffer, sampleFormat format,
    mSequence->SetSamples(buffer, format, start, len);
 
    // use NOFAIL-GUARANTEE
+   MarkSamplesChanged(start, start + len);
+}
+
+void WaveClip::MarkSamplesChanged(sampleCount start, sampleCount end)
+// NOFAIL-GUARANTEE
+{
+   ODLocker locker(&mWaveCacheMutex);
+   const bool valid = mWaveCache->dirty == mDirty;
    MarkChanged();
+   if (valid) {
+      try {
+         // Keep the other columns of the display; the invalid ones are
+         // computed again in the background
+         auto &cache = UnshareWaveCache(mWaveCache);
+         cache.AddInvalidRegion(start, end);
+         cache.dirty = mDirty;
+      }
+      catch (...) {
+         // The whole display will be computed again
+      }
+   }
 }
 
 BlockArray* WaveClip::GetSequenceBlockArray()
@@ -484,11 +906,16 @@ bool WaveClip::IsClipStartAfterClip(double t) const
 }
 
 
+void WaveClip::StopBackgroundWork()
+{
+   WaveColumnsWorker::Get().Stop();
+}
+
 ///Delete the wave cache - force redraw.  Thread-safe
 void WaveClip::ClearWaveCache()
 {
    ODLocker locker(&mWaveCacheMutex);
-   mWaveCache = std::make_unique<WaveCache>();
+   mWaveCache = std::make_shared<WaveCache>();
 }
 
 ///Adds an invalid region to the wavecache so it redraws that portion only.
@@ -496,7 +923,7 @@ void WaveClip::AddInvalidRegion(sampleCount startSample, sampleCount endSample)
 {
    ODLocker locker(&mWaveCacheMutex);
    if(mWaveCache!=NULL)
-      mWaveCache->AddInvalidRegion(startSample,endSample);
+      UnshareWaveCache(mWaveCache).AddInvalidRegion(startSample,endSample);
 }
 
 namespace {
@@ -578,6 +1005,7 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
    float *rms;
    int *bl;
    std::vector<sampleCount> *pWhere;
+   std::shared_ptr<WaveCache> pCache;
 
    if (allocated) {
       // assume ownWhere is filled.
@@ -607,76 +1035,100 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
          mWaveCache->dirty == mDirty;
 
       if (match &&
-         mWaveCache->start == t0 &&
-         mWaveCache->len >= numPixels) {
-         mWaveCache->LoadInvalidRegions(mSequence.get(), true);
-         mWaveCache->ClearInvalidRegions();
+         mWaveCache->visibleStart == t0 &&
+         mWaveCache->len - mWaveCache->margin >= numPixels) {
+         // Take what the worker has computed, and give it what else is
+         // invalid; meanwhile the old columns are shown
+         auto &cache = UnshareWaveCache(mWaveCache);
+         cache.ApplyResults();
+         RequestWaveColumns(mWaveCache, *mSequence);
 
          // Satisfy the request completely from the cache
-         display.min = &mWaveCache->min[0];
-         display.max = &mWaveCache->max[0];
-         display.rms = &mWaveCache->rms[0];
-         display.bl = &mWaveCache->bl[0];
-         display.where = &mWaveCache->where[0];
-         isLoadingOD = mWaveCache->numODPixels > 0;
+         const auto margin = cache.margin;
+         display.min = &cache.min[margin];
+         display.max = &cache.max[margin];
+         display.rms = &cache.rms[margin];
+         display.bl = &cache.bl[margin];
+         display.where = &cache.where[margin];
+         isLoadingOD = cache.numODPixels > 0;
          return true;
       }
 
-      std::unique_ptr<WaveCache> oldCache(std::move(mWaveCache));
+      auto oldCache = std::move(mWaveCache);
+
+      // Make the cache wider than the display by some neighbouring columns
+      // on each side, to be ready for scrolling, but keep it within the
+      // samples of the sequence
+      const size_t maxMargin = numPixels / 2;
+      const size_t leftMargin = std::min<double>(maxMargin,
+         std::max(0.0, floor(t0 * pixelsPerSecond)));
+      const double remaining =
+         (mSequence->GetNumSamples().as_double() - t0 * mRate) /
+            samplesPerPixel - numPixels;
+      const size_t rightMargin = std::min<double>(maxMargin,
+         std::max(0.0, floor(remaining) - 1));
+      const size_t len = leftMargin + numPixels + rightMargin;
+      const double start = t0 - leftMargin * tstep;
 
       int oldX0 = 0;
       double correction = 0.0;
       size_t copyBegin = 0, copyEnd = 0;
       if (match) {
-         findCorrection(oldCache->where, oldCache->len, numPixels,
-            t0, mRate, samplesPerPixel,
+         findCorrection(oldCache->where, oldCache->len, len,
+            start, mRate, samplesPerPixel,
             oldX0, correction);
          // Remember our first pixel maps to oldX0 in the old cache,
          // possibly out of bounds.
          // For what range of pixels can data be copied?
-         copyBegin = std::min<size_t>(numPixels, std::max(0, -oldX0));
-         copyEnd = std::min<size_t>(numPixels, std::max(0,
+         copyBegin = std::min<size_t>(len, std::max(0, -oldX0));
+         copyEnd = std::min<size_t>(len, std::max(0,
             (int)oldCache->len - oldX0
          ));
       }
-      if (!(copyEnd > copyBegin))
-         oldCache.reset(0);
-
-      mWaveCache = std::make_unique<WaveCache>(numPixels, pixelsPerSecond, mRate, t0, mDirty);
-      min = &mWaveCache->min[0];
-      max = &mWaveCache->max[0];
-      rms = &mWaveCache->rms[0];
-      bl = &mWaveCache->bl[0];
-      pWhere = &mWaveCache->where;
+      if (!(copyEnd > copyBegin)) {
+         oldCache.reset();
+         copyBegin = copyEnd = 0;
+      }
 
-      fillWhere(*pWhere, numPixels, 0.0, correction,
-         t0, mRate, samplesPerPixel);
+      mWaveCache = std::make_shared<WaveCache>(len, pixelsPerSecond, mRate,
+         start, mDirty, t0, leftMargin, numPixels);
+      pCache = mWaveCache;
+      min = &pCache->min[0];
+      max = &pCache->max[0];
+      rms = &pCache->rms[0];
+      bl = &pCache->bl[0];
+      pWhere = &pCache->where;
 
-      // The range of pixels we must fetch from the Sequence:
-      p0 = (copyBegin > 0) ? 0 : copyEnd;
-      p1 = (copyEnd >= numPixels) ? copyBegin : numPixels;
+      fillWhere(*pWhere, len, 0.0, correction,
+         start, mRate, samplesPerPixel);
 
       // Optimization: if the old cache is good and overlaps
       // with the current one, re-use as much of the cache as
-      // possible
-
-      if (oldCache) {
-
-         //TODO: only load inval regions if
-         //necessary.  (usually is the case, so no rush.)
-         //also, we should be updating the NEW cache, but here we are patching the old one up.
-         oldCache->LoadInvalidRegions(mSequence.get(), false);
-         oldCache->ClearInvalidRegions();
-
-         // Copy what we can from the old cache.
-         const int length = copyEnd - copyBegin;
-         const size_t sizeFloats = length * sizeof(float);
-         const int srcIdx = (int)copyBegin + oldX0;
-         memcpy(&min[copyBegin], &oldCache->min[srcIdx], sizeFloats);
-         memcpy(&max[copyBegin], &oldCache->max[srcIdx], sizeFloats);
-         memcpy(&rms[copyBegin], &oldCache->rms[srcIdx], sizeFloats);
-         memcpy(&bl[copyBegin], &oldCache->bl[srcIdx], length * sizeof(int));
-      }
+      // possible, with its invalid regions
+      if (oldCache)
+         pCache->CopyColumns(*oldCache, oldX0, copyBegin, copyEnd);
+
+      // The range of visible pixels we must fetch from the Sequence now:
+      const size_t v0 = leftMargin, v1 = leftMargin + numPixels;
+      p0 = (copyBegin > v0) ? v0 : std::max(v0, copyEnd);
+      p1 = (copyEnd >= v1) ? std::min(v1, copyBegin) : v1;
+
+      // The neighbouring pixels that were not copied are left to the
+      // worker, and marked as not yet available
+      const auto defer = [&](size_t a, size_t b) {
+         for (const auto &range : {
+            std::make_pair(a, std::min(b, copyBegin)),
+            std::make_pair(std::max(a, copyEnd), b) }) {
+            if (range.second > range.first) {
+               std::fill(&bl[range.first], &bl[range.second], -1);
+               pCache->AddInvalidColumns(range.first, range.second);
+            }
+         }
+      };
+      defer(0, v0);
+      defer(v1, len);
+
+      RequestWaveColumns(pCache, *mSequence);
    }
 
    if (p1 > p0) {
@@ -709,39 +1161,19 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
             //wxCriticalSectionLocker locker(mAppendCriticalSection);
 
             if (right > left) {
-               Floats b;
-               float *pb{};
                // left is nonnegative and at most mAppendBufferLen:
                auto sLeft = left.as_size_t();
                // The difference is at most mAppendBufferLen:
                size_t len = ( right - left ).as_size_t();
 
-               if (seqFormat == floatSample)
-                  pb = &((float *)mAppendBuffer.ptr())[sLeft];
-               else {
-                  b.reinit(len);
-                  pb = b.get();
-                  CopySamples(mAppendBuffer.ptr() + sLeft * SAMPLE_SIZE(seqFormat),
-                              seqFormat,
-                              (samplePtr)pb, floatSample, len);
-               }
+               // No need to convert the samples to float first
+               const auto values = ComputeMinMaxSumsqFromFirst(
+                  mAppendBuffer.ptr() + sLeft * SAMPLE_SIZE(seqFormat),
+                  seqFormat, len);
 
-               float theMax, theMin, sumsq;
-               {
-                  const float val = pb[0];
-                  theMax = theMin = val;
-                  sumsq = val * val;
-               }
-               for(decltype(len) j = 1; j < len; j++) {
-                  const float val = pb[j];
-                  theMax = std::max(theMax, val);
-                  theMin = std::min(theMin, val);
-                  sumsq += val * val;
-               }
-
-               min[i] = theMin;
-               max[i] = theMax;
-               rms[i] = (float)sqrt(sumsq / len);
+               min[i] = values.min;
+               max[i] = values.max;
+               rms[i] = (float)sqrt(values.sumsq / len);
                bl[i] = 1; //for now just fake it.
 
                didUpdate=true;
@@ -771,13 +1203,16 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
 
    //find the number of OD pixels - the only way to do this is by recounting
    if (!allocated) {
-      // Now report the results
-      display.min = min;
-      display.max = max;
-      display.rms = rms;
-      display.bl = bl;
-      display.where = &(*pWhere)[0];
-      isLoadingOD = mWaveCache->numODPixels > 0;
+      pCache->numODPixels = pCache->CountODPixels(0, pCache->len);
+
+      // Now report the results, skipping the neighbouring columns
+      const auto margin = pCache->margin;
+      display.min = min + margin;
+      display.max = max + margin;
+      display.rms = rms + margin;
+      display.bl = bl + margin;
+      display.where = &(*pWhere)[margin];
+      isLoadingOD = pCache->numODPixels > 0;
    }
    else {
       using namespace std;
@@ -1081,6 +1516,15 @@ void SpecCache::Grow(size_t len_, const SpectrogramSettings& settings,
    frequencyGain = settings.frequencyGain;
 }
 
+#ifndef _OPENMP
+namespace {
+
+// Fewer columns than this are not worth another thread
+constexpr int MinColumnsPerRun = 16;
+
+}
+#endif
+
 void SpecCache::Populate
    (const SpectrogramSettings &settings, WaveTrackCache &waveTrackCache,
     int copyBegin, int copyEnd, size_t numPixels,
@@ -1136,6 +1580,33 @@ void SpecCache::Populate
       } tls;
 
       #pragma omp parallel for private(tls)
+#else
+      // Without OpenMP, use the pool, except for reassignment, whose
+      // columns add to each other's results
+      const auto nThreads =
+         reassignment ? 0 : ThreadPool::SharedThreadCount();
+      if (nThreads > 0 && upperBoundX - lowerBoundX >= 2 * MinColumnsPerRun) {
+         // Contiguous runs of columns, each with its own cache of samples
+         // and scratch space; more runs than threads, to balance the load
+         const int nRuns = std::min<int>(
+            4 * (nThreads + 1),
+            (upperBoundX - lowerBoundX) / MinColumnsPerRun);
+         const int runLength =
+            (upperBoundX - lowerBoundX + nRuns - 1) / nRuns;
+         ThreadPool::RunShared(nRuns, [&](size_t run){
+            WaveTrackCache cache{ waveTrackCache.GetTrack() };
+            std::vector<float> buffer(scratchSize);
+            const int begin = lowerBoundX + run * runLength;
+            const int end = std::min(upperBoundX, begin + runLength);
+            for (auto xx = begin; xx < end; ++xx)
+               CalculateOneSpectrum(
+                  settings, cache, xx, numSamples,
+                  offset, rate, pixelsPerSecond,
+                  lowerBoundX, upperBoundX,
+                  gainFactors, &buffer[0], &freq[0]);
+         });
+      }
+      else
 #endif
       for (auto xx = lowerBoundX; xx < upperBoundX; ++xx)
       {
@@ -1193,13 +1664,7 @@ void SpecCache::Populate
 #endif
          for (xx = lowerBoundX; xx < upperBoundX; ++xx) {
             float *const results = &freq[nBins * xx];
-            for (size_t ii = 0; ii < nBins; ++ii) {
-               float &power = results[ii];
-               if (power <= 0)
-                  power = -160.0;
-               else
-                  power = 10.0*log10f(power);
-            }
+            PowersToDecibels(results, nBins);
             if (!gainFactors.empty()) {
                // Apply a frequency-dependent gain factor
                for (size_t ii = 0; ii < nBins; ++ii)
@@ -1474,6 +1939,40 @@ void WaveClip::AppendBlockFile( const BlockFileFactory &factory, size_t len)
    MarkChanged();
 }
 
+void WaveClip::AppendBlocks(samplePtr buffer, sampleFormat format, size_t len)
+// PARTIAL-GUARANTEE in case of exceptions:
+// Some prefix (maybe none) of the buffer is appended, and no content already
+// flushed to disk is lost.
+{
+   // Complete the block begun in the append buffer first
+   const auto blockSize = mSequence->GetIdealAppendLen();
+   if (mAppendBufferLen > 0) {
+      const auto head =
+         std::min(len, blockSize - std::min(blockSize, mAppendBufferLen));
+      Append(buffer, format, head);
+      buffer += head * SAMPLE_SIZE(format);
+      len -= head;
+      if (mAppendBufferLen > 0)
+         return;
+   }
+
+   // Make whole blocks directly, and keep the rest in the append buffer
+   // for the next samples, rather than making a short block
+   const auto idealSamples = mSequence->GetIdealBlockSize();
+   const auto whole = len - len % idealSamples;
+   if (whole > 0) {
+      auto cleanup = finally( [&] {
+         // use NOFAIL-GUARANTEE
+         UpdateEnvelopeTrackLen();
+         MarkChanged();
+      } );
+
+      // use STRONG-GUARANTEE
+      mSequence->AppendBlocks(buffer, format, whole);
+   }
+   Append(buffer + whole * SAMPLE_SIZE(format), format, len - whole);
+}
+
 void WaveClip::Flush()
 // NOFAIL-GUARANTEE that the clip will be in a flushed state.
 // PARTIAL-GUARANTEE in case of exceptions:
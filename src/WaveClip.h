@@ -255,6 +255,11 @@ public:
    void MarkChanged() // NOFAIL-GUARANTEE
       { mDirty++; }
 
+   /** Like MarkChanged(), but only samples in [start, end) changed, so the
+    * waveform display keeps the other columns and computes these again in
+    * the background */
+   void MarkSamplesChanged(sampleCount start, sampleCount end); // NOFAIL-GUARANTEE
+
    /** Getting high-level data for screen display and clipping
     * calculations and Contrast */
    bool GetWaveDisplay(WaveDisplay &display,
@@ -290,6 +295,14 @@ public:
       std::function< BlockFilePtr( wxFileNameWrapper, size_t /* len */ ) >;
    void AppendBlockFile( const BlockFileFactory &factory, size_t len);
 
+   /// Append samples as whole blocks made from the buffer itself, or from
+   /// a converted copy if the format is not that of the sequence, without
+   /// the copies through the append buffer.  Samples that do not make a
+   /// whole block go through the append buffer, as for Append(); so Flush
+   /// must be called after the last.
+   /// Block files are written in the background where possible.
+   void AppendBlocks(samplePtr buffer, sampleFormat format, size_t len);
+
    /// This name is consistent with WaveTrack::Clear. It performs a "Cut"
    /// operation (but without putting the cutted audio to the clipboard)
    void Clear(double t0, double t1);
@@ -343,6 +356,9 @@ public:
    ///Delete the wave cache - force redraw.  Thread-safe
    void ClearWaveCache();
 
+   ///Stop computing wave cache columns in the background, at exit
+   static void StopBackgroundWork();
+
    ///Adds an invalid region to the wavecache so it redraws that portion only.
    void AddInvalidRegion(sampleCount startSample, sampleCount endSample);
 
@@ -377,7 +393,8 @@ protected:
    std::unique_ptr<Sequence> mSequence;
    std::unique_ptr<Envelope> mEnvelope;
 
-   mutable std::unique_ptr<WaveCache> mWaveCache;
+   // Shared with copies of the clip until either changes it
+   mutable std::shared_ptr<WaveCache> mWaveCache;
    mutable ODLock       mWaveCacheMutex {};
    mutable std::unique_ptr<SpecCache> mSpecCache;
    SampleBuffer  mAppendBuffer {};
@@ -1303,7 +1303,7 @@ void WaveTrack::Silence(double t0, double t1)
          }
 
          clip->GetSequence()->SetSilence(inclipDelta, samplesToCopy);
-         clip->MarkChanged();
+         clip->MarkSamplesChanged(inclipDelta, inclipDelta + samplesToCopy);
       }
    }
 }
@@ -1856,6 +1856,97 @@ float WaveTrack::GetRMS(double t0, double t1, bool mayThrow) const
    return length > 0 ? sqrt(sumsq / length.as_double()) : 0.0;
 }
 
+namespace {
+// Find the part of the clip that WaveTrack::Get() would copy: count samples
+// from inclipDelta in the clip, to startDelta from start.  Returns false if
+// there are none.
+bool GetClipOverlap(const WaveClip &clip, sampleCount start, sampleCount len,
+   sampleCount &inclipDelta, sampleCount &startDelta, sampleCount &count)
+{
+   auto clipStart = clip.GetStartSample();
+   auto clipEnd = clip.GetEndSample();
+   if (!(clipEnd > start && clipStart < start+len))
+      return false;
+
+   count = std::min( start+len - clipStart, clip.GetNumSamples() );
+   startDelta = clipStart - start;
+   inclipDelta = 0;
+   if (startDelta < 0) {
+      inclipDelta = -startDelta;
+      count -= inclipDelta;
+      startDelta = 0;
+   }
+   return true;
+}
+}
+
+double WaveTrack::GetSum(sampleCount start, sampleCount len,
+   sampleCount * pNumWithinClips, bool mayThrow) const
+{
+   double sum = 0.0;
+   sampleCount numWithinClips = 0;
+   for (const auto &clip: mClips) {
+      sampleCount inclipDelta, startDelta, count;
+      if (GetClipOverlap(*clip, start, len, inclipDelta, startDelta, count)) {
+         sum += clip->GetSequence()->GetSum(inclipDelta, count, mayThrow);
+         numWithinClips += count;
+      }
+   }
+   if (pNumWithinClips)
+      *pNumWithinClips = numWithinClips;
+   return sum;
+}
+
+void WaveTrack::GetClipRuns(sampleCount start, sampleCount len,
+   ClipRuns &runs, bool mayThrow) const
+{
+   runs.clear();
+   Sequence::ClipRuns clipRuns;
+   // The clips are not necessarily sorted by time
+   for (const auto &clip: mClips) {
+      sampleCount inclipDelta, startDelta, count;
+      if (GetClipOverlap(*clip, start, len, inclipDelta, startDelta, count)) {
+         clipRuns.clear();
+         clip->GetSequence()->GetClipRuns(
+            inclipDelta, count, clipRuns, mayThrow);
+         for (const auto &run : clipRuns)
+            runs.emplace_back(run.first - inclipDelta + startDelta,
+               run.second);
+      }
+   }
+
+   // Sort, and join runs in clips that meet
+   std::sort(runs.begin(), runs.end());
+   size_t nn = 0;
+   for (size_t ii = 0; ii < runs.size(); ++ii) {
+      if (nn > 0 && runs[nn - 1].first + runs[nn - 1].second == runs[ii].first)
+         runs[nn - 1].second += runs[ii].second;
+      else
+         runs[nn++] = runs[ii];
+   }
+   runs.resize(nn);
+}
+
+bool WaveTrack::GetContentKey(sampleCount start, sampleCount len,
+   std::vector<unsigned long long> &key) const
+{
+   key.push_back(len.as_long_long());
+   for (const auto clip : SortedClipArray()) {
+      sampleCount inclipDelta, startDelta, count;
+      if (GetClipOverlap(*clip, start, len, inclipDelta, startDelta, count)) {
+         key.push_back(startDelta.as_long_long());
+         // Leave room for the number of blocks
+         const auto pos = key.size();
+         key.push_back(0);
+         if (!clip->GetSequence()->AppendContentKey(inclipDelta, count, key))
+            return false;
+         // Three numbers for each block
+         key[pos] = (key.size() - pos - 1) / 3;
+      }
+   }
+   return true;
+}
+
 bool WaveTrack::Get(samplePtr buffer, sampleFormat format,
                     sampleCount start, size_t len, fillFormat fill,
                     bool mayThrow, sampleCount * pNumWithinClips) const
@@ -1976,7 +2067,6 @@ void WaveTrack::Set(samplePtr buffer, sampleFormat format,
                            startDelta.as_size_t() *
                            SAMPLE_SIZE(format)),
                           format, inclipDelta, samplesToCopy.as_size_t() );
-         clip->MarkChanged();
       }
    }
 }
@@ -260,6 +260,23 @@ private:
    // May assume precondition: t0 <= t1
    float GetRMS(double t0, double t1, bool mayThrow = true) const;
 
+   // The sum of the samples that Get() would copy from within clips, and
+   // optionally their number.  Blocks are read only the first time.
+   double GetSum(sampleCount start, sampleCount len,
+      sampleCount * pNumWithinClips = nullptr, bool mayThrow = true) const;
+
+   // Start and length of each run of samples of magnitude at least
+   // MAX_AUDIO, relative to start, in order and not adjacent
+   using ClipRuns = std::vector< std::pair<sampleCount, sampleCount> >;
+   void GetClipRuns(sampleCount start, sampleCount len,
+      ClipRuns &runs, bool mayThrow = true) const;
+
+   // Name the samples that Get() would fetch, so that equal keys mean equal
+   // samples, as by BlockAnalysisCache.  Returns false if some of them are
+   // not yet available.
+   bool GetContentKey(sampleCount start, sampleCount len,
+      std::vector<unsigned long long> &key) const;
+
    //
    // MM: We now have more than one sequence and envelope per track, so
    // instead of GetSequence() and GetEnvelope() we have the following
@@ -0,0 +1,209 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockWriter.cpp
+
+*******************************************************************//**
+
+\class BlockWriter
+\brief Writes the files of new recorded blocks on a thread of its own.
+
+While recording, each block made by Sequence::Append() used to be
+written to its .au file by the constructor of SimpleBlockFile, on the
+thread that empties the capture buffer.  A stall of the disk then
+stalled that thread, and with many channels at a high rate the capture
+buffer could overflow and drop audio.
+
+Now such a block keeps its samples and summary in memory, and is given
+to the writer thread, which writes and releases them.  Until then reads
+are served from memory.  The writer takes all queued files at each
+waking, so that a burst of blocks costs one waking, not one per block.
+
+The queue is bounded by the preference
+"/Directories/BlockWriteQueueSize", in megabytes of samples.  When it is
+full, the appending thread writes the block itself, as before, and the
+statistics count it.  If "/Directories/SyncBlockWrites" is set, each
+file is flushed to the device before it counts as written.
+
+A file that the writer fails to write keeps its samples in memory, and
+is written again by DirManager::WriteCacheToDisk() when recording stops,
+which first waits for the queue to drain.
+
+The recovery log of a recording names the new blocks, so it must not be
+appended before their files exist:  AfterWrites() queues the append
+behind them, and the append is then passed to the main thread, which
+alone replaces the auto-save file.  For the same reason, an autosave
+first waits for the queue to drain.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "BlockWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "SimpleBlockFile.h"
+#include "../FileException.h"
+#include "../Prefs.h"
+
+namespace {
+// Default bound of the queue in megabytes
+constexpr long DefaultQueueSize = 128;
+}
+
+BlockWriter &BlockWriter::Get()
+{
+   // Never destroyed, because block files may outlive other statics
+   static auto theWriter = safenew BlockWriter;
+   return *theWriter;
+}
+
+BlockWriter::BlockWriter()
+{
+   UpdatePrefs();
+}
+
+void BlockWriter::UpdatePrefs()
+{
+   bool enabled = true;
+   bool sync = false;
+   long queueSize = DefaultQueueSize;
+   if (gPrefs) {
+      gPrefs->Read(wxT("/Directories/BackgroundBlockWrites"), &enabled, true);
+      gPrefs->Read(wxT("/Directories/SyncBlockWrites"), &sync, false);
+      queueSize = gPrefs->Read(
+         wxT("/Directories/BlockWriteQueueSize"), DefaultQueueSize);
+   }
+   if (queueSize < 0)
+      queueSize = 0;
+
+   std::lock_guard<std::mutex> lock{ mMutex };
+   mEnabled = enabled && queueSize > 0;
+   mSync = sync;
+   mMaxBytes = (size_t)queueSize << 20;
+}
+
+bool BlockWriter::IsEnabled()
+{
+   std::lock_guard<std::mutex> lock{ mMutex };
+   return mEnabled;
+}
+
+void BlockWriter::Write(const std::shared_ptr<SimpleBlockFile> &file)
+{
+   // Files held in memory by the write cache are not the writer's
+   if (!file->WaitsForWriter())
+      return;
+   const auto bytes = file->GetPendingBytes();
+   if (bytes == 0)
+      return;
+
+   bool sync;
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      sync = mSync;
+      if (mEnabled && mQueuedBytes + bytes <= mMaxBytes) {
+         if (!mStarted) {
+            std::thread{ [this]{ Work(); } }.detach();
+            mStarted = true;
+         }
+         mQueue.push_back({ file, bytes, {} });
+         mQueuedBytes += bytes;
+         auto &stats = mStatistics;
+         stats.peakBlocks = std::max(stats.peakBlocks, mQueue.size() + mBusy);
+         stats.peakBytes = std::max(stats.peakBytes, mQueuedBytes);
+         mAvailable.notify_one();
+         return;
+      }
+      ++mStatistics.synchronous;
+   }
+
+   // Back pressure:  don't let the memory grow without bound
+   if (!file->WriteCache(sync))
+      throw FileException{
+         FileException::Cause::Write, file->GetFileName().name };
+}
+
+void BlockWriter::Flush()
+{
+   std::unique_lock<std::mutex> lock{ mMutex };
+   mDrained.wait(lock, [this]{ return mQueue.empty() && mBusy == 0; });
+}
+
+void BlockWriter::AfterWrites(std::function<void()> action)
+{
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      if (!mQueue.empty() || mBusy > 0) {
+         // The thread was started for the queued files
+         mQueue.push_back({ {}, 0, std::move(action) });
+         mAvailable.notify_one();
+         return;
+      }
+   }
+   action();
+}
+
+auto BlockWriter::GetStatistics() -> Statistics
+{
+   std::lock_guard<std::mutex> lock{ mMutex };
+   return mStatistics;
+}
+
+void BlockWriter::ResetStatistics()
+{
+   std::lock_guard<std::mutex> lock{ mMutex };
+   mStatistics = {};
+}
+
+void BlockWriter::Work()
+{
+   using Clock = std::chrono::steady_clock;
+   while (true) {
+      std::deque<Entry> batch;
+      bool sync;
+      {
+         std::unique_lock<std::mutex> lock{ mMutex };
+         mAvailable.wait(lock, [this]{ return !mQueue.empty(); });
+         batch.swap(mQueue);
+         mBusy = batch.size();
+         sync = mSync;
+         ++mStatistics.batches;
+      }
+
+      for (auto &entry : batch) {
+         bool written = false, success = true;
+         double elapsed = 0.0;
+         if (entry.action)
+            // The files queued before it are done
+            entry.action();
+         // The file may have been deleted, if the recording was discarded
+         else if (auto file = entry.file.lock()) {
+            written = true;
+            const auto start = Clock::now();
+            try {
+               success = file->WriteCache(sync);
+            }
+            catch (...) {
+               success = false;
+            }
+            elapsed = std::chrono::duration<double>(Clock::now() - start)
+               .count();
+         }
+
+         std::lock_guard<std::mutex> lock{ mMutex };
+         auto &stats = mStatistics;
+         if (!success)
+            ++stats.failures;
+         else if (written)
+            ++stats.written;
+         stats.maxWriteTime = std::max(stats.maxWriteTime, elapsed);
+         mQueuedBytes -= entry.bytes;
+         --mBusy;
+      }
+      mDrained.notify_all();
+   }
+}
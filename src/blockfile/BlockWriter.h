@@ -0,0 +1,90 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockWriter.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_WRITER__
+#define __AUDACITY_BLOCK_WRITER__
+
+#include "../Audacity.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "../MemoryX.h"
+
+class SimpleBlockFile;
+
+/// Writes the files of new recorded blocks on a thread of its own, so that
+/// the thread appending captured audio does not wait for the disk
+class BlockWriter final
+{
+ public:
+   struct Statistics {
+      size_t written{ 0 };     // by the writer thread
+      size_t batches{ 0 };     // wakings of the writer thread
+      size_t synchronous{ 0 }; // by the appending thread, the queue being full
+      size_t failures{ 0 };    // left for DirManager::WriteCacheToDisk()
+      size_t peakBlocks{ 0 };  // greatest depth of the queue
+      size_t peakBytes{ 0 };   // greatest size of the samples queued
+      double maxWriteTime{ 0.0 }; // seconds, of the slowest file
+   };
+
+   static BlockWriter &Get();
+
+   BlockWriter(const BlockWriter&) PROHIBITED;
+   BlockWriter &operator= (const BlockWriter&) PROHIBITED;
+
+   /// Read the preferences
+   void UpdatePrefs();
+
+   /// Whether new blocks written with deferral allowed should be queued
+   bool IsEnabled();
+
+   /// Queue the file to be written, or write it now if the queue is full.
+   /// Throws if writing now fails.
+   void Write(const std::shared_ptr<SimpleBlockFile> &file);
+
+   /// Wait until each queued file is written, or has failed
+   void Flush();
+
+   /// Run the action on the writer thread once each file queued before it
+   /// is written, or has failed; or run it now if none is queued.  The
+   /// action must not throw.
+   void AfterWrites(std::function<void()> action);
+
+   Statistics GetStatistics();
+   void ResetStatistics();
+
+ private:
+   BlockWriter();
+   void Work();
+
+   struct Entry {
+      std::weak_ptr<SimpleBlockFile> file;
+      size_t bytes;
+      std::function<void()> action; // instead of a file
+   };
+
+   std::mutex mMutex;
+   std::condition_variable mAvailable;
+   std::condition_variable mDrained;
+   std::deque<Entry> mQueue;
+   size_t mQueuedBytes{ 0 }; // including the batch being written
+   size_t mBusy{ 0 };        // files of the batch not yet written
+   bool mStarted{ false };
+
+   bool mEnabled{ true };
+   bool mSync{ false };
+   size_t mMaxBytes{ 0 };
+
+   Statistics mStatistics;
+};
+
+#endif
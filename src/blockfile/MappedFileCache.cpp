@@ -0,0 +1,197 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  MappedFileCache.cpp
+
+*******************************************************************//**
+
+\file MappedFileCache.cpp
+\brief Implements MappedFile and MappedFileCache.
+
+*//****************************************************************//**
+
+\class MappedFile
+\brief Maps a whole file read-only into memory, with the native facility
+of each platform.
+
+*//****************************************************************//**
+
+\class MappedFileCache
+\brief A bounded, least-recently-used set of MappedFile objects.
+
+Block files are small and many, and are read again and again while
+drawing and mixing.  Keeping recent mappings alive turns each read into a
+copy out of the page cache, without opening the file again.
+
+The bounds keep address space and the number of open files modest on all
+platforms.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "MappedFileCache.h"
+
+#include <atomic>
+
+#if defined(__WXMSW__)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Limits on the live mappings
+constexpr size_t MaxMappings = 1024;
+constexpr size_t MaxMappedBytes = 256 * 1024 * 1024;
+
+std::atomic<bool> sEnabled{ true };
+
+}
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const FilePath &path)
+{
+#if defined(__WXMSW__)
+   // Allow deletion of the file while it is mapped
+   HANDLE file = ::CreateFileW(path.wc_str(), GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE)
+      return {};
+
+   LARGE_INTEGER size;
+   const char *data = nullptr;
+   if (::GetFileSizeEx(file, &size) && size.QuadPart > 0 &&
+       (unsigned long long)size.QuadPart <= MaxMappedBytes) {
+      HANDLE mapping =
+         ::CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (mapping) {
+         data = static_cast<const char*>(
+            ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+         // The view keeps the mapping and the file open
+         ::CloseHandle(mapping);
+      }
+   }
+   ::CloseHandle(file);
+
+   if (!data)
+      return {};
+   return std::shared_ptr<const MappedFile>{
+      safenew MappedFile{ data, (size_t)size.QuadPart } };
+#else
+   int fd = ::open(path.fn_str(), O_RDONLY);
+   if (fd < 0)
+      return {};
+
+   struct stat st;
+   void *data = MAP_FAILED;
+   if (::fstat(fd, &st) == 0 && st.st_size > 0 &&
+       (unsigned long long)st.st_size <= MaxMappedBytes)
+      data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   // The mapping keeps its own reference to the file
+   ::close(fd);
+
+   if (data == MAP_FAILED)
+      return {};
+   return std::shared_ptr<const MappedFile>{
+      safenew MappedFile{ static_cast<const char*>(data), (size_t)st.st_size } };
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(__WXMSW__)
+   ::UnmapViewOfFile(mData);
+#else
+   ::munmap(const_cast<char*>(mData), mSize);
+#endif
+}
+
+MappedFileCache &MappedFileCache::Get()
+{
+   // Never destroyed, because block files may outlive other statics
+   static auto theCache = safenew MappedFileCache;
+   return *theCache;
+}
+
+bool MappedFileCache::IsEnabled()
+{
+   return sEnabled.load(std::memory_order_relaxed);
+}
+
+void MappedFileCache::SetEnabled(bool enabled)
+{
+   sEnabled.store(enabled, std::memory_order_relaxed);
+   if (!enabled)
+      Get().Clear();
+}
+
+MappedFileCache::MappedFileCache()
+{
+}
+
+std::shared_ptr<const MappedFile> MappedFileCache::Acquire(
+   const FilePath &path)
+{
+   {
+      ODLocker locker{ &mLock };
+      auto iter = mIndex.find(path);
+      if (iter != mIndex.end()) {
+         // Move to the front
+         mEntries.splice(mEntries.begin(), mEntries, iter->second);
+         return iter->second->second;
+      }
+   }
+
+   // Map without holding the lock
+   auto file = MappedFile::Open(path);
+   if (!file)
+      return {};
+
+   ODLocker locker{ &mLock };
+   auto iter = mIndex.find(path);
+   if (iter != mIndex.end())
+      // Another thread was quicker
+      return iter->second->second;
+
+   mEntries.emplace_front(path, file);
+   mIndex[path] = mEntries.begin();
+   mTotalBytes += file->GetSize();
+   Trim();
+   return file;
+}
+
+void MappedFileCache::Invalidate(const FilePath &path)
+{
+   ODLocker locker{ &mLock };
+   auto iter = mIndex.find(path);
+   if (iter != mIndex.end()) {
+      mTotalBytes -= iter->second->second->GetSize();
+      mEntries.erase(iter->second);
+      mIndex.erase(iter);
+   }
+}
+
+void MappedFileCache::Clear()
+{
+   ODLocker locker{ &mLock };
+   mIndex.clear();
+   mEntries.clear();
+   mTotalBytes = 0;
+}
+
+void MappedFileCache::Trim()
+{
+   // Keep at least the newest entry
+   while (mEntries.size() > 1 &&
+          (mEntries.size() > MaxMappings || mTotalBytes > MaxMappedBytes)) {
+      auto &entry = mEntries.back();
+      mTotalBytes -= entry.second->GetSize();
+      mIndex.erase(entry.first);
+      mEntries.pop_back();
+   }
+}
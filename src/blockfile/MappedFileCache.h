@@ -0,0 +1,82 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  MappedFileCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_MAPPED_FILE_CACHE__
+#define __AUDACITY_MAPPED_FILE_CACHE__
+
+#include "../Audacity.h"
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "audacity/Types.h"
+#include "../MemoryX.h"
+#include "../ondemand/ODTaskThread.h"
+
+/// A read-only memory mapping of a whole file
+class MappedFile final
+{
+ public:
+   /// Returns null if the file cannot be opened or mapped, or is empty
+   static std::shared_ptr<const MappedFile> Open(const FilePath &path);
+
+   MappedFile(const MappedFile&) PROHIBITED;
+   MappedFile &operator= (const MappedFile&) PROHIBITED;
+   ~MappedFile();
+
+   const char *GetData() const { return mData; }
+   size_t GetSize() const { return mSize; }
+
+ private:
+   MappedFile(const char *data, size_t size) : mData{ data }, mSize{ size } {}
+
+   const char *const mData;
+   const size_t mSize;
+};
+
+/// Keeps a bounded number of MappedFile objects alive, discarding the
+/// least recently used, so that repeated reads of the same block files
+/// do not pay for opening and mapping them each time
+class MappedFileCache final
+{
+ public:
+   static MappedFileCache &Get();
+
+   /// Whether block files should be read through mappings at all
+   static bool IsEnabled();
+   static void SetEnabled(bool enabled);
+
+   MappedFileCache();
+   MappedFileCache(const MappedFileCache&) PROHIBITED;
+   MappedFileCache &operator= (const MappedFileCache&) PROHIBITED;
+
+   /// Map the file, or find an existing mapping of it.  Returns null on
+   /// failure.  The result stays valid after it leaves the cache.
+   std::shared_ptr<const MappedFile> Acquire(const FilePath &path);
+
+   /// Must be called before the file is rewritten or removed, so that
+   /// stale contents are never served and (on Windows) removal can succeed
+   void Invalidate(const FilePath &path);
+
+   /// Discard all mappings
+   void Clear();
+
+ private:
+   using Entry = std::pair< FilePath, std::shared_ptr<const MappedFile> >;
+   using Entries = std::list<Entry>;
+
+   void Trim();
+
+   ODLock mLock;
+   Entries mEntries; // most recently used first
+   std::unordered_map< FilePath, Entries::iterator > mIndex;
+   size_t mTotalBytes{ 0 };
+};
+
+#endif
@@ -20,6 +20,7 @@ The summary is eventually computed and written to a file in a background thread.
 #include "ODPCMAliasBlockFile.h"
 
 #include <float.h>
+#include <algorithm>
 
 #include <wx/file.h>
 #include <wx/utils.h>
@@ -40,6 +41,12 @@ The summary is eventually computed and written to a file in a background thread.
 const int aheaderTagLen = 20;
 char aheaderTag[aheaderTagLen + 1] = "AudacityBlockFile112";
 
+namespace {
+// Bound the frames that DoWriteSummaries() reads at once, and so its memory:
+// 16 MB of float samples for a stereo file
+constexpr long long MaxSpanFrames = 1 << 21;
+}
+
 
 ODPCMAliasBlockFile::ODPCMAliasBlockFile(
       wxFileNameWrapper &&fileName,
@@ -356,6 +363,108 @@ void ODPCMAliasBlockFile::DoWriteSummary()
       WriteSummary();
 }
 
+void ODPCMAliasBlockFile::DoWriteSummary(const float *samples)
+{
+   ODLocker locker { &mWriteSummaryMutex };
+   if(!IsSummaryAvailable())
+      WriteSummaryFromSamples(samples);
+}
+
+void ODPCMAliasBlockFile::DoWriteSummaries(
+   const std::vector< std::shared_ptr< ODPCMAliasBlockFile > > &blocks)
+{
+   struct Entry {
+      ODPCMAliasBlockFile *block;
+      wxString path;
+   };
+   std::vector<Entry> entries;
+   for (const auto &block : blocks)
+   {
+      if (!block || block->IsSummaryAvailable())
+         continue;
+      auto locker = block->LockForRead();
+      entries.push_back({ block.get(), block->mAliasedFileName.GetFullPath() });
+   }
+   std::stable_sort(entries.begin(), entries.end(),
+      [](const Entry &a, const Entry &b){
+         return a.path < b.path ||
+            (a.path == b.path && a.block->mAliasStart < b.block->mAliasStart);
+      });
+
+   Floats samples;
+   size_t samplesLen = 0;
+   for (auto first = entries.begin(); first != entries.end();)
+   {
+      // Find the run of blocks that fit in one span of the file
+      const auto spanStart = first->block->mAliasStart.as_long_long();
+      auto spanEnd = spanStart + (long long)first->block->mLen;
+      auto last = first + 1;
+      for (; last != entries.end() && last->path == first->path; ++last)
+      {
+         const auto end = std::max(spanEnd,
+            last->block->mAliasStart.as_long_long() + (long long)last->block->mLen);
+         if (end - spanStart > MaxSpanFrames)
+            break;
+         spanEnd = end;
+      }
+
+      SF_INFO info;
+      memset(&info, 0, sizeof(info));
+      Floats frames;
+      bool read = false;
+      {
+         // The file can't be renamed while one of the blocks aliasing it is locked;
+         // see DirManager::EnsureSafeFilename()
+         auto locker = first->block->LockForRead();
+         if (first->block->mAliasedFileName.GetFullPath() == first->path)
+         {
+            wxFile f;   // will be closed when it goes out of scope
+            SFFile sf;
+            {
+               // Errors are reported by DoWriteSummary() instead, below
+               wxLogNull silence;
+               if (wxFile::Exists(first->path) && f.Open(first->path))
+                  sf.reset(SFCall<SNDFILE*>(
+                     sf_open_fd, f.fd(), SFM_READ, &info, FALSE));
+            }
+            const auto nFrames = spanEnd - spanStart;
+            read = sf &&
+               std::all_of(first, last, [&](const Entry &entry){
+                  return entry.block->mAliasChannel < info.channels; }) &&
+               SFCall<sf_count_t>(sf_seek, sf.get(), spanStart, SEEK_SET) >= 0;
+            if (read)
+            {
+               frames.reinit((size_t)(nFrames * info.channels));
+               read = SFCall<sf_count_t>(
+                  sf_readf_float, sf.get(), frames.get(), nFrames) == nFrames;
+            }
+         }
+      }
+
+      for (auto entry = first; entry != last; ++entry)
+      {
+         auto block = entry->block;
+         if (!read)
+         {
+            // Read the block alone, as ever
+            block->DoWriteSummary();
+            continue;
+         }
+         if (samplesLen < block->mLen)
+            samples.reinit(samplesLen = block->mLen);
+         const auto channels = info.channels;
+         const float *src = frames.get() +
+            (block->mAliasStart.as_long_long() - spanStart) * channels +
+            block->mAliasChannel;
+         for (size_t i = 0; i < block->mLen; ++i)
+            samples[i] = src[i * channels];
+         block->DoWriteSummary(samples.get());
+      }
+
+      first = last;
+   }
+}
+
 ///sets the file name the summary info will be saved in.  threadsafe.
 void ODPCMAliasBlockFile::SetFileName(wxFileNameWrapper &&name)
 {
@@ -380,6 +489,11 @@ void ODPCMAliasBlockFile::WriteSummary()
    SampleBuffer sampleData(mLen, floatSample);
    this->ReadData(sampleData.ptr(), floatSample, 0, mLen, true);
 
+   WriteSummaryFromSamples((const float *)sampleData.ptr());
+}
+
+void ODPCMAliasBlockFile::WriteSummaryFromSamples(const float *samples)
+{
    ArrayOf< char > fileNameChar;
    FILE *summaryFile{};
    {
@@ -413,7 +527,7 @@ void ODPCMAliasBlockFile::WriteSummary()
    }
 
    ArrayOf<char> cleanup;
-   void *summaryData = CalcSummary(sampleData.ptr(), mLen,
+   void *summaryData = CalcSummary((samplePtr)samples, mLen,
                                             floatSample, cleanup);
 
    //summaryFile.Write(summaryData, mSummaryInfo.totalSummaryBytes);
@@ -38,6 +38,8 @@ Some of these methods have been overridden only because they used the unsafe wxL
 
 #include "PCMAliasBlockFile.h"
 
+#include <vector>
+
 /// An AliasBlockFile that references uncompressed data in an existing file
 class ODPCMAliasBlockFile final : public PCMAliasBlockFile
 {
@@ -85,6 +87,15 @@ class ODPCMAliasBlockFile final : public PCMAliasBlockFile
    ///A public interface to WriteSummary
    void DoWriteSummary();
 
+   ///As DoWriteSummary, given the samples of the block, read from the aliased file already
+   void DoWriteSummary(const float *samples);
+
+   ///Writes the summaries of those blocks that have none yet.  The blocks that alias nearby
+   ///ranges of one file are summarized together, from one read of the span of the file
+   ///that they cover, for all of its channels.  Might throw, leaving some summaries unwritten.
+   static void DoWriteSummaries(
+      const std::vector< std::shared_ptr< ODPCMAliasBlockFile > > &blocks);
+
    ///Sets the value that indicates where the first sample in this block corresponds to the global sequence/clip.  Only for display use.
    void SetStart(sampleCount startSample){mStart = startSample;}
 
@@ -135,6 +146,8 @@ class ODPCMAliasBlockFile final : public PCMAliasBlockFile
 
 protected:
    void WriteSummary() override;
+   ///Writes the summary file, given the samples of the block
+   void WriteSummaryFromSamples(const float *samples);
    void *CalcSummary(samplePtr buffer, size_t len,
       sampleFormat format, ArrayOf<char> &cleanup) override;
 
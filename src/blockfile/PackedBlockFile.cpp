@@ -0,0 +1,677 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PackedBlockFile.cpp
+
+*******************************************************************//**
+
+\file PackedBlockFile.cpp
+\brief Implements PackedBlockFile and BlockPack.
+
+*//****************************************************************//**
+
+\class BlockPack
+\brief Stores the data of many blocks as extents inside a few large
+append-only files ("pack files") in the project data directory.
+
+Each extent is a small header, then the summary data, then the samples
+in their native in-memory format, native endian.
+
+Extents are never rewritten or reused once appended, so a saved project
+remains valid while the pack files keep growing during editing.  When the
+project moves to another directory, each pack file is hard-linked or copied
+whole, with one large sequential write, and keeps its unique name, so the
+offsets recorded in the project file stay valid.
+
+The pack counts the extents that blocks use in each of its files.  Before
+a project is saved, the used extents of files that are mostly unused are
+copied to the end of the pack; once the project file is written, the
+files that no block uses any more are removed.  So the space of deleted
+blocks is reclaimed at each save.
+
+The index from blocks to extents is held in memory by the
+PackedBlockFile objects, and is saved with them in the project file.
+
+*//****************************************************************//**
+
+\class PackedBlockFile
+\brief A BlockFile whose data live in a BlockPack.
+
+This avoids creating a file system object for every block, which makes
+opening, saving and copying of large projects dominated by directory
+operations.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "PackedBlockFile.h"
+
+#include <time.h>
+
+#include <algorithm>
+
+#include <wx/dir.h>
+#include <wx/file.h>
+#include <wx/filefn.h>
+#include <wx/log.h>
+
+#include "../DirManager.h"
+#include "../FileException.h"
+#include "../FileNames.h"
+#include "../Internat.h"
+#include "../xml/XMLWriter.h"
+
+namespace {
+
+// Start a NEW pack file when the current one reaches this size
+constexpr long long MaxPackFileBytes = 1LL << 30;
+
+const wxChar *PackFilePrefix = wxT("pack");
+const wxChar *PackFileExtension = wxT("aupk");
+
+struct ExtentHeader {
+   wxUint32 magic;        // 'APKB', native endian
+   wxUint32 format;       // sampleFormat of the samples
+   wxUint32 len;          // number of samples
+   wxUint32 summaryBytes; // length of the summary that follows
+};
+
+constexpr wxUint32 ExtentMagic = 0x41504b42;
+
+ODLock &GetPacksLock()
+{
+   static ODLock theLock;
+   return theLock;
+}
+
+using BlockPacks = std::unordered_map< wxString, std::weak_ptr<BlockPack> >;
+BlockPacks &GetPacks()
+{
+   static BlockPacks thePacks;
+   return thePacks;
+}
+
+}
+
+std::shared_ptr<BlockPack> BlockPack::Get(const FilePath &directory)
+{
+   ODLocker locker{ &GetPacksLock() };
+   auto &wPack = GetPacks()[directory];
+   auto pack = wPack.lock();
+   if (!pack)
+      wPack = pack = std::make_shared<BlockPack>(directory);
+   return pack;
+}
+
+void BlockPack::RemoveFiles(const FilePath &directory)
+{
+   {
+      ODLocker locker{ &GetPacksLock() };
+      auto &packs = GetPacks();
+      auto iter = packs.find(directory);
+      if (iter != packs.end()) {
+         if (auto pack = iter->second.lock()) {
+            ODLocker packLocker{ &pack->mLock };
+            pack->mFiles.clear();
+            pack->mCurrentPack.clear();
+         }
+         packs.erase(iter);
+      }
+   }
+
+   wxDir dir(directory);
+   if (!dir.IsOpened())
+      return;
+
+   FilePaths paths;
+   wxString name;
+   const auto spec = wxString::Format(wxT("%s*.%s"),
+      PackFilePrefix, PackFileExtension);
+   for (bool cont = dir.GetFirst(&name, spec, wxDIR_FILES); cont;
+        cont = dir.GetNext(&name))
+      paths.push_back(
+         wxFileName{ directory, name }.GetFullPath());
+   for (const auto &path : paths)
+      wxRemoveFile(path);
+}
+
+bool BlockPack::IsPackFileName(const wxFileName &fileName)
+{
+   return fileName.GetExt().IsSameAs(PackFileExtension, false) &&
+      fileName.GetName().StartsWith(PackFilePrefix);
+}
+
+BlockPack::BlockPack(const FilePath &directory)
+   : mDirectory{ directory }
+{
+}
+
+BlockPack::~BlockPack()
+{
+}
+
+wxFileNameWrapper BlockPack::GetPackFileName(const wxString &pack) const
+{
+   wxFileNameWrapper fileName;
+   fileName.Assign(mDirectory, PackFilePrefix + pack, PackFileExtension);
+   return fileName;
+}
+
+// Pack files are never renamed, and may be linked or copied into the data
+// directories of other projects, so their names are made unique
+wxString BlockPack::NewPackName() const
+{
+   wxString pack;
+   do
+      pack.Printf(wxT("%08lx%04x"),
+         (unsigned long)time(NULL),
+         (unsigned)(65536.*rand()/(RAND_MAX+1.)));
+   while (GetPackFileName(pack).FileExists());
+   return pack;
+}
+
+// Call with mLock held
+wxFile *BlockPack::GetFile(const wxString &pack, bool create)
+{
+   auto &pFile = mFiles[pack];
+   if (pFile)
+      return pFile.get();
+
+   const auto path = GetPackFileName(pack).GetFullPath();
+   if (!wxFile::Exists(path)) {
+      if (!create)
+         return nullptr;
+      if (!wxDirExists(mDirectory) &&
+          !wxFileName::Mkdir(mDirectory, 0777, wxPATH_MKDIR_FULL))
+         return nullptr;
+      wxFile newFile;
+      if (!newFile.Create(path))
+         return nullptr;
+   }
+
+   auto file = std::make_unique<wxFile>();
+   if (!file->Open(path, wxFile::read_write) &&
+       // Adopted packs of a read-only project can still be read
+       !file->Open(path, wxFile::read))
+      return nullptr;
+
+   pFile = std::move(file);
+   return pFile.get();
+}
+
+auto BlockPack::Append(
+   const std::vector< std::pair<const void*, size_t> > &parts) -> Extent
+{
+   ODLocker locker{ &mLock };
+
+   size_t size = 0;
+   for (const auto &part : parts)
+      size += part.second;
+
+   // Each session appends only to pack files it created itself, so that
+   // pack files shared with other projects are never modified
+   wxFile *file = nullptr;
+   if (!mCurrentPack.empty())
+      file = GetFile(mCurrentPack, true);
+   if (!file || file->Length() + (long long)size > MaxPackFileBytes) {
+      mCurrentPack = NewPackName();
+      file = GetFile(mCurrentPack, true);
+   }
+   if (!file)
+      throw FileException{
+         FileException::Cause::Open, GetPackFileName(mCurrentPack) };
+
+   Extent extent;
+   extent.pack = mCurrentPack;
+   extent.offset = file->SeekEnd();
+   extent.size = size;
+   if (extent.offset == wxInvalidOffset)
+      throw FileException{
+         FileException::Cause::Write, GetPackFileName(mCurrentPack) };
+
+   for (const auto &part : parts) {
+      if (file->Write(part.first, part.second) != part.second)
+         // A partial extent may remain, but nothing will refer to it
+         throw FileException{
+            FileException::Cause::Write, GetPackFileName(mCurrentPack) };
+   }
+
+   return extent;
+}
+
+bool BlockPack::Read(
+   const Extent &extent, size_t offset, void *buffer, size_t bytes)
+{
+   if (offset + bytes > extent.size)
+      return false;
+
+   ODLocker locker{ &mLock };
+   auto file = GetFile(extent.pack, false);
+   if (!file)
+      return false;
+   return file->Seek(extent.offset + offset) != wxInvalidOffset &&
+      file->Read(buffer, bytes) == (ssize_t)bytes;
+}
+
+bool BlockPack::Contains(const Extent &extent)
+{
+   ODLocker locker{ &mLock };
+   auto file = GetFile(extent.pack, false);
+   return file && file->Length() >= extent.offset + (long long)extent.size;
+}
+
+bool BlockPack::Adopt(BlockPack &source, const wxString &pack, bool &link)
+{
+   if (&source == this)
+      return true;
+
+   ODLocker locker{ &mLock };
+   if (mFiles[pack])
+      // Already done for another block
+      return true;
+
+   const auto oldPath = source.GetPackFileName(pack).GetFullPath();
+   const auto newPath = GetPackFileName(pack).GetFullPath();
+   if (wxFile::Exists(newPath) &&
+       wxFileName::GetSize(newPath) == wxFileName::GetSize(oldPath))
+      return GetFile(pack, false) != nullptr;
+
+   if (wxFile::Exists(newPath))
+      // Left over from an incomplete attempt
+      wxRemoveFile(newPath);
+   else if (!wxDirExists(mDirectory) &&
+       !wxFileName::Mkdir(mDirectory, 0777, wxPATH_MKDIR_FULL))
+      return false;
+
+   // One large sequential copy for the whole pack, instead of
+   // one file system operation per block
+   {
+      ODLocker sourceLocker{ &source.mLock };
+      bool success = false;
+      if (link)
+         success = FileNames::HardLinkFile( oldPath, newPath );
+      if (!success)
+          link = false,
+          success = FileNames::CopyFile( oldPath, newPath );
+      if (!success)
+         return false;
+   }
+
+   return GetFile(pack, false) != nullptr;
+}
+
+void BlockPack::Use(const Extent &extent)
+{
+   ODLocker locker{ &mLock };
+   auto &usage = mUsage[extent.pack];
+   ++usage.extents;
+   usage.bytes += extent.size;
+}
+
+void BlockPack::Release(const Extent &extent)
+{
+   ODLocker locker{ &mLock };
+   auto iter = mUsage.find(extent.pack);
+   if (iter == mUsage.end())
+      return;
+   auto &usage = iter->second;
+   usage.bytes -= std::min<unsigned long long>(usage.bytes, extent.size);
+   if (--usage.extents == 0)
+      mUsage.erase(iter);
+}
+
+std::unordered_set<wxString> BlockPack::FindSparseFiles()
+{
+   ODLocker locker{ &mLock };
+   std::unordered_set<wxString> sparse;
+   for (const auto &pair : mUsage) {
+      auto file = GetFile(pair.first, false);
+      if (file && pair.second.bytes < (unsigned long long)file->Length() / 2)
+         sparse.insert(pair.first);
+   }
+   // Don't copy extents into a file that is to be emptied
+   if (sparse.count(mCurrentPack))
+      mCurrentPack.clear();
+   return sparse;
+}
+
+auto BlockPack::CopyExtent(const Extent &extent) -> Extent
+{
+   ArrayOf<char> data{ extent.size };
+   if (!Read(extent, 0, data.get(), extent.size))
+      throw FileException{
+         FileException::Cause::Read, GetPackFileName(extent.pack) };
+   return Append( { { data.get(), extent.size } } );
+}
+
+void BlockPack::RemoveUnusedFiles()
+{
+   ODLocker locker{ &mLock };
+
+   wxDir dir(mDirectory);
+   if (!dir.IsOpened())
+      return;
+
+   std::vector<wxString> packs;
+   wxString name;
+   const auto spec = wxString::Format(wxT("%s*.%s"),
+      PackFilePrefix, PackFileExtension);
+   for (bool cont = dir.GetFirst(&name, spec, wxDIR_FILES); cont;
+        cont = dir.GetNext(&name))
+      packs.push_back(
+         wxFileName{ name }.GetName().Mid(wxStrlen(PackFilePrefix)));
+
+   for (const auto &pack : packs) {
+      // A block may be under construction in the current file, not yet
+      // counted
+      if (pack == mCurrentPack || mUsage.count(pack))
+         continue;
+      mFiles.erase(pack);
+      wxRemoveFile(GetPackFileName(pack).GetFullPath());
+   }
+}
+
+/// Constructs a PackedBlockFile based on sample data and appends it to
+/// the pack.
+///
+/// @param name       The key of this block, without extension
+/// @param pack       The pack of the project data directory
+/// @param sampleData The sample data to be written to this block.
+/// @param sampleLen  The number of samples to be written to this block.
+/// @param format     The format of the given samples.
+PackedBlockFile::PackedBlockFile(wxFileNameWrapper &&name,
+                                 const BlockPackPtr &pack,
+                                 samplePtr sampleData, size_t sampleLen,
+                                 sampleFormat format)
+   : BlockFile{
+      (name.SetExt(wxT("pkb")), std::move(name)),
+      sampleLen
+   }
+   , mPack{ pack }
+   , mFormat{ format }
+{
+   ArrayOf<char> cleanup;
+   void *summaryData = CalcSummary(sampleData, sampleLen, format, cleanup);
+
+   ExtentHeader header;
+   header.magic = ExtentMagic;
+   header.format = format;
+   header.len = sampleLen;
+   header.summaryBytes = mSummaryInfo.totalSummaryBytes;
+
+   mExtent = mPack->Append( {
+      { &header, sizeof(header) },
+      { summaryData, mSummaryInfo.totalSummaryBytes },
+      { sampleData, sampleLen * SAMPLE_SIZE(format) },
+   } );
+   mPack->Use(mExtent);
+}
+
+/// Construct a PackedBlockFile memory structure that will point to an
+/// existing extent.
+PackedBlockFile::PackedBlockFile(wxFileNameWrapper &&name,
+                                 const BlockPackPtr &pack,
+                                 const BlockPack::Extent &extent,
+                                 sampleFormat format,
+                                 size_t len, float min, float max, float rms)
+   : BlockFile{ std::move(name), len }
+   , mPack{ pack }
+   , mExtent{ extent }
+   , mFormat{ format }
+{
+   mMin = min;
+   mMax = max;
+   mRMS = rms;
+   mPack->Use(mExtent);
+}
+
+PackedBlockFile::~PackedBlockFile()
+{
+   // The name is only a key; there is no file of that name for the base
+   // class destructor to remove.  The extent is immutable and stays in the
+   // pack, in case a saved project still refers to it, until the next save
+   // removes the files that no block uses.
+   mFileName.Clear();
+   mPack->Release(mExtent);
+}
+
+size_t PackedBlockFile::HeaderSize() const
+{
+   return sizeof(ExtentHeader) + mSummaryInfo.totalSummaryBytes;
+}
+
+bool PackedBlockFile::ReadSummary(ArrayOf<char> &data)
+{
+   data.reinit( mSummaryInfo.totalSummaryBytes );
+   if (!mPack->Read(mExtent, sizeof(ExtentHeader),
+                    data.get(), mSummaryInfo.totalSummaryBytes)) {
+      memset(data.get(), 0, mSummaryInfo.totalSummaryBytes);
+      return false;
+   }
+   return true;
+}
+
+/// Read the data portion of the extent.  Convert it to the given format
+/// if it is not already.
+///
+/// @param data   The buffer where the data will be stored
+/// @param format The format the data will be stored in
+/// @param start  The offset in this block file
+/// @param len    The number of samples to read
+size_t PackedBlockFile::ReadData(samplePtr data, sampleFormat format,
+                        size_t start, size_t len, bool mayThrow) const
+{
+   auto framesRead = std::min(len, std::max(start, mLen) - start);
+   const auto offset = HeaderSize() + start * SAMPLE_SIZE(mFormat);
+   const auto bytes = framesRead * SAMPLE_SIZE(mFormat);
+
+   bool ok;
+   if (format == mFormat)
+      ok = mPack->Read(mExtent, offset, data, bytes);
+   else {
+      SampleBuffer buffer(framesRead, mFormat);
+      ok = mPack->Read(mExtent, offset, buffer.ptr(), bytes);
+      if (ok)
+         CopySamples(buffer.ptr(), mFormat, data, format, framesRead);
+   }
+   if (!ok)
+      framesRead = 0;
+   mSilentLog = !ok;
+
+   if ( framesRead < len ) {
+      if (mayThrow)
+         throw FileException{ FileException::Cause::Read,
+            mPack->GetPackFileName(mExtent.pack) };
+      ClearSamples(data, format, framesRead, len - framesRead);
+   }
+
+   return framesRead;
+}
+
+void PackedBlockFile::SaveXML(XMLWriter &xmlFile)
+// may throw
+{
+   xmlFile.StartTag(wxT("packedblockfile"));
+
+   xmlFile.WriteAttr(wxT("filename"), mFileName.GetFullName());
+   xmlFile.WriteAttr(wxT("pack"), mExtent.pack);
+   xmlFile.WriteAttr(wxT("offset"), mExtent.offset);
+   xmlFile.WriteAttr(wxT("size"), mExtent.size);
+   xmlFile.WriteAttr(wxT("format"), (long) mFormat);
+   xmlFile.WriteAttr(wxT("len"), mLen);
+   xmlFile.WriteAttr(wxT("min"), mMin);
+   xmlFile.WriteAttr(wxT("max"), mMax);
+   xmlFile.WriteAttr(wxT("rms"), mRMS);
+
+   xmlFile.EndTag(wxT("packedblockfile"));
+}
+
+// BuildFromXML methods should always return a BlockFile, not NULL,
+// even if the result is flawed (e.g., refers to nonexistent file),
+// as testing will be done in ProjectFSCK().
+/// static
+BlockFilePtr PackedBlockFile::BuildFromXML(DirManager &dm, const wxChar **attrs)
+{
+   wxFileNameWrapper fileName;
+   BlockPack::Extent extent;
+   sampleFormat format = floatSample;
+   float min = 0.0f, max = 0.0f, rms = 0.0f;
+   size_t len = 0;
+   double dblValue;
+   long nValue;
+   long long nnValue;
+
+   while(*attrs)
+   {
+      const wxChar *attr =  *attrs++;
+      const wxChar *value = *attrs++;
+      if (!value)
+         break;
+
+      const wxString strValue = value;
+      if (!wxStricmp(attr, wxT("filename")) &&
+            XMLValueChecker::IsGoodFileString(strValue) &&
+            (strValue.length() + 1 + dm.GetDataFilesDir().length() <= PLATFORM_MAX_PATH))
+         fileName.Assign(dm.GetDataFilesDir(), strValue);
+      else if (!wxStricmp(attr, wxT("pack")) &&
+               XMLValueChecker::IsGoodFileString(strValue))
+         extent.pack = strValue;
+      else if (!wxStricmp(attr, wxT("offset")))
+      {
+         if (XMLValueChecker::IsGoodInt64(strValue) &&
+             strValue.ToLongLong(&nnValue) && (nnValue >= 0))
+            extent.offset = nnValue;
+      }
+      else if (!wxStricmp(attr, wxT("size")))
+      {
+         if (XMLValueChecker::IsGoodInt64(strValue) &&
+             strValue.ToLongLong(&nnValue) && (nnValue >= 0))
+            extent.size = nnValue;
+      }
+      else if (XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue))
+      {  // integer parameters
+         if (!wxStricmp(attr, wxT("len")) && (nValue > 0))
+            len = nValue;
+         else if (!wxStricmp(attr, wxT("format")) &&
+                  XMLValueChecker::IsValidSampleFormat(nValue))
+            format = (sampleFormat) nValue;
+         else if (!wxStricmp(attr, wxT("min")))
+            min = nValue;
+         else if (!wxStricmp(attr, wxT("max")))
+            max = nValue;
+         else if (!wxStricmp(attr, wxT("rms")) && (nValue >= 0))
+            rms = nValue;
+      }
+      else if (XMLValueChecker::IsGoodString(strValue) && Internat::CompatibleToDouble(strValue, &dblValue))
+      {  // double parameters
+         if (!wxStricmp(attr, wxT("min")))
+            min = dblValue;
+         else if (!wxStricmp(attr, wxT("max")))
+            max = dblValue;
+         else if (!wxStricmp(attr, wxT("rms")) && (dblValue >= 0.0))
+            rms = dblValue;
+      }
+   }
+
+   return make_blockfile<PackedBlockFile>(std::move(fileName),
+      BlockPack::Get(dm.GetDataFilesDir()), extent, format, len, min, max, rms);
+}
+
+/// Create a copy of this BlockFile, under a different name.  The extent
+/// is immutable, so it is shared, not copied.
+///
+/// @param newFileName The name of the NEW block.
+BlockFilePtr PackedBlockFile::Copy(wxFileNameWrapper &&newFileName)
+{
+   newFileName.SetExt(wxT("pkb"));
+   return make_blockfile<PackedBlockFile>(std::move(newFileName),
+      mPack, mExtent, mFormat, mLen, mMin, mMax, mRMS);
+}
+
+auto PackedBlockFile::GetSpaceUsage() const -> DiskByteCount
+{
+   return mExtent.size;
+}
+
+void PackedBlockFile::Recover()
+{
+   // Replace missing data with a NEW extent of silence, in the same
+   // format that SimpleBlockFile::Recover() uses
+   SampleBuffer silence(mLen, int16Sample);
+   ClearSamples(silence.ptr(), int16Sample, 0, mLen);
+
+   ArrayOf<char> summary{ mSummaryInfo.totalSummaryBytes, true };
+
+   ExtentHeader header;
+   header.magic = ExtentMagic;
+   header.format = int16Sample;
+   header.len = mLen;
+   header.summaryBytes = mSummaryInfo.totalSummaryBytes;
+
+   const auto extent = mPack->Append( {
+      { &header, sizeof(header) },
+      { summary.get(), mSummaryInfo.totalSummaryBytes },
+      { silence.ptr(), mLen * SAMPLE_SIZE(int16Sample) },
+   } );
+   mPack->Release(mExtent);
+   mExtent = extent;
+   mPack->Use(mExtent);
+   mFormat = int16Sample;
+
+   ContentsChanged();
+}
+
+bool PackedBlockFile::CopyToPack(const BlockPackPtr &pack, bool &link)
+{
+   if (!pack->Adopt(*mPack, mExtent.pack, link))
+      return false;
+   mNewPack = pack;
+   return true;
+}
+
+void PackedBlockFile::SetFileName(wxFileNameWrapper &&name)
+{
+   BlockFile::SetFileName(std::move(name));
+   if (mNewPack) {
+      // The extent keeps its pack name and offset
+      mNewPack->Use(mExtent);
+      mPack->Release(mExtent);
+      mPack = std::move(mNewPack);
+   }
+}
+
+void PackedBlockFile::MoveFromSparseFile(BlockPack &pack,
+   const std::unordered_set<wxString> &sparse, MovedExtents &moved)
+{
+   if (mPack.get() != &pack || !sparse.count(mExtent.pack))
+      return;
+
+   const auto key = std::make_pair(mExtent.pack, mExtent.offset);
+   auto iter = moved.find(key);
+   if (iter == moved.end())
+      iter = moved.emplace(key, mPack->CopyExtent(mExtent)).first;
+
+   mPack->Release(mExtent);
+   mExtent = iter->second;
+   mPack->Use(mExtent);
+}
+
+bool PackedBlockFile::IsExtentAvailable() const
+{
+   if (!mPack->Contains(mExtent) || mExtent.size < HeaderSize())
+      return false;
+
+   ExtentHeader header;
+   return mPack->Read(mExtent, 0, &header, sizeof(header)) &&
+      header.magic == ExtentMagic &&
+      header.len == mLen &&
+      header.format == (wxUint32) mFormat;
+}
+
+static DirManager::RegisteredBlockFileDeserializer sRegistration {
+   "packedblockfile",
+   []( DirManager &dm, const wxChar **attrs ){
+      return PackedBlockFile::BuildFromXML( dm, attrs );
+   }
+};
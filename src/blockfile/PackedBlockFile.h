@@ -0,0 +1,181 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PackedBlockFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PACKED_BLOCKFILE__
+#define __AUDACITY_PACKED_BLOCKFILE__
+
+#include "../BlockFile.h"
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class DirManager;
+class wxFile;
+
+/// A set of large append-only files in one project data directory, each
+/// holding the sample and summary data of many PackedBlockFiles
+class BlockPack final
+{
+ public:
+   /// Location of the data of one block within the pack
+   struct Extent {
+      wxString pack;          // unique identifier of the pack file
+      long long offset{ 0 };  // byte offset of the extent header
+      size_t size{ 0 };       // total bytes, including the header
+   };
+
+   /// There is at most one BlockPack object for each directory, shared by
+   /// all the blocks stored in it
+   static std::shared_ptr<BlockPack> Get(const FilePath &directory);
+
+   /// Remove the pack files in a directory that is no longer used
+   static void RemoveFiles(const FilePath &directory);
+
+   /// True if the name is one this class gives to its pack files
+   static bool IsPackFileName(const wxFileName &fileName);
+
+   explicit BlockPack(const FilePath &directory);
+   BlockPack(const BlockPack&) PROHIBITED;
+   BlockPack &operator= (const BlockPack&) PROHIBITED;
+   ~BlockPack();
+
+   const FilePath &GetDirectory() const { return mDirectory; }
+   wxFileNameWrapper GetPackFileName(const wxString &pack) const;
+
+   /// Write the concatenation of the buffers as one NEW extent at the end
+   /// of the current pack file, starting a NEW pack file when the
+   /// current one is full.  Throws FileException on failure.
+   Extent Append(const std::vector< std::pair<const void*, size_t> > &parts);
+
+   /// Read bytes of an extent, starting at the given offset within it.
+   /// Returns false if the data are not all available.
+   bool Read(const Extent &extent, size_t offset, void *buffer, size_t bytes);
+
+   /// True if the pack file exists and is long enough to contain the extent
+   bool Contains(const Extent &extent);
+
+   /// Make the named pack file of another directory available in this one,
+   /// by hard link if link is true and that is possible, else by copying.
+   /// Pack files have unique names, so offsets of extents are preserved and
+   /// packs from several projects may coexist in one directory.
+   /// Sets link false if copying was needed.
+   bool Adopt(BlockPack &source, const wxString &pack, bool &link);
+
+   /// Count the extent as used by one more block, or one fewer.  Blocks of
+   /// any project that read from this pack are counted.
+   void Use(const Extent &extent);
+   void Release(const Extent &extent);
+
+   /// The pack files that blocks use for less than half their length.
+   /// Later appends go to a NEW pack file if the current one is among them.
+   std::unordered_set<wxString> FindSparseFiles();
+
+   /// Append a copy of an extent, as a NEW extent.  Throws FileException
+   /// on failure.
+   Extent CopyExtent(const Extent &extent);
+
+   /// Remove the pack files of the directory that no block uses.  Call
+   /// only when no saved project file refers to their extents.
+   void RemoveUnusedFiles();
+
+ private:
+   wxFile *GetFile(const wxString &pack, bool create);
+   wxString NewPackName() const;
+
+   const FilePath mDirectory;
+
+   ODLock mLock;
+   std::unordered_map< wxString, std::unique_ptr<wxFile> > mFiles;
+   wxString mCurrentPack; // where appends go; empty until the first one
+   // Extents of each pack file in use, and their bytes, counted once for
+   // each block
+   struct Usage {
+      size_t extents{ 0 };
+      unsigned long long bytes{ 0 };
+   };
+   std::unordered_map< wxString, Usage > mUsage;
+};
+
+using BlockPackPtr = std::shared_ptr<BlockPack>;
+
+/// A BlockFile whose data is an extent in a BlockPack, rather than a
+/// file of its own.  Its file name is only a unique key for the
+/// DirManager's hash and the project file; no such file exists on disk.
+class PackedBlockFile final : public BlockFile {
+ public:
+
+   // Constructor / Destructor
+
+   /// Append summary and sample data as a NEW extent in the pack
+   PackedBlockFile(wxFileNameWrapper &&name, const BlockPackPtr &pack,
+                   samplePtr sampleData, size_t sampleLen,
+                   sampleFormat format);
+   /// Create the memory structure to refer to an existing extent
+   PackedBlockFile(wxFileNameWrapper &&name, const BlockPackPtr &pack,
+                   const BlockPack::Extent &extent, sampleFormat format,
+                   size_t len, float min, float max, float rms);
+
+   virtual ~PackedBlockFile();
+
+   // Reading
+
+   /// Read the summary section of the extent
+   bool ReadSummary(ArrayOf<char> &data) override;
+   /// Read the data section of the extent
+   size_t ReadData(samplePtr data, sampleFormat format,
+                        size_t start, size_t len, bool mayThrow) const override;
+
+   /// Create a NEW block file sharing this one's immutable extent
+   BlockFilePtr Copy(wxFileNameWrapper &&newFileName) override;
+   /// Write an XML representation of this file
+   void SaveXML(XMLWriter &xmlFile) override;
+
+   DiskByteCount GetSpaceUsage() const override;
+   void Recover() override;
+
+   bool IsPacked() const override { return true; }
+
+   /// Completes a relocation begun by CopyToPack(), if any
+   void SetFileName(wxFileNameWrapper &&name) override;
+
+   /// Make the extent available in another pack; the block goes on
+   /// reading from its present pack until SetFileName() is called
+   bool CopyToPack(const BlockPackPtr &pack, bool &link);
+
+   /// True if the extent is present in a pack file on disk
+   bool IsExtentAvailable() const;
+
+   /// Extents already moved by MoveFromSparseFile(), by pack and offset,
+   /// so that blocks sharing an extent go on sharing the copy
+   using MovedExtents =
+      std::map< std::pair<wxString, long long>, BlockPack::Extent >;
+
+   /// If the block reads from the given pack, and its extent is in one of
+   /// the sparse files, use a copy of the extent at the end of the pack
+   /// instead.  Throws FileException on failure, leaving the block
+   /// unchanged.
+   void MoveFromSparseFile(BlockPack &pack,
+      const std::unordered_set<wxString> &sparse, MovedExtents &moved);
+
+   static BlockFilePtr BuildFromXML(DirManager &dm, const wxChar **attrs);
+
+ private:
+   size_t HeaderSize() const;
+
+   BlockPackPtr mPack;
+   BlockPack::Extent mExtent;
+   sampleFormat mFormat;
+
+   // Pending relocation
+   BlockPackPtr mNewPack;
+};
+
+#endif
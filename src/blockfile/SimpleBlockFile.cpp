@@ -21,6 +21,12 @@ libsndfile
 A block file that writes the audio data to an .au file and reads
 it back using libsndfile.
 
+Unless the block is cached, reads of native-endian 16-bit and float files
+are served from a memory mapping kept by MappedFileCache, which avoids
+opening the file and the libsndfile machinery on each access.  Packed
+24-bit samples, and files written on a machine of other endianness, still
+go through libsndfile.
+
 There are two ways to construct a simple block file.  One is to
 supply data and have the constructor write the file.  The other
 is for when the file already exists and we simply want to create
@@ -48,6 +54,11 @@ default is to disable caching.
   manual auto recovery, because the files are never written physically to
   disk).
 
+* Background writing: If caching is disabled, allowDeferredWrite is
+  enabled, and the BlockWriter is enabled, NEW block files are held in memory
+  only until the BlockWriter thread writes them, soon after.  Then the memory
+  is released.  See BlockWriter.
+
 *//****************************************************************//**
 
 \class auHeader
@@ -70,9 +81,17 @@ to get its definition, rather than rolling our own.
 #include "../Prefs.h"
 
 #include "../FileFormats.h"
+#include "BlockWriter.h"
+#include "MappedFileCache.h"
 
 #include "sndfile.h"
 
+#ifdef __WXMSW__
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 
 static wxUint32 SwapUintEndianess(wxUint32 in)
 {
@@ -86,6 +105,18 @@ static wxUint32 SwapUintEndianess(wxUint32 in)
   return out;
 }
 
+// Flush the written file to the device, not only to the system
+static bool SyncFile(wxFFile &file)
+{
+   if (!file.Flush())
+      return false;
+#ifdef __WXMSW__
+   return _commit(_fileno(file.fp())) == 0;
+#else
+   return fsync(fileno(file.fp())) == 0;
+#endif
+}
+
 /// Constructs a SimpleBlockFile based on sample data and writes
 /// it to disk.
 ///
@@ -111,8 +142,10 @@ SimpleBlockFile::SimpleBlockFile(wxFileNameWrapper &&baseFileName,
    mCache.active = false;
 
    bool useCache = GetCache() && (!bypassCache);
+   bool useWriter = allowDeferredWrite && !useCache && !bypassCache &&
+      BlockWriter::Get().IsEnabled();
 
-   if (!(allowDeferredWrite && useCache) && !bypassCache)
+   if (!(allowDeferredWrite && useCache) && !bypassCache && !useWriter)
    {
       bool bSuccess = WriteSimpleBlockFile(sampleData, sampleLen, format, NULL);
       if (!bSuccess)
@@ -120,10 +153,11 @@ SimpleBlockFile::SimpleBlockFile(wxFileNameWrapper &&baseFileName,
             FileException::Cause::Write, GetFileName().name };
    }
 
-   if (useCache) {
+   if (useCache || useWriter) {
       //wxLogDebug("SimpleBlockFile::SimpleBlockFile(): Caching block file data.");
       mCache.active = true;
       mCache.needWrite = true;
+      mCache.release = !useCache;
       mCache.format = format;
       const auto sampleDataSize = sampleLen * SAMPLE_SIZE(format);
       mCache.sampleData.reinit(sampleDataSize);
@@ -157,14 +191,19 @@ SimpleBlockFile::SimpleBlockFile(wxFileNameWrapper &&existingFile, size_t len,
 
 SimpleBlockFile::~SimpleBlockFile()
 {
+   // Release the mapping before the base class removes the file
+   MappedFileCache::Get().Invalidate(mFileName.GetFullPath());
 }
 
 bool SimpleBlockFile::WriteSimpleBlockFile(
     samplePtr sampleData,
     size_t sampleLen,
     sampleFormat format,
-    void* summaryData)
+    void* summaryData,
+    bool sync /* = false */)
 {
+   MappedFileCache::Get().Invalidate(mFileName.GetFullPath());
+
    wxFFile file(mFileName.GetFullPath(), wxT("wb"));
    if( !file.IsOpened() ){
       // Can't do anything else.
@@ -266,6 +305,9 @@ bool SimpleBlockFile::WriteSimpleBlockFile(
       }
    }
 
+   if (sync && !SyncFile(file))
+      return false;
+
    return true;
 }
 
@@ -273,7 +315,7 @@ bool SimpleBlockFile::WriteSimpleBlockFile(
 // (not throwing) if there is failure.
 void SimpleBlockFile::FillCache()
 {
-   if (mCache.active)
+   if (!GetNeedFillCache())
       return; // cache is already filled
 
    // Check sample format
@@ -331,8 +373,10 @@ void SimpleBlockFile::FillCache()
    ReadSummary(mCache.summaryData);
 
    // Cache is active but already on disk
+   std::lock_guard<std::mutex> lock{ mCacheMutex };
    mCache.active = true;
    mCache.needWrite = false;
+   mCache.release = false;
 
    //wxLogDebug("SimpleBlockFile::FillCache(): Successfully read simple block file into cache.");
 }
@@ -344,12 +388,15 @@ void SimpleBlockFile::FillCache()
 bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
 {
    data.reinit( mSummaryInfo.totalSummaryBytes );
-   if (mCache.active) {
-      //wxLogDebug("SimpleBlockFile::ReadSummary(): Summary is already in cache.");
-      memcpy(data.get(), mCache.summaryData.get(), mSummaryInfo.totalSummaryBytes);
-      return true;
+   {
+      std::lock_guard<std::mutex> lock{ mCacheMutex };
+      if (mCache.active) {
+         //wxLogDebug("SimpleBlockFile::ReadSummary(): Summary is already in cache.");
+         memcpy(data.get(), mCache.summaryData.get(), mSummaryInfo.totalSummaryBytes);
+         return true;
+      }
    }
-   else
+
    {
       //wxLogDebug("SimpleBlockFile::ReadSummary(): Reading summary from disk.");
 
@@ -393,6 +440,7 @@ bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
 size_t SimpleBlockFile::ReadData(samplePtr data, sampleFormat format,
                         size_t start, size_t len, bool mayThrow) const
 {
+   std::unique_lock<std::mutex> lock{ mCacheMutex };
    if (mCache.active)
    {
       //wxLogDebug("SimpleBlockFile::ReadData(): Data are already in cache.");
@@ -412,9 +460,71 @@ size_t SimpleBlockFile::ReadData(samplePtr data, sampleFormat format,
 
       return framesRead;
    }
+   lock.unlock();
+
+   size_t framesRead;
+   if (ReadMappedData(data, format, start, len, framesRead)) {
+      if ( framesRead < len ) {
+         if (mayThrow)
+            throw FileException{ FileException::Cause::Read, mFileName };
+         ClearSamples(data, format, framesRead, len - framesRead);
+      }
+      return framesRead;
+   }
+
+   return CommonReadData( mayThrow,
+      mFileName, mSilentLog, nullptr, 0, 0, data, format, start, len);
+}
+
+/// Read the data portion of the block file from a memory mapping, if the
+/// samples are stored in a format that needs no decoding.
+///
+/// @return false if the file could not be mapped or must be decoded by
+/// libsndfile; then nothing was read.
+bool SimpleBlockFile::ReadMappedData(samplePtr data, sampleFormat format,
+   size_t start, size_t len, size_t &framesRead) const
+{
+   if (!MappedFileCache::IsEnabled())
+      return false;
+
+   auto file = MappedFileCache::Get().Acquire(mFileName.GetFullPath());
+   if (!file || file->GetSize() < sizeof(auHeader))
+      return false;
+
+   auHeader header;
+   memcpy(&header, file->GetData(), sizeof(header));
+   if (header.magic != 0x2e736e64 ||
+       header.dataOffset < sizeof(auHeader) ||
+       header.dataOffset > file->GetSize())
+      // Other endianness or corrupt
+      return false;
+
+   sampleFormat fileFormat;
+   switch (header.encoding) {
+      case AU_SAMPLE_FORMAT_16:
+         fileFormat = int16Sample;
+         break;
+      case AU_SAMPLE_FORMAT_FLOAT:
+         fileFormat = floatSample;
+         break;
+      default:
+         // 24 bit samples are packed on disk
+         return false;
+   }
+
+   const auto sampleSize = SAMPLE_SIZE(fileFormat);
+   const size_t available =
+      (file->GetSize() - header.dataOffset) / sampleSize;
+   framesRead = std::min(len, std::max(start, available) - start);
+
+   const auto src = file->GetData() + header.dataOffset + start * sampleSize;
+   if (format == fileFormat)
+      memcpy(data, src, framesRead * sampleSize);
    else
-      return CommonReadData( mayThrow,
-         mFileName, mSilentLog, nullptr, 0, 0, data, format, start, len);
+      CopySamples((samplePtr)src, fileFormat, data, format, framesRead);
+
+   mSilentLog = FALSE;
+   return true;
 }
 
 void SimpleBlockFile::SaveXML(XMLWriter &xmlFile)
@@ -431,6 +541,21 @@ void SimpleBlockFile::SaveXML(XMLWriter &xmlFile)
    xmlFile.EndTag(wxT("simpleblockfile"));
 }
 
+namespace {
+void AssignFileName(
+   DirManager &dm, wxFileNameWrapper &fileName, const wxString &strValue)
+{
+   // Can't use XMLValueChecker::IsGoodFileName here, but do part of its test.
+   if (XMLValueChecker::IsGoodFileString(strValue) &&
+       (strValue.length() + 1 + dm.GetProjectDataDir().length() <= PLATFORM_MAX_PATH))
+   {
+      if (!dm.AssignFile(fileName, strValue, false))
+         // Make sure fileName is back to uninitialized state so we can detect problem later.
+         fileName.Clear();
+   }
+}
+}
+
 // BuildFromXML methods should always return a BlockFile, not NULL,
 // even if the result is flawed (e.g., refers to nonexistent file),
 // as testing will be done in ProjectFSCK().
@@ -451,15 +576,8 @@ BlockFilePtr SimpleBlockFile::BuildFromXML(DirManager &dm, const wxChar **attrs)
          break;
 
       const wxString strValue = value;
-      if (!wxStricmp(attr, wxT("filename")) &&
-            // Can't use XMLValueChecker::IsGoodFileName here, but do part of its test.
-            XMLValueChecker::IsGoodFileString(strValue) &&
-            (strValue.length() + 1 + dm.GetProjectDataDir().length() <= PLATFORM_MAX_PATH))
-      {
-         if (!dm.AssignFile(fileName, strValue, false))
-            // Make sure fileName is back to uninitialized state so we can detect problem later.
-            fileName.Clear();
-      }
+      if (!wxStricmp(attr, wxT("filename")))
+         AssignFileName(dm, fileName, strValue);
       else if (!wxStrcmp(attr, wxT("len")) &&
                XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
                nValue > 0)
@@ -479,6 +597,16 @@ BlockFilePtr SimpleBlockFile::BuildFromXML(DirManager &dm, const wxChar **attrs)
       (std::move(fileName), len, min, max, rms);
 }
 
+/// static
+BlockFilePtr SimpleBlockFile::BuildFromTable(DirManager &dm,
+   const wxString &name, size_t len, float min, float max, float rms)
+{
+   wxFileNameWrapper fileName;
+   AssignFileName(dm, fileName, name);
+   return make_blockfile<SimpleBlockFile>
+      (std::move(fileName), len, min, max, rms);
+}
+
 /// Create a copy of this BlockFile, but using a different disk file.
 ///
 /// @param newFileName The name of the NEW file to use.
@@ -492,10 +620,13 @@ BlockFilePtr SimpleBlockFile::Copy(wxFileNameWrapper &&newFileName)
 
 auto SimpleBlockFile::GetSpaceUsage() const -> DiskByteCount
 {
-   if (mCache.active && mCache.needWrite)
    {
-      // We don't know space usage yet
-      return 0;
+      std::lock_guard<std::mutex> lock{ mCacheMutex };
+      if (mCache.active && mCache.needWrite)
+      {
+         // We don't know space usage yet
+         return 0;
+      }
    }
 
    // Don't know the format, so it must be read from the file
@@ -549,6 +680,8 @@ auto SimpleBlockFile::GetSpaceUsage() const -> DiskByteCount
 }
 
 void SimpleBlockFile::Recover(){
+   MappedFileCache::Get().Invalidate(mFileName.GetFullPath());
+
    wxFFile file(mFileName.GetFullPath(), wxT("wb"));
 
    if( !file.IsOpened() ){
@@ -574,23 +707,65 @@ void SimpleBlockFile::Recover(){
    for(decltype(mLen) i = 0; i < mLen * 2; i++)
       file.Write(wxT("\0"),1);
 
+   ContentsChanged();
 }
 
 void SimpleBlockFile::WriteCacheToDisk()
 {
+   WriteCache(false);
+}
+
+bool SimpleBlockFile::WriteCache(bool sync)
+{
+   std::lock_guard<std::mutex> writeLock{ mWriteMutex };
    if (!GetNeedWriteCacheToDisk())
-      return;
+      return true;
+
+   // Only a writer changes the cached data while a write is needed, so they
+   // may be written without holding mCacheMutex, and reads continue
+   if (!WriteSimpleBlockFile(mCache.sampleData.get(), mLen, mCache.format,
+                             mCache.summaryData.get(), sync))
+      return false;
+
+   ArrayOf<char> sampleData, summaryData;
+   std::lock_guard<std::mutex> lock{ mCacheMutex };
+   mCache.needWrite = false;
+   if (mCache.release) {
+      // Read from the file from now on; free the memory after unlocking
+      mCache.active = false;
+      sampleData = std::move(mCache.sampleData);
+      summaryData = std::move(mCache.summaryData);
+   }
+   return true;
+}
 
-   if (WriteSimpleBlockFile(mCache.sampleData.get(), mLen, mCache.format,
-                            mCache.summaryData.get()))
-      mCache.needWrite = false;
+size_t SimpleBlockFile::GetPendingBytes()
+{
+   std::lock_guard<std::mutex> lock{ mCacheMutex };
+   if (!(mCache.active && mCache.needWrite))
+      return 0;
+   return mLen * SAMPLE_SIZE(mCache.format);
+}
+
+bool SimpleBlockFile::WaitsForWriter()
+{
+   std::lock_guard<std::mutex> lock{ mCacheMutex };
+   // Only the files for the writer release their memory once written
+   return mCache.active && mCache.needWrite && mCache.release;
 }
 
 bool SimpleBlockFile::GetNeedWriteCacheToDisk()
 {
+   std::lock_guard<std::mutex> lock{ mCacheMutex };
    return mCache.active && mCache.needWrite;
 }
 
+bool SimpleBlockFile::GetNeedFillCache()
+{
+   std::lock_guard<std::mutex> lock{ mCacheMutex };
+   return !mCache.active;
+}
+
 bool SimpleBlockFile::GetCache()
 {
 #ifdef DEPRECATED_AUDIO_CACHE
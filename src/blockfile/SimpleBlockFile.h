@@ -13,11 +13,14 @@
 
 #include "../BlockFile.h"
 
+#include <mutex>
+
 class DirManager;
 
 struct SimpleBlockFileCache {
    bool active;
    bool needWrite;
+   bool release; // the samples, once written
    sampleFormat format;
    ArrayOf<char> sampleData, summaryData;
 
@@ -74,25 +77,48 @@ class PROFILE_DLL_API SimpleBlockFile /* not final */ : public BlockFile {
    void Recover() override;
 
    static BlockFilePtr BuildFromXML(DirManager &dm, const wxChar **attrs);
+   /// As BuildFromXML, from values already parsed, as in the block table
+   /// of a binary project file
+   static BlockFilePtr BuildFromTable(DirManager &dm,
+      const wxString &name, size_t len, float min, float max, float rms);
 
    bool GetNeedWriteCacheToDisk() override;
    void WriteCacheToDisk() override;
 
-   bool GetNeedFillCache() override { return !mCache.active; }
+   /// Write the samples held in memory, if not yet written, and release
+   /// them unless caching.  May be called on any thread.  Returns false
+   /// on failure.
+   bool WriteCache(bool sync);
+   /// Bytes of samples held in memory that are not yet written
+   size_t GetPendingBytes();
+   /// Whether the file was made to be written by the BlockWriter, rather
+   /// than held by the write cache, and is not yet written
+   bool WaitsForWriter();
+
+   bool GetNeedFillCache() override;
 
    void FillCache() /* noexcept */ override;
 
  protected:
 
    bool WriteSimpleBlockFile(samplePtr sampleData, size_t sampleLen,
-                             sampleFormat format, void* summaryData);
+                             sampleFormat format, void* summaryData,
+                             bool sync = false);
    static bool GetCache();
    void ReadIntoCache();
 
    SimpleBlockFileCache mCache;
+   // Guards mCache against release by the BlockWriter thread
+   mutable std::mutex mCacheMutex;
+   // Held for the whole of a write of the cache
+   std::mutex mWriteMutex;
 
  private:
-   mutable sampleFormat mFormat; // may be found lazily
+   bool ReadMappedData(samplePtr data, sampleFormat format,
+                       size_t start, size_t len, size_t &framesRead) const;
+
+   // may be found lazily, by GetSpaceUsage() only
+   mutable std::atomic<sampleFormat> mFormat;
 };
 
 #endif
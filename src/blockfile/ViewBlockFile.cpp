@@ -0,0 +1,250 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ViewBlockFile.cpp
+
+*******************************************************************//**
+
+\class ViewBlockFile
+\brief A run of the samples of another block, sharing its storage.
+
+Cutting, copying, pasting and deleting in the middle of a block used to
+read the samples on either side of the edit point and write them out as
+NEW blocks.  Blocks are immutable, so a part of a block can instead
+refer to the whole one, with an offset and a length.  Then an edit
+makes only metadata, and undo states that differ by edits share all
+their sample storage.
+
+A view always refers directly to a block holding samples, never to
+another view.  The viewed block stays registered with the DirManager
+under its own name, so saving, moving and copying of projects treat it
+like any other; it is written into the project file inside the tag of
+the view.
+
+The summary of a view is computed from its samples when it is made, or
+when first needed after loading a project, and kept in memory.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "ViewBlockFile.h"
+
+#include <cstring>
+
+#include "../Internat.h"
+#include "../xml/XMLTagHandler.h"
+#include "../xml/XMLWriter.h"
+
+bool ViewBlockFile::CanView(const BlockFile &file)
+{
+   return !file.IsAlias() &&
+      file.IsDataAvailable() && file.IsSummaryAvailable();
+}
+
+ViewBlockFile::ViewBlockFile(
+   const BlockFilePtr &base, size_t start, size_t len)
+   : BlockFile{ wxFileNameWrapper{}, len }
+   , mBase{ base }
+   , mStart{ start }
+{
+   if (auto pView = dynamic_cast<ViewBlockFile*>(base.get())) {
+      mBase = pView->mBase;
+      mStart += pView->mStart;
+   }
+   wxASSERT(mBase && mStart + mLen <= mBase->GetLength());
+   MakeSummary();
+}
+
+ViewBlockFile::ViewBlockFile(
+   size_t start, size_t len, float min, float max, float rms)
+   : BlockFile{ wxFileNameWrapper{}, len }
+   , mStart{ start }
+{
+   mMin = min;
+   mMax = max;
+   mRMS = rms;
+}
+
+ViewBlockFile::~ViewBlockFile()
+{
+}
+
+bool ViewBlockFile::SetBase(const BlockFilePtr &base)
+{
+   if (!base || dynamic_cast<ViewBlockFile*>(base.get()) ||
+       mLen == 0 || mStart + mLen > base->GetLength())
+      return false;
+   mBase = base;
+   return true;
+}
+
+void ViewBlockFile::MakeSummary()
+{
+   SampleBuffer buffer(mLen, floatSample);
+   ReadData(buffer.ptr(), floatSample, 0, mLen, false);
+
+   auto summary = std::make_shared< ArrayOf<char> >();
+   CalcSummary(buffer.ptr(), mLen, floatSample, *summary);
+
+   std::lock_guard<std::mutex> lock{ mSummaryMutex };
+   mSummary = summary;
+}
+
+/// This method also has the side effect of setting the mMin, mMax,
+/// and mRMS members of this class.  The returned buffer is cleanup.
+void *ViewBlockFile::CalcSummary(samplePtr buffer, size_t len,
+                                 sampleFormat format, ArrayOf<char> &cleanup)
+{
+   cleanup.reinit(mSummaryInfo.totalSummaryBytes);
+   char *localFullSummary = cleanup.get();
+
+   // No header tag, because the summary is never written to disk
+   memset(localFullSummary, 0, mSummaryInfo.offset64K);
+
+   float *summary64K = (float *)(localFullSummary + mSummaryInfo.offset64K);
+   float *summary256 = (float *)(localFullSummary + mSummaryInfo.offset256);
+
+   Floats floats;
+   float *fbuffer;
+   if (format == floatSample)
+      fbuffer = (float*)buffer;
+   else {
+      floats.reinit(len);
+      fbuffer = floats.get();
+      CopySamples(buffer, format, (samplePtr)fbuffer, floatSample, len);
+   }
+
+   BlockFile::CalcSummaryFromBuffer(fbuffer, len, summary256, summary64K);
+
+   return localFullSummary;
+}
+
+bool ViewBlockFile::ReadSummary(ArrayOf<char> &data)
+{
+   std::shared_ptr< ArrayOf<char> > summary;
+   {
+      std::lock_guard<std::mutex> lock{ mSummaryMutex };
+      summary = mSummary;
+   }
+
+   if (!summary) {
+      // First use since loading
+      MakeSummary();
+      std::lock_guard<std::mutex> lock{ mSummaryMutex };
+      summary = mSummary;
+   }
+
+   data.reinit( mSummaryInfo.totalSummaryBytes );
+   memcpy(data.get(), summary->get(), mSummaryInfo.totalSummaryBytes);
+   return true;
+}
+
+size_t ViewBlockFile::ReadData(samplePtr data, sampleFormat format,
+                               size_t start, size_t len, bool mayThrow) const
+{
+   if (!mBase) {
+      ClearSamples(data, format, 0, len);
+      return len;
+   }
+   return mBase->ReadData(data, format, mStart + start, len, mayThrow);
+}
+
+void ViewBlockFile::SaveXML(XMLWriter &xmlFile)
+// may throw
+{
+   xmlFile.StartTag(wxT("viewblockfile"));
+
+   xmlFile.WriteAttr(wxT("start"), mStart);
+   xmlFile.WriteAttr(wxT("len"), mLen);
+   xmlFile.WriteAttr(wxT("min"), mMin);
+   xmlFile.WriteAttr(wxT("max"), mMax);
+   xmlFile.WriteAttr(wxT("rms"), mRMS);
+
+   mBase->SaveXML(xmlFile);
+
+   xmlFile.EndTag(wxT("viewblockfile"));
+}
+
+// BuildFromXML methods should always return a BlockFile, not NULL,
+// even if the result is flawed (e.g., refers to nonexistent file),
+// as testing will be done in ProjectFSCK().
+/// static
+std::shared_ptr<ViewBlockFile> ViewBlockFile::BuildFromXML(const wxChar **attrs)
+{
+   float min = 0.0f, max = 0.0f, rms = 0.0f;
+   size_t start = 0, len = 0;
+   double dblValue;
+   long nValue;
+
+   while(*attrs)
+   {
+      const wxChar *attr =  *attrs++;
+      const wxChar *value = *attrs++;
+      if (!value)
+         break;
+
+      const wxString strValue = value;
+      if (!wxStrcmp(attr, wxT("start")) &&
+          XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
+          nValue >= 0)
+         start = nValue;
+      else if (!wxStrcmp(attr, wxT("len")) &&
+               XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
+               nValue > 0)
+         len = nValue;
+      else if (XMLValueChecker::IsGoodString(strValue) && Internat::CompatibleToDouble(strValue, &dblValue))
+      {  // double parameters
+         if (!wxStricmp(attr, wxT("min")))
+            min = dblValue;
+         else if (!wxStricmp(attr, wxT("max")))
+            max = dblValue;
+         else if (!wxStricmp(attr, wxT("rms")) && (dblValue >= 0.0))
+            rms = dblValue;
+      }
+   }
+
+   return make_blockfile<ViewBlockFile>(start, len, min, max, rms);
+}
+
+/// Create a copy of this BlockFile
+BlockFilePtr ViewBlockFile::Copy(wxFileNameWrapper &&)
+{
+   auto newBlockFile =
+      make_blockfile<ViewBlockFile>(mStart, mLen, mMin, mMax, mRMS);
+   newBlockFile->mBase = mBase;
+   std::lock_guard<std::mutex> lock{ mSummaryMutex };
+   newBlockFile->mSummary = mSummary;
+   return newBlockFile;
+}
+
+auto ViewBlockFile::GetSpaceUsage() const -> DiskByteCount
+{
+   return 0;
+}
+
+const BlockFile &ViewBlockFile::GetStorage() const
+{
+   return mBase ? *mBase : *this;
+}
+
+void ViewBlockFile::Lock()
+{
+   BlockFile::Lock();
+   if (mBase)
+      mBase->Lock();
+}
+
+void ViewBlockFile::Unlock()
+{
+   BlockFile::Unlock();
+   if (mBase)
+      mBase->Unlock();
+}
+
+void ViewBlockFile::CloseLock()
+{
+   BlockFile::Lock();
+   if (mBase)
+      mBase->CloseLock();
+}
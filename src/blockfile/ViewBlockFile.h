@@ -0,0 +1,87 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ViewBlockFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_VIEW_BLOCKFILE__
+#define __AUDACITY_VIEW_BLOCKFILE__
+
+#include "../BlockFile.h"
+
+#include <mutex>
+
+/// A BlockFile that is a run of the samples of another, and shares its
+/// storage, so that splitting a block at an edit writes no samples.  It has
+/// no file of its own, and keeps its summary in memory.
+class ViewBlockFile final : public BlockFile {
+ public:
+
+   /// Whether views of the block may be made.  Its data must be available,
+   /// and not in another audio file, so that dependencies stay visible.
+   static bool CanView(const BlockFile &file);
+
+   // Constructor / Destructor
+
+   /// View len samples of base from start.  If base is itself a view, view
+   /// what it views instead.  Reads the samples, to make the summary.
+   ViewBlockFile(const BlockFilePtr &base, size_t start, size_t len);
+
+   /// Create the memory structure for a view read from the project file,
+   /// to be completed by SetBase()
+   ViewBlockFile(size_t start, size_t len, float min, float max, float rms);
+
+   virtual ~ViewBlockFile();
+
+   const BlockFilePtr &GetBase() const { return mBase; }
+   size_t GetStart() const { return mStart; }
+
+   /// Complete the loading of the view.  Returns false if base does not
+   /// contain the samples to view.
+   bool SetBase(const BlockFilePtr &base);
+
+   // Reading
+
+   /// Make the summary from the samples when first needed
+   bool ReadSummary(ArrayOf<char> &data) override;
+   /// Read the samples from the base
+   size_t ReadData(samplePtr data, sampleFormat format,
+                        size_t start, size_t len, bool mayThrow) const override;
+
+   /// Create a NEW view of the same samples
+   BlockFilePtr Copy(wxFileNameWrapper &&newFileName) override;
+   /// Write an XML representation of this view, enclosing that of the base
+   void SaveXML(XMLWriter &xmlFile) override;
+   /// The base is counted instead, once however many views it has
+   DiskByteCount GetSpaceUsage() const override;
+   const BlockFile &GetStorage() const override;
+   void Recover() override { };
+
+   /// The base file must not be moved or deleted while a view is locked
+   void Lock() override;
+   void Unlock() override;
+   void CloseLock() override;
+
+   /// The base is given later, by the enclosed tag
+   static std::shared_ptr<ViewBlockFile> BuildFromXML(const wxChar **attrs);
+
+ protected:
+   /// A thread-safe version of BlockFile::CalcSummary
+   void *CalcSummary(samplePtr buffer, size_t len,
+                     sampleFormat format, ArrayOf<char> &cleanup) override;
+
+ private:
+   // Make the summary, and the minimum, maximum and RMS, from the samples
+   void MakeSummary();
+
+   BlockFilePtr mBase;
+   size_t mStart;
+
+   std::mutex mSummaryMutex;
+   // Shared by copies; null until needed, for views loaded from a project
+   std::shared_ptr< ArrayOf<char> > mSummary;
+};
+
+#endif
@@ -17,6 +17,7 @@ This class now lists
 - Clips
 - Labels
 - Boxes
+- Sample cache statistics
 
 *//*******************************************************************/
 
@@ -36,6 +37,7 @@ This class now lists
 #include "../WaveTrack.h"
 #include "../LabelTrack.h"
 #include "../Envelope.h"
+#include "../SampleBlockCache.h"
 
 #include "SelectCommand.h"
 #include "../ShuttleGui.h"
@@ -64,6 +66,7 @@ enum {
    kEnvelopes,
    kLabels,
    kBoxes,
+   kSampleCache,
    nTypes
 };
 
@@ -78,6 +81,7 @@ static const EnumValueSymbol kTypes[nTypes] =
    { XO("Envelopes") },
    { XO("Labels") },
    { XO("Boxes") },
+   { wxT("SampleCache"), XO("Sample Cache") },
 };
 
 enum {
@@ -158,6 +162,7 @@ bool GetInfoCommand::ApplyInner(const CommandContext &context)
       case kEnvelopes    : return SendEnvelopes( context );
       case kLabels       : return SendLabels( context );
       case kBoxes        : return SendBoxes( context );
+      case kSampleCache  : return SendSampleCache( context );
       default:
          context.Status( "Command options not recognised" );
    }
@@ -606,6 +611,21 @@ bool GetInfoCommand::SendLabels(const CommandContext &context)
    return true;
 }
 
+bool GetInfoCommand::SendSampleCache(const CommandContext &context)
+{
+   const auto stats = SampleBlockCache::Get().GetStatistics();
+   context.StartStruct();
+   context.AddItem( (double)stats.hits, "hits" );
+   context.AddItem( (double)stats.misses, "misses" );
+   context.AddItem( (double)stats.evictions, "evictions" );
+   context.AddItem( (double)stats.entries, "blocks" );
+   context.AddItem( (double)stats.bytes, "bytes" );
+   context.AddItem( (double)stats.budget, "budget" );
+   context.EndStruct();
+
+   return true;
+}
+
 /*******************************************************************
 The various Explore functions are called from the Send functions,
 and may be recursive.  'Send' is the top level.
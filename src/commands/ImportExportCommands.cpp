@@ -10,7 +10,8 @@
 ******************************************************************//**
 
 \file ImportExportCommands.cpp
-\brief Contains definitions for the ImportCommand and ExportCommand classes
+\brief Contains definitions for the ImportCommand, ExportCommand and
+ExportMultipleCommand classes
 
 *//*******************************************************************/
 
@@ -18,9 +19,14 @@
 #include "ImportExportCommands.h"
 
 #include "LoadCommands.h"
+#include "../LabelTrack.h"
+#include "../Prefs.h"
 #include "../ProjectFileManager.h"
+#include "../Tags.h"
 #include "../ViewInfo.h"
+#include "../WaveTrack.h"
 #include "../export/Export.h"
+#include "../export/ExportMultiple.h"
 #include "../Shuttle.h"
 #include "../ShuttleGui.h"
 #include "../wxFileNameWrapper.h"
@@ -111,3 +117,147 @@ bool ExportCommand::Apply(const CommandContext & context)
    return false;
 }
 
+const ComponentInterfaceSymbol ExportMultipleCommand::Symbol
+{ XO("ExportMultiple2") };
+
+namespace{ BuiltinCommandsModule::Registration< ExportMultipleCommand > reg3; }
+
+bool ExportMultipleCommand::DefineParams( ShuttleParams & S ){
+   wxFileName fn = FileNames::DefaultToDocumentsFolder(wxT("/Export/Path"));
+   S.Define( mFolder, wxT("Folder"), fn.GetPath() );
+   S.Define( mFormat, wxT("Format"), wxT("WAV") );
+   S.Define( mbByTracks, wxT("ByTracks"), false );
+   S.Define( mbByName, wxT("ByName"), true );
+   S.Define( mPrefix, wxT("Prefix"), wxT("") );
+   S.Define( mbOverwrite, wxT("Overwrite"), false );
+   return true;
+}
+
+void ExportMultipleCommand::PopulateOrExchange(ShuttleGui & S)
+{
+   S.AddSpace(0, 5);
+
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      S.TieTextBox(XO("Folder:"),mFolder);
+      S.TieTextBox(XO("Format:"),mFormat);
+      S.TieTextBox(XO("File Name Prefix:"),mPrefix);
+   }
+   S.EndMultiColumn();
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      S.TieCheckBox(XO("Split by Tracks"), mbByTracks );
+      S.TieCheckBox(XO("Name by Label/Track"), mbByName );
+      S.TieCheckBox(XO("Overwrite existing files"), mbOverwrite );
+   }
+   S.EndMultiColumn();
+}
+
+bool ExportMultipleCommand::Apply(const CommandContext & context)
+{
+   auto &project = context.project;
+   auto &tracks = TrackList::Get( project );
+
+   // Find the format, as Exporter::Process() does
+   Exporter exporter{ project };
+   ExportPlugin *plugin = nullptr;
+   int subformat = 0;
+   for (const auto &pPlugin : exporter.GetPlugins()) {
+      for (int j = 0; !plugin && j < pPlugin->GetFormatCount(); j++) {
+         if (pPlugin->GetFormat(j).IsSameAs(mFormat, false)) {
+            plugin = pPlugin.get();
+            subformat = j;
+         }
+      }
+   }
+   if (!plugin) {
+      context.Error(wxString::Format(wxT("Unknown export format %s!"), mFormat));
+      return false;
+   }
+
+   if (!wxFileName::DirExists(mFolder) &&
+       !wxFileName::Mkdir(mFolder, 0777, wxPATH_MKDIR_FULL)) {
+      context.Error(wxString::Format(wxT("Could not create folder %s!"), mFolder));
+      return false;
+   }
+
+   // Name the files as the dialog does, but change illegal characters
+   // instead of asking
+   std::vector<ExportMultipleItem> items;
+   FilePaths otherNames;
+   ExportMultipleItem item;
+   item.destfile.AssignDir(mFolder);
+   item.destfile.SetExt(plugin->GetExtension(subformat));
+   auto addItem = [&](wxString title, int number) {
+      if (title.empty())
+         title = _("untitled");
+      wxString name = mbByName
+         ? title
+         : wxString::Format(wxT("%s-%02d"), mPrefix, number);
+      Internat::SanitiseFilename(name, wxT("_"));
+      item.destfile.SetName(name);
+      FileNames::MakeNameUnique(otherNames, item.destfile);
+
+      item.filetags = Tags::Get( project );
+      item.filetags.LoadDefaults();
+      item.filetags.SetTag(TAG_TITLE, title);
+      item.filetags.SetTag(TAG_TRACK, number);
+      items.push_back(item);
+   };
+
+   if (mbByTracks) {
+      bool anySolo = !(( tracks.Any<const WaveTrack>() + &WaveTrack::GetSolo ).empty());
+      bool skipSilenceAtBeginning;
+      gPrefs->Read(wxT("/AudioFiles/SkipSilenceAtBeginning"), &skipSilenceAtBeginning, false);
+
+      int number = 0;
+      for (auto tr : tracks.Leaders<WaveTrack>() -
+         (anySolo ? &WaveTrack::GetNotSolo : &WaveTrack::GetMute)) {
+         auto channels = TrackList::Channels(tr);
+         item.t0 = skipSilenceAtBeginning ? channels.min(&Track::GetStartTime) : 0;
+         item.t1 = channels.max( &Track::GetEndTime );
+         item.channels = channels.size();
+         if (item.channels == 1 &&
+             !(tr->GetChannel() == WaveTrack::MonoChannel &&
+                     tr->GetPan() == 0.0))
+            item.channels = 2;
+         item.track = tr;
+         addItem(tr->GetName(), ++number);
+      }
+   }
+   else {
+      auto labels = *tracks.Any< const LabelTrack >().begin();
+      if (!labels) {
+         context.Error(wxT("There is no label track to split by!"));
+         return false;
+      }
+      item.channels = GetNumExportChannels( tracks );
+      const int numLabels = labels->GetNumLabels();
+      for (int l = 0; l < numLabels; ++l) {
+         const auto info = labels->GetLabel(l);
+         item.t0 = info->selectedRegion.t0();
+         if (!info->selectedRegion.isPoint())
+            item.t1 = info->selectedRegion.t1();
+         else if (l < numLabels - 1)
+            // Use start of next label as end
+            item.t1 = labels->GetLabel(l + 1)->selectedRegion.t0();
+         else
+            item.t1 = tracks.GetEndTime();
+         addItem(info->title, l + 1);
+      }
+   }
+
+   FilePaths exported;
+   auto result = ExportMultipleFiles(project, *plugin, subformat, items,
+      mbOverwrite, exported, false);
+   for (const auto &path : exported)
+      context.Status(wxString::Format(wxT("Exported to %s format: %s"),
+         mFormat, path));
+
+   if (result == ProgressResult::Success ||
+       result == ProgressResult::Stopped)
+      return true;
+
+   context.Error(wxString::Format(wxT("Could not export to %s format!"), mFormat));
+   return false;
+}
@@ -16,6 +16,9 @@
 \class ExportCommand
 \brief Command for exporting audio
 
+\class ExportMultipleCommand
+\brief Command for exporting labeled regions or tracks to separate files
+
 *//*******************************************************************/
 
 #include "Command.h"
@@ -59,3 +62,26 @@ public:
    wxString mFileName;
    int mnChannels;
 };
+
+class ExportMultipleCommand : public AudacityCommand
+{
+public:
+   static const ComponentInterfaceSymbol Symbol;
+
+   // ComponentInterface overrides
+   ComponentInterfaceSymbol GetSymbol() override {return Symbol;};
+   TranslatableString GetDescription() override {return XO("Exports labeled regions or tracks to separate files.");};
+   bool DefineParams( ShuttleParams & S ) override;
+   void PopulateOrExchange(ShuttleGui & S) override;
+   bool Apply(const CommandContext & context) override;
+
+   // AudacityCommand overrides
+   wxString ManualPage() override {return wxT("Extra_Menu:_Scriptables_II#export_multiple");};
+public:
+   wxString mFolder;
+   wxString mFormat;
+   bool mbByTracks;
+   bool mbByName;
+   wxString mPrefix;
+   bool mbOverwrite;
+};
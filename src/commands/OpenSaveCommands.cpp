@@ -10,7 +10,8 @@
 ******************************************************************//**
 
 \file OpenSaveCommands.cpp
-\brief Contains definitions for the OpenProjectCommand and SaveProjectCommand classes
+\brief Contains definitions for the OpenProjectCommand, SaveProjectCommand
+and ConvertProjectCommand classes
 
 *//*******************************************************************/
 
@@ -22,6 +23,7 @@
 #include "../ProjectFileManager.h"
 #include "../ProjectManager.h"
 #include "../export/Export.h"
+#include "../xml/XMLBinary.h"
 #include "../Shuttle.h"
 #include "../ShuttleGui.h"
 #include "CommandContext.h"
@@ -105,3 +107,44 @@ bool SaveProjectCommand::Apply(const CommandContext &context)
       return projectFileManager.SaveAs(
          mFileName, mbCompress, mbAddToHistory);
 }
+
+const ComponentInterfaceSymbol ConvertProjectCommand::Symbol
+{ XO("Convert Project2") };
+
+namespace{ BuiltinCommandsModule::Registration< ConvertProjectCommand > reg3; }
+
+bool ConvertProjectCommand::DefineParams( ShuttleParams & S ){
+   S.Define( mFileName, wxT("Filename"),  "name.aup" );
+   S.Define( mOutputName, wxT("Output"),  "converted.aup" );
+   return true;
+}
+
+void ConvertProjectCommand::PopulateOrExchange(ShuttleGui & S)
+{
+   S.AddSpace(0, 5);
+
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      S.TieTextBox(XO("File Name:"),mFileName);
+      S.TieTextBox(XO("Output File Name:"),mOutputName);
+   }
+   S.EndMultiColumn();
+}
+
+bool ConvertProjectCommand::Apply(const CommandContext &context)
+{
+   // The project file only; its _data directory serves either form
+   if ( mFileName.empty() || mOutputName.empty() ||
+        mFileName == mOutputName ) {
+      context.Error( wxT("Input and output file names must differ!") );
+      return false;
+   }
+
+   XMLBinaryReader reader;
+   const bool result = XMLBinaryReader::IsBinary(mFileName)
+      ? reader.ConvertToXML(mFileName, mOutputName)
+      : reader.ConvertFromXML(mFileName, mOutputName);
+   if (!result)
+      context.Error( reader.GetErrorStr().Translation() );
+   return result;
+}
@@ -16,6 +16,10 @@
 \class SaveProjectCommand
 \brief Command for saving an Audacity project
 
+\class ConvertProjectCommand
+\brief Command for rewriting a project file between its XML and binary
+forms
+
 *//*******************************************************************/
 
 #include "Command.h"
@@ -62,3 +66,22 @@ public:
    bool bHasAddToHistory;
    bool bHasCompress;
 };
+
+class ConvertProjectCommand : public AudacityCommand
+{
+public:
+   static const ComponentInterfaceSymbol Symbol;
+
+   // ComponentInterface overrides
+   ComponentInterfaceSymbol GetSymbol() override {return Symbol;};
+   TranslatableString GetDescription() override {return XO("Rewrites a binary project file as XML, or an XML one as binary.");};
+   bool DefineParams( ShuttleParams & S ) override;
+   void PopulateOrExchange(ShuttleGui & S) override;
+   bool Apply(const CommandContext & context) override;
+
+   // AudacityCommand overrides
+   wxString ManualPage() override {return wxT("Extra_Menu:_Scriptables_II#convert_project");};
+public:
+   wxString mFileName;
+   wxString mOutputName;
+};
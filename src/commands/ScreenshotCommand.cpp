@@ -604,6 +604,7 @@ void ScreenshotCommand::CaptureScriptables(
       "Export2",
       "OpenProject2",
       "SaveProject2",
+      "ConvertProject2",
       "Drag",
       "CompareAudio",
       "Screenshot",
@@ -24,9 +24,16 @@ code out of ModuleManager.
 #include "CommandTargets.h"
 #include "CommandBuilder.h"
 #include "AppCommandEvent.h"
+#include "../CommonCommandFlags.h"
 #include "../Project.h"
+#include "../ProjectHistory.h"
+#include "../ProjectWindow.h"
+#include "../WaveTrack.h"
 #include <wx/app.h>
 #include <wx/string.h>
+#include <algorithm>
+#include <functional>
+#include <future>
 #include <thread>
 
 /// This is the function which actually obeys one command.
@@ -89,6 +96,154 @@ void ScriptCommandRelay::StartScriptServer(tpRegScriptServerFunc scriptFn)
    std::thread(server, scriptFn).detach();
 }
 
+namespace {
+
+/// Runs the function on the main thread, and waits for it.  Exceptions are
+/// caught, and give false.
+bool CallOnMain(const std::function< bool() > &function)
+{
+   std::promise<bool> promise;
+   auto future = promise.get_future();
+   wxTheApp->CallAfter( [&] {
+      bool result = false;
+      try {
+         result = function();
+      }
+      catch (...) {
+      }
+      promise.set_value(result);
+   } );
+   return future.get();
+}
+
+/// Find the wave channel, counting all channels as SetTrackBase does
+WaveTrack *FindWaveChannel(int index)
+{
+   auto project = ::GetActiveProject();
+   if (!project || index < 0)
+      return nullptr;
+
+   int j = 0;
+   for (auto t : TrackList::Get( *project ).Leaders())
+      for (auto channel : TrackList::Channels(t))
+         if (j++ == index)
+            return track_cast<WaveTrack*>(channel);
+   return nullptr;
+}
+
+bool GetChannelInfo(int channel, long long *pLength, double *pRate)
+{
+   return CallOnMain( [&] {
+      auto track = FindWaveChannel(channel);
+      if (!track)
+         return false;
+      *pLength =
+         track->TimeToLongSamples(track->GetEndTime()).as_long_long();
+      *pRate = track->GetRate();
+      return true;
+   } );
+}
+
+bool ReadSamples(int channel, long long start, long long len,
+   size_t maxLen, ScriptServerFunctions::SampleSink sink, void *context)
+{
+   // Copy the channel on the main thread, once for the whole request.
+   // That copies only the lists of blocks, which are immutable, so the
+   // samples can be read here, without holding up the main thread.
+   std::shared_ptr<const WaveTrack> copy;
+   CallOnMain( [&] {
+      if (auto track = FindWaveChannel(channel))
+         copy = std::static_pointer_cast<const WaveTrack>(track->Duplicate());
+      return true;
+   } );
+   if (!copy || start < 0 || len < 0 || maxLen == 0)
+      return false;
+
+   try {
+      Floats buffer{ (size_t)std::min<long long>(len, maxLen) };
+      while (len > 0) {
+         const auto n = (size_t)std::min<long long>(len, maxLen);
+         if (!copy->Get(
+               (samplePtr)buffer.get(), floatSample, start, n, fillZero, true))
+            return false;
+         if (!sink(context, buffer.get(), n))
+            return false;
+         start += n;
+         len -= n;
+      }
+      return true;
+   }
+   catch (...) {
+      return false;
+   }
+}
+
+bool WriteSamples(
+   int channel, long long start, size_t len, const float *buffer)
+{
+   if (start < 0)
+      return false;
+   return CallOnMain( [&] {
+      auto project = ::GetActiveProject();
+      // Don't change tracks while they play or record, as commands that
+      // require AudioIONotBusyFlag() don't
+      if (!project || AudioIOBusyPred( *project ))
+         return false;
+      auto track = FindWaveChannel(channel);
+      if (!track)
+         return false;
+      if (len == 0)
+         return true;
+
+      // Samples are written only within clips
+      const auto end = start + (long long)len;
+      const auto &clips = track->GetClips();
+      if (std::none_of(clips.begin(), clips.end(),
+            [&](const WaveClipHolder &clip){
+               return clip->GetEndSample() > start &&
+                  clip->GetStartSample() < end; }))
+         return false;
+
+      // Set() gives only the weak guarantee
+      auto &history = ProjectHistory::Get( *project );
+      bool committed = false;
+      auto cleanup = finally( [&] {
+         if (!committed)
+            history.RollbackState();
+      } );
+      track->Set((samplePtr)buffer, floatSample, start, len);
+      history.PushState(
+         XO("Script wrote samples"), XO("Write Samples"));
+      committed = true;
+
+      ProjectWindow::Get( *project ).RedrawProject();
+      return true;
+   } );
+}
+
+const ScriptServerFunctions BinaryServerFunctions{
+   ExecFromWorker, GetChannelInfo, ReadSamples, WriteSamples
+};
+
+}
+
+/// Starts the binary script server
+void ScriptCommandRelay::StartBinaryScriptServer(
+   tpRegBinaryScriptServerFunc scriptFn)
+{
+   wxASSERT(scriptFn != NULL);
+
+   auto server = [](tpRegBinaryScriptServerFunc function)
+   {
+      while (true)
+      {
+         function(&BinaryServerFunctions);
+      }
+   };
+
+   std::thread(server, scriptFn).detach();
+}
+
 // The void * return is actually a Lisp LVAL and will be cast to such as needed.
 extern void * ExecForLisp( char * pIn );
 extern void * nyq_make_opaque_string( int size, unsigned char *src );
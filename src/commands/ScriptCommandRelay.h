@@ -25,10 +25,35 @@ class wxString;
 typedef int(*tpExecScriptServerFunc)(wxString * pIn, wxString * pOut);
 typedef int(*tpRegScriptServerFunc)(tpExecScriptServerFunc pFn);
 
+/// What Audacity gives to a module that serves scripts in binary: the
+/// command function, and direct access to the samples of wave channels.
+/// Channels are numbered as by the "Channel" parameter of the Set Track
+/// commands.  The sample functions return false if there is no such wave
+/// channel, or reading or writing fails.  They may be called from any thread
+/// but the main one.
+///
+/// readSamples takes one snapshot of the channel, then gives the samples
+/// from it to the sink, in pieces of at most maxLen, until the sink returns
+/// false.
+struct ScriptServerFunctions
+{
+   using SampleSink =
+      bool (*)(void *context, const float *buffer, size_t len);
+
+   tpExecScriptServerFunc execCommand;
+   bool (*getChannelInfo)(int channel, long long *pLength, double *pRate);
+   bool (*readSamples)(int channel, long long start, long long len,
+      size_t maxLen, SampleSink sink, void *context);
+   bool (*writeSamples)(
+      int channel, long long start, size_t len, const float *buffer);
+};
+typedef int(*tpRegBinaryScriptServerFunc)(const ScriptServerFunctions *pFns);
+
 class ScriptCommandRelay
 {
 public:
    static void StartScriptServer(tpRegScriptServerFunc scriptFn);
+   static void StartBinaryScriptServer(tpRegBinaryScriptServerFunc scriptFn);
 };
 
 #endif /* End of include guard: __SCRIPT_COMMAND_RELAY__ */
@@ -184,6 +184,11 @@ bool EffectAmplify::LoadFactoryDefaults()
 
 // Effect implementation
 
+std::unique_ptr<Effect> EffectAmplify::NewTrackWorker()
+{
+   return std::make_unique<EffectAmplify>();
+}
+
 bool EffectAmplify::Init()
 {
    mPeak = 0.0;
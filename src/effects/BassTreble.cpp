@@ -221,6 +221,11 @@ bool EffectBassTreble::CheckWhetherSkipEffect()
 
 // Effect implementation
 
+std::unique_ptr<Effect> EffectBassTreble::NewTrackWorker()
+{
+   return std::make_unique<EffectBassTreble>();
+}
+
 void EffectBassTreble::PopulateOrExchange(ShuttleGui & S)
 {
    S.SetBorder(5);
@@ -72,6 +72,7 @@ public:
 
    // Effect Implementation
 
+   std::unique_ptr<Effect> NewTrackWorker() override;
    void PopulateOrExchange(ShuttleGui & S) override;
    bool TransferDataToWindow() override;
    bool TransferDataFromWindow() override;
@@ -10,29 +10,68 @@ Max Maisel
 
 #include "EBUR128.h"
 
-EBUR128::EBUR128(double rate, size_t channels)
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EBUR128_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Interpolation filter for true peak measurement, from ITU-R BS.1770-4,
+// Annex 2: four phases for 4 times oversampling
+const float PeakFilter[4][12] = {
+   {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,
+      0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+      0.9721679687500f, -0.1022949218750f,  0.0476074218750f,
+     -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+   { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,
+      0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+      0.7797851562500f, -0.2003173828125f,  0.1015625000000f,
+     -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+   { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,
+      0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+      0.4650878906250f, -0.1665039062500f,  0.0891113281250f,
+     -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+   { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,
+      0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+      0.1373291015625f, -0.0594482421875f,  0.0332031250000f,
+     -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+};
+}
+
+EBUR128::EBUR128(double rate, size_t channels, bool truePeak)
    : mChannelCount(channels)
    , mRate(rate)
+   , mMeasureTruePeak(truePeak)
 {
-   mBlockSize = ceil(0.4 * mRate); // 400 ms blocks
-   mBlockOverlap = ceil(0.1 * mRate); // 100 ms overlap
+   mHopSize = ceil(0.1 * mRate); // 100 ms steps of 400 ms blocks
    mLoudnessHist.reinit(HIST_BIN_COUNT, false);
-   mBlockRingBuffer.reinit(mBlockSize);
+   mSquares.reinit(CHUNK_SIZE);
    mWeightingFilter.reinit(mChannelCount, false);
    for(size_t channel = 0; channel < mChannelCount; ++channel)
       mWeightingFilter[channel] = CalcWeightingFilter(mRate);
+   if(mMeasureTruePeak)
+      mPeakHistory.reinit(mChannelCount, PEAK_TAPS - 1 + CHUNK_SIZE);
 }
 
 void EBUR128::Initialize()
 {
-   mSampleCount = 0;
-   mBlockRingPos = 0;
-   mBlockRingSize = 0;
+   mHopCount = 0;
+   mHopSum = 0;
+   mHopPos = 0;
+   mMomentary = 0;
+   mSampleSquare = 0;
+   mTruePeak = 0;
    memset(mLoudnessHist.get(), 0, HIST_BIN_COUNT*sizeof(long int));
    for(size_t channel = 0; channel < mChannelCount; ++channel)
    {
       mWeightingFilter[channel][0].Reset();
       mWeightingFilter[channel][1].Reset();
+      if(mMeasureTruePeak)
+         std::fill(mPeakHistory[channel].get(),
+                   mPeakHistory[channel].get() + PEAK_TAPS - 1, 0.0f);
    }
 }
 
@@ -85,36 +124,225 @@ ArrayOf<Biquad> EBUR128::CalcWeightingFilter(double fs)
    return std::move(pBiquad);
 }
 
-void EBUR128::ProcessSampleFromChannel(float x_in, size_t channel)
+void EBUR128::ProcessSamples(const float *const *buffers, size_t len)
 {
-   double value;
-   value = mWeightingFilter[channel][0].ProcessOne(x_in);
-   value = mWeightingFilter[channel][1].ProcessOne(value);
-   if(channel == 0)
-      mBlockRingBuffer[mBlockRingPos] = value * value;
-   else
+   for(size_t pos = 0; pos < len; pos += CHUNK_SIZE)
    {
+      const auto chunk = std::min(CHUNK_SIZE, len - pos);
+      size_t channel = 0;
       // Add the power of additional channels to the power of first channel.
       // As a result, stereo tracks appear about 3 LUFS louder, as specified.
-      mBlockRingBuffer[mBlockRingPos] += value * value;
+      for(; channel + 2 <= mChannelCount; channel += 2)
+         WeightChannelPair(channel,
+            buffers[channel] + pos, buffers[channel + 1] + pos, chunk,
+            mSquares.get(), channel == 0);
+      if(channel < mChannelCount)
+         WeightChannel(channel, buffers[channel] + pos, chunk,
+            mSquares.get(), channel == 0);
+      AddSquares(mSquares.get(), chunk);
+
+      if(mMeasureTruePeak)
+         for(channel = 0; channel < mChannelCount; ++channel)
+            FindTruePeak(channel, buffers[channel] + pos, chunk);
    }
 }
 
+void EBUR128::ProcessSampleFromChannel(float x_in, size_t channel)
+{
+   WeightChannel(channel, &x_in, 1, &mSampleSquare, channel == 0);
+   if(mMeasureTruePeak)
+      FindTruePeak(channel, &x_in, 1);
+}
+
 void EBUR128::NextSample()
 {
-   ++mBlockRingPos;
-   ++mBlockRingSize;
+   AddSquares(&mSampleSquare, 1);
+}
 
-   if(mBlockRingPos % mBlockOverlap == 0)
+// The two stages of the filter are computed in double precision, like
+// Biquad::ProcessOne(), but without rounding between them.
+void EBUR128::WeightChannel(
+   size_t channel, const float *in, size_t len, double *squares, bool first)
+{
+   auto &hsf = mWeightingFilter[channel][0];
+   auto &hpf = mWeightingFilter[channel][1];
+   const double b0 = hsf.fNumerCoeffs[Biquad::B0];
+   const double b1 = hsf.fNumerCoeffs[Biquad::B1];
+   const double b2 = hsf.fNumerCoeffs[Biquad::B2];
+   const double a1 = hsf.fDenomCoeffs[Biquad::A1];
+   const double a2 = hsf.fDenomCoeffs[Biquad::A2];
+   const double c0 = hpf.fNumerCoeffs[Biquad::B0];
+   const double c1 = hpf.fNumerCoeffs[Biquad::B1];
+   const double c2 = hpf.fNumerCoeffs[Biquad::B2];
+   const double d1 = hpf.fDenomCoeffs[Biquad::A1];
+   const double d2 = hpf.fDenomCoeffs[Biquad::A2];
+
+   double x1 = hsf.fPrevIn, x2 = hsf.fPrevPrevIn;
+   double y1 = hsf.fPrevOut, y2 = hsf.fPrevPrevOut;
+   double u1 = hpf.fPrevIn, u2 = hpf.fPrevPrevIn;
+   double z1 = hpf.fPrevOut, z2 = hpf.fPrevPrevOut;
+
+   for(size_t i = 0; i < len; ++i)
+   {
+      const double x = in[i];
+      const double y = x * b0 + x1 * b1 + x2 * b2 - y1 * a1 - y2 * a2;
+      const double z = y * c0 + u1 * c1 + u2 * c2 - z1 * d1 - z2 * d2;
+      x2 = x1; x1 = x; y2 = y1; y1 = y;
+      u2 = u1; u1 = y; z2 = z1; z1 = z;
+      if(first)
+         squares[i] = z * z;
+      else
+         squares[i] += z * z;
+   }
+
+   hsf.fPrevIn = x1; hsf.fPrevPrevIn = x2;
+   hsf.fPrevOut = y1; hsf.fPrevPrevOut = y2;
+   hpf.fPrevIn = u1; hpf.fPrevPrevIn = u2;
+   hpf.fPrevOut = z1; hpf.fPrevPrevOut = z2;
+}
+
+void EBUR128::WeightChannelPair(size_t channel,
+   const float *in0, const float *in1, size_t len, double *squares,
+   bool first)
+{
+#ifdef EBUR128_USE_SSE2
+   // Each lane of the vectors is one channel.  All channels have the same
+   // coefficients.
+   auto &hsf0 = mWeightingFilter[channel][0];
+   auto &hpf0 = mWeightingFilter[channel][1];
+   auto &hsf1 = mWeightingFilter[channel + 1][0];
+   auto &hpf1 = mWeightingFilter[channel + 1][1];
+   const __m128d b0 = _mm_set1_pd(hsf0.fNumerCoeffs[Biquad::B0]);
+   const __m128d b1 = _mm_set1_pd(hsf0.fNumerCoeffs[Biquad::B1]);
+   const __m128d b2 = _mm_set1_pd(hsf0.fNumerCoeffs[Biquad::B2]);
+   const __m128d a1 = _mm_set1_pd(hsf0.fDenomCoeffs[Biquad::A1]);
+   const __m128d a2 = _mm_set1_pd(hsf0.fDenomCoeffs[Biquad::A2]);
+   const __m128d c0 = _mm_set1_pd(hpf0.fNumerCoeffs[Biquad::B0]);
+   const __m128d c1 = _mm_set1_pd(hpf0.fNumerCoeffs[Biquad::B1]);
+   const __m128d c2 = _mm_set1_pd(hpf0.fNumerCoeffs[Biquad::B2]);
+   const __m128d d1 = _mm_set1_pd(hpf0.fDenomCoeffs[Biquad::A1]);
+   const __m128d d2 = _mm_set1_pd(hpf0.fDenomCoeffs[Biquad::A2]);
+
+   __m128d x1 = _mm_setr_pd(hsf0.fPrevIn, hsf1.fPrevIn);
+   __m128d x2 = _mm_setr_pd(hsf0.fPrevPrevIn, hsf1.fPrevPrevIn);
+   __m128d y1 = _mm_setr_pd(hsf0.fPrevOut, hsf1.fPrevOut);
+   __m128d y2 = _mm_setr_pd(hsf0.fPrevPrevOut, hsf1.fPrevPrevOut);
+   __m128d u1 = _mm_setr_pd(hpf0.fPrevIn, hpf1.fPrevIn);
+   __m128d u2 = _mm_setr_pd(hpf0.fPrevPrevIn, hpf1.fPrevPrevIn);
+   __m128d z1 = _mm_setr_pd(hpf0.fPrevOut, hpf1.fPrevOut);
+   __m128d z2 = _mm_setr_pd(hpf0.fPrevPrevOut, hpf1.fPrevPrevOut);
+
+   for(size_t i = 0; i < len; ++i)
+   {
+      const __m128d x = _mm_setr_pd(in0[i], in1[i]);
+      const __m128d y = _mm_sub_pd(
+         _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, b0), _mm_mul_pd(x1, b1)),
+                    _mm_mul_pd(x2, b2)),
+         _mm_add_pd(_mm_mul_pd(y1, a1), _mm_mul_pd(y2, a2)));
+      const __m128d z = _mm_sub_pd(
+         _mm_add_pd(_mm_add_pd(_mm_mul_pd(y, c0), _mm_mul_pd(u1, c1)),
+                    _mm_mul_pd(u2, c2)),
+         _mm_add_pd(_mm_mul_pd(z1, d1), _mm_mul_pd(z2, d2)));
+      x2 = x1; x1 = x; y2 = y1; y1 = y;
+      u2 = u1; u1 = y; z2 = z1; z1 = z;
+
+      const __m128d zz = _mm_mul_pd(z, z);
+      const double sum =
+         _mm_cvtsd_f64(zz) + _mm_cvtsd_f64(_mm_unpackhi_pd(zz, zz));
+      if(first)
+         squares[i] = sum;
+      else
+         squares[i] += sum;
+   }
+
+   double lanes[2];
+   _mm_storeu_pd(lanes, x1); hsf0.fPrevIn = lanes[0]; hsf1.fPrevIn = lanes[1];
+   _mm_storeu_pd(lanes, x2); hsf0.fPrevPrevIn = lanes[0]; hsf1.fPrevPrevIn = lanes[1];
+   _mm_storeu_pd(lanes, y1); hsf0.fPrevOut = lanes[0]; hsf1.fPrevOut = lanes[1];
+   _mm_storeu_pd(lanes, y2); hsf0.fPrevPrevOut = lanes[0]; hsf1.fPrevPrevOut = lanes[1];
+   _mm_storeu_pd(lanes, u1); hpf0.fPrevIn = lanes[0]; hpf1.fPrevIn = lanes[1];
+   _mm_storeu_pd(lanes, u2); hpf0.fPrevPrevIn = lanes[0]; hpf1.fPrevPrevIn = lanes[1];
+   _mm_storeu_pd(lanes, z1); hpf0.fPrevOut = lanes[0]; hpf1.fPrevOut = lanes[1];
+   _mm_storeu_pd(lanes, z2); hpf0.fPrevPrevOut = lanes[0]; hpf1.fPrevPrevOut = lanes[1];
+#else
+   WeightChannel(channel, in0, len, squares, first);
+   WeightChannel(channel + 1, in1, len, squares, false);
+#endif
+}
+
+void EBUR128::FindTruePeak(size_t channel, const float *in, size_t len)
+{
+   // The history and the new samples, contiguous
+   float *const buffer = mPeakHistory[channel].get();
+   std::copy(in, in + len, buffer + PEAK_TAPS - 1);
+
+   float peak = mTruePeak;
+   for(size_t i = 0; i < len; ++i)
+   {
+      const float *const x = buffer + i;
+      for(const auto &phase : PeakFilter)
+      {
+         float value = 0;
+         for(size_t k = 0; k < PEAK_TAPS; ++k)
+            value += phase[k] * x[k];
+         peak = std::max(peak, std::abs(value));
+      }
+   }
+   mTruePeak = peak;
+
+   // Keep the latest inputs for next time
+   std::copy(buffer + len, buffer + len + PEAK_TAPS - 1, buffer);
+}
+
+void EBUR128::AddSquares(const double *squares, size_t len)
+{
+   while(len > 0)
+   {
+      const auto count = std::min(len, mHopSize - mHopPos);
+      double sum = mHopSum;
+      for(size_t i = 0; i < count; ++i)
+         sum += squares[i];
+      mHopSum = sum;
+      mHopPos += count;
+      squares += count;
+      len -= count;
+      if(mHopPos == mHopSize)
+         EndHop();
+   }
+}
+
+void EBUR128::EndHop()
+{
+   mHopRing[mHopCount % SHORT_TERM_HOPS] = mHopSum;
+   ++mHopCount;
+   mHopSum = 0;
+   mHopPos = 0;
+
+   if(mHopCount >= BLOCK_HOPS)
    {
       // A new full block of samples was submitted.
-      if(mBlockRingSize >= mBlockSize)
-         AddBlockToHistogram(mBlockSize);
+      double blockSum = 0;
+      for(size_t i = mHopCount - BLOCK_HOPS; i < mHopCount; ++i)
+         blockSum += mHopRing[i % SHORT_TERM_HOPS];
+      mMomentary = blockSum / double(BLOCK_HOPS * mHopSize);
+      AddBlockToHistogram(mMomentary);
    }
-   // Close the ring.
-   if(mBlockRingPos == mBlockSize)
-      mBlockRingPos = 0;
-   ++mSampleCount;
+}
+
+double EBUR128::MomentaryLoudness() const
+{
+   return 0.8529037031 * mMomentary;
+}
+
+double EBUR128::ShortTermLoudness() const
+{
+   const auto hops = std::min(mHopCount, SHORT_TERM_HOPS);
+   if(hops == 0)
+      return 0;
+   double sum = 0;
+   for(size_t i = 0; i < hops; ++i)
+      sum += mHopRing[i];
+   return 0.8529037031 * sum / double(hops * mHopSize);
 }
 
 double EBUR128::IntegrativeLoudness()
@@ -127,11 +355,39 @@ double EBUR128::IntegrativeLoudness()
    HistogramSums(0, sum_v, sum_c);
 
    // Handle incomplete block if no non-zero block was found.
+   // Count it only for this result, so that more audio may follow.
+   size_t extraIdx = HIST_BIN_COUNT;
    if(sum_c == 0)
    {
-      AddBlockToHistogram(mBlockRingSize);
+      double sum = 0;
+      size_t count = 0;
+      if(mHopCount < BLOCK_HOPS)
+      {
+         // Less than a block, so measure all of it
+         for(size_t i = 0; i < mHopCount; ++i)
+            sum += mHopRing[i];
+         sum += mHopSum;
+         count = mHopCount * mHopSize + mHopPos;
+      }
+      else
+      {
+         // Every block was below the absolute threshold; measure the last
+         for(size_t i = mHopCount - BLOCK_HOPS; i < mHopCount; ++i)
+            sum += mHopRing[i % SHORT_TERM_HOPS];
+         count = BLOCK_HOPS * mHopSize;
+      }
+      if(count > 0)
+         extraIdx = AddBlockToHistogram(sum / double(count));
       HistogramSums(0, sum_v, sum_c);
    }
+   auto removeExtra = finally([&]{
+      if(extraIdx < HIST_BIN_COUNT)
+         --mLoudnessHist[extraIdx];
+   });
+
+   if(sum_c == 0)
+      // Silence was processed.
+      return 0;
 
    // Histogram values are simplified log(x^2) immediate values
    // without -0.691 + 10*(...) to safe computing power. This is
@@ -139,10 +395,11 @@ double EBUR128::IntegrativeLoudness()
    // The -1 in the line below is the -10 LUFS from the EBU R128
    // specification without the scaling factor of 10.
    double Gamma_R = log10(sum_v/sum_c) - 1;
-   size_t idx_R = round((Gamma_R - GAMMA_A) * double(HIST_BIN_COUNT) / -GAMMA_A - 1);
+   double idx_R = round((Gamma_R - GAMMA_A) * double(HIST_BIN_COUNT) / -GAMMA_A - 1);
 
    // Apply Gamma_R threshold and calculate gated loudness (extent).
-   HistogramSums(idx_R+1, sum_v, sum_c);
+   // The relative threshold may lie below the absolute one.
+   HistogramSums(idx_R < 0 ? 0 : size_t(idx_R) + 1, sum_v, sum_c);
    if(sum_c == 0)
       // Silence was processed.
       return 0;
@@ -150,46 +407,54 @@ double EBUR128::IntegrativeLoudness()
    return 0.8529037031 * sum_v / sum_c;
 }
 
-void EBUR128::HistogramSums(size_t start_idx, double& sum_v, long int& sum_c)
+void EBUR128::HistogramSums(
+   size_t start_idx, double& sum_v, long int& sum_c) const
 {
-    double val;
-    sum_v = 0;
-    sum_c = 0;
-    for(size_t i = start_idx; i < HIST_BIN_COUNT; ++i)
-    {
-       val = -GAMMA_A / double(HIST_BIN_COUNT) * (i+1) + GAMMA_A;
-       sum_v += pow(10, val) * mLoudnessHist[i];
-       sum_c += mLoudnessHist[i];
-    }
+   // The mean square that each bin stands for, computed once
+   static const Doubles binValues = []{
+      Doubles values{ HIST_BIN_COUNT };
+      for(size_t i = 0; i < HIST_BIN_COUNT; ++i)
+         values[i] =
+            pow(10, -GAMMA_A / double(HIST_BIN_COUNT) * (i+1) + GAMMA_A);
+      return values;
+   }();
+
+   sum_v = 0;
+   sum_c = 0;
+   for(size_t i = start_idx; i < HIST_BIN_COUNT; ++i)
+   {
+      if(mLoudnessHist[i])
+      {
+         sum_v += binValues[i] * mLoudnessHist[i];
+         sum_c += mLoudnessHist[i];
+      }
+   }
 }
 
 /// Process new full block. Incomplete blocks shall be discarded
 /// according to the EBU R128 specification there is usually no need
 /// to call this on the last block.
-/// However, allow to override the block size if the audio to be
-/// processed is shorter than one block.
-void EBUR128::AddBlockToHistogram(size_t validLen)
+/// However, IntegrativeLoudness() calls it for an incomplete block if the
+/// audio to be processed is shorter than one block.
+size_t EBUR128::AddBlockToHistogram(double meanSquare)
 {
-   // Reset mBlockRingSize to full state to avoid overflow.
-   // The actual value of mBlockRingSize does not matter
-   // since this is only used to detect if blocks are complete (>= mBlockSize).
-   mBlockRingSize = mBlockSize;
-
-   size_t idx;
-   double blockVal = 0;
-   for(size_t i = 0; i < validLen; ++i)
-      blockVal += mBlockRingBuffer[i];
+   // Silence is below the absolute threshold
+   if(!(meanSquare > 0))
+      return HIST_BIN_COUNT;
 
    // Histogram values are simplified log10() immediate values
    // without -0.691 + 10*(...) to safe computing power. This is
    // possible because these constant cancel out anyway during the
    // following processing steps.
-   blockVal = log10(blockVal/double(validLen));
+   const double blockVal = log10(meanSquare);
    // log(blockVal) is within ]-inf, 1]
-   idx = round((blockVal - GAMMA_A) * double(HIST_BIN_COUNT) / -GAMMA_A - 1);
+   const double idx =
+      round((blockVal - GAMMA_A) * double(HIST_BIN_COUNT) / -GAMMA_A - 1);
 
    // idx is within ]-inf, HIST_BIN_COUNT-1], discard indices below 0
    // as they are below the EBU R128 absolute threshold anyway.
-   if(idx < HIST_BIN_COUNT)
-      ++mLoudnessHist[idx];
+   if(idx < 0 || idx >= HIST_BIN_COUNT)
+      return HIST_BIN_COUNT;
+   ++mLoudnessHist[size_t(idx)];
+   return size_t(idx);
 }
@@ -16,36 +16,80 @@ Max Maisel
 #include "SampleFormat.h"
 
 /// \brief Implements EBU-R128 loudness measurement.
+///
+/// Audio may be fed a block at a time with ProcessSamples(), as it is read,
+/// recorded or exported, and the measurements may be read at any time.
+/// Loudness values are mean squares; convert them with
+/// IntegrativeLoudnessToLUFS().
 class EBUR128
 {
 public:
-   EBUR128(double rate, size_t channels);
+   /// @param truePeak whether to measure the true peak too, which costs
+   /// more than the loudness
+   EBUR128(double rate, size_t channels, bool truePeak = false);
    EBUR128(const EBUR128&) = delete;
    EBUR128(EBUR128&&) = delete;
    ~EBUR128() = default;
 
    static ArrayOf<Biquad> CalcWeightingFilter(double fs);
    void Initialize();
+   /// Measure len samples of each channel; buffers has one pointer for
+   /// each channel
+   void ProcessSamples(const float *const *buffers, size_t len);
    void ProcessSampleFromChannel(float x_in, size_t channel);
    void NextSample();
    double IntegrativeLoudness();
+   /// Loudness of the latest 400 ms block, or 0 before the first block
+   double MomentaryLoudness() const;
+   /// Loudness of the latest 3 s, or of all complete 100 ms steps if fewer
+   double ShortTermLoudness() const;
+   /// Greatest magnitude of the 4 times oversampled signal, or 0 if not
+   /// measuring the true peak
+   double TruePeak() const { return mTruePeak; }
    inline double IntegrativeLoudnessToLUFS(double loudness)
       { return 10 * log10(loudness); }
 
 private:
-   void HistogramSums(size_t start_idx, double& sum_v, long int& sum_c);
-   void AddBlockToHistogram(size_t validLen);
+   // Apply the K-weighting filter of the channel to the input, and store
+   // the squares of the results into squares, or add them if not first
+   void WeightChannel(
+      size_t channel, const float *in, size_t len, double *squares, bool first);
+   // The same, for two channels at once
+   void WeightChannelPair(size_t channel,
+      const float *in0, const float *in1, size_t len, double *squares,
+      bool first);
+   void FindTruePeak(size_t channel, const float *in, size_t len);
+   void AddSquares(const double *squares, size_t len);
+   void EndHop();
+   void HistogramSums(size_t start_idx, double& sum_v, long int& sum_c) const;
+   /// @return the index of the bin incremented, or HIST_BIN_COUNT if none
+   size_t AddBlockToHistogram(double meanSquare);
 
    static const size_t HIST_BIN_COUNT = 65536;
    /// EBU R128 absolute threshold
    static constexpr double GAMMA_A = (-70.0 + 0.691) / 10.0;
+   /// Steps of 100 ms in a 400 ms gating block, and in the 3 s short term
+   static const size_t BLOCK_HOPS = 4;
+   static const size_t SHORT_TERM_HOPS = 30;
+   /// Samples per channel filtered at once
+   static const size_t CHUNK_SIZE = 4096;
+   /// Taps of each phase of the true peak interpolation filter
+   static const size_t PEAK_TAPS = 12;
+
    ArrayOf<long int> mLoudnessHist;
-   Doubles mBlockRingBuffer;
-   size_t mSampleCount;
-   size_t mBlockRingPos;
-   size_t mBlockRingSize;
-   size_t mBlockSize;
-   size_t mBlockOverlap;
+   /// Weighted squares, summed over the channels, of the current chunk
+   Doubles mSquares;
+   /// Sums of the squares of the latest complete steps
+   double mHopRing[SHORT_TERM_HOPS];
+   size_t mHopCount;
+   /// The step in progress
+   double mHopSum;
+   size_t mHopPos;
+   size_t mHopSize;
+   /// Mean square of the latest block
+   double mMomentary;
+   /// For ProcessSampleFromChannel()
+   double mSampleSquare;
    size_t mChannelCount;
    double mRate;
 
@@ -54,6 +98,11 @@ private:
    /// CHANNEL = LEFT/RIGHT (0/1) and
    /// FILTER  = HSF/HPF    (0/1)
    ArrayOf<ArrayOf<Biquad>> mWeightingFilter;
+
+   bool mMeasureTruePeak;
+   /// The latest PEAK_TAPS - 1 inputs of each channel, then room for a chunk
+   ArraysOf<float> mPeakHistory;
+   double mTruePeak;
 };
 
 #endif
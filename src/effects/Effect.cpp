@@ -21,6 +21,10 @@
 #include "../Experimental.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <numeric>
 
 #include <wx/defs.h>
 #include <wx/sizer.h>
@@ -34,6 +38,7 @@
 #include "../ProjectSettings.h"
 #include "../ShuttleGui.h"
 #include "../Shuttle.h"
+#include "../ThreadPool.h"
 #include "../ViewInfo.h"
 #include "../WaveTrack.h"
 #include "../wxFileNameWrapper.h"
@@ -1377,152 +1382,297 @@ bool Effect::Process()
    return bGoodResult;
 }
 
-bool Effect::ProcessPass()
+struct Effect::TrackGroup
 {
-   bool bGoodResult = true;
-   bool isGenerator = GetType() == EffectTypeGenerate;
+   WaveTrack *left{};
+   WaveTrack *right{};
+   ChannelName map[3]{ ChannelNameEOL, ChannelNameEOL, ChannelNameEOL };
+   unsigned numChannels{ 0 };
+};
 
+struct Effect::ProcessBuffers
+{
    FloatBuffers inBuffer, outBuffer;
    ArrayOf<float *> inBufPos, outBufPos;
+   bool clear{ false };
+};
 
-   ChannelName map[3];
-
-   mBufferSize = 0;
-   mBlockSize = 0;
+// Progress of one worker of ProcessGroupsInParallel(), and the shared
+// request to stop
+struct Effect::WorkerState
+{
+   std::atomic<double> frac{ 0.0 };
+   const std::atomic<bool> *cancelled{};
+};
 
-   int count = 0;
-   bool clear = false;
+bool Effect::ProcessPass()
+{
+   bool bGoodResult = true;
 
+   // Find the groups of channels to process, adjusting other tracks
+   std::vector<TrackGroup> groups;
    const bool multichannel = mNumAudioIn > 1;
    auto range = multichannel
       ? mOutputTracks->Leaders()
       : mOutputTracks->Any();
-   range.VisitWhile( bGoodResult,
+   range.Visit(
       [&](WaveTrack *left, const Track::Fallthrough &fallthrough) {
          if (!left->GetSelected())
             return fallthrough();
 
-         sampleCount len = 0;
-         sampleCount start = 0;
-
-         mNumChannels = 0;
-         WaveTrack *right{};
+         TrackGroup group;
+         group.left = left;
 
          // Iterate either over one track which could be any channel,
          // or if multichannel, then over all channels of left,
          // which is a leader.
          for (auto channel :
               TrackList::Channels(left).StartingWith(left)) {
+            auto &map = group.map;
+            auto &nChannels = group.numChannels;
             if (channel->GetChannel() == Track::LeftChannel)
-               map[mNumChannels] = ChannelNameFrontLeft;
+               map[nChannels] = ChannelNameFrontLeft;
             else if (channel->GetChannel() == Track::RightChannel)
-               map[mNumChannels] = ChannelNameFrontRight;
+               map[nChannels] = ChannelNameFrontRight;
             else
-               map[mNumChannels] = ChannelNameMono;
+               map[nChannels] = ChannelNameMono;
 
-            ++ mNumChannels;
-            map[mNumChannels] = ChannelNameEOL;
+            ++ nChannels;
+            map[nChannels] = ChannelNameEOL;
 
             if (! multichannel)
                break;
 
-            if (mNumChannels == 2) {
+            if (nChannels == 2) {
                // TODO: more-than-two-channels
-               right = channel;
-               clear = false;
+               group.right = channel;
                // Ignore other channels
                break;
             }
          }
 
-         if (!isGenerator)
-         {
-            GetBounds(*left, right, &start, &len);
-            mSampleCnt = len;
-         }
-         else
-            mSampleCnt = left->TimeToLongSamples(mDuration);
+         groups.push_back(group);
+      },
+      [&](Track *t) {
+         if (t->IsSyncLockSelected())
+            t->SyncLockAdjust(mT1, mT0 + mDuration);
+      }
+   );
 
-         // Let the client know the sample rate
-         SetSampleRate(left->GetRate());
+   mBufferSize = 0;
+   mBlockSize = 0;
 
-         // Get the block size the client wants to use
-         auto max = left->GetMaxBlockSize() * 2;
-         mBlockSize = SetBlockSize(max);
+   if (groups.size() > 1 && GetType() == EffectTypeProcess &&
+       ThreadPool::SharedThreadCount() > 0)
+      bGoodResult = ProcessGroupsInParallel(groups);
+   else
+      bGoodResult = ProcessGroups(groups);
 
-         // Calculate the buffer size to be at least the max rounded up to the clients
-         // selected block size.
-         const auto prevBufferSize = mBufferSize;
-         mBufferSize = ((max + (mBlockSize - 1)) / mBlockSize) * mBlockSize;
+   if (bGoodResult && GetType() == EffectTypeGenerate)
+   {
+      mT1 = mT0 + mDuration;
+   }
 
-         // If the buffer size has changed, then (re)allocate the buffers
-         if (prevBufferSize != mBufferSize)
-         {
-            // Always create the number of input buffers the client expects even if we don't have
-            // the same number of channels.
-            inBufPos.reinit( mNumAudioIn );
-            inBuffer.reinit( mNumAudioIn, mBufferSize );
+   return bGoodResult;
+}
 
-            // We won't be using more than the first 2 buffers, so clear the rest (if any)
-            for (size_t i = 2; i < mNumAudioIn; i++)
-            {
-               for (size_t j = 0; j < mBufferSize; j++)
-               {
-                  inBuffer[i][j] = 0.0;
-               }
-            }
+bool Effect::ProcessGroups(const std::vector<TrackGroup> &groups)
+{
+   ProcessBuffers buffers;
+   int count = 0;
+   for (const auto &group : groups) {
+      if (!ProcessGroup(count, group, buffers))
+         return false;
+      count++;
+   }
+   return true;
+}
 
-            // Always create the number of output buffers the client expects even if we don't have
-            // the same number of channels.
-            outBufPos.reinit( mNumAudioOut );
-            // Output buffers get an extra mBlockSize worth to give extra room if
-            // the plugin adds latency
-            outBuffer.reinit( mNumAudioOut, mBufferSize + mBlockSize );
-         }
+bool Effect::ProcessGroup(
+   int count, const TrackGroup &group, ProcessBuffers &buffers)
+{
+   bool isGenerator = GetType() == EffectTypeGenerate;
 
-         // (Re)Set the input buffer positions
-         for (size_t i = 0; i < mNumAudioIn; i++)
-         {
-            inBufPos[i] = inBuffer[i].get();
-         }
+   auto left = group.left;
+   auto right = group.right;
+   auto &inBuffer = buffers.inBuffer;
+   auto &outBuffer = buffers.outBuffer;
+   auto &inBufPos = buffers.inBufPos;
+   auto &outBufPos = buffers.outBufPos;
 
-         // (Re)Set the output buffer positions
-         for (size_t i = 0; i < mNumAudioOut; i++)
-         {
-            outBufPos[i] = outBuffer[i].get();
-         }
+   mNumChannels = group.numChannels;
+   if (right)
+      buffers.clear = false;
 
-         // Clear unused input buffers
-         if (!right && !clear && mNumAudioIn > 1)
+   sampleCount len = 0;
+   sampleCount start = 0;
+
+   if (!isGenerator)
+   {
+      GetBounds(*left, right, &start, &len);
+      mSampleCnt = len;
+   }
+   else
+      mSampleCnt = left->TimeToLongSamples(mDuration);
+
+   // Let the client know the sample rate
+   SetSampleRate(left->GetRate());
+
+   // Get the block size the client wants to use
+   auto max = left->GetMaxBlockSize() * 2;
+   mBlockSize = SetBlockSize(max);
+
+   // Calculate the buffer size to be at least the max rounded up to the clients
+   // selected block size.
+   const auto prevBufferSize = mBufferSize;
+   mBufferSize = ((max + (mBlockSize - 1)) / mBlockSize) * mBlockSize;
+
+   // If the buffer size has changed, then (re)allocate the buffers
+   if (prevBufferSize != mBufferSize)
+   {
+      // Always create the number of input buffers the client expects even if we don't have
+      // the same number of channels.
+      inBufPos.reinit( mNumAudioIn );
+      inBuffer.reinit( mNumAudioIn, mBufferSize );
+
+      // We won't be using more than the first 2 buffers, so clear the rest (if any)
+      for (size_t i = 2; i < mNumAudioIn; i++)
+      {
+         for (size_t j = 0; j < mBufferSize; j++)
          {
-            for (size_t j = 0; j < mBufferSize; j++)
-            {
-               inBuffer[1][j] = 0.0;
-            }
-            clear = true;
+            inBuffer[i][j] = 0.0;
          }
+      }
 
-         // Go process the track(s)
-         bGoodResult = ProcessTrack(
-            count, map, left, right, start, len,
-            inBuffer, outBuffer, inBufPos, outBufPos);
-         if (!bGoodResult)
-            return;
+      // Always create the number of output buffers the client expects even if we don't have
+      // the same number of channels.
+      outBufPos.reinit( mNumAudioOut );
+      // Output buffers get an extra mBlockSize worth to give extra room if
+      // the plugin adds latency
+      outBuffer.reinit( mNumAudioOut, mBufferSize + mBlockSize );
+   }
 
-         count++;
-      },
-      [&](Track *t) {
-         if (t->IsSyncLockSelected())
-            t->SyncLockAdjust(mT1, mT0 + mDuration);
-      }
-   );
+   // (Re)Set the input buffer positions
+   for (size_t i = 0; i < mNumAudioIn; i++)
+   {
+      inBufPos[i] = inBuffer[i].get();
+   }
 
-   if (bGoodResult && GetType() == EffectTypeGenerate)
+   // (Re)Set the output buffer positions
+   for (size_t i = 0; i < mNumAudioOut; i++)
    {
-      mT1 = mT0 + mDuration;
+      outBufPos[i] = outBuffer[i].get();
    }
 
-   return bGoodResult;
+   // Clear unused input buffers
+   if (!right && !buffers.clear && mNumAudioIn > 1)
+   {
+      for (size_t j = 0; j < mBufferSize; j++)
+      {
+         inBuffer[1][j] = 0.0;
+      }
+      buffers.clear = true;
+   }
+
+   // Go process the track(s)
+   ChannelName map[3];
+   std::copy(group.map, group.map + 3, map);
+   return ProcessTrack(
+      count, map, left, right, start, len,
+      inBuffer, outBuffer, inBufPos, outBufPos);
+}
+
+bool Effect::ProcessGroupsInParallel(const std::vector<TrackGroup> &groups)
+{
+   // Give each group its own instance of the effect, with the same
+   // settings as this one.  Each worker writes only its own tracks, so the
+   // result is the same as processing the groups one after another.
+   auto firstWorker = NewTrackWorker();
+   CommandParameters eap;
+   if (!firstWorker || !GetAutomationParameters(eap))
+      return ProcessGroups(groups);
+
+   std::atomic<bool> cancelled{ false };
+   ArrayOf<WorkerState> states{ groups.size() };
+   std::vector< std::unique_ptr<Effect> > workers(groups.size());
+   for (size_t ii = 0; ii < groups.size(); ++ii) {
+      auto &worker = workers[ii];
+      worker = ii == 0 ? std::move(firstWorker) : NewTrackWorker();
+      if (!worker)
+         return ProcessGroups(groups);
+
+      worker->mIsBatch = mIsBatch;
+      worker->mIsPreview = mIsPreview;
+      worker->mProjectRate = mProjectRate;
+      worker->mT0 = mT0;
+      worker->mT1 = mT1;
+      worker->mDuration = mDuration;
+      worker->mPass = mPass;
+      worker->mNumTracks = mNumTracks;
+      worker->mNumGroups = mNumGroups;
+      worker->mNumAudioIn = worker->GetAudioInCount();
+      worker->mNumAudioOut = worker->GetAudioOutCount();
+      if (!worker->SetAutomationParameters(eap))
+         return ProcessGroups(groups);
+
+      states[ii].cancelled = &cancelled;
+      worker->mWorkerState = &states[ii];
+   }
+
+   // Start the longest groups first, so that the batch finishes sooner;
+   // each thread takes the next group as soon as it is free
+   std::vector<sampleCount> lengths(groups.size());
+   for (size_t ii = 0; ii < groups.size(); ++ii) {
+      sampleCount start;
+      GetBounds(*groups[ii].left, groups[ii].right, &start, &lengths[ii]);
+   }
+   std::vector<size_t> order(groups.size());
+   std::iota(order.begin(), order.end(), 0);
+   std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){
+      return lengths[a] > lengths[b];
+   });
+
+   // One thread joins the shared pool, or runs all groups if another
+   // caller has the pool, while this thread shows progress
+   ArrayOf<char> results{ groups.size(), true };
+   auto task = std::async(std::launch::async, [&]{
+      ThreadPool::RunShared(order, [&](size_t ii){
+         try {
+            ProcessBuffers buffers;
+            results[ii] =
+               workers[ii]->ProcessGroup((int)ii, groups[ii], buffers);
+         }
+         catch (...) {
+            cancelled.store(true, std::memory_order_relaxed);
+            throw;
+         }
+         if (!results[ii])
+            cancelled.store(true, std::memory_order_relaxed);
+      });
+   });
+
+   // Report progress and detect cancellation here in the main thread,
+   // while the pool works
+   while (task.wait_for(std::chrono::milliseconds(50)) !=
+          std::future_status::ready) {
+      double total = 0;
+      for (size_t ii = 0; ii < groups.size(); ++ii)
+         total += states[ii].frac.load(std::memory_order_relaxed);
+      if (TotalProgress(total / groups.size()))
+         cancelled.store(true, std::memory_order_relaxed);
+   }
+
+   // Rethrows any exception from the workers
+   task.get();
+
+   return !cancelled.load(std::memory_order_relaxed) &&
+      std::all_of(results.get(), results.get() + groups.size(),
+         [](char result){ return result != 0; });
+}
+
+std::unique_ptr<Effect> Effect::NewTrackWorker()
+{
+   return nullptr;
 }
 
 bool Effect::ProcessTrack(int count,
@@ -2021,6 +2171,9 @@ bool Effect::TotalProgress(double frac, const TranslatableString &msg)
 
 bool Effect::TrackProgress(int whichTrack, double frac, const TranslatableString &msg)
 {
+   if (mWorkerState)
+      return WorkerProgress(frac);
+
    auto updateResult = (mProgress ?
       mProgress->Update(whichTrack + frac, (double) mNumTracks, msg) :
       ProgressResult::Success);
@@ -2029,12 +2182,23 @@ bool Effect::TrackProgress(int whichTrack, double frac, const TranslatableString
 
 bool Effect::TrackGroupProgress(int whichGroup, double frac, const TranslatableString &msg)
 {
+   if (mWorkerState)
+      return WorkerProgress(frac);
+
    auto updateResult = (mProgress ?
       mProgress->Update(whichGroup + frac, (double) mNumGroups, msg) :
       ProgressResult::Success);
    return (updateResult != ProgressResult::Success);
 }
 
+bool Effect::WorkerProgress(double frac)
+{
+   // Not in the main thread, so leave the dialog to
+   // ProcessGroupsInParallel()
+   mWorkerState->frac.store(frac, std::memory_order_relaxed);
+   return mWorkerState->cancelled->load(std::memory_order_relaxed);
+}
+
 void Effect::GetBounds(
    const WaveTrack &track, const WaveTrack *pRight,
    sampleCount *start, sampleCount *len)
@@ -304,6 +304,13 @@ protected:
    virtual bool InitPass2();
    virtual int GetPass();
 
+   // Opt in to processing several track groups at once, by returning a NEW
+   // instance of the same effect.  Do so only if ProcessInitialize(),
+   // ProcessBlock() and ProcessFinalize() keep no state from one group to
+   // the next, and touch no user interface.  ProcessPass() gives each
+   // instance the automation parameters of this one.
+   virtual std::unique_ptr<Effect> NewTrackWorker();
+
    // clean up any temporary memory, needed only per invocation of the
    // effect, after either successful or failed or exception-aborted processing.
    // Invoked inside a "finally" block so it must be no-throw.
@@ -496,6 +503,15 @@ protected:
                      ArrayOf< float * > &inBufPos,
                      ArrayOf< float *> &outBufPos);
 
+   struct TrackGroup;
+   struct ProcessBuffers;
+   struct WorkerState;
+   bool ProcessGroups(const std::vector<TrackGroup> &groups);
+   bool ProcessGroup(
+      int count, const TrackGroup &group, ProcessBuffers &buffers);
+   bool ProcessGroupsInParallel(const std::vector<TrackGroup> &groups);
+   bool WorkerProgress(double frac);
+
  //
  // private data
  //
@@ -531,6 +547,9 @@ private:
    size_t mBlockSize;
    unsigned mNumChannels;
 
+   // Not null only in the workers of ProcessGroupsInParallel()
+   WorkerState *mWorkerState{};
+
 public:
    const static wxString kUserPresetIdent;
    const static wxString kFactoryPresetIdent;
@@ -112,3 +112,10 @@ size_t EffectFade::ProcessBlock(float **inBlock, float **outBlock, size_t blockL
 
    return blockLen;
 }
+
+// Effect implementation
+
+std::unique_ptr<Effect> EffectFade::NewTrackWorker()
+{
+   return std::make_unique<EffectFade>(mFadeIn);
+}
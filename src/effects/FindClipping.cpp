@@ -161,80 +161,79 @@ bool EffectFindClipping::ProcessOne(LabelTrack * lt,
                                     sampleCount len)
 {
    bool bGoodResult = true;
-   size_t blockSize = (mStart * 1000);
 
    if (len < mStart) {
       return true;
    }
 
-   Floats buffer;
-   try {
-      // mStart should be positive.
-      // if we are throwing bad_alloc and mStart is negative, find out why.
-      if (mStart < 0 || (int)blockSize < mStart)
-         // overflow
-         throw std::bad_alloc{};
-      buffer.reinit(blockSize);
-   }
-   catch( const std::bad_alloc & ) {
-      Effect::MessageBox( XO("Requested value exceeds memory capacity.") );
-      return false;
-   }
-
-   float *ptr = buffer.get();
+   // Rather than look at each sample, take the runs of clipped samples,
+   // which are found once for each block and remembered, and step over the
+   // runs and the gaps between them.  The labels are as if each sample were
+   // examined in turn:  a run of at least mStart clipped samples begins a
+   // label, and mStop unclipped samples end it.
+   const size_t blockSize = wt->GetMaxBlockSize();
+   WaveTrack::ClipRuns runs;
 
    decltype(len) s = 0, startrun = 0, stoprun = 0, samps = 0;
-   decltype(blockSize) block = 0;
    double startTime = -1.0;
 
-   while (s < len) {
-      if (block == 0) {
-         if (TrackProgress(count,
-                           s.as_double() /
-                           len.as_double() )) {
-            bGoodResult = false;
-            break;
-         }
-
-         block = limitSampleBufferSize( blockSize, len - s );
-
-         wt->Get((samplePtr)buffer.get(), floatSample, start + s, block);
-         ptr = buffer.get();
-      }
-
-      float v = fabs(*ptr++);
-      if (v >= MAX_AUDIO) {
-         if (startrun == 0) {
-            startTime = wt->LongSamplesToTime(start + s);
+   // Unclipped samples, from s
+   auto gap = [&](sampleCount n) {
+      if (n <= 0)
+         return;
+      if (startrun >= mStart) {
+         // The sample that completes the stop run
+         const auto need = std::max<sampleCount>( 1, mStop - stoprun );
+         if (n >= need) {
+            samps += need;
+            const auto end = s + need - 1;
+            lt->AddLabel(SelectedRegion(startTime,
+                                       wt->LongSamplesToTime(start + end - mStop)),
+                        wxString::Format(wxT("%lld of %lld"), startrun.as_long_long(), (samps - mStop).as_long_long()));
+            startrun = 0;
+            stoprun = 0;
             samps = 0;
          }
          else {
-            stoprun = 0;
+            stoprun += n;
+            samps += n;
          }
-         startrun++;
-         samps++;
       }
       else {
-         if (startrun >= mStart) {
-            stoprun++;
-            samps++;
-
-            if (stoprun >= mStop) {
-               lt->AddLabel(SelectedRegion(startTime,
-                                          wt->LongSamplesToTime(start + s - mStop)),
-                           wxString::Format(wxT("%lld of %lld"), startrun.as_long_long(), (samps - mStop).as_long_long()));
-               startrun = 0;
-               stoprun = 0;
-               samps = 0;
-            }
-         }
-         else {
-            startrun = 0;
-         }
+         startrun = 0;
+      }
+      s += n;
+   };
+
+   // Clipped samples, from s
+   auto run = [&](sampleCount n) {
+      if (startrun == 0) {
+         startTime = wt->LongSamplesToTime(start + s);
+         samps = 0;
       }
+      stoprun = 0;
+      startrun += n;
+      samps += n;
+      s += n;
+   };
 
-      s++;
-      block--;
+   while (s < len) {
+      if (TrackProgress(count,
+                        s.as_double() /
+                        len.as_double() )) {
+         bGoodResult = false;
+         break;
+      }
+
+      const auto block = limitSampleBufferSize( blockSize, len - s );
+      const auto blockStart = s;
+
+      wt->GetClipRuns(start + blockStart, block, runs);
+      for (const auto &clipRun : runs) {
+         gap(blockStart + clipRun.first - s);
+         run(clipRun.second);
+      }
+      gap(blockStart + block - s);
    }
 
    return bGoodResult;
@@ -82,3 +82,10 @@ size_t EffectInvert::ProcessBlock(float **inBlock, float **outBlock, size_t bloc
 
    return blockLen;
 }
+
+// Effect implementation
+
+std::unique_ptr<Effect> EffectInvert::NewTrackWorker()
+{
+   return std::make_unique<EffectInvert>();
+}
@@ -38,6 +38,10 @@ public:
    unsigned GetAudioInCount() override;
    unsigned GetAudioOutCount() override;
    size_t ProcessBlock(float **inBlock, float **outBlock, size_t blockLen) override;
+
+   // Effect implementation
+
+   std::unique_ptr<Effect> NewTrackWorker() override;
 };
 
 #endif
@@ -18,10 +18,12 @@
 #include "Loudness.h"
 
 #include <math.h>
+#include <string.h>
 
 #include <wx/intl.h>
 #include <wx/valgen.h>
 
+#include "../BlockAnalysisCache.h"
 #include "../Internat.h"
 #include "../Prefs.h"
 #include "../ProjectFileManager.h"
@@ -215,15 +217,31 @@ bool EffectLoudness::Process()
 
       mProcStereo = range.size() > 1;
 
+      double loudness = 0.0;
       if(mNormalizeTo == kLoudness)
       {
-         mLoudnessProcessor.reset(safenew EBUR128(mCurRate, range.size()));
-         mLoudnessProcessor->Initialize();
-         if(!ProcessOne(range, true))
+         // Audio analysed before, and unchanged since, need not be read again
+         auto &cache = BlockAnalysisCache::Get();
+         BlockAnalysisCache::ContentKey key;
+         const bool haveKey = GetContentKey(range, key);
+         if(haveKey && cache.FindResult(key, loudness))
          {
-            // Processing failed -> abort
-            bGoodResult = false;
-            break;
+            mProgressVal += double(1+mProcStereo)
+               / (double(GetNumWaveTracks()) * double(mSteps));
+         }
+         else
+         {
+            mLoudnessProcessor.reset(safenew EBUR128(mCurRate, range.size()));
+            mLoudnessProcessor->Initialize();
+            if(!ProcessOne(range, true))
+            {
+               // Processing failed -> abort
+               bGoodResult = false;
+               break;
+            }
+            loudness = mLoudnessProcessor->IntegrativeLoudness();
+            if(haveKey)
+               cache.InsertResult(key, loudness);
          }
       }
       else // RMS
@@ -244,7 +262,7 @@ bool EffectLoudness::Process()
       // Calculate normalization values the analysis results
       float extent;
       if(mNormalizeTo == kLoudness)
-         extent = mLoudnessProcessor->IntegrativeLoudness();
+         extent = loudness;
       else // RMS
       {
          extent = mRMS[0];
@@ -478,6 +496,32 @@ bool EffectLoudness::ProcessOne(TrackIterRange<WaveTrack> range, bool analyse)
    return true;
 }
 
+/// Names the audio that ProcessOne() would analyse, with what else decides
+/// the loudness.  Returns false if the audio is not all available yet.
+bool EffectLoudness::GetContentKey(TrackIterRange<WaveTrack> range,
+                                   std::vector<unsigned long long> &key)
+{
+   // ProcessOne() would fail
+   if(mCurT1 <= mCurT0)
+      return false;
+
+   WaveTrack* track = *range.begin();
+   auto start = track->TimeToLongSamples(mCurT0);
+   auto end   = track->TimeToLongSamples(mCurT1);
+
+   unsigned long long rate;
+   static_assert(sizeof(rate) == sizeof(mCurRate), "");
+   memcpy(&rate, &mCurRate, sizeof(rate));
+   key.push_back(rate);
+   key.push_back(range.size());
+   for(auto channel : range)
+   {
+      if(!channel->GetContentKey(start, end - start, key))
+         return false;
+   }
+   return true;
+}
+
 void EffectLoudness::LoadBufferBlock(TrackIterRange<WaveTrack> range,
                                      sampleCount pos, size_t len)
 {
@@ -495,13 +539,8 @@ void EffectLoudness::LoadBufferBlock(TrackIterRange<WaveTrack> range,
 /// (for loudness).
 bool EffectLoudness::AnalyseBufferBlock()
 {
-   for(size_t i = 0; i < mTrackBufferLen; i++)
-   {
-      mLoudnessProcessor->ProcessSampleFromChannel(mTrackBuffer[0][i], 0);
-      if(mProcStereo)
-         mLoudnessProcessor->ProcessSampleFromChannel(mTrackBuffer[1][i], 1);
-      mLoudnessProcessor->NextSample();
-   }
+   const float *buffers[2] = { mTrackBuffer[0].get(), mTrackBuffer[1].get() };
+   mLoudnessProcessor->ProcessSamples(buffers, mTrackBufferLen);
 
    if(!UpdateProgress())
       return false;
@@ -64,6 +64,8 @@ private:
    void FreeBuffers();
    bool GetTrackRMS(WaveTrack* track, float& rms);
    bool ProcessOne(TrackIterRange<WaveTrack> range, bool analyse);
+   bool GetContentKey(TrackIterRange<WaveTrack> range,
+                      std::vector<unsigned long long> &key);
    void LoadBufferBlock(TrackIterRange<WaveTrack> range,
                         sampleCount pos, size_t len);
    bool AnalyseBufferBlock();
@@ -427,10 +427,6 @@ bool EffectNormalize::AnalyseTrackData(const WaveTrack * track, const Translatab
    //to make it a double now than it is to do it later
    auto len = (end - start).as_double();
 
-   //Initiate a processing buffer.  This buffer will (most likely)
-   //be shorter than the length of the track being processed.
-   Floats buffer{ track->GetMaxBlockSize() };
-
    mSum   = 0.0; // dc offset inits
 
    sampleCount blockSamples;
@@ -447,13 +443,11 @@ bool EffectNormalize::AnalyseTrackData(const WaveTrack * track, const Translatab
          end - s
       );
 
-      //Get the samples from the track and put them in the buffer
-      track->Get((samplePtr) buffer.get(), floatSample, s, block, fillZero, true, &blockSamples);
+      //Sum the samples.  Whole blocks are summed only once, for as long
+      //as they exist, so analysing the same audio again is fast.
+      mSum += track->GetSum(s, block, &blockSamples);
       totalSamples += blockSamples;
 
-      //Process the buffer.
-      AnalyseDataDC(buffer.get(), block);
-
       //Increment s one blockfull of samples
       s += block;
 
@@ -532,13 +526,6 @@ bool EffectNormalize::ProcessOne(
    return rc;
 }
 
-/// @see AnalyseDataLoudnessDC
-void EffectNormalize::AnalyseDataDC(float *buffer, size_t len)
-{
-   for(decltype(len) i = 0; i < len; i++)
-      mSum += (double)buffer[i];
-}
-
 void EffectNormalize::ProcessData(float *buffer, size_t len, float offset)
 {
    for(decltype(len) i = 0; i < len; i++) {
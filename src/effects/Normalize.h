@@ -64,7 +64,6 @@ private:
                      double &progress, float &offset, float &extent);
    bool AnalyseTrackData(const WaveTrack * track, const TranslatableString &msg, double &progress,
                      float &offset);
-   void AnalyseDataDC(float *buffer, size_t len);
    void ProcessData(float *buffer, size_t len, float offset);
 
    void OnUpdateUI(wxCommandEvent & evt);
@@ -253,6 +253,11 @@ bool EffectPhaser::SetAutomationParameters(CommandParameters & parms)
 
 // Effect implementation
 
+std::unique_ptr<Effect> EffectPhaser::NewTrackWorker()
+{
+   return std::make_unique<EffectPhaser>();
+}
+
 void EffectPhaser::PopulateOrExchange(ShuttleGui & S)
 {
    S.SetBorder(5);
@@ -237,6 +237,11 @@ bool EffectWahwah::SetAutomationParameters(CommandParameters & parms)
 
 // Effect implementation
 
+std::unique_ptr<Effect> EffectWahwah::NewTrackWorker()
+{
+   return std::make_unique<EffectWahwah>();
+}
+
 void EffectWahwah::PopulateOrExchange(ShuttleGui & S)
 {
    S.SetBorder(5);
@@ -74,6 +74,7 @@ public:
 
    // Effect implementation
 
+   std::unique_ptr<Effect> NewTrackWorker() override;
    void PopulateOrExchange(ShuttleGui & S) override;
    bool TransferDataToWindow() override;
    bool TransferDataFromWindow() override;
@@ -73,6 +73,24 @@
 #include "../widgets/HelpSystem.h"
 #include "../widgets/ProgressDialog.h"
 
+//----------------------------------------------------------------------------
+// ExportJob
+//----------------------------------------------------------------------------
+
+ExportProgress::~ExportProgress()
+{
+}
+
+ExportJob::ExportJob(const wxString &name, const TranslatableString &message)
+   : mName{ name }
+   , mMessage{ message }
+{
+}
+
+ExportJob::~ExportJob()
+{
+}
+
 //----------------------------------------------------------------------------
 // ExportPlugin
 //----------------------------------------------------------------------------
@@ -205,6 +223,24 @@ bool ExportPlugin::DisplayOptions(wxWindow * WXUNUSED(parent), int WXUNUSED(form
    return false;
 }
 
+bool ExportPlugin::CanPrepareExport(int WXUNUSED(subformat))
+{
+   return false;
+}
+
+std::unique_ptr<ExportJob> ExportPlugin::PrepareExport(
+   AudacityProject *WXUNUSED(project), unsigned WXUNUSED(channels),
+   const wxFileNameWrapper &WXUNUSED(fName), bool WXUNUSED(selectedOnly),
+   double WXUNUSED(t0), double WXUNUSED(t1),
+   MixerSpec *WXUNUSED(mixerSpec), const Tags *WXUNUSED(metadata),
+   int WXUNUSED(subformat), ProgressResult &result)
+{
+   // Callers should have asked CanPrepareExport()
+   wxASSERT(false);
+   result = ProgressResult::Failed;
+   return {};
+}
+
 void ExportPlugin::OptionsCreate(ShuttleGui &S, int WXUNUSED(format))
 {
    S.StartHorizontalLay(wxCENTER);
@@ -239,7 +275,7 @@ std::unique_ptr<Mixer> ExportPlugin::CreateMixer(const TrackList &tracks,
    const auto timeTrack = *tracks.Any<const TimeTrack>().begin();
    auto envelope = timeTrack ? timeTrack->GetEnvelope() : nullptr;
    // MB: the stop time should not be warped, this was a bug.
-   return std::make_unique<Mixer>(inputTracks,
+   auto mixer = std::make_unique<Mixer>(inputTracks,
                   // Throw, to stop exporting, if read fails:
                   true,
                   Mixer::WarpOptions(envelope),
@@ -247,6 +283,9 @@ std::unique_ptr<Mixer> ExportPlugin::CreateMixer(const TrackList &tracks,
                   numOutChannels, outBufferSize, outInterleaved,
                   outRate, outFormat,
                   highQuality, mixerSpec);
+   // Exporting is not real time, so use more than one thread
+   mixer->MixInParallel();
+   return mixer;
 }
 
 void ExportPlugin::InitProgress(std::unique_ptr<ProgressDialog> &pDialog,
@@ -268,6 +307,38 @@ void ExportPlugin::InitProgress(std::unique_ptr<ProgressDialog> &pDialog,
       pDialog, Verbatim( title.GetName() ), message );
 }
 
+namespace {
+// Reports to a progress dialog and to message boxes, on the main thread
+class DialogExportProgress final : public ExportProgress
+{
+public:
+   explicit DialogExportProgress(ProgressDialog &dialog)
+      : mDialog{ dialog }
+   {}
+
+   ProgressResult Update(double current, double total) override
+   {
+      return mDialog.Update(current, total);
+   }
+
+   void ReportError(const TranslatableString &message) override
+   {
+      AudacityMessageBox( message );
+   }
+
+private:
+   ProgressDialog &mDialog;
+};
+}
+
+ProgressResult ExportPlugin::RunExportJob(ExportJob &job,
+   std::unique_ptr<ProgressDialog> &pDialog)
+{
+   InitProgress( pDialog, Verbatim( job.GetName() ), job.GetMessage() );
+   DialogExportProgress progress{ *pDialog };
+   return job.Run( progress );
+}
+
 //----------------------------------------------------------------------------
 // Export
 //----------------------------------------------------------------------------
@@ -59,6 +59,52 @@ class AUDACITY_DLL_API FormatInfo
       bool mCanMetaData;
 };
 
+//----------------------------------------------------------------------------
+// ExportJob
+//----------------------------------------------------------------------------
+
+/// Where an ExportJob reports its progress and its problems
+class AUDACITY_DLL_API ExportProgress /* not final */
+{
+public:
+   virtual ~ExportProgress();
+
+   /// Returns ProgressResult::Success to go on, or else the result to stop
+   /// with
+   virtual ProgressResult Update(double current, double total) = 0;
+   /// Tell the user, now or later, that something went wrong
+   virtual void ReportError(const TranslatableString &message) = 0;
+};
+
+/** \brief The rest of one export, after ExportPlugin::PrepareExport() has
+ * done what needs the main thread: mixing, encoding and writing.
+ *
+ * A job may run on any thread, alongside other jobs.  It must not touch the
+ * user interface or the preferences, except through its ExportProgress.
+ */
+class AUDACITY_DLL_API ExportJob /* not final */
+{
+public:
+   ExportJob(const wxString &name, const TranslatableString &message);
+   virtual ~ExportJob();
+
+   /// The name of the file, for the title of a progress dialog
+   const wxString &GetName() const { return mName; }
+   const TranslatableString &GetMessage() const { return mMessage; }
+
+   /// @return as for ExportPlugin::Export(), except that the failure has
+   /// been reported to progress, and not to the user
+   virtual ProgressResult Run(ExportProgress &progress) = 0;
+
+protected:
+   /// For jobs that know their message only after construction
+   void SetMessage(const TranslatableString &message) { mMessage = message; }
+
+private:
+   wxString mName;
+   TranslatableString mMessage;
+};
+
 //----------------------------------------------------------------------------
 // ExportPlugin
 //----------------------------------------------------------------------------
@@ -134,6 +180,28 @@ public:
                        const Tags *metadata = NULL,
                        int subformat = 0) = 0;
 
+   /// Whether PrepareExport() is implemented for the subformat
+   virtual bool CanPrepareExport(int subformat);
+
+   /** \brief Begin an export as Export() would, but stop short of the
+    * mixing and encoding, and return those as a job to run on any thread.
+    *
+    * The arguments are as for Export(); objects they point to must outlive
+    * the job.
+    * @param result Set to ProgressResult::Failed or ProgressResult::Cancelled
+    * when no job is returned, after alerting the user
+    */
+   virtual std::unique_ptr<ExportJob> PrepareExport(AudacityProject *project,
+                       unsigned channels,
+                       const wxFileNameWrapper &fName,
+                       bool selectedOnly,
+                       double t0,
+                       double t1,
+                       MixerSpec *mixerSpec,
+                       const Tags *metadata,
+                       int subformat,
+                       ProgressResult &result);
+
 protected:
    std::unique_ptr<Mixer> CreateMixer(const TrackList &tracks,
          bool selectionOnly,
@@ -148,6 +216,11 @@ protected:
    static void InitProgress(std::unique_ptr<ProgressDialog> &pDialog,
          const wxFileNameWrapper &title, const TranslatableString &message);
 
+   /// Run a job on this thread, with a progress dialog and message boxes, as
+   /// Export() does when it also has PrepareExport()
+   static ProgressResult RunExportJob(ExportJob &job,
+         std::unique_ptr<ProgressDialog> &pDialog);
+
 private:
    std::vector<FormatInfo> mFormatInfos;
 };
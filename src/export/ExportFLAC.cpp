@@ -223,6 +223,17 @@ public:
                MixerSpec *mixerSpec = NULL,
                const Tags *metadata = NULL,
                int subformat = 0) override;
+   bool CanPrepareExport(int subformat) override;
+   std::unique_ptr<ExportJob> PrepareExport(AudacityProject *project,
+               unsigned channels,
+               const wxFileNameWrapper &fName,
+               bool selectedOnly,
+               double t0,
+               double t1,
+               MixerSpec *mixerSpec,
+               const Tags *metadata,
+               int subformat,
+               ProgressResult &result) override;
 
 private:
 
@@ -245,6 +256,48 @@ ExportFLAC::ExportFLAC()
    SetDescription(XO("FLAC Files"),0);
 }
 
+/// Mixes and encodes the audio for ExportFLAC, after the encoder is ready
+class FLACExportJob final : public ExportJob
+{
+public:
+   using ExportJob::ExportJob;
+   ~FLACExportJob() override;
+
+   ProgressResult Run(ExportProgress &progress) override;
+
+private:
+   friend ExportFLAC;
+
+   // Give up on an initialized encoder
+   void Abandon();
+
+   FLAC::Encoder::File mEncoder;
+#ifndef LEGACY_FLAC
+   wxFFile mFile;     // will be closed when it goes out of scope
+#endif
+   bool mInitialized{ false };
+   std::unique_ptr<Mixer> mMixer;
+   sampleFormat mFormat;
+   unsigned mNumChannels;
+   double mT0, mT1;
+};
+
+FLACExportJob::~FLACExportJob()
+{
+   Abandon();
+}
+
+void FLACExportJob::Abandon()
+{
+   if (mInitialized) {
+      mInitialized = false;
+#ifndef LEGACY_FLAC
+      mFile.Detach(); // libflac closes the file
+#endif
+      mEncoder.finish();
+   }
+}
+
 ProgressResult ExportFLAC::Export(AudacityProject *project,
                         std::unique_ptr<ProgressDialog> &pDialog,
                         unsigned numChannels,
@@ -254,21 +307,49 @@ ProgressResult ExportFLAC::Export(AudacityProject *project,
                         double t1,
                         MixerSpec *mixerSpec,
                         const Tags *metadata,
-                        int WXUNUSED(subformat))
+                        int subformat)
+{
+   auto result = ProgressResult::Success;
+   auto job = PrepareExport(project, numChannels, fName, selectionOnly,
+      t0, t1, mixerSpec, metadata, subformat, result);
+   if (!job)
+      return result;
+   return RunExportJob(*job, pDialog);
+}
+
+bool ExportFLAC::CanPrepareExport(int WXUNUSED(subformat))
+{
+   return true;
+}
+
+std::unique_ptr<ExportJob> ExportFLAC::PrepareExport(AudacityProject *project,
+                        unsigned numChannels,
+                        const wxFileNameWrapper &fName,
+                        bool selectionOnly,
+                        double t0,
+                        double t1,
+                        MixerSpec *mixerSpec,
+                        const Tags *metadata,
+                        int WXUNUSED(subformat),
+                        ProgressResult &result)
 {
    const auto &settings = ProjectSettings::Get( *project );
    double    rate    = settings.GetRate();
    const auto &tracks = TrackList::Get( *project );
 
    wxLogNull logNo;            // temporarily disable wxWidgets error messages
-   auto updateResult = ProgressResult::Success;
+   result = ProgressResult::Cancelled;
 
    long levelPref;
    FLACLevel.Read().ToLong( &levelPref );
 
    auto bitDepthPref = FLACBitDepth.Read();
 
-   FLAC::Encoder::File encoder;
+   auto job = std::make_unique<FLACExportJob>(fName.GetName(),
+      selectionOnly
+         ? XO("Exporting the selected audio as FLAC")
+         : XO("Exporting the audio as FLAC") );
+   auto &encoder = job->mEncoder;
 
    bool success = true;
    success = success &&
@@ -282,7 +363,7 @@ ProgressResult ExportFLAC::Export(AudacityProject *project,
    if (success && !GetMetadata(project, metadata)) {
       // TODO: more precise message
       AudacityMessageBox( XO("Unable to export") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
    if (success && mMetadata) {
@@ -335,17 +416,23 @@ ProgressResult ExportFLAC::Export(AudacityProject *project,
    if (!success) {
       // TODO: more precise message
       AudacityMessageBox( XO("Unable to export") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
+   // Make the mixer first, in case that throws
+   job->mMixer = CreateMixer(tracks, selectionOnly,
+                            t0, t1,
+                            numChannels, SAMPLES_PER_RUN, false,
+                            rate, format, true, mixerSpec);
+
 #ifdef LEGACY_FLAC
    encoder.init();
 #else
-   wxFFile f;     // will be closed when it goes out of scope
+   auto &f = job->mFile;
    const auto path = fName.GetFullPath();
    if (!f.Open(path, wxT("w+b"))) {
       AudacityMessageBox( XO("FLAC export couldn't open %s").Format( path ) );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
    // Even though there is an init() method that takes a filename, use the one that
@@ -356,43 +443,47 @@ ProgressResult ExportFLAC::Export(AudacityProject *project,
       AudacityMessageBox(
          XO("FLAC encoder failed to initialize\nStatus: %d")
             .Format( status ) );
-      return ProgressResult::Cancelled;
+      return {};
    }
 #endif
+   job->mInitialized = true;
 
    mMetadata.reset();
 
+   job->mFormat = format;
+   job->mNumChannels = numChannels;
+   job->mT0 = t0;
+   job->mT1 = t1;
+
+   result = ProgressResult::Success;
+   return job;
+}
+
+ProgressResult FLACExportJob::Run(ExportProgress &progress)
+{
+   wxLogNull logNo;            // temporarily disable wxWidgets error messages
+   auto updateResult = ProgressResult::Success;
+
    auto cleanup2 = finally( [&] {
       if (!(updateResult == ProgressResult::Success ||
             updateResult == ProgressResult::Stopped)) {
-#ifndef LEGACY_FLAC
-         f.Detach(); // libflac closes the file
-#endif
-         encoder.finish();
+         Abandon();
       }
+      mMixer.reset();
    } );
 
-   auto mixer = CreateMixer(tracks, selectionOnly,
-                            t0, t1,
-                            numChannels, SAMPLES_PER_RUN, false,
-                            rate, format, true, mixerSpec);
-
+   const auto numChannels = mNumChannels;
+   const auto format = mFormat;
    ArraysOf<FLAC__int32> tmpsmplbuf{ numChannels, SAMPLES_PER_RUN, true };
 
-   InitProgress( pDialog, fName,
-      selectionOnly
-         ? XO("Exporting the selected audio as FLAC")
-         : XO("Exporting the audio as FLAC") );
-   auto &progress = *pDialog;
-
    while (updateResult == ProgressResult::Success) {
-      auto samplesThisRun = mixer->Process(SAMPLES_PER_RUN);
+      auto samplesThisRun = mMixer->Process(SAMPLES_PER_RUN);
       if (samplesThisRun == 0) { //stop encoding
          break;
       }
       else {
          for (size_t i = 0; i < numChannels; i++) {
-            samplePtr mixed = mixer->GetBuffer(i);
+            samplePtr mixed = mMixer->GetBuffer(i);
             if (format == int24Sample) {
                for (decltype(samplesThisRun) j = 0; j < samplesThisRun; j++) {
                   tmpsmplbuf[i][j] = ((int *)mixed)[j];
@@ -404,26 +495,27 @@ ProgressResult ExportFLAC::Export(AudacityProject *project,
                }
             }
          }
-         if (! encoder.process(
+         if (! mEncoder.process(
                reinterpret_cast<FLAC__int32**>( tmpsmplbuf.get() ),
                samplesThisRun) ) {
             // TODO: more precise message
-            AudacityMessageBox( XO("Unable to export") );
+            progress.ReportError( XO("Unable to export") );
             updateResult = ProgressResult::Cancelled;
             break;
          }
          if (updateResult == ProgressResult::Success)
             updateResult =
-               progress.Update(mixer->MixGetCurrentTime() - t0, t1 - t0);
+               progress.Update(mMixer->MixGetCurrentTime() - mT0, mT1 - mT0);
       }
    }
 
    if (updateResult == ProgressResult::Success ||
        updateResult == ProgressResult::Stopped) {
+      mInitialized = false;
 #ifndef LEGACY_FLAC
-      f.Detach(); // libflac closes the file
+      mFile.Detach(); // libflac closes the file
 #endif
-      if (!encoder.finish())
+      if (!mEncoder.finish())
          // Do not reassign updateResult, see cleanup2
          return ProgressResult::Failed;
 #ifdef LEGACY_FLAC
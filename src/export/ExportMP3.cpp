@@ -1691,6 +1691,17 @@ public:
                MixerSpec *mixerSpec = NULL,
                const Tags *metadata = NULL,
                int subformat = 0) override;
+   bool CanPrepareExport(int subformat) override;
+   std::unique_ptr<ExportJob> PrepareExport(AudacityProject *project,
+               unsigned channels,
+               const wxFileNameWrapper &fName,
+               bool selectedOnly,
+               double t0,
+               double t1,
+               MixerSpec *mixerSpec,
+               const Tags *metadata,
+               int subformat,
+               ProgressResult &result) override;
 
 private:
 
@@ -1739,6 +1750,33 @@ int ExportMP3::SetNumExportChannels()
 }
 
 
+/// Mixes and encodes the audio for ExportMP3, after the encoder and the
+/// file are ready
+class MP3ExportJob final : public ExportJob
+{
+public:
+   explicit MP3ExportJob(const wxString &name)
+      : ExportJob{ name, {} }
+   {}
+
+   ProgressResult Run(ExportProgress &progress) override;
+
+private:
+   friend ExportMP3;
+
+   MP3Exporter mExporter;
+   wxFFile mOutFile;
+   ArrayOf<char> mId3Buffer;
+   unsigned long mId3Len{ 0 };
+   bool mEndOfFile{ false };
+   wxFileOffset mPos{ 0 };
+   int mInSamples{ 0 };
+   unsigned mChannels{ 0 };
+   ArrayOf<unsigned char> mBuffer;
+   std::unique_ptr<Mixer> mMixer;
+   double mT0{ 0 }, mT1{ 0 };
+};
+
 ProgressResult ExportMP3::Export(AudacityProject *project,
                        std::unique_ptr<ProgressDialog> &pDialog,
                        unsigned channels,
@@ -1748,14 +1786,40 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
                        double t1,
                        MixerSpec *mixerSpec,
                        const Tags *metadata,
-                       int WXUNUSED(subformat))
+                       int subformat)
+{
+   auto result = ProgressResult::Success;
+   auto job = PrepareExport(project, channels, fName, selectionOnly,
+      t0, t1, mixerSpec, metadata, subformat, result);
+   if (!job)
+      return result;
+   return RunExportJob(*job, pDialog);
+}
+
+bool ExportMP3::CanPrepareExport(int WXUNUSED(subformat))
+{
+   return true;
+}
+
+std::unique_ptr<ExportJob> ExportMP3::PrepareExport(AudacityProject *project,
+                       unsigned channels,
+                       const wxFileNameWrapper &fName,
+                       bool selectionOnly,
+                       double t0,
+                       double t1,
+                       MixerSpec *mixerSpec,
+                       const Tags *metadata,
+                       int WXUNUSED(subformat),
+                       ProgressResult &result)
 {
    int rate = lrint( ProjectSettings::Get( *project ).GetRate());
 #ifndef DISABLE_DYNAMIC_LOADING_LAME
    wxWindow *parent = ProjectWindow::Find( project );
 #endif // DISABLE_DYNAMIC_LOADING_LAME
    const auto &tracks = TrackList::Get( *project );
-   MP3Exporter exporter;
+   auto job = std::make_unique<MP3ExportJob>(fName.GetName());
+   auto &exporter = job->mExporter;
+   result = ProgressResult::Cancelled;
 
 #ifdef DISABLE_DYNAMIC_LOADING_LAME
    if (!exporter.InitLibrary(wxT(""))) {
@@ -1763,7 +1827,7 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
       gPrefs->Write(wxT("/MP3/MP3LibPath"), wxString(wxT("")));
       gPrefs->Flush();
 
-      return ProgressResult::Cancelled;
+      return {};
    }
 #else
    if (!exporter.LoadLibrary(parent, MP3Exporter::Maybe)) {
@@ -1771,7 +1835,7 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
       gPrefs->Write(wxT("/MP3/MP3LibPath"), wxString(wxT("")));
       gPrefs->Flush();
 
-      return ProgressResult::Cancelled;
+      return {};
    }
 
    if (!exporter.ValidLibraryLoaded()) {
@@ -1779,7 +1843,7 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
       gPrefs->Write(wxT("/MP3/MP3LibPath"), wxString(wxT("")));
       gPrefs->Flush();
 
-      return ProgressResult::Cancelled;
+      return {};
    }
 #endif // DISABLE_DYNAMIC_LOADING_LAME
 
@@ -1842,7 +1906,7 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
       (rate < lowrate) || (rate > highrate)) {
       rate = AskResample(bitrate, rate, lowrate, highrate);
       if (rate == 0) {
-         return ProgressResult::Cancelled;
+         return {};
       }
    }
 
@@ -1860,7 +1924,7 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
    auto inSamples = exporter.InitializeStream(channels, rate);
    if (((int)inSamples) < 0) {
       AudacityMessageBox( XO("Unable to initialize MP3 stream") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
    // Put ID3 tags at beginning of file
@@ -1868,65 +1932,83 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
       metadata = &Tags::Get( *project );
 
    // Open file for writing
-   wxFFile outFile(fName.GetFullPath(), wxT("w+b"));
+   auto &outFile = job->mOutFile;
+   outFile.Open(fName.GetFullPath(), wxT("w+b"));
    if (!outFile.IsOpened()) {
       AudacityMessageBox( XO("Unable to open target file for writing") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
-   ArrayOf<char> id3buffer;
-   bool endOfFile;
+   auto &id3buffer = job->mId3Buffer;
+   bool &endOfFile = job->mEndOfFile;
    unsigned long id3len = AddTags(project, id3buffer, &endOfFile, metadata);
+   job->mId3Len = id3len;
    if (id3len && !endOfFile) {
       if (id3len > outFile.Write(id3buffer.get(), id3len)) {
          // TODO: more precise message
          AudacityMessageBox( XO("Unable to export") );
-         return ProgressResult::Cancelled;
+         return {};
       }
    }
 
-   wxFileOffset pos = outFile.Tell();
-   auto updateResult = ProgressResult::Success;
-   int bytes = 0;
+   job->mPos = outFile.Tell();
 
    size_t bufferSize = std::max(0, exporter.GetOutBufferSize());
    if (bufferSize <= 0) {
       // TODO: more precise message
       AudacityMessageBox( XO("Unable to export") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
-   ArrayOf<unsigned char> buffer{ bufferSize };
-   wxASSERT(buffer);
+   job->mBuffer.reinit(bufferSize);
+   wxASSERT(job->mBuffer);
 
-   {
-      auto mixer = CreateMixer(tracks, selectionOnly,
-         t0, t1,
-         channels, inSamples, true,
-         rate, floatSample, true, mixerSpec);
-
-      TranslatableString title;
-      if (rmode == MODE_SET) {
-         title = (selectionOnly ?
-            XO("Exporting selected audio with %s preset") :
-            XO("Exporting the audio with %s preset"))
-               .Format( setRateNamesShort[brate] );
-      }
-      else if (rmode == MODE_VBR) {
-         title = (selectionOnly ?
-            XO("Exporting selected audio with VBR quality %s") :
-            XO("Exporting the audio with VBR quality %s"))
-               .Format( varRateNames[brate] );
-      }
-      else {
-         title = (selectionOnly ?
-            XO("Exporting selected audio at %d Kbps") :
-            XO("Exporting the audio at %d Kbps"))
-               .Format( bitrate );
-      }
+   job->mMixer = CreateMixer(tracks, selectionOnly,
+      t0, t1,
+      channels, inSamples, true,
+      rate, floatSample, true, mixerSpec);
+
+   if (rmode == MODE_SET) {
+      job->SetMessage( (selectionOnly ?
+         XO("Exporting selected audio with %s preset") :
+         XO("Exporting the audio with %s preset"))
+            .Format( setRateNamesShort[brate] ) );
+   }
+   else if (rmode == MODE_VBR) {
+      job->SetMessage( (selectionOnly ?
+         XO("Exporting selected audio with VBR quality %s") :
+         XO("Exporting the audio with VBR quality %s"))
+            .Format( varRateNames[brate] ) );
+   }
+   else {
+      job->SetMessage( (selectionOnly ?
+         XO("Exporting selected audio at %d Kbps") :
+         XO("Exporting the audio at %d Kbps"))
+            .Format( bitrate ) );
+   }
 
-      InitProgress( pDialog, fName, title );
-      auto &progress = *pDialog;
+   job->mInSamples = inSamples;
+   job->mChannels = channels;
+   job->mT0 = t0;
+   job->mT1 = t1;
+
+   result = ProgressResult::Success;
+   return job;
+}
+
+ProgressResult MP3ExportJob::Run(ExportProgress &progress)
+{
+   auto &exporter = mExporter;
+   auto &outFile = mOutFile;
+   auto &buffer = mBuffer;
+   const auto inSamples = mInSamples;
+   const auto channels = mChannels;
+   auto updateResult = ProgressResult::Success;
+   int bytes = 0;
+
+   {
+      auto closeMixer = finally( [&]{ mMixer.reset(); } );
+      auto &mixer = mMixer;
 
       while (updateResult == ProgressResult::Success) {
          auto blockLen = mixer->Process(inSamples);
@@ -1957,19 +2039,19 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
          if (bytes < 0) {
             auto msg = XO("Error %ld returned from MP3 encoder")
                .Format( bytes );
-            AudacityMessageBox( msg );
+            progress.ReportError( msg );
             updateResult = ProgressResult::Cancelled;
             break;
          }
 
          if (bytes > (int)outFile.Write(buffer.get(), bytes)) {
             // TODO: more precise message
-            AudacityMessageBox( XO("Unable to export") );
+            progress.ReportError( XO("Unable to export") );
             updateResult = ProgressResult::Cancelled;
             break;
          }
 
-         updateResult = progress.Update(mixer->MixGetCurrentTime() - t0, t1 - t0);
+         updateResult = progress.Update(mixer->MixGetCurrentTime() - mT0, mT1 - mT0);
       }
    }
 
@@ -1979,23 +2061,23 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
 
       if (bytes < 0) {
          // TODO: more precise message
-         AudacityMessageBox( XO("Unable to export") );
+         progress.ReportError( XO("Unable to export") );
          return ProgressResult::Cancelled;
       }
 
       if (bytes > 0) {
          if (bytes > (int)outFile.Write(buffer.get(), bytes)) {
             // TODO: more precise message
-            AudacityMessageBox( XO("Unable to export") );
+            progress.ReportError( XO("Unable to export") );
             return ProgressResult::Cancelled;
          }
       }
 
       // Write ID3 tag if it was supposed to be at the end of the file
-      if (id3len > 0 && endOfFile) {
-         if (bytes > (int)outFile.Write(id3buffer.get(), id3len)) {
+      if (mId3Len > 0 && mEndOfFile) {
+         if (bytes > (int)outFile.Write(mId3Buffer.get(), mId3Len)) {
             // TODO: more precise message
-            AudacityMessageBox( XO("Unable to export") );
+            progress.ReportError( XO("Unable to export") );
             return ProgressResult::Cancelled;
          }
       }
@@ -2006,11 +2088,11 @@ ProgressResult ExportMP3::Export(AudacityProject *project,
       //
       // Also, if beWriteInfoTag() is used, mGF will no longer be valid after
       // this call, so do not use it.
-      if (!exporter.PutInfoTag(outFile, pos) ||
+      if (!exporter.PutInfoTag(outFile, mPos) ||
           !outFile.Flush() ||
           !outFile.Close()) {
          // TODO: more precise message
-         AudacityMessageBox( XO("Unable to export") );
+         progress.ReportError( XO("Unable to export") );
          return ProgressResult::Cancelled;
       }
    }
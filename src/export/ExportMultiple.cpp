@@ -18,6 +18,13 @@
 #include "../Audacity.h"
 #include "ExportMultiple.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <list>
+#include <mutex>
+
 #include <wx/defs.h>
 #include <wx/button.h>
 #include <wx/checkbox.h>
@@ -49,6 +56,7 @@
 #include "../SelectionState.h"
 #include "../ShuttleGui.h"
 #include "../Tags.h"
+#include "../ThreadPool.h"
 #include "../WaveTrack.h"
 #include "../widgets/HelpSystem.h"
 #include "../widgets/AudacityMessageBox.h"
@@ -56,28 +64,6 @@
 #include "../widgets/ProgressDialog.h"
 
 
-namespace {
-/** \brief A private class used to store the information needed to do an
-    * export.
-    *
-    * We create a set of these during the interactive phase of the export
-    * cycle, then use them when the actual exports are done. */
-   class ExportKit
-   {
-   public:
-      Tags filetags; /**< The set of metadata to use for the export */
-      wxFileNameWrapper destfile; /**< The file to export to */
-      double t0;           /**< Start time for the export */
-      double t1;           /**< End time for the export */
-      unsigned channels;   /**< Number of channels for ExportMultipleByTrack */
-   };  // end of ExportKit declaration
-   /* we are going to want an set of these kits, and don't know how many until
-    * runtime. I would dearly like to use a std::vector, but it seems that
-    * this isn't done anywhere else in Audacity, presumably for a reason?, so
-    * I'm stuck with wxArrays, which are much harder, as well as non-standard.
-    */
-}
-
 /* define our dynamic array of export settings */
 
 enum {
@@ -678,7 +664,7 @@ bool ExportMultipleDialog::DirOk()
    return fn.Mkdir(0777, wxPATH_MKDIR_FULL);
 }
 
-static unsigned GetNumExportChannels( const TrackList &tracks )
+unsigned GetNumExportChannels( const TrackList &tracks )
 {
    /* counters for tracks panned different places */
    int numLeft = 0;
@@ -740,7 +726,7 @@ ProgressResult ExportMultipleDialog::ExportMultipleByLabel(bool byName,
    wxASSERT(mProject);
    int numFiles = mNumLabels;
    int l = 0;        // counter for files done
-   std::vector<ExportKit> exportSettings; // dynamic array for settings.
+   std::vector<ExportMultipleItem> exportSettings; // dynamic array for settings.
    exportSettings.reserve(numFiles); // Allocate some guessed space to use.
 
    // Account for exporting before first label
@@ -751,10 +737,11 @@ ProgressResult ExportMultipleDialog::ExportMultipleByLabel(bool byName,
 
    // Figure out how many channels we should export.
    auto channels = GetNumExportChannels( *mTracks );
+   setting.channels = channels;
 
    FilePaths otherNames;  // keep track of file names we will use, so we
    // don't duplicate them
-   ExportKit setting;   // the current batch of settings
+   ExportMultipleItem setting;   // the current batch of settings
    setting.destfile.SetPath(mDir->GetValue());
    setting.destfile.SetExt(mPlugins[mPluginIndex]->GetExtension(mSubFormatIndex));
    wxLogDebug(wxT("Plug-in index = %d, Sub-format = %d"), mPluginIndex, mSubFormatIndex);
@@ -853,39 +840,11 @@ ProgressResult ExportMultipleDialog::ExportMultipleByLabel(bool byName,
       l++;  // next label, count up one
    }
 
-   auto ok = ProgressResult::Success;   // did it work?
-   int count = 0; // count the number of successful runs
-   ExportKit activeSetting;  // pointer to the settings in use for this export
    /* Go round again and do the exporting (so this run is slow but
     * non-interactive) */
-   std::unique_ptr<ProgressDialog> pDialog;
-   for (count = 0; count < numFiles; count++) {
-      /* get the settings to use for the export from the array */
-      activeSetting = exportSettings[count];
-      // Bug 1440 fix.
-      if( activeSetting.destfile.GetName().empty() )
-         continue;
-
-      // Export it
-      ok = DoExport(pDialog, channels, activeSetting.destfile, false,
-         activeSetting.t0, activeSetting.t1, activeSetting.filetags);
-      if (ok == ProgressResult::Stopped) {
-         AudacityMessageDialog dlgMessage(
-            nullptr,
-            XO("Continue to export remaining files?"),
-            XO("Export"),
-            wxYES_NO | wxNO_DEFAULT | wxICON_WARNING);
-         if (dlgMessage.ShowModal() != wxID_YES ) {
-            // User decided not to continue - bail out!
-            break;
-         }
-      }
-      else if (ok != ProgressResult::Success) {
-         break;
-      }
-   }
-
-   return ok;
+   return ExportMultipleFiles(*mProject,
+      *mPlugins[mPluginIndex], mSubFormatIndex, exportSettings,
+      mOverwrite->GetValue(), mExported);
 }
 
 ProgressResult ExportMultipleDialog::ExportMultipleByTrack(bool byName,
@@ -895,10 +854,10 @@ ProgressResult ExportMultipleDialog::ExportMultipleByTrack(bool byName,
    int l = 0;     // track counter
    auto ok = ProgressResult::Success;
    FilePaths otherNames;
-   std::vector<ExportKit> exportSettings; // dynamic array we will use to store the
+   std::vector<ExportMultipleItem> exportSettings; // dynamic array we will use to store the
                                   // settings needed to do the exports with in
    exportSettings.reserve(mNumWaveTracks);   // Allocate some guessed space to use.
-   ExportKit setting;   // the current batch of settings
+   ExportMultipleItem setting;   // the current batch of settings
    setting.destfile.SetPath(mDir->GetValue());
    setting.destfile.SetExt(mPlugins[mPluginIndex]->GetExtension(mSubFormatIndex));
 
@@ -996,33 +955,137 @@ ProgressResult ExportMultipleDialog::ExportMultipleByTrack(bool byName,
       l++;  // next track, count up one
    }
    // end of user-interactive data gathering loop, start of export processing
-   // loop
-   int count = 0; // count the number of successful runs
-   ExportKit activeSetting;  // pointer to the settings in use for this export
-   std::unique_ptr<ProgressDialog> pDialog;
+   return ExportMultipleFiles(*mProject,
+      *mPlugins[mPluginIndex], mSubFormatIndex, exportSettings,
+      mOverwrite->GetValue(), mExported);
+}
 
-   for (auto tr : mTracks->Leaders<WaveTrack>() - 
-      (anySolo ? &WaveTrack::GetNotSolo : &WaveTrack::GetMute)) {
+namespace {
 
-      wxLogDebug( "Get setting %i", count );
-      /* get the settings to use for the export from the array */
-      activeSetting = exportSettings[count];
-      if( activeSetting.destfile.GetName().empty() ){
-         count++;
-         continue;
+/// The file that one item is written to, and the original that it replaces
+struct ExportFile
+{
+   wxString fullPath;
+   wxFileName backup;
+};
+
+// Choose the file name, moving any file to be overwritten out of the way.
+// Returns false if the user must not write to the file.
+bool BeginFile(AudacityProject &project,
+   const wxFileName &inName, bool overwrite, ExportFile &file)
+{
+   wxFileName name;
+
+   wxLogDebug(wxT("Doing multiple Export: File name \"%s\""), (inName.GetFullName()));
+
+   if (overwrite) {
+      // Make sure we don't overwrite (corrupt) alias files
+      if (!DirManager::Get( project ).EnsureSafeFilename(inName)) {
+         return false;
       }
+      name = inName;
+      file.backup.Assign(name);
 
-      /* Select the track */
-      SelectionStateChanger changer2{ mSelectionState, *mTracks };
-      const auto range = TrackList::Channels(tr);
-      for (auto channel : range)
+      int suffix = 0;
+      do {
+         file.backup.SetName(name.GetName() +
+                           wxString::Format(wxT("%d"), suffix));
+         ++suffix;
+      }
+      while (file.backup.FileExists());
+      ::wxRenameFile(inName.GetFullPath(), file.backup.GetFullPath());
+   }
+   else {
+      name = inName;
+      int i = 2;
+      wxString base(name.GetName());
+      while (name.FileExists()) {
+         name.SetName(wxString::Format(wxT("%s-%d"), base, i++));
+      }
+   }
+
+   file.fullPath = name.GetFullPath();
+   return true;
+}
+
+// Keep the new file or restore the old one, depending on how the export went
+void EndFile(const ExportFile &file, ProgressResult success)
+{
+   bool ok =
+      success == ProgressResult::Stopped ||
+      success == ProgressResult::Success;
+   if (file.backup.IsOk()) {
+      if ( ok )
+         // Remove backup
+         ::wxRemoveFile(file.backup.GetFullPath());
+      else {
+         // Restore original
+         ::wxRemoveFile(file.fullPath);
+         ::wxRenameFile(file.backup.GetFullPath(), file.fullPath);
+      }
+   }
+   else {
+      if ( ! ok )
+         // Remove any new, and only partially written, file.
+         ::wxRemoveFile(file.fullPath);
+   }
+}
+
+// Selects just the track of the item, if any, until destroyed
+class ItemSelection
+{
+public:
+   ItemSelection(AudacityProject &project, const ExportMultipleItem &item)
+   {
+      if (!item.track)
+         return;
+      auto &tracks = TrackList::Get( project );
+      mChanger.emplace( SelectionState::Get( project ), tracks );
+      for (auto tr : tracks.Selected<WaveTrack>())
+         tr->SetSelected(false);
+      for (auto channel : TrackList::Channels(item.track))
          channel->SetSelected(true);
+   }
+
+private:
+   Optional<SelectionStateChanger> mChanger;
+};
+
+ProgressResult ExportSerially(AudacityProject &project,
+   ExportPlugin &plugin, int subformat,
+   const std::vector<ExportMultipleItem> &items,
+   bool overwrite, FilePaths &exported, bool interactive)
+{
+   auto ok = ProgressResult::Success;
+   std::unique_ptr<ProgressDialog> pDialog;
+
+   for (const auto &item : items) {
+      // Bug 1440 fix.
+      if( item.destfile.GetName().empty() )
+         continue;
+
+      ExportFile file;
+      if (!BeginFile(project, item.destfile, overwrite, file))
+         return ProgressResult::Cancelled;
+
+      ProgressResult success = ProgressResult::Cancelled;
+      {
+         auto cleanup = finally( [&] { EndFile(file, success); } );
+         ItemSelection selection{ project, item };
+
+         // Call the format export routine
+         success = plugin.Export(&project, pDialog,
+            item.channels, file.fullPath, item.track != nullptr,
+            item.t0, item.t1, NULL, &item.filetags, subformat);
+      }
+      ok = success;
+
+      if (ok == ProgressResult::Success || ok == ProgressResult::Stopped)
+         exported.push_back(file.fullPath);
 
-      // Export the data. "channels" are per track.
-      ok = DoExport(pDialog,
-         activeSetting.channels, activeSetting.destfile, true,
-         activeSetting.t0, activeSetting.t1, activeSetting.filetags);
       if (ok == ProgressResult::Stopped) {
+         if (!interactive)
+            break;
          AudacityMessageDialog dlgMessage(
             nullptr,
             XO("Continue to export remaining files?"),
@@ -1036,102 +1099,267 @@ ProgressResult ExportMultipleDialog::ExportMultipleByTrack(bool byName,
       else if (ok != ProgressResult::Success) {
          break;
       }
-      // increment export counter
-      count++;
-
    }
 
-   return ok ;
+   return ok;
 }
 
-ProgressResult ExportMultipleDialog::DoExport(std::unique_ptr<ProgressDialog> &pDialog,
-                              unsigned channels,
-                              const wxFileName &inName,
-                              bool selectedOnly,
-                              double t0,
-                              double t1,
-                              const Tags &tags)
+/// Collects what a job reports from its worker thread, for the main thread
+class JobProgress final : public ExportProgress
 {
-   wxFileName name;
+public:
+   ProgressResult Update(double current, double total) override
+   {
+      if (total > 0)
+         mFraction.store(
+            std::max(0.0, std::min(1.0, current / total)),
+            std::memory_order_relaxed);
+      return mRequest.load(std::memory_order_relaxed);
+   }
 
-   wxLogDebug(wxT("Doing multiple Export: File name \"%s\""), (inName.GetFullName()));
-   wxLogDebug(wxT("Channels: %i, Start: %lf, End: %lf "), channels, t0, t1);
-   if (selectedOnly)
-      wxLogDebug(wxT("Selected Region Only"));
-   else
-      wxLogDebug(wxT("Whole Project"));
+   void ReportError(const TranslatableString &message) override
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      mErrors.push_back(message);
+   }
 
-   wxFileName backup;
-   if (mOverwrite->GetValue()) {
-      // Make sure we don't overwrite (corrupt) alias files
-      if (!DirManager::Get( *mProject ).EnsureSafeFilename(inName)) {
-         return ProgressResult::Cancelled;
-      }
-      name = inName;
-      backup.Assign(name);
+   double GetFraction() const
+   { return mFraction.load(std::memory_order_relaxed); }
 
-      int suffix = 0;
-      do {
-         backup.SetName(name.GetName() +
-                           wxString::Format(wxT("%d"), suffix));
-         ++suffix;
-      }
-      while (backup.FileExists());
-      ::wxRenameFile(inName.GetFullPath(), backup.GetFullPath());
-   }
-   else {
-      name = inName;
-      int i = 2;
-      wxString base(name.GetName());
-      while (name.FileExists()) {
-         name.SetName(wxString::Format(wxT("%s-%d"), base, i++));
-      }
+   // Make the next Update() return Stopped or Cancelled
+   void Request(ProgressResult request)
+   { mRequest.store(request, std::memory_order_relaxed); }
+
+   std::vector<TranslatableString> TakeErrors()
+   {
+      std::vector<TranslatableString> errors;
+      std::lock_guard<std::mutex> lock{ mMutex };
+      errors.swap(mErrors);
+      return errors;
    }
 
-   ProgressResult success = ProgressResult::Cancelled;
-   const wxString fullPath{name.GetFullPath()};
+private:
+   std::atomic<double> mFraction{ 0.0 };
+   std::atomic<ProgressResult> mRequest{ ProgressResult::Success };
+   std::mutex mMutex;
+   std::vector<TranslatableString> mErrors;
+};
+
+/// A job that runs on the shared thread pool
+struct RunningExport
+{
+   size_t index;
+   ExportFile file;
+   std::unique_ptr<ExportJob> job;
+   JobProgress progress;
+   // Written by the pool before the batch finishes
+   ProgressResult result{ ProgressResult::Failed };
+   std::exception_ptr exception;
+};
 
+// Preparation of the jobs, and everything else that may touch the user
+// interface or the project, stays on the main thread.  Only ExportJob::Run()
+// happens elsewhere, in batches of nJobs on the shared thread pool.
+ProgressResult ExportConcurrently(AudacityProject &project,
+   ExportPlugin &plugin, int subformat,
+   const std::vector<ExportMultipleItem> &items,
+   bool overwrite, FilePaths &exported, bool interactive,
+   size_t nJobs)
+{
+   auto ok = ProgressResult::Success;
+   std::exception_ptr exception;
+   std::vector< std::pair<size_t, wxString> > done;
+
+   const auto nFiles = std::count_if(items.begin(), items.end(),
+      [](const ExportMultipleItem &item){
+         return !item.destfile.GetName().empty(); });
+   size_t nFinished = 0;
+
+   std::list<RunningExport> running;
+   std::vector<RunningExport *> batch;
+   std::future<void> task;
+   auto requestAll = [&](ProgressResult request){
+      for (auto &run : running)
+         run.progress.Request(request);
+   };
+   // Whatever happens, don't leave jobs writing files behind
    auto cleanup = finally( [&] {
-      bool ok =
-         success == ProgressResult::Stopped ||
-         success == ProgressResult::Success;
-      if (backup.IsOk()) {
-         if ( ok )
-            // Remove backup
-            ::wxRemoveFile(backup.GetFullPath());
-         else {
-            // Restore original
-            ::wxRemoveFile(fullPath);
-            ::wxRenameFile(backup.GetFullPath(), fullPath);
+      requestAll(ProgressResult::Cancelled);
+      if (task.valid())
+         task.wait();
+      for (auto &run : running) {
+         run.job.reset();
+         EndFile(run.file, ProgressResult::Cancelled);
+      }
+   } );
+
+   std::unique_ptr<ProgressDialog> pDialog;
+   size_t next = 0;
+   bool starting = true;
+
+   while (true) {
+      // Prepare the next batch
+      while (starting && next < items.size() && running.size() < nJobs) {
+         const auto index = next++;
+         const auto &item = items[index];
+         // Bug 1440 fix.
+         if( item.destfile.GetName().empty() )
+            continue;
+
+         ExportFile file;
+         if (!BeginFile(project, item.destfile, overwrite, file)) {
+            ok = ProgressResult::Cancelled;
+            starting = false;
+            break;
+         }
+
+         auto prepared = ProgressResult::Cancelled;
+         std::unique_ptr<ExportJob> job;
+         {
+            auto endFile = finally( [&] {
+               if (!job)
+                  EndFile(file, prepared);
+            } );
+            ItemSelection selection{ project, item };
+            job = plugin.PrepareExport(&project,
+               item.channels, file.fullPath, item.track != nullptr,
+               item.t0, item.t1, NULL, &item.filetags, subformat, prepared);
+         }
+         if (!job) {
+            ++nFinished;
+            if (prepared == ProgressResult::Success)
+               done.emplace_back(index, file.fullPath);
+            else {
+               ok = prepared;
+               starting = false;
+            }
+            continue;
          }
+
+         running.emplace_back();
+         auto &run = running.back();
+         run.index = index;
+         run.file = file;
+         run.job = std::move(job);
       }
-      else {
-         if ( ! ok )
-            // Remove any new, and only partially written, file.
-            ::wxRemoveFile(fullPath);
+
+      if (running.empty())
+         break;
+
+      // One thread joins the shared pool, or runs the whole batch if
+      // another caller has the pool, while this thread shows progress
+      batch.clear();
+      for (auto &run : running)
+         batch.push_back(&run);
+      task = std::async(std::launch::async, [&]{
+         ThreadPool::RunShared(batch.size(), [&](size_t ii){
+            auto &run = *batch[ii];
+            try {
+               run.result = run.job->Run(run.progress);
+            }
+            catch (...) {
+               run.exception = std::current_exception();
+            }
+         });
+      });
+
+      // One progress dialog for the whole set
+      bool stopping = false;
+      while (task.wait_for(std::chrono::milliseconds(50)) !=
+             std::future_status::ready) {
+         if (!pDialog)
+            pDialog = std::make_unique<ProgressDialog>(
+               XO("Export Multiple"),
+               XO("Exporting %lld files").Format( (long long) nFiles ) );
+         double current = nFinished;
+         for (const auto &run : running)
+            current += run.progress.GetFraction();
+         const auto update = pDialog->Update(current, (double) nFiles);
+         if (update == ProgressResult::Cancelled) {
+            ok = ProgressResult::Cancelled;
+            starting = false;
+            requestAll(ProgressResult::Cancelled);
+         }
+         else if (update == ProgressResult::Stopped && !stopping) {
+            stopping = true;
+            requestAll(ProgressResult::Stopped);
+         }
+      }
+      task.get();
+
+      // Collect the batch
+      while (!running.empty()) {
+         auto &run = running.front();
+         for (const auto &message : run.progress.TakeErrors())
+            AudacityMessageBox( message );
+         if (run.exception && !exception)
+            exception = run.exception;
+
+         // Close the file before keeping or removing it
+         run.job.reset();
+         const auto result = run.result;
+         EndFile(run.file, result);
+         if (result == ProgressResult::Success ||
+             result == ProgressResult::Stopped)
+            done.emplace_back(run.index, run.file.fullPath);
+         if (result != ProgressResult::Success &&
+             result != ProgressResult::Stopped) {
+            // Start no more
+            ok = result;
+            starting = false;
+         }
+         ++nFinished;
+         running.pop_front();
       }
-   } );
 
-   // Call the format export routine
-   success = mPlugins[mPluginIndex]->Export(mProject,
-                                            pDialog,
-                                                channels,
-                                                fullPath,
-                                                selectedOnly,
-                                                t0,
-                                                t1,
-                                                NULL,
-                                                &tags,
-                                                mSubFormatIndex);
-
-   if (success == ProgressResult::Success || success == ProgressResult::Stopped) {
-      mExported.push_back(fullPath);
+      if (exception)
+         starting = false;
+
+      if (stopping) {
+         // Maybe go on with the rest
+         if (ok == ProgressResult::Success)
+            ok = ProgressResult::Stopped;
+         if (!starting || !interactive || next >= items.size())
+            break;
+         AudacityMessageDialog dlgMessage(
+            nullptr,
+            XO("Continue to export remaining files?"),
+            XO("Export"),
+            wxYES_NO | wxNO_DEFAULT | wxICON_WARNING);
+         if (dlgMessage.ShowModal() != wxID_YES )
+            // User decided not to continue - bail out!
+            break;
+         ok = ProgressResult::Success;
+         if (pDialog)
+            pDialog->Reinit();
+      }
    }
 
-   Refresh();
-   Update();
+   if (exception)
+      std::rethrow_exception(exception);
+
+   std::sort(done.begin(), done.end());
+   for (const auto &pair : done)
+      exported.push_back(pair.second);
+
+   return ok;
+}
 
-   return success;
+}
+
+ProgressResult ExportMultipleFiles(AudacityProject &project,
+   ExportPlugin &plugin, int subformat,
+   const std::vector<ExportMultipleItem> &items,
+   bool overwrite, FilePaths &exported, bool interactive)
+{
+   // Each job has its own encoder and mixer, so the limit is only of the
+   // processors to share
+   const auto nThreads = ThreadPool::SharedThreadCount();
+   if (nThreads < 2 || !plugin.CanPrepareExport(subformat))
+      return ExportSerially(project, plugin, subformat, items,
+         overwrite, exported, interactive);
+   return ExportConcurrently(project, plugin, subformat, items,
+      overwrite, exported, interactive, nThreads + 1);
 }
 
 wxString ExportMultipleDialog::MakeFileName(const wxString &input)
@@ -12,6 +12,7 @@
 #define __AUDACITY_EXPORT_MULTIPLE__
 
 #include "Export.h"
+#include "../Tags.h" // member variable
 #include "../wxFileNameWrapper.h" // member variable
 
 class wxButton;
@@ -28,6 +29,43 @@ class LabelTrack;
 class SelectionState;
 class ShuttleGui;
 class Track;
+class TrackList;
+class WaveTrack;
+
+/// One file of an export multiple set, decided before any exporting starts
+struct ExportMultipleItem
+{
+   Tags filetags; /**< The set of metadata to use for the export */
+   wxFileNameWrapper destfile; /**< The file to export to; skipped if it
+                                 has no name */
+   double t0;           /**< Start time for the export */
+   double t1;           /**< End time for the export */
+   unsigned channels;   /**< Number of channels to export */
+   WaveTrack *track{};  /**< If not null, export this track only, else all
+                          of the project */
+};
+
+/// The number of channels, 1 or 2, for exporting all of the unmuted tracks
+AUDACITY_DLL_API
+unsigned GetNumExportChannels( const TrackList &tracks );
+
+/** \brief Export each item of a set to its own file, without questions
+ * about names or tags
+ *
+ * Formats whose plug-in can prepare an ExportJob encode several files at
+ * once, on a bounded number of threads, with one progress dialog for the
+ * whole set.  Other formats export one file at a time.
+ * @param overwrite Replace existing files, else choose new names
+ * @param exported Receives the paths of the files written, in the order of
+ * the items
+ * @param interactive If false, stopping does not ask whether to continue
+ * with the remaining files
+ * @return as for ExportPlugin::Export(), for the set */
+AUDACITY_DLL_API
+ProgressResult ExportMultipleFiles(AudacityProject &project,
+   ExportPlugin &plugin, int subformat,
+   const std::vector<ExportMultipleItem> &items,
+   bool overwrite, FilePaths &exported, bool interactive = true);
 
 class ExportMultipleDialog final : public wxDialogWrapper
 {
@@ -62,23 +100,6 @@ private:
     * numbered rather than named */
    ProgressResult ExportMultipleByTrack(bool byName, const wxString &prefix, bool addNumber);
 
-   /** Export one file of an export multiple set
-    *
-    * Called once for each file in the list to do a (non-interactive) export
-    * @param channels Number of channels to export
-    * @param name The file name (and path) to export to
-    * @param selectedOnly Should we  export the selected tracks only?
-    * @param t0 Start time for export
-    * @param t1 End time for export
-    * @param tags Metadata to include in the file (if possible).
-    */
-   ProgressResult DoExport(std::unique_ptr<ProgressDialog> &pDialog,
-                 unsigned channels,
-                 const wxFileName &name,
-                 bool selectedOnly,
-                 double t0,
-                 double t1,
-                 const Tags &tags);
    /** \brief Takes an arbitrary text string and converts it to a form that can
     * be used as a file name, if necessary prompting the user to edit the file
     * name produced */
@@ -36,6 +36,7 @@
 #include "../Track.h"
 #include "../widgets/AudacityMessageBox.h"
 #include "../widgets/ProgressDialog.h"
+#include "../wxFileNameWrapper.h"
 
 //----------------------------------------------------------------------------
 // ExportOGGOptions
@@ -142,6 +143,17 @@ public:
                MixerSpec *mixerSpec = NULL,
                const Tags *metadata = NULL,
                int subformat = 0) override;
+   bool CanPrepareExport(int subformat) override;
+   std::unique_ptr<ExportJob> PrepareExport(AudacityProject *project,
+               unsigned channels,
+               const wxFileNameWrapper &fName,
+               bool selectedOnly,
+               double t0,
+               double t1,
+               MixerSpec *mixerSpec,
+               const Tags *metadata,
+               int subformat,
+               ProgressResult &result) override;
 
 private:
 
@@ -159,6 +171,56 @@ ExportOGG::ExportOGG()
    SetDescription(XO("Ogg Vorbis Files"),0);
 }
 
+/// Mixes and encodes the audio for ExportOGG, after the headers are written
+class OGGExportJob final : public ExportJob
+{
+public:
+   OGGExportJob(const wxFileNameWrapper &fName,
+      const TranslatableString &message)
+      : ExportJob{ fName.GetName(), message }
+      , mOutFile{ fName, FileIO::Output }
+   {}
+   ~OGGExportJob() override;
+
+   ProgressResult Run(ExportProgress &progress) override;
+
+private:
+   friend ExportOGG;
+
+   FileIO mOutFile;
+
+   // All the Ogg and Vorbis encoding data
+   ogg_stream_state mStream{};
+   ogg_page         mPage{};
+   ogg_packet       mPacket{};
+
+   vorbis_info      mInfo{};
+   vorbis_comment   mComment{};
+   vorbis_dsp_state mDsp{};
+   vorbis_block     mBlock{};
+
+   // How far the setup got, for the cleanup
+   bool mInfoInitialized{ false };
+   bool mEncoderInitialized{ false };
+
+   std::unique_ptr<Mixer> mMixer;
+   unsigned mNumChannels;
+   double mT0, mT1;
+};
+
+OGGExportJob::~OGGExportJob()
+{
+   if (mEncoderInitialized) {
+      ogg_stream_clear(&mStream);
+
+      vorbis_block_clear(&mBlock);
+      vorbis_dsp_clear(&mDsp);
+      vorbis_comment_clear(&mComment);
+   }
+   if (mInfoInitialized)
+      vorbis_info_clear(&mInfo);
+}
+
 ProgressResult ExportOGG::Export(AudacityProject *project,
                        std::unique_ptr<ProgressDialog> &pDialog,
                        unsigned numChannels,
@@ -168,69 +230,82 @@ ProgressResult ExportOGG::Export(AudacityProject *project,
                        double t1,
                        MixerSpec *mixerSpec,
                        const Tags *metadata,
-                       int WXUNUSED(subformat))
+                       int subformat)
+{
+   auto result = ProgressResult::Success;
+   auto job = PrepareExport(project, numChannels, fName, selectionOnly,
+      t0, t1, mixerSpec, metadata, subformat, result);
+   if (!job)
+      return result;
+   return RunExportJob(*job, pDialog);
+}
+
+bool ExportOGG::CanPrepareExport(int WXUNUSED(subformat))
+{
+   return true;
+}
+
+std::unique_ptr<ExportJob> ExportOGG::PrepareExport(AudacityProject *project,
+                       unsigned numChannels,
+                       const wxFileNameWrapper &fName,
+                       bool selectionOnly,
+                       double t0,
+                       double t1,
+                       MixerSpec *mixerSpec,
+                       const Tags *metadata,
+                       int WXUNUSED(subformat),
+                       ProgressResult &result)
 {
    double    rate    = ProjectSettings::Get( *project ).GetRate();
    const auto &tracks = TrackList::Get( *project );
    double    quality = (gPrefs->Read(wxT("/FileFormats/OggExportQuality"), 50)/(float)100.0);
 
    wxLogNull logNo;            // temporarily disable wxWidgets error messages
-   auto updateResult = ProgressResult::Success;
-   int       eos = 0;
+   result = ProgressResult::Cancelled;
 
-   FileIO outFile(fName, FileIO::Output);
+   auto job = std::make_unique<OGGExportJob>(fName,
+      selectionOnly
+         ? XO("Exporting the selected audio as Ogg Vorbis")
+         : XO("Exporting the audio as Ogg Vorbis") );
+   auto &outFile = job->mOutFile;
 
    if (!outFile.IsOpened()) {
       AudacityMessageBox( XO("Unable to open target file for writing") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
-   // All the Ogg and Vorbis encoding data
-   ogg_stream_state stream;
-   ogg_page         page;
-   ogg_packet       packet;
-
-   vorbis_info      info;
-   vorbis_comment   comment;
-   vorbis_dsp_state dsp;
-   vorbis_block     block;
-
-
-   auto cleanup1 = finally( [&] {
-      vorbis_info_clear(&info);
-   } );
-
+   auto &stream = job->mStream;
+   auto &page = job->mPage;
+   auto &info = job->mInfo;
+   auto &comment = job->mComment;
+   auto &dsp = job->mDsp;
+   auto &block = job->mBlock;
 
    // Many of the library functions called below return 0 for success and
    // various nonzero codes for failure.
 
    // Encoding setup
    vorbis_info_init(&info);
+   job->mInfoInitialized = true;
    if (vorbis_encode_init_vbr(&info, numChannels, (int)(rate + 0.5), quality)) {
       // TODO: more precise message
       AudacityMessageBox( XO("Unable to export - rate or quality problem") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
-   auto cleanup2 = finally( [&] {
-      ogg_stream_clear(&stream);
-
-      vorbis_block_clear(&block);
-      vorbis_dsp_clear(&dsp);
-      vorbis_comment_clear(&comment);
-   } );
+   job->mEncoderInitialized = true;
 
    // Retrieve tags
    if (!FillComment(project, &comment, metadata)) {
       AudacityMessageBox( XO("Unable to export - problem with metadata") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
    // Set up analysis state and auxiliary encoding storage
    if (vorbis_analysis_init(&dsp, &info) ||
        vorbis_block_init(&dsp, &block)) {
       AudacityMessageBox( XO("Unable to export - problem initialising") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
    // Set up packet->stream encoder.  According to encoder example,
@@ -239,7 +314,7 @@ ProgressResult ExportOGG::Export(AudacityProject *project,
    srand(time(NULL));
    if (ogg_stream_init(&stream, rand())) {
       AudacityMessageBox( XO("Unable to export - problem creating stream") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
    // First we need to write the required headers:
@@ -261,7 +336,7 @@ ProgressResult ExportOGG::Export(AudacityProject *project,
       ogg_stream_packetin(&stream, &comment_header) ||
       ogg_stream_packetin(&stream, &codebook_header)) {
       AudacityMessageBox( XO("Unable to export - problem with packets") );
-      return ProgressResult::Cancelled;
+      return {};
    }
 
    // Flushing these headers now guarantees that audio data will
@@ -270,21 +345,38 @@ ProgressResult ExportOGG::Export(AudacityProject *project,
       if ( outFile.Write(page.header, page.header_len).GetLastError() ||
            outFile.Write(page.body, page.body_len).GetLastError()) {
          AudacityMessageBox( XO("Unable to export - problem with file") );
-         return ProgressResult::Cancelled;
+         return {};
       }
    }
 
-   {
-      auto mixer = CreateMixer(tracks, selectionOnly,
-         t0, t1,
-         numChannels, SAMPLES_PER_RUN, false,
-         rate, floatSample, true, mixerSpec);
+   job->mMixer = CreateMixer(tracks, selectionOnly,
+      t0, t1,
+      numChannels, SAMPLES_PER_RUN, false,
+      rate, floatSample, true, mixerSpec);
+   job->mNumChannels = numChannels;
+   job->mT0 = t0;
+   job->mT1 = t1;
 
-      InitProgress( pDialog, fName,
-         selectionOnly
-            ? XO("Exporting the selected audio as Ogg Vorbis")
-            : XO("Exporting the audio as Ogg Vorbis") );
-      auto &progress = *pDialog;
+   result = ProgressResult::Success;
+   return job;
+}
+
+ProgressResult OGGExportJob::Run(ExportProgress &progress)
+{
+   wxLogNull logNo;            // temporarily disable wxWidgets error messages
+   auto updateResult = ProgressResult::Success;
+   int       eos = 0;
+
+   auto &outFile = mOutFile;
+   auto &stream = mStream;
+   auto &page = mPage;
+   auto &packet = mPacket;
+   auto &dsp = mDsp;
+   auto &block = mBlock;
+
+   {
+      auto cleanup = finally( [&] { mMixer.reset(); } );
+      auto &mixer = mMixer;
 
       while (updateResult == ProgressResult::Success && !eos) {
          float **vorbis_buffer = vorbis_analysis_buffer(&dsp, SAMPLES_PER_RUN);
@@ -297,7 +389,7 @@ ProgressResult ExportOGG::Export(AudacityProject *project,
          }
          else {
 
-            for (size_t i = 0; i < numChannels; i++) {
+            for (size_t i = 0; i < mNumChannels; i++) {
                float *temp = (float *)mixer->GetBuffer(i);
                memcpy(vorbis_buffer[i], temp, sizeof(float)*SAMPLES_PER_RUN);
             }
@@ -337,7 +429,7 @@ ProgressResult ExportOGG::Export(AudacityProject *project,
                   if ( outFile.Write(page.header, page.header_len).GetLastError() ||
                        outFile.Write(page.body, page.body_len).GetLastError()) {
                      // TODO: more precise message
-                     AudacityMessageBox( XO("Unable to export") );
+                     progress.ReportError( XO("Unable to export") );
                      return ProgressResult::Cancelled;
                   }
 
@@ -351,18 +443,18 @@ ProgressResult ExportOGG::Export(AudacityProject *project,
          if (err) {
             updateResult = ProgressResult::Cancelled;
             // TODO: more precise message
-            AudacityMessageBox( XO("Unable to export") );
+            progress.ReportError( XO("Unable to export") );
             break;
          }
 
-         updateResult = progress.Update(mixer->MixGetCurrentTime() - t0, t1 - t0);
+         updateResult = progress.Update(mixer->MixGetCurrentTime() - mT0, mT1 - mT0);
       }
    }
 
    if ( !outFile.Close() ) {
       updateResult = ProgressResult::Cancelled;
       // TODO: more precise message
-      AudacityMessageBox( XO("Unable to export") );
+      progress.ReportError( XO("Unable to export") );
    }
 
    return updateResult;
@@ -410,12 +410,25 @@ public:
                          MixerSpec *mixerSpec = NULL,
                          const Tags *metadata = NULL,
                          int subformat = 0) override;
+   bool CanPrepareExport(int subformat) override;
+   std::unique_ptr<ExportJob> PrepareExport(AudacityProject *project,
+                         unsigned channels,
+                         const wxFileNameWrapper &fName,
+                         bool selectedOnly,
+                         double t0,
+                         double t1,
+                         MixerSpec *mixerSpec,
+                         const Tags *metadata,
+                         int subformat,
+                         ProgressResult &result) override;
    // optional
    wxString GetFormat(int index) override;
    FileExtension GetExtension(int index) override;
    unsigned GetMaxChannels(int index) override;
 
 private:
+   friend class PCMExportJob;
+
    void ReportTooBigError(wxWindow * pParent);
    ArrayOf<char> AdjustString(const wxString & wxStr, int sf_format);
    bool AddStrings(AudacityProject *project, SNDFILE *sf, const Tags *tags, int sf_format);
@@ -469,6 +482,35 @@ void ExportPCM::ReportTooBigError(wxWindow * pParent)
 #endif
 }
 
+/// Mixes and writes the audio for ExportPCM, after the file is open
+class PCMExportJob final : public ExportJob
+{
+public:
+   PCMExportJob(const wxFileNameWrapper &fName,
+      const TranslatableString &message, ExportPCM &plugin)
+      : ExportJob{ fName.GetName(), message }
+      , mPlugin{ plugin }
+      , mFileName{ fName }
+   {}
+
+   ProgressResult Run(ExportProgress &progress) override;
+
+private:
+   friend ExportPCM;
+
+   ExportPCM &mPlugin;
+   const wxFileNameWrapper mFileName;
+   wxFile mFile;   // will be closed when it goes out of scope
+   SFFile mSF; // wraps mFile
+   std::unique_ptr<Mixer> mMixer;
+   wxString mFormatStr;
+   int mSFFormat;
+   sampleFormat mFormat;
+   size_t mMaxBlockLen;
+   double mT0, mT1;
+   const Tags *mMetadata;
+};
+
 /**
  *
  * @param subformat Control whether we are doing a "preset" export to a popular
@@ -484,6 +526,30 @@ ProgressResult ExportPCM::Export(AudacityProject *project,
                                  MixerSpec *mixerSpec,
                                  const Tags *metadata,
                                  int subformat)
+{
+   auto result = ProgressResult::Success;
+   auto job = PrepareExport(project, numChannels, fName, selectionOnly,
+      t0, t1, mixerSpec, metadata, subformat, result);
+   if (!job)
+      return result;
+   return RunExportJob(*job, pDialog);
+}
+
+bool ExportPCM::CanPrepareExport(int WXUNUSED(subformat))
+{
+   return true;
+}
+
+std::unique_ptr<ExportJob> ExportPCM::PrepareExport(AudacityProject *project,
+                                 unsigned numChannels,
+                                 const wxFileNameWrapper &fName,
+                                 bool selectionOnly,
+                                 double t0,
+                                 double t1,
+                                 MixerSpec *mixerSpec,
+                                 const Tags *metadata,
+                                 int subformat,
+                                 ProgressResult &result)
 {
    double rate = ProjectSettings::Get( *project ).GetRate();
    const auto &tracks = TrackList::Get( *project );
@@ -523,166 +589,191 @@ ProgressResult ExportPCM::Export(AudacityProject *project,
    }
 
    int fileFormat = sf_format & SF_FORMAT_TYPEMASK;
-   
-   auto updateResult = ProgressResult::Success;
-   {
-      wxFile f;   // will be closed when it goes out of scope
-      SFFile       sf; // wraps f
 
-      wxString     formatStr;
-      SF_INFO      info;
-      //int          err;
+   result = ProgressResult::Cancelled;
 
-      //This whole operation should not occur while a file is being loaded on OD,
-      //(we are worried about reading from a file being written to,) so we block.
-      //Furthermore, we need to do this because libsndfile is not threadsafe.
-      formatStr = SFCall<wxString>(sf_header_name, fileFormat);
+   wxString     formatStr;
+   SF_INFO      info;
+   //int          err;
 
-      // Use libsndfile to export file
+   //This whole operation should not occur while a file is being loaded on OD,
+   //(we are worried about reading from a file being written to,) so we block.
+   //Furthermore, we need to do this because libsndfile is not threadsafe.
+   formatStr = SFCall<wxString>(sf_header_name, fileFormat);
 
-      info.samplerate = (unsigned int)(rate + 0.5);
-      info.frames = (unsigned int)((t1 - t0)*rate + 0.5);
-      info.channels = numChannels;
-      info.format = sf_format;
-      info.sections = 1;
-      info.seekable = 0;
+   auto job = std::make_unique<PCMExportJob>(fName,
+      (selectionOnly
+         ? XO("Exporting the selected audio as %s")
+         : XO("Exporting the audio as %s"))
+         .Format( formatStr ),
+      *this);
+   auto &f = job->mFile;
+   auto &sf = job->mSF;
 
-      // Bug 46.  Trap here, as sndfile.c does not trap it properly.
-      if( (numChannels != 1) && ((sf_format & SF_FORMAT_SUBMASK) == SF_FORMAT_GSM610) )
-      {
-         AudacityMessageBox( XO("GSM 6.10 requires mono") );
-         return ProgressResult::Cancelled;
-      }
+   // Use libsndfile to export file
 
-      if (sf_format == SF_FORMAT_WAVEX + SF_FORMAT_GSM610) {
-         AudacityMessageBox(
-            XO("WAVEX and GSM 6.10 formats are not compatible") );
-         return ProgressResult::Cancelled;
-      }
+   info.samplerate = (unsigned int)(rate + 0.5);
+   info.frames = (unsigned int)((t1 - t0)*rate + 0.5);
+   info.channels = numChannels;
+   info.format = sf_format;
+   info.sections = 1;
+   info.seekable = 0;
 
-      // If we can't export exactly the format they requested,
-      // try the default format for that header type...
-      // 
-      // LLL: I don't think this is valid since libsndfile checks
-      // for all allowed subtypes explicitly and doesn't provide
-      // for an unspecified subtype.
-      if (!sf_format_check(&info))
-         info.format = (info.format & SF_FORMAT_TYPEMASK);
-      if (!sf_format_check(&info)) {
-         AudacityMessageBox( XO("Cannot export audio in this format.") );
-         return ProgressResult::Cancelled;
-      }
-      const auto path = fName.GetFullPath();
-      if (f.Open(path, wxFile::write)) {
-         // Even though there is an sf_open() that takes a filename, use the one that
-         // takes a file descriptor since wxWidgets can open a file with a Unicode name and
-         // libsndfile can't (under Windows).
-         sf.reset(SFCall<SNDFILE*>(sf_open_fd, f.fd(), SFM_WRITE, &info, FALSE));
-         //add clipping for integer formats.  We allow floats to clip.
-         sf_command(sf.get(), SFC_SET_CLIPPING, NULL, sf_subtype_is_integer(sf_format)?SF_TRUE:SF_FALSE) ;
-      }
+   // Bug 46.  Trap here, as sndfile.c does not trap it properly.
+   if( (numChannels != 1) && ((sf_format & SF_FORMAT_SUBMASK) == SF_FORMAT_GSM610) )
+   {
+      AudacityMessageBox( XO("GSM 6.10 requires mono") );
+      return {};
+   }
 
-      if (!sf) {
-         AudacityMessageBox( XO("Cannot export audio to %s").Format( path ) );
-         return ProgressResult::Cancelled;
-      }
-      // Retrieve tags if not given a set
-      if (metadata == NULL)
-         metadata = &Tags::Get( *project );
-
-      // Install the meta data at the beginning of the file (except for
-      // WAV and WAVEX formats)
-      if (fileFormat != SF_FORMAT_WAV &&
-          fileFormat != SF_FORMAT_WAVEX) {
-         if (!AddStrings(project, sf.get(), metadata, sf_format)) {
-            return ProgressResult::Cancelled;
-         }
+   if (sf_format == SF_FORMAT_WAVEX + SF_FORMAT_GSM610) {
+      AudacityMessageBox(
+         XO("WAVEX and GSM 6.10 formats are not compatible") );
+      return {};
+   }
+
+   // If we can't export exactly the format they requested,
+   // try the default format for that header type...
+   // 
+   // LLL: I don't think this is valid since libsndfile checks
+   // for all allowed subtypes explicitly and doesn't provide
+   // for an unspecified subtype.
+   if (!sf_format_check(&info))
+      info.format = (info.format & SF_FORMAT_TYPEMASK);
+   if (!sf_format_check(&info)) {
+      AudacityMessageBox( XO("Cannot export audio in this format.") );
+      return {};
+   }
+   const auto path = fName.GetFullPath();
+   if (f.Open(path, wxFile::write)) {
+      // Even though there is an sf_open() that takes a filename, use the one that
+      // takes a file descriptor since wxWidgets can open a file with a Unicode name and
+      // libsndfile can't (under Windows).
+      sf.reset(SFCall<SNDFILE*>(sf_open_fd, f.fd(), SFM_WRITE, &info, FALSE));
+      //add clipping for integer formats.  We allow floats to clip.
+      sf_command(sf.get(), SFC_SET_CLIPPING, NULL, sf_subtype_is_integer(sf_format)?SF_TRUE:SF_FALSE) ;
+   }
+
+   if (!sf) {
+      AudacityMessageBox( XO("Cannot export audio to %s").Format( path ) );
+      return {};
+   }
+   // Retrieve tags if not given a set
+   if (metadata == NULL)
+      metadata = &Tags::Get( *project );
+
+   // Install the meta data at the beginning of the file (except for
+   // WAV and WAVEX formats)
+   if (fileFormat != SF_FORMAT_WAV &&
+       fileFormat != SF_FORMAT_WAVEX) {
+      if (!AddStrings(project, sf.get(), metadata, sf_format)) {
+         return {};
       }
+   }
 
-      sampleFormat format;
-      if (sf_subtype_more_than_16_bits(info.format))
-         format = floatSample;
-      else
-         format = int16Sample;
-
-      // Bug 2200
-      // Only trap size limit for file types we know have an upper size limit.
-      // The error message mentions aiff and wav.
-      if( (fileFormat == SF_FORMAT_WAV) ||
-          (fileFormat == SF_FORMAT_WAVEX) ||
-          (fileFormat == SF_FORMAT_AIFF ))
+   sampleFormat format;
+   if (sf_subtype_more_than_16_bits(info.format))
+      format = floatSample;
+   else
+      format = int16Sample;
+
+   // Bug 2200
+   // Only trap size limit for file types we know have an upper size limit.
+   // The error message mentions aiff and wav.
+   if( (fileFormat == SF_FORMAT_WAV) ||
+       (fileFormat == SF_FORMAT_WAVEX) ||
+       (fileFormat == SF_FORMAT_AIFF ))
+   {
+      float sampleCount = (float)(t1-t0)*rate*info.channels;
+      float byteCount = sampleCount * sf_subtype_bytes_per_sample( info.format);
+      // Test for 4 Gibibytes, rather than 4 Gigabytes
+      if( byteCount > 4.295e9)
       {
-         float sampleCount = (float)(t1-t0)*rate*info.channels;
-         float byteCount = sampleCount * sf_subtype_bytes_per_sample( info.format);
-         // Test for 4 Gibibytes, rather than 4 Gigabytes
-         if( byteCount > 4.295e9)
-         {
-            ReportTooBigError( wxTheApp->GetTopWindow() );
-            return ProgressResult::Failed;
-         }
+         ReportTooBigError( wxTheApp->GetTopWindow() );
+         result = ProgressResult::Failed;
+         return {};
       }
-      size_t maxBlockLen = 44100 * 5;
+   }
+   size_t maxBlockLen = 44100 * 5;
+
+   wxASSERT(info.channels >= 0);
+   job->mMixer = CreateMixer(tracks, selectionOnly,
+                            t0, t1,
+                            info.channels, maxBlockLen, true,
+                            rate, format, true, mixerSpec);
+   job->mFormatStr = formatStr;
+   job->mSFFormat = sf_format;
+   job->mFormat = format;
+   job->mMaxBlockLen = maxBlockLen;
+   job->mT0 = t0;
+   job->mT1 = t1;
+   job->mMetadata = metadata;
+
+   result = ProgressResult::Success;
+   return job;
+}
 
-      {
-         wxASSERT(info.channels >= 0);
-         auto mixer = CreateMixer(tracks, selectionOnly,
-                                  t0, t1,
-                                  info.channels, maxBlockLen, true,
-                                  rate, format, true, mixerSpec);
-
-         InitProgress( pDialog, fName,
-            (selectionOnly
-               ? XO("Exporting the selected audio as %s")
-               : XO("Exporting the audio as %s"))
-               .Format( formatStr ) );
-         auto &progress = *pDialog;
-
-         while (updateResult == ProgressResult::Success) {
-            sf_count_t samplesWritten;
-            size_t numSamples = mixer->Process(maxBlockLen);
-
-            if (numSamples == 0)
-               break;
-
-            samplePtr mixed = mixer->GetBuffer();
-
-            if (format == int16Sample)
-               samplesWritten = SFCall<sf_count_t>(sf_writef_short, sf.get(), (short *)mixed, numSamples);
-            else
-               samplesWritten = SFCall<sf_count_t>(sf_writef_float, sf.get(), (float *)mixed, numSamples);
-
-            if (static_cast<size_t>(samplesWritten) != numSamples) {
-               char buffer2[1000];
-               sf_error_str(sf.get(), buffer2, 1000);
-               AudacityMessageBox(
-                  XO(
-                  /* i18n-hint: %s will be the error message from libsndfile, which
-                   * is usually something unhelpful (and untranslated) like "system
-                   * error" */
+ProgressResult PCMExportJob::Run(ExportProgress &progress)
+{
+   const int fileFormat = mSFFormat & SF_FORMAT_TYPEMASK;
+   auto &sf = mSF;
+
+   auto updateResult = ProgressResult::Success;
+   {
+      // Close everything before returning, so that a failed file can be
+      // removed
+      auto cleanup = finally( [&] {
+         mMixer.reset();
+         sf.reset();
+         if (mFile.IsOpened())
+            mFile.Close();
+      } );
+
+      while (updateResult == ProgressResult::Success) {
+         sf_count_t samplesWritten;
+         size_t numSamples = mMixer->Process(mMaxBlockLen);
+
+         if (numSamples == 0)
+            break;
+
+         samplePtr mixed = mMixer->GetBuffer();
+
+         if (mFormat == int16Sample)
+            samplesWritten = SFCall<sf_count_t>(sf_writef_short, sf.get(), (short *)mixed, numSamples);
+         else
+            samplesWritten = SFCall<sf_count_t>(sf_writef_float, sf.get(), (float *)mixed, numSamples);
+
+         if (static_cast<size_t>(samplesWritten) != numSamples) {
+            char buffer2[1000];
+            sf_error_str(sf.get(), buffer2, 1000);
+            progress.ReportError(
+               XO(
+               /* i18n-hint: %s will be the error message from libsndfile, which
+                * is usually something unhelpful (and untranslated) like "system
+                * error" */
 "Error while writing %s file (disk full?).\nLibsndfile says \"%s\"")
-                     .Format( formatStr, wxString::FromAscii(buffer2) ));
-               updateResult = ProgressResult::Cancelled;
-               break;
-            }
-            
-            updateResult = progress.Update(mixer->MixGetCurrentTime() - t0, t1 - t0);
+                  .Format( mFormatStr, wxString::FromAscii(buffer2) ));
+            updateResult = ProgressResult::Cancelled;
+            break;
          }
+
+         updateResult = progress.Update(mMixer->MixGetCurrentTime() - mT0, mT1 - mT0);
       }
-      
+
       // Install the WAV metata in a "LIST" chunk at the end of the file
       if (updateResult == ProgressResult::Success ||
           updateResult == ProgressResult::Stopped) {
          if (fileFormat == SF_FORMAT_WAV ||
              fileFormat == SF_FORMAT_WAVEX) {
-            if (!AddStrings(project, sf.get(), metadata, sf_format)) {
+            if (!mPlugin.AddStrings(nullptr, sf.get(), mMetadata, mSFFormat)) {
                // TODO: more precise message
-               AudacityMessageBox( XO("Unable to export") );
+               progress.ReportError( XO("Unable to export") );
                return ProgressResult::Cancelled;
             }
          }
          if (0 != sf.close()) {
             // TODO: more precise message
-            AudacityMessageBox( XO("Unable to export") );
+            progress.ReportError( XO("Unable to export") );
             return ProgressResult::Cancelled;
          }
       }
@@ -693,9 +784,9 @@ ProgressResult ExportPCM::Export(AudacityProject *project,
       if ((fileFormat == SF_FORMAT_AIFF) ||
           (fileFormat == SF_FORMAT_WAV))
          // Note: file has closed, and gets reopened and closed again here:
-         if (!AddID3Chunk(fName, metadata, sf_format) ) {
+         if (!mPlugin.AddID3Chunk(mFileName, mMetadata, mSFFormat) ) {
             // TODO: more precise message
-            AudacityMessageBox( XO("Unable to export") );
+            progress.ReportError( XO("Unable to export") );
             return ProgressResult::Cancelled;
          }
 
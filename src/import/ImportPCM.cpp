@@ -48,6 +48,8 @@
 //If OD is enabled, he minimum number of samples a file has to use it.
 //Otherwise, we use the older PCMAliasBlockFile method since it should be fast enough.
 #define kMinimumODFileSampleSize 44100*30
+//bytes of interleaved samples to read at once in copy mode
+#define kMaxImportReadBytes (16 << 20)
 
 #ifndef SNDFILE_1
 #error Requires libsndfile 1.0 or higher
@@ -523,24 +525,43 @@ ProgressResult PCMImportFileHandle::Import(TrackFactory *trackFactory,
       // samples from the file and store our own local copy of the
       // samples in the tracks.
 
+      // The samples are made into whole blocks directly, several blocks of
+      // all channels for each read of the file, which is sequential; what
+      // is left of a short read waits in the append buffer of the clip.
+      // The summaries are computed as the blocks are made, and the block
+      // files are written in the background while the next samples are read.
+
       // PRL:  guard against excessive memory buffer allocation in case of many channels
       using type = decltype(maxBlockSize);
       if (mInfo.channels < 1)
          return ProgressResult::Failed;
+      const sampleFormat readFormat =
+         (mFormat == int16Sample) ? int16Sample : floatSample;
+      const size_t frameBytes = mInfo.channels * SAMPLE_SIZE(readFormat);
       auto maxBlock = std::min(maxBlockSize,
-         std::numeric_limits<type>::max() /
-            (mInfo.channels * SAMPLE_SIZE(mFormat))
+         std::numeric_limits<type>::max() / frameBytes
       );
       if (maxBlock < 1)
          return ProgressResult::Failed;
+      // Whole blocks at a time, up to about kMaxImportReadBytes
+      auto maxRead = maxBlock *
+         std::max<size_t>(1, kMaxImportReadBytes / (maxBlock * frameBytes));
 
+      // Mono samples need no deinterleaving, so they are made into blocks
+      // where they are read
+      const bool interleaved = mInfo.channels > 1;
       SampleBuffer srcbuffer, buffer;
       wxASSERT(mInfo.channels >= 0);
-      while (NULL == srcbuffer.Allocate(maxBlock * mInfo.channels, mFormat).ptr() ||
-             NULL == buffer.Allocate(maxBlock, mFormat).ptr())
+      while (NULL == srcbuffer.Allocate(maxRead * mInfo.channels, readFormat).ptr() ||
+             (interleaved &&
+              NULL == buffer.Allocate(maxRead, readFormat).ptr()))
       {
-         maxBlock /= 2;
-         if (maxBlock < 1)
+         // Fall back to fewer blocks at a time, still whole, then to
+         // shorter blocks
+         maxRead = (maxRead > maxBlock)
+            ? std::max(maxBlock, maxRead / 2 / maxBlock * maxBlock)
+            : (maxBlock /= 2);
+         if (maxRead < 1)
             return ProgressResult::Failed;
       }
 
@@ -548,34 +569,36 @@ ProgressResult PCMImportFileHandle::Import(TrackFactory *trackFactory,
 
       long block;
       do {
-         block = maxBlock;
+         block = maxRead;
 
-         if (mFormat == int16Sample)
+         if (readFormat == int16Sample)
             block = SFCall<sf_count_t>(sf_readf_short, mFile.get(), (short *)srcbuffer.ptr(), block);
          //import 24 bit int as float and have the append function convert it.  This is how PCMAliasBlockFile works too.
          else
             block = SFCall<sf_count_t>(sf_readf_float, mFile.get(), (float *)srcbuffer.ptr(), block);
 
-         if(block < 0 || block > (long)maxBlock) {
+         if(block < 0 || block > (long)maxRead) {
             wxASSERT(false);
-            block = maxBlock;
+            block = maxRead;
          }
 
          if (block) {
             auto iter = channels.begin();
             for(int c=0; c<mInfo.channels; ++iter, ++c) {
-               if (mFormat==int16Sample) {
+               if (interleaved && readFormat==int16Sample) {
                   for(int j=0; j<block; j++)
                      ((short *)buffer.ptr())[j] =
                         ((short *)srcbuffer.ptr())[mInfo.channels*j+c];
                }
-               else {
+               else if (interleaved) {
                   for(int j=0; j<block; j++)
                      ((float *)buffer.ptr())[j] =
                         ((float *)srcbuffer.ptr())[mInfo.channels*j+c];
                }
 
-               iter->get()->Append(buffer.ptr(), (mFormat == int16Sample)?int16Sample:floatSample, block);
+               iter->get()->RightmostOrNewClip()->AppendBlocks(
+                  interleaved ? buffer.ptr() : srcbuffer.ptr(), readFormat,
+                  block);
             }
             framescompleted += block;
          }
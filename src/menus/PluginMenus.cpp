@@ -12,6 +12,7 @@
 #include "../ProjectSettings.h"
 #include "../ProjectWindow.h"
 #include "../Screenshot.h"
+#include "../SelfTests.h"
 #include "../commands/CommandContext.h"
 #include "../commands/CommandManager.h"
 #include "../commands/ScreenshotCommand.h"
@@ -499,6 +500,13 @@ void OnDetectUpstreamDropouts(const CommandContext &context)
    setting = !setting;
 }
 
+#ifdef IS_ALPHA
+void OnRunSelfTests(const CommandContext &context)
+{
+   SelfTests::Run( context.project );
+}
+#endif
+
 void OnApplyMacroDirectly(const CommandContext &context )
 {
    auto &project = context.project;
@@ -907,7 +915,9 @@ BaseItemSharedPtr ToolsMenu()
             AudioIONotBusyFlag(),
             Options{}.CheckTest(
                [](AudacityProject&){
-                  return AudioIO::Get()->mDetectUpstreamDropouts; } ) )
+                  return AudioIO::Get()->mDetectUpstreamDropouts; } ) ),
+         Command( wxT("RunSelfTests"), XXO("Run Self &Tests"),
+            FN(OnRunSelfTests), AudioIONotBusyFlag() )
       )
 #endif
    ) ) };
@@ -998,6 +1008,9 @@ BaseItemSharedPtr ExtraScriptablesIIMenu()
       Command( wxT("SaveProject2"), XXO("Save Project..."),
          FN(OnAudacityCommand),
          AudioIONotBusyFlag() ),
+      Command( wxT("ConvertProject2"), XXO("Convert Project..."),
+         FN(OnAudacityCommand),
+         AudioIONotBusyFlag() ),
       Command( wxT("Drag"), XXO("Move Mouse..."), FN(OnAudacityCommand),
          AudioIONotBusyFlag() ),
       Command( wxT("CompareAudio"), XXO("Compare Audio..."),
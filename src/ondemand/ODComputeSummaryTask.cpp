@@ -19,14 +19,20 @@ updating the ODPCMAliasBlockFile and the GUI of the newly available data.
 
 
 #include "ODComputeSummaryTask.h"
+#include "ODManager.h"
 #include "../blockfile/ODPCMAliasBlockFile.h"
 #include "../Sequence.h"
+#include "../ThreadPool.h"
 #include "../WaveClip.h"
 #include "../WaveTrack.h"
+#include <algorithm>
 #include <wx/wx.h>
 
 //36 blockfiles > 3 minutes stereo 44.1kHz per ODTask::DoSome
 #define nBlockFilesPerDoSome 36
+//blockfiles read together from the aliased file, and how many such spans are summarized at once
+#define nBlockFilesPerSpan 16
+#define nSpansPerDoSome 4u
 
 ///Creates a NEW task that computes summaries for a wavetrack that needs to be specified through SetWaveTrack()
 ODComputeSummaryTask::ODComputeSummaryTask()
@@ -54,7 +60,8 @@ void ODComputeSummaryTask::Terminate()
    mBlockFilesMutex.Unlock();
 }
 
-///Computes and writes the data for one BlockFile if it still has a refcount.
+///Computes and writes the data for spans of BlockFiles that still have a refcount,
+///several spans at once.
 void ODComputeSummaryTask::DoSomeInternal()
 {
    if(mBlockFiles.size()<=0)
@@ -65,66 +72,73 @@ void ODComputeSummaryTask::DoSomeInternal()
       return;
    }
 
+   //Take spans of consecutive blocks from the front of the list.  The blocks of all
+   //channels of a time range are together in the list, so one read of the aliased
+   //file serves all of them.
+   using Span = std::vector< std::shared_ptr< ODPCMAliasBlockFile > >;
+   static const size_t nSpans =
+      std::min<size_t>(nSpansPerDoSome, ThreadPool::SharedThreadCount() + 1);
+   std::vector<Span> spans;
    mBlockFilesMutex.Lock();
-   for(size_t j=0; j < mWaveTracks.size() && mBlockFiles.size();j++)
+   while(spans.size() < nSpans && mBlockFiles.size())
    {
-      bool success = false;
-      const auto bf = mBlockFiles[0].lock();
-
-      sampleCount blockStartSample = 0;
-      sampleCount blockEndSample = 0;
-
-      if(bf)
+      Span span;
+      while(span.size() < nBlockFilesPerSpan && mBlockFiles.size())
       {
-         // WriteSummary might throw, but this is a worker thread, so stop
-         // the exceptions here!
-         success = GuardedCall<bool>( [&] {
-            bf->DoWriteSummary();
-            return true;
-         } );
-         blockStartSample = bf->GetStart();
-         blockEndSample = blockStartSample + bf->GetLength();
-      }
-      else
-      {
-         success = true;
-         // The block file disappeared.
-         //the waveform in the wavetrack now is shorter, so we need to update mMaxBlockFiles
-         //because now there is less work to do.
-         mMaxBlockFiles--;
-      }
-
-      if (success)
-      {
-         //take it out of the array - we are done with it.
+         if (auto bf = mBlockFiles[0].lock())
+            span.push_back(bf);
+         else
+            // The block file disappeared.
+            //the waveform in the wavetrack now is shorter, so we need to update mMaxBlockFiles
+            //because now there is less work to do.
+            mMaxBlockFiles--;
          mBlockFiles.erase(mBlockFiles.begin());
       }
-      else
-         // The task does not make progress
-         ;
+      spans.push_back(std::move(span));
+   }
+   mBlockFilesMutex.Unlock();
 
-      //This is a bit of a convenience in case someone tries to terminate the task by closing the trackpanel or window.
-      //ODComputeSummaryTask::Terminate() uses this lock to remove everything, and we don't want it to wait since the UI is being blocked.
-      mBlockFilesMutex.Unlock();
-      wxThread::This()->Yield();
-      mBlockFilesMutex.Lock();
+   ThreadPool::RunShared(spans.size(), [&](size_t i){
+      // WriteSummary might throw, but this is a worker thread, so stop
+      // the exceptions here!
+      GuardedCall<bool>( [&] {
+         ODPCMAliasBlockFile::DoWriteSummaries(spans[i]);
+         return true;
+      } );
+   });
+
+   //Blocks that failed go back to the front of the list.  The task does not make progress with them.
+   Span failed;
+   for (const auto &span : spans)
+   {
+      for (const auto &bf : span)
+      {
+         if (!bf->IsSummaryAvailable())
+         {
+            failed.push_back(bf);
+            continue;
+         }
 
-      //update the gui for all associated blocks.  It doesn't matter that we're hitting more wavetracks then we should
-      //because this loop runs a number of times equal to the number of tracks, they probably are getting processed in
-      //the next iteration at the same sample window.
-      if (success && bf) {
+         //update the gui for all associated blocks.  It doesn't matter that we're hitting more wavetracks then we should
+         //because the blocks of all the tracks at the same sample window are done together.
+         const auto blockStartSample = bf->GetStart();
+         const auto blockEndSample = blockStartSample + bf->GetLength();
          mWaveTrackMutex.Lock();
          for(size_t i=0;i<mWaveTracks.size();i++)
          {
             auto waveTrack = mWaveTracks[i].lock();
-            if(success && waveTrack)
+            if(waveTrack)
                waveTrack->AddInvalidRegion(blockStartSample,blockEndSample);
          }
          mWaveTrackMutex.Unlock();
       }
    }
-
-   mBlockFilesMutex.Unlock();
+   if (failed.size())
+   {
+      mBlockFilesMutex.Lock();
+      mBlockFiles.insert(mBlockFiles.begin(), failed.begin(), failed.end());
+      mBlockFilesMutex.Unlock();
+   }
 
    //update percentage complete.
    CalculatePercentComplete();
@@ -57,7 +57,7 @@ protected:
    ///recalculates the percentage complete.
    void CalculatePercentComplete() override;
 
-   ///Computes and writes the data for one BlockFile if it still has a refcount.
+   ///Computes and writes the data for spans of BlockFiles that still have a refcount, several spans at once.
    void DoSomeInternal() override;
 
    ///Readjusts the blockfile order in the default manner.  If we have had an ODRequest
@@ -20,116 +20,16 @@ ODTask requests and internals.
 #include "ODTask.h"
 #include "ODWaveTrackTaskQueue.h"
 #include "../Project.h"
+#include "../ThreadPool.h"
 #include <NonGuiThread.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 #include <wx/utils.h>
 #include <wx/wx.h>
 #include <wx/thread.h>
 #include <wx/event.h>
 
-#ifdef __WXMAC__
-
-// On Mac OS X, it's better not to use the wxThread class.
-// We use our own implementation based on pthreads instead.
-
-class ODTaskThread {
- public:
-   typedef int ExitCode;
-   ODTaskThread(ODTask* task);
-   /*ExitCode*/ void Entry();
-   void Create() {}
-   void Delete() {
-      mDestroy = true;
-      pthread_join(mThread, NULL);
-   }
-   bool TestDestroy() { return mDestroy; }
-   void Sleep(int ms) {
-      struct timespec spec;
-      spec.tv_sec = 0;
-      spec.tv_nsec = ms * 1000 * 1000;
-      nanosleep(&spec, NULL);
-   }
-   static void *callback(void *p) {
-      ODTaskThread *th = (ODTaskThread *)p;
-#if defined(__WXMAC__)
-      /*return (void *)*/ th->Entry();
-      return NULL;
-#else
-      return (void *) th->Entry();
-#endif
-   }
-   void Run() {
-      pthread_create(&mThread, NULL, callback, this);
-   }
-
-   ///Specifies the priority the thread will run at.  Currently doesn't work.
-   ///@param priority value from 0 (min priority) to 100 (max priority)
-   void SetPriority(int priority)
-   {
-      mPriority=priority;
-   }
-
- private:
-   int mPriority;
-   bool mDestroy;
-   pthread_t mThread;
-
-   ODTask* mTask;
-};
-
-#else
-
-class ODTaskThread final : public wxThread
-{
-public:
-   ///Constructs a ODTaskThread
-   ///@param task the task to be launched as an
-   ODTaskThread(ODTask* task);
-
-
-protected:
-   ///Executes a part of the task
-   void* Entry() override;
-   ODTask* mTask;
-
-};
-
-#endif
-
-ODTaskThread::ODTaskThread(ODTask* task)
-#ifndef __WXMAC__
-: wxThread()
-#endif
-{
-   mTask=task;
-#ifdef __WXMAC__
-   mDestroy = false;
-   mThread = NULL;
-#endif
-
-}
-
-#ifdef __WXMAC__
-
-void ODTaskThread::Entry()
-#else
-void *ODTaskThread::Entry()
-
-#endif
-{
-   //TODO: Figure out why this has no effect at all.
-   //wxThread::This()->SetPriority( 40);
-   //Do at least 5 percent of the task
-   mTask->DoSome(0.05f);
-
-   //release the thread count so that the ODManager knows how many active threads are alive.
-   ODManager::Instance()->DecrementCurrentThreads();
-
-
-#ifndef __WXMAC__
-   return NULL;
-#endif
-}
-
 static ODLock gODInitedMutex;
 static bool gManagerCreated=false;
 static bool gPause=false; //to be loaded in and used with Pause/Resume before ODMan init.
@@ -161,9 +61,10 @@ ODManager::ODManager()
    mTerminate = false;
    mTerminated = false;
    mPause = gPause;
-
-   //must set up the queue condition
-   mQueueNotEmptyCond = std::make_unique<ODCondition>(&mQueueNotEmptyCondLock);
+   mCurrentThreads = 0;
+   mMaxThreads = 0;
+   mStopWorkers = false;
+   mWake = false;
 }
 
 //private destructor - DELETE with static method Quit()
@@ -181,10 +82,8 @@ ODManager::~ODManager()
       mTerminatedMutex.Unlock();
       wxThread::Sleep(200);
 
-      //signal the queue not empty condition since the ODMan thread will wait on the queue condition
-      mQueueNotEmptyCondLock.Lock();
-      mQueueNotEmptyCond->Signal();
-      mQueueNotEmptyCondLock.Unlock();
+      //wake the ODMan thread, which may be waiting for a change in the queues
+      WakeManager();
 
       mTerminatedMutex.Lock();
    }
@@ -198,48 +97,52 @@ ODManager::~ODManager()
 ///Adds a task to running queue.  Thread-safe.
 void ODManager::AddTask(ODTask* task)
 {
-   mTasksMutex.Lock();
-   mTasks.push_back(task);
-   mTasksMutex.Unlock();
-   //signal the queue not empty condition.
    bool paused;
-
-   mPauseLock.Lock();
-   paused=mPause;
-   mPauseLock.Unlock();
+   {
+      std::lock_guard<std::mutex> lock{ mTasksMutex };
+      mTasks.push_back(task);
+      paused=mPause;
+   }
 
    //don't signal if we are paused since if we wake up the loop it will start processing other tasks while paused
    if(!paused)
-      mQueueNotEmptyCond->Signal();
+   {
+      mTaskAvailable.notify_one();
+      WakeManager();
+   }
 }
 
 void ODManager::SignalTaskQueueLoop()
 {
    bool paused;
-
-   mPauseLock.Lock();
-   paused=mPause;
-   mPauseLock.Unlock();
+   {
+      std::lock_guard<std::mutex> lock{ mTasksMutex };
+      paused=mPause;
+   }
    //don't signal if we are paused
    if(!paused)
-      mQueueNotEmptyCond->Signal();
+      WakeManager();
 }
 
-///removes a task from the active task queue
-void ODManager::RemoveTaskIfInQueue(ODTask* task)
+void ODManager::WakeManager()
 {
-   mTasksMutex.Lock();
-   //linear search okay for now, (probably only 1-5 tasks exist at a time.)
-   for(unsigned int i=0;i<mTasks.size();i++)
    {
-      if(mTasks[i]==task)
-      {
-         mTasks.erase(mTasks.begin()+i);
-         break;
-      }
+      std::lock_guard<std::mutex> lock{ mWakeMutex };
+      mWake = true;
    }
-   mTasksMutex.Unlock();
+   mWakeCondition.notify_one();
+}
 
+///removes a task from the active task queue, and waits until no worker runs it,
+///so that the caller may destroy it
+void ODManager::RemoveTaskIfInQueue(ODTask* task)
+{
+   std::unique_lock<std::mutex> lock{ mTasksMutex };
+   mTasks.erase(std::remove(mTasks.begin(), mTasks.end(), task), mTasks.end());
+   mTaskDone.wait(lock, [&]{
+      return std::find(mRunningTasks.begin(), mRunningTasks.end(), task) ==
+         mRunningTasks.end();
+   });
 }
 
 ///Adds a NEW task to the queue.  Creates a queue if the tracks associated with the task is not in the list
@@ -315,11 +218,16 @@ bool ODManager::IsInstanceCreated()
    return ret;
 }
 
-///Launches a thread for the manager and starts accepting Tasks.
+///Launches a thread for the manager and the worker threads, and starts accepting Tasks.
 void ODManager::Init()
 {
-   mCurrentThreads = 0;
-   mMaxThreads = 5;
+   {
+      std::lock_guard<std::mutex> lock{ mTasksMutex };
+      mMaxThreads = std::max(1u, ThreadPool::DefaultThreadCount());
+      mCurrentThreads = mMaxThreads;
+   }
+   for (int i = 0; i < mMaxThreads; ++i)
+      std::thread{ [this]{ RunWorker(); } }.detach();
 
    //   wxLogDebug(wxT("Initializing ODManager...Creating manager thread"));
    // This is a detached thread, so it deletes itself when it finishes
@@ -335,18 +243,79 @@ void ODManager::Init()
    //destruction of thread is taken care of by thread library
 }
 
-void ODManager::DecrementCurrentThreads()
+void ODManager::RunWorker()
 {
-   mCurrentThreadsMutex.Lock();
+   std::unique_lock<std::mutex> lock{ mTasksMutex };
+   while (!mStopWorkers)
+   {
+      auto task = TakeNextTask();
+      if (!task)
+      {
+         mTaskAvailable.wait(lock);
+         continue;
+      }
+      mRunningTasks.push_back(task);
+      lock.unlock();
+
+      //a task whose tracks were all closed is not run again.
+      //UpdateQueues() then deletes it with its queue.
+      bool finished = true;
+      if (task->HasWaveTracks())
+      {
+         //Do at least 5 percent of the task
+         task->DoSome(0.05f);
+         finished = task->PercentComplete() >= 1.0;
+      }
+
+      lock.lock();
+      mRunningTasks.erase(
+         std::find(mRunningTasks.begin(), mRunningTasks.end(), task));
+      mTaskDone.notify_all();
+
+      //let the manager schedule the next task of the queue
+      if (finished && !mPause)
+         WakeManager();
+   }
    mCurrentThreads--;
-   mCurrentThreadsMutex.Unlock();
+   mTaskDone.notify_all();
+}
+
+ODTask* ODManager::TakeNextTask()
+{
+   if (mPause)
+      return NULL;
+
+   //tasks of equal priority take turns, since DoSome() puts unfinished tasks at the back.
+   auto best = mTasks.end();
+   for (auto iter = mTasks.begin(); iter != mTasks.end(); ++iter)
+   {
+      //another worker is running this task; don't wait for it
+      if (std::find(mRunningTasks.begin(), mRunningTasks.end(), *iter) !=
+          mRunningTasks.end())
+         continue;
+      if (best == mTasks.end() ||
+          (*iter)->GetPriority() > (*best)->GetPriority())
+         best = iter;
+   }
+   if (best == mTasks.end())
+      return NULL;
+
+   auto task = *best;
+   mTasks.erase(best);
+   return task;
+}
+
+void ODManager::StopWorkers()
+{
+   std::unique_lock<std::mutex> lock{ mTasksMutex };
+   mStopWorkers = true;
+   mTaskAvailable.notify_all();
+   mTaskDone.wait(lock, [this]{ return mCurrentThreads == 0; });
 }
 
 ///Main loop for managing threads and tasks.
 void ODManager::Start()
 {
-   bool tasksInArray;
-   bool paused;
    int  numQueues=0;
 
    mNeedsDraw=0;
@@ -364,48 +333,14 @@ void ODManager::Start()
       //we should look at our WaveTrack queues to see if we can process a NEW task to the running queue.
       UpdateQueues();
 
-      //start some threads if necessary
-
-      mTasksMutex.Lock();
-      tasksInArray = mTasks.size()>0;
-      mTasksMutex.Unlock();
-
-      mPauseLock.Lock();
-      paused=mPause;
-      mPauseLock.Unlock();
-
-      mCurrentThreadsMutex.Lock();
-      // keep adding tasks if there is work to do, up to the limit.
-      while(!paused && tasksInArray && (mCurrentThreads < mMaxThreads))
-      {
-         mCurrentThreads++;
-         mCurrentThreadsMutex.Unlock();
-
-         mTasksMutex.Lock();
-         //detach a NEW thread.
-         // This is a detached thread, so it deletes itself when it finishes
-         // ... except on Mac where we don't use wxThread for reasons unexplained
-         auto thread = safenew ODTaskThread(mTasks[0]);//task);
-         //thread->SetPriority(10);//default is 50.
-         thread->Create();
-         thread->Run();
-
-         mTasks.erase(mTasks.begin());
-         tasksInArray = mTasks.size()>0;
-         mTasksMutex.Unlock();
-
-         mCurrentThreadsMutex.Lock();
-      }
-
-      mCurrentThreadsMutex.Unlock();
-      //use a condition variable to block here instead of a sleep.
-
-      // JKC: If there are no tasks ready to run, or we're paused then
-      // we wait for there to be tasks in the queue.
+      //the worker threads run the tasks.  Wait until a task is added, or a worker
+      //finishes one, rather than spinning; but look again at least every
+      //200 ms, to redraw the progress of tasks.
       {
-         ODLocker locker{ &mQueueNotEmptyCondLock };
-         if( (!tasksInArray) || paused)
-            mQueueNotEmptyCond->Wait();
+         std::unique_lock<std::mutex> lock{ mWakeMutex };
+         mWakeCondition.wait_for(lock, std::chrono::milliseconds(200),
+            [this]{ return mWake; });
+         mWake = false;
       }
 
       //if there is some ODTask running, then there will be something in the queue.  If so then redraw to show progress
@@ -442,13 +377,17 @@ void ODManager::Pauser::Pause(bool pause)
 {
    if(IsInstanceCreated())
    {
-      pMan->mPauseLock.Lock();
-      pMan->mPause = pause;
-      pMan->mPauseLock.Unlock();
+      {
+         std::lock_guard<std::mutex> lock{ pMan->mTasksMutex };
+         pMan->mPause = pause;
+      }
 
       if(!pause)
+      {
          //we should check the queue again.
-         pMan->mQueueNotEmptyCond->Signal();
+         pMan->mTaskAvailable.notify_all();
+         pMan->WakeManager();
+      }
    }
    else
    {
@@ -465,6 +404,8 @@ void ODManager::Quit()
 {
    if(IsInstanceCreated())
    {
+      //the workers may call Instance() until they stop
+      pMan->StopWorkers();
       pMan.reset();
    }
 }
@@ -565,6 +506,25 @@ void ODManager::DemandTrackUpdate(WaveTrack* track, double seconds)
    mQueuesMutex.Unlock();
 }
 
+void ODManager::DemandTracks(const std::vector<Demand> &demands)
+{
+   ODLocker locker{ &mQueuesMutex };
+   for(unsigned int i=0;i<mQueues.size();i++)
+   {
+      int priority = -1;
+      for (const auto &demand : demands)
+      {
+         if (!mQueues[i]->ContainsWaveTrack(demand.track))
+            continue;
+         priority = std::max(priority, demand.priority);
+         if (demand.t1 > demand.t0)
+            mQueues[i]->DemandTrackRange(demand.track, demand.t0, demand.t1);
+      }
+      if (priority >= 0)
+         mQueues[i]->SetPriority(priority);
+   }
+}
+
 ///remove tasks from ODWaveTrackTaskQueues that have been done.  Schedules NEW ones if they exist
 ///Also remove queues that have become empty.
 void ODManager::UpdateQueues()
@@ -19,6 +19,8 @@ number of threads.
 #ifndef __AUDACITY_ODMANAGER__
 #define __AUDACITY_ODMANAGER__
 
+#include <condition_variable>
+#include <mutex>
 #include <vector>
 #include "ODTaskThread.h"
 #include <wx/event.h> // for DECLARE_EXPORTED_EVENT_TYPE
@@ -60,8 +62,20 @@ class ODManager final
    ///changes the tasks associated with this Waveform to process the task from a different point in the track
    void DemandTrackUpdate(WaveTrack* track, double seconds);
 
-   ///Reduces the count of current threads running.  Meant to be called when ODTaskThreads end in their own threads.  Thread-safe.
-   void DecrementCurrentThreads();
+   ///Priorities of the tasks of a track, by what the user does with it
+   enum : int { NoPriority = 0, VisiblePriority = 1, PlayingPriority = 2 };
+
+   struct Demand {
+      WaveTrack *track;
+      ///The range of time to process first, or none if t1 <= t0
+      double t0, t1;
+      int priority;
+   };
+
+   ///Sets the priorities of the tasks of the tracks, and makes them process the demanded ranges
+   ///first, unless they already process from a point within the range.  Called periodically with
+   ///what the TrackPanel shows and plays.
+   void DemandTracks(const std::vector<Demand> &demands);
 
    ///Adds a wavetrack, creates a queue member.
    void AddNewTask(std::unique_ptr<ODTask> &&mtask, bool lockMutex=true);
@@ -131,15 +145,27 @@ class ODManager final
    //private constructor - DELETE with static method Quit()
    friend std::default_delete < ODManager > ;
    ~ODManager();
-   ///Launches a thread for the manager and starts accepting Tasks.
+   ///Launches a thread for the manager and the worker threads, and starts accepting Tasks.
    void Init();
 
    ///Start the main loop for the manager.
    void Start();
 
+   ///Main loop of a worker thread, which runs parts of tasks in order of priority.
+   void RunWorker();
+
+   ///Removes and returns the runnable task of highest priority, or NULL.  Call with mTasksMutex locked.
+   ODTask* TakeNextTask();
+
+   ///Makes the worker threads exit, waiting for them to finish their current parts of tasks.
+   void StopWorkers();
+
    ///Remove references in our array to Tasks that have been completed/Schedule NEW ones
    void UpdateQueues();
 
+   ///Wakes the manager loop, to look at the queues again.  Safe from any thread.
+   void WakeManager();
+
    //instance
    static std::unique_ptr<ODManager> pMan;
 
@@ -147,34 +173,39 @@ class ODManager final
    std::vector<std::unique_ptr<ODWaveTrackTaskQueue>> mQueues;
    ODLock mQueuesMutex;
 
-   //List of current Task to do.
+   //List of current Task to do, in order of scheduling within each priority.
    std::vector<ODTask*> mTasks;
-   //mutex for above variable
-   ODLock mTasksMutex;
+   //Tasks that workers are running now
+   std::vector<ODTask*> mRunningTasks;
+   //mutex for above variables, mPause, mCurrentThreads and mStopWorkers
+   std::mutex mTasksMutex;
+   std::condition_variable mTaskAvailable;
+   std::condition_variable mTaskDone;
 
    //global pause switch for OD
-   volatile bool mPause;
-   ODLock mPauseLock;
+   bool mPause;
 
    volatile int mNeedsDraw;
 
-   ///Number of threads currently running.   Accessed thru multiple threads
-   volatile int mCurrentThreads;
-   //mutex for above variable
-   ODLock mCurrentThreadsMutex;
+   ///Number of worker threads currently running.
+   int mCurrentThreads;
 
-   ///Maximum number of threads allowed out.
+   ///Number of worker threads, as for any ThreadPool.
    int mMaxThreads;
 
+   bool mStopWorkers;
+
    volatile bool mTerminate;
    ODLock mTerminateMutex;
 
    volatile bool mTerminated;
    ODLock mTerminatedMutex;
 
-   //for the queue not empty comdition
-   ODLock         mQueueNotEmptyCondLock;
-   std::unique_ptr<ODCondition> mQueueNotEmptyCond;
+   //for waking the manager loop when tasks are added or finished.  The flag
+   //is set under the mutex, so that no wakeup is lost while the loop is busy.
+   std::mutex mWakeMutex;
+   std::condition_variable mWakeCondition;
+   bool mWake;
 
 #ifdef __WXMAC__
 
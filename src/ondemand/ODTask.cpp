@@ -262,6 +262,16 @@ std::shared_ptr< WaveTrack > ODTask::GetWaveTrack(int i)
    return track;
 }
 
+bool ODTask::HasWaveTracks()
+{
+   bool ret = false;
+   mWaveTrackMutex.Lock();
+   for(size_t i=0;i<mWaveTracks.size() && !ret;i++)
+      ret = !mWaveTracks[i].expired();
+   mWaveTrackMutex.Unlock();
+   return ret;
+}
+
 ///Sets the wavetrack that will be analyzed for ODPCMAliasBlockFiles that will
 ///have their summaries computed and written to disk.
 void ODTask::AddWaveTrack( const std::shared_ptr< WaveTrack > &track)
@@ -336,6 +346,22 @@ void ODTask::DemandTrackUpdate(WaveTrack* track, double seconds)
 
 }
 
+///changes the point from which the task processes the track to the start of the range,
+///unless that point is in the range already.  So a point the user clicked in view is kept,
+///and the blocks are ordered again only when the view or the play position leaves it.
+///@param track the track to update
+///@param t0, t1 the range of time in the track to process first
+void ODTask::DemandTrackRange(WaveTrack* track, double t0, double t1)
+{
+   const auto demandSample = GetDemandSample();
+   const double rate = track->GetRate();
+   if (demandSample >= sampleCount(t0 * rate) &&
+       demandSample < sampleCount(t1 * rate))
+      return;
+   DemandTrackUpdate(track, t0);
+}
+
+
 
 void ODTask::StopUsingWaveTrack(WaveTrack* track)
 {
@@ -25,6 +25,7 @@ in a background thread.
 
 #include "../BlockFile.h"
 
+#include <atomic>
 #include <vector>
 #include <wx/event.h> // to declare custom event type
 class AudacityProject;
@@ -92,9 +93,20 @@ class ODTask /* not final */
    virtual int GetNumWaveTracks();
    virtual std::shared_ptr< WaveTrack > GetWaveTrack(int i);
 
+   ///returns false if all of the tracks of the task were closed
+   bool HasWaveTracks();
+
    ///changes the tasks associated with this Waveform to process the task from a different point in the track
    virtual void DemandTrackUpdate(WaveTrack* track, double seconds);
 
+   ///calls DemandTrackUpdate for the start of the range, unless the task already
+   ///processes from a point within the range.
+   void DemandTrackRange(WaveTrack* track, double t0, double t1);
+
+   ///ODManager runs tasks of higher priority first.  Thread-safe.
+   int GetPriority() const { return mPriority; }
+   void SetPriority(int priority) { mPriority = priority; }
+
    bool IsComplete();
 
    void TerminateAndBlock();
@@ -166,6 +178,8 @@ class ODTask /* not final */
    volatile bool mIsRunning;
    ODLock mIsRunningMutex;
 
+   std::atomic<int> mPriority{ 0 };
+
 
    private:
 
@@ -187,6 +187,31 @@ void ODWaveTrackTaskQueue::DemandTrackUpdate(WaveTrack* track, double seconds)
    }
 }
 
+///changes the tasks associated with this Waveform to process the range first, unless they do already
+void ODWaveTrackTaskQueue::DemandTrackRange(WaveTrack* track, double t0, double t1)
+{
+   if(track)
+   {
+      mTasksMutex.Lock();
+      for(unsigned int i=0;i<mTasks.size();i++)
+      {
+         mTasks[i]->DemandTrackRange(track,t0,t1);
+      }
+      mTasksMutex.Unlock();
+   }
+}
+
+///sets the priority of all of the tasks
+void ODWaveTrackTaskQueue::SetPriority(int priority)
+{
+   mTasksMutex.Lock();
+   for(unsigned int i=0;i<mTasks.size();i++)
+   {
+      mTasks[i]->SetPriority(priority);
+   }
+   mTasksMutex.Unlock();
+}
+
 
 //Replaces all instances of a wavetracck with a NEW one (effectively transferes the task.)
 void ODWaveTrackTaskQueue::ReplaceWaveTrack(Track *oldTrack,
@@ -48,6 +48,12 @@ class ODWaveTrackTaskQueue final
    ///changes the tasks associated with this Waveform to process the task from a different point in the track
    void DemandTrackUpdate(WaveTrack* track, double seconds);
 
+   ///changes the tasks associated with this Waveform to process the range first, unless they do already
+   void DemandTrackRange(WaveTrack* track, double t0, double t1);
+
+   ///sets the priority of all of the tasks
+   void SetPriority(int priority);
+
    ///replaces all instances of a WaveTrack within this task with another.
    void ReplaceWaveTrack(Track *oldTrack,
       const std::shared_ptr<Track> &newTrack);
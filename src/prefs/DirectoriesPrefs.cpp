@@ -34,6 +34,8 @@
 
 #include "../FileNames.h"
 #include "../Prefs.h"
+#include "../SampleBlockCache.h"
+#include "../blockfile/BlockWriter.h"
 #include "../ShuttleGui.h"
 #include "../widgets/AudacityMessageBox.h"
 
@@ -120,6 +122,35 @@ void DirectoriesPrefs::PopulateOrExchange(ShuttleGui & S)
    }
    S.EndStatic();
 
+   S.StartStatic(XO("Project data"));
+   {
+      S.TieCheckBox(XO("Store audio of new projects in a few large &pack files"),
+                    wxT("/Directories/PackBlockFiles"),
+                    false);
+      S.TieCheckBox(XO("Save projects in a compact binary form that opens &faster"),
+                    wxT("/Directories/BinaryProjectFiles"),
+                    false);
+
+      S.TieCheckBox(XO("Write recorded audio to disk in the &background"),
+                    wxT("/Directories/BackgroundBlockWrites"),
+                    true);
+      S.TieCheckBox(XO("Force recorded audio onto the disk as it is &written (slower)"),
+                    wxT("/Directories/SyncBlockWrites"),
+                    false);
+
+      S.StartTwoColumn();
+      {
+         S.TieIntegerTextBox(XO("Memory for recently read &audio (MB):"),
+                             {wxT("/Directories/SampleCacheSize"), 256},
+                             9);
+         S.TieIntegerTextBox(XO("Memory for recorded audio waiting to be written (MB):"),
+                             {wxT("/Directories/BlockWriteQueueSize"), 128},
+                             9);
+      }
+      S.EndTwoColumn();
+   }
+   S.EndStatic();
+
 #ifdef DEPRECATED_AUDIO_CACHE
    // See http://bugzilla.audacityteam.org/show_bug.cgi?id=545.
    S.StartStatic(XO("Audio cache"));
@@ -286,6 +317,9 @@ bool DirectoriesPrefs::Commit()
    ShuttleGui S(this, eIsSavingToPrefs);
    PopulateOrExchange(S);
 
+   SampleBlockCache::Get().UpdatePrefs();
+   BlockWriter::Get().UpdatePrefs();
+
    return true;
 }
 
@@ -0,0 +1,626 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  XMLBinary.cpp
+
+*******************************************************************//**
+
+\class XMLBinaryWriter
+\brief Writes a tree of tags in a compact binary form.
+
+\class XMLBinaryReader
+\brief Reads the binary form, and passes the results through an
+XMLTagHandler.
+
+Loading a project with very many blocks spent most of its time in
+expat, and in converting each attribute from UTF-8 and then from text
+to a number.  The binary form keeps the tree of tags, so that every
+XMLTagHandler reads it unchanged, but:
+
+ - each tag and attribute name is stored once, in a table before the
+   document, and then by number;
+ - numbers are stored as numbers, and formatted only as handlers need;
+ - each element is prefixed with its length, so that an element that no
+   handler wants is skipped whole;
+ - a tag may hold "blobs", runs of bytes given whole to
+   XMLTagHandler::HandleXMLBlob(), so that a table such as the blocks of
+   a Sequence can be built without a tag per entry.
+
+The file is a header, then records, each a type byte and its fields:
+
+   'N' u32 length, UTF-8             define the next name number; all of
+                                     these come before the root element,
+                                     so that skipping any element skips
+                                     no names
+   '<' u32 name, u64 length          start an element; the length counts
+                                     the bytes after it, to its '>'
+   '>'                               end the element
+   's' u32 name, u32 length, UTF-8   string attribute
+   'i' u32 name, i64                 integer attribute
+   'b' u32 name, u8                  boolean attribute
+   'f' u32 name, f32, i32 digits     float attribute
+   'd' u32 name, f64, i32 digits     double attribute
+   'c' u32 length, UTF-8             content
+   'B' u32 name, u64 length, bytes   blob
+
+Numbers, including those of the header, are little-endian on every
+machine; big-endian machines swap them as they write and read.  Whoever
+writes a blob should do the same, with XMLBinaryLittleEndian().
+
+*//*******************************************************************/
+
+#include "XMLBinary.h"
+
+#include <map>
+
+#include <wx/defs.h>
+#include <wx/ffile.h>
+#include <wx/intl.h>
+
+#include "XMLFileReader.h"
+
+namespace {
+
+constexpr char Magic[] = "AudacityBinXML\r\n";
+constexpr size_t MagicLength = sizeof(Magic) - 1;
+constexpr uint32_t ByteOrderMark = 0x01020304;
+constexpr uint32_t Version = 1;
+constexpr size_t HeaderLength =
+   MagicLength + sizeof(ByteOrderMark) + sizeof(Version);
+
+bool IsAttribute(char type)
+{
+   switch (type) {
+   case 's': case 'i': case 'b': case 'f': case 'd':
+      return true;
+   default:
+      return false;
+   }
+}
+
+using BlobExpanders =
+   std::map< wxString, XMLBinaryReader::BlobExpander >;
+BlobExpanders &GetBlobExpanders()
+{
+   static BlobExpanders theExpanders;
+   return theExpanders;
+}
+
+// Copies what it reads to a writer, for conversion between the forms
+class XMLCopier final : public XMLTagHandler
+{
+public:
+   explicit XMLCopier(XMLWriter &out) : mOut{ out } {}
+
+   bool HandleXMLTag(const wxChar *tag, const wxChar **attrs) override
+   {
+      mOut.StartTag(tag);
+      while (*attrs) {
+         const wxChar *attr = *attrs++;
+         const wxChar *value = *attrs++;
+         if (!value)
+            break;
+         mOut.WriteAttr(attr, value);
+      }
+      return true;
+   }
+
+   void HandleXMLEndTag(const wxChar *tag) override
+   {
+      mOut.EndTag(tag);
+   }
+
+   void HandleXMLContent(const wxString &content) override
+   {
+      // Drop the indentation between the tags of text files
+      if (content.find_first_not_of(wxT(" \t\r\n")) == wxString::npos)
+         return;
+      // Text writers escape only attributes and WriteData(), and
+      // WriteData() does not close the open tag
+      if (mOut.AcceptsBlobs())
+         mOut.WriteSubTree(content);
+      else
+         mOut.WriteSubTree(mOut.XMLEsc(content));
+   }
+
+   bool HandleXMLBlob(
+      const wxChar *name, const void *data, size_t len) override
+   {
+      if (mOut.AcceptsBlobs()) {
+         mOut.WriteBlob(name, data, len);
+         return true;
+      }
+      if (auto expander = XMLBinaryReader::FindBlobExpander(name)) {
+         (*expander)(data, len, mOut);
+         return true;
+      }
+      // Refusing it would leave the copied tag open; fail the conversion
+      // instead
+      mLostBlob = true;
+      return true;
+   }
+
+   XMLTagHandler *HandleXMLChild(const wxChar *) override
+   {
+      return this;
+   }
+
+   bool LostBlob() const { return mLostBlob; }
+
+private:
+   XMLWriter &mOut;
+   bool mLostBlob{ false };
+};
+
+}
+
+///
+/// XMLBinaryWriter class
+///
+XMLBinaryWriter::XMLBinaryWriter()
+{
+}
+
+XMLBinaryWriter::~XMLBinaryWriter()
+{
+}
+
+template<typename T> void XMLBinaryWriter::WriteValue(T value)
+{
+   value = XMLBinaryLittleEndian(value);
+   WriteBytes(&value, sizeof(value));
+}
+
+uint32_t XMLBinaryWriter::NameId(const wxString &name)
+{
+   auto iter = mNames.find(name);
+   if (iter != mNames.end())
+      return iter->second;
+
+   const uint32_t id = mNameList.size();
+   mNames[name] = id;
+   mNameList.push_back(name);
+   return id;
+}
+
+void XMLBinaryWriter::WriteString(const wxString &value)
+{
+   const auto utf8 = value.ToUTF8();
+   WriteValue<uint32_t>(utf8.length());
+   WriteBytes(utf8.data(), utf8.length());
+}
+
+void XMLBinaryWriter::WriteBytes(const void *data, size_t len)
+{
+   auto bytes = static_cast<const char*>(data);
+   mBuffer.insert(mBuffer.end(), bytes, bytes + len);
+}
+
+void XMLBinaryWriter::StartTag(const wxString &name)
+{
+   const auto id = NameId(name);
+   WriteValue<char>('<');
+   WriteValue<uint32_t>(id);
+   mOpen.push_back(mBuffer.size());
+   WriteValue<uint64_t>(0);
+   mDepth++;
+}
+
+void XMLBinaryWriter::EndTag(const wxString &)
+{
+   if (mOpen.empty())
+      return;
+
+   WriteValue<char>('>');
+   const auto offset = mOpen.back();
+   mOpen.pop_back();
+   const uint64_t length = XMLBinaryLittleEndian<uint64_t>(
+      mBuffer.size() - (offset + sizeof(uint64_t)));
+   memcpy(mBuffer.data() + offset, &length, sizeof(length));
+   mDepth--;
+}
+
+void XMLBinaryWriter::WriteAttr(const wxString &name, const wxString &value)
+{
+   const auto id = NameId(name);
+   WriteValue<char>('s');
+   WriteValue<uint32_t>(id);
+   WriteString(value);
+}
+
+void XMLBinaryWriter::WriteAttr(const wxString &name, const wxChar *value)
+{
+   WriteAttr(name, wxString(value));
+}
+
+void XMLBinaryWriter::WriteAttr(const wxString &name, int value)
+{
+   WriteAttr(name, (long long) value);
+}
+
+void XMLBinaryWriter::WriteAttr(const wxString &name, bool value)
+{
+   const auto id = NameId(name);
+   WriteValue<char>('b');
+   WriteValue<uint32_t>(id);
+   WriteValue<uint8_t>(value ? 1 : 0);
+}
+
+void XMLBinaryWriter::WriteAttr(const wxString &name, long value)
+{
+   WriteAttr(name, (long long) value);
+}
+
+void XMLBinaryWriter::WriteAttr(const wxString &name, long long value)
+{
+   const auto id = NameId(name);
+   WriteValue<char>('i');
+   WriteValue<uint32_t>(id);
+   WriteValue<int64_t>(value);
+}
+
+void XMLBinaryWriter::WriteAttr(const wxString &name, size_t value)
+{
+   WriteAttr(name, (long long) value);
+}
+
+void XMLBinaryWriter::WriteAttr(const wxString &name, float value, int digits)
+{
+   const auto id = NameId(name);
+   WriteValue<char>('f');
+   WriteValue<uint32_t>(id);
+   WriteValue<float>(value);
+   WriteValue<int32_t>(digits);
+}
+
+void XMLBinaryWriter::WriteAttr(const wxString &name, double value, int digits)
+{
+   const auto id = NameId(name);
+   WriteValue<char>('d');
+   WriteValue<uint32_t>(id);
+   WriteValue<double>(value);
+   WriteValue<int32_t>(digits);
+}
+
+void XMLBinaryWriter::WriteData(const wxString &value)
+{
+   WriteValue<char>('c');
+   WriteString(value);
+}
+
+void XMLBinaryWriter::WriteSubTree(const wxString &value)
+{
+   WriteData(value);
+}
+
+void XMLBinaryWriter::Write(const wxString &data)
+{
+   if (!mOpen.empty())
+      WriteData(data);
+}
+
+void XMLBinaryWriter::WriteBlob(
+   const wxString &name, const void *data, size_t len)
+{
+   const auto id = NameId(name);
+   WriteValue<char>('B');
+   WriteValue<uint32_t>(id);
+   WriteValue<uint64_t>(len);
+   WriteBytes(data, len);
+}
+
+void XMLBinaryWriter::WriteTo(XMLFileWriter &file)
+// may throw
+{
+   while (!mOpen.empty())
+      EndTag({});
+
+   const auto mark = XMLBinaryLittleEndian(ByteOrderMark);
+   const auto version = XMLBinaryLittleEndian(Version);
+   file.WriteBytes(Magic, MagicLength);
+   file.WriteBytes(&mark, sizeof(mark));
+   file.WriteBytes(&version, sizeof(version));
+
+   // The table of names, then the document that uses them
+   for (const auto &name : mNameList) {
+      const auto utf8 = name.ToUTF8();
+      const char type = 'N';
+      const auto length = XMLBinaryLittleEndian<uint32_t>(utf8.length());
+      file.WriteBytes(&type, sizeof(type));
+      file.WriteBytes(&length, sizeof(length));
+      file.WriteBytes(utf8.data(), utf8.length());
+   }
+   file.WriteBytes(mBuffer.data(), mBuffer.size());
+}
+
+///
+/// XMLBinaryReader class
+///
+XMLBinaryReader::XMLBinaryReader()
+{
+}
+
+XMLBinaryReader::~XMLBinaryReader()
+{
+}
+
+// static
+bool XMLBinaryReader::IsBinary(const FilePath &fname)
+{
+   wxFFile file(fname, wxT("rb"));
+   if (!file.IsOpened())
+      return false;
+
+   char buffer[MagicLength];
+   return file.Read(buffer, MagicLength) == MagicLength &&
+      memcmp(buffer, Magic, MagicLength) == 0;
+}
+
+template<typename T> T XMLBinaryReader::PeekValue(size_t pos) const
+{
+   T value;
+   memcpy(&value, mData.data() + pos, sizeof(value));
+   return XMLBinaryLittleEndian(value);
+}
+
+bool XMLBinaryReader::ReadFile(const FilePath &fname)
+{
+   wxFFile file(fname, wxT("rb"));
+   if (!file.IsOpened()) {
+      mErrorStr = XO("Could not open file: \"%s\"").Format( fname );
+      return false;
+   }
+
+   const auto length = file.Length();
+   if (length < (wxFileOffset)HeaderLength) {
+      mErrorStr = XO("Could not load file: \"%s\"").Format( fname );
+      return false;
+   }
+
+   mData.resize(length);
+   if (file.Read(mData.data(), length) != (size_t)length) {
+      mErrorStr = XO("Could not read file: \"%s\"").Format( fname );
+      return false;
+   }
+
+   if (memcmp(mData.data(), Magic, MagicLength) != 0) {
+      mErrorStr = XO("Could not load file: \"%s\"").Format( fname );
+      return false;
+   }
+   if (PeekValue<uint32_t>(MagicLength) != ByteOrderMark) {
+      mErrorStr = XO("Could not load file: \"%s\"").Format( fname );
+      return false;
+   }
+   const auto version = PeekValue<uint32_t>(MagicLength + sizeof(ByteOrderMark));
+   if (version > Version) {
+      mErrorStr = XO(
+"\"%s\" was saved by a newer version of Audacity, and cannot be opened.")
+         .Format( fname );
+      return false;
+   }
+
+   mPos = HeaderLength;
+   return true;
+}
+
+bool XMLBinaryReader::Parse(XMLTagHandler *baseHandler,
+                            const FilePath &fname)
+{
+   mNames.clear();
+   if (!ReadFile(fname))
+      return false;
+
+   bool handled = false;
+   try {
+      bool root = false;
+      while (mPos < mData.size()) {
+         const auto type = ReadValue<char>();
+         if (type == 'N' && !root)
+            ReadName();
+         else if (type == '<' && !root) {
+            root = true;
+            handled = ReadElement(baseHandler);
+         }
+         else
+            throw Error{};
+      }
+   }
+   catch (const Error &) {
+      mLibraryErrorStr = {};
+      mErrorStr = XO("Error: the file is damaged at byte %llu")
+         .Format( (unsigned long long) mPos );
+      mData.clear();
+      return false;
+   }
+   mData.clear();
+
+   // As for XMLFileReader, succeed only if the first-level handler
+   // accepted its tag
+   if (handled)
+      return true;
+   else {
+      mErrorStr = XO("Could not load file: \"%s\"").Format( fname );
+      return false;
+   }
+}
+
+void XMLBinaryReader::Need(size_t len) const
+{
+   if (len > mData.size() - mPos)
+      throw Error{};
+}
+
+wxString XMLBinaryReader::ReadString()
+{
+   const auto len = ReadValue<uint32_t>();
+   Need(len);
+   auto result = wxString::FromUTF8(mData.data() + mPos, len);
+   mPos += len;
+   return result;
+}
+
+void XMLBinaryReader::ReadName()
+{
+   mNames.push_back(ReadString());
+}
+
+const wxString &XMLBinaryReader::GetName(uint32_t id) const
+{
+   if (id >= mNames.size())
+      throw Error{};
+   return mNames[id];
+}
+
+bool XMLBinaryReader::ReadElement(XMLTagHandler *handler)
+{
+   const auto tagId = ReadValue<uint32_t>();
+   GetName(tagId);
+   const auto length = ReadValue<uint64_t>();
+   Need(length);
+   const auto end = mPos + length;
+
+   if (!handler) {
+      // Nobody wants it; skip it whole
+      mPos = end;
+      return false;
+   }
+
+   mValues.clear();
+   while (mPos < end && IsAttribute(mData[mPos])) {
+      const auto type = ReadValue<char>();
+      mValues.push_back(GetName(ReadValue<uint32_t>()));
+      switch (type) {
+      case 's':
+         mValues.push_back(ReadString());
+         break;
+      case 'i':
+         mValues.push_back(wxString::Format(wxT("%lld"),
+            (long long) ReadValue<int64_t>()));
+         break;
+      case 'b':
+         mValues.push_back(wxString::Format(wxT("%d"),
+            (int) ReadValue<uint8_t>()));
+         break;
+      case 'f': {
+         const auto value = ReadValue<float>();
+         mValues.push_back(Internat::ToString(value, ReadValue<int32_t>()));
+         break;
+      }
+      case 'd': {
+         const auto value = ReadValue<double>();
+         mValues.push_back(Internat::ToString(value, ReadValue<int32_t>()));
+         break;
+      }
+      }
+   }
+   mAttrs.clear();
+   for (const auto &value : mValues)
+      mAttrs.push_back(value.wx_str());
+   mAttrs.push_back(nullptr);
+
+   if (!handler->HandleXMLTag(GetName(tagId), mAttrs.data())) {
+      mPos = end;
+      return false;
+   }
+
+   while (true) {
+      if (mPos >= end)
+         throw Error{};
+      switch (ReadValue<char>()) {
+      case '<': {
+         // Look ahead for the name of the child
+         Need(sizeof(uint32_t));
+         const auto childId = PeekValue<uint32_t>(mPos);
+         ReadElement(handler->HandleXMLChild(GetName(childId)));
+         break;
+      }
+      case 'c':
+         handler->HandleXMLContent(ReadString());
+         break;
+      case 'B': {
+         const auto &name = GetName(ReadValue<uint32_t>());
+         const auto len = ReadValue<uint64_t>();
+         Need(len);
+         const auto data = mData.data() + mPos;
+         mPos += len;
+         // As when the tag is refused, drop the rest of the element
+         if (!handler->HandleXMLBlob(name, data, len)) {
+            mPos = end;
+            return false;
+         }
+         break;
+      }
+      case '>':
+         if (mPos != end)
+            throw Error{};
+         handler->HandleXMLEndTag(GetName(tagId));
+         return true;
+      default:
+         throw Error{};
+      }
+   }
+}
+
+const TranslatableString &XMLBinaryReader::GetErrorStr() const
+{
+   return mErrorStr;
+}
+
+const TranslatableString &XMLBinaryReader::GetLibraryErrorStr() const
+{
+   return mLibraryErrorStr;
+}
+
+XMLBinaryReader::RegisteredBlobExpander::RegisteredBlobExpander(
+   const wxString &name, const BlobExpander &expander)
+{
+   GetBlobExpanders()[name] = expander;
+}
+
+// static
+auto XMLBinaryReader::FindBlobExpander(const wxString &name)
+   -> const BlobExpander *
+{
+   auto &expanders = GetBlobExpanders();
+   auto iter = expanders.find(name);
+   return iter == expanders.end() ? nullptr : &iter->second;
+}
+
+bool XMLBinaryReader::ConvertToXML(
+   const FilePath &binaryName, const FilePath &xmlName)
+// may throw
+{
+   XMLFileWriter xmlFile{ xmlName, XO("Error Converting File") };
+   xmlFile.Write(wxT("<?xml version=\"1.0\" standalone=\"no\" ?>\n"));
+
+   XMLCopier copier{ xmlFile };
+   if (!Parse(&copier, binaryName))
+      return false;
+   if (copier.LostBlob()) {
+      mErrorStr = XO("Could not load file: \"%s\"").Format( binaryName );
+      return false;
+   }
+
+   xmlFile.Commit();
+   return true;
+}
+
+bool XMLBinaryReader::ConvertFromXML(
+   const FilePath &xmlName, const FilePath &binaryName)
+// may throw
+{
+   XMLBinaryWriter binaryFile;
+   XMLCopier copier{ binaryFile };
+   XMLFileReader reader;
+   if (!reader.Parse(&copier, xmlName)) {
+      mErrorStr = reader.GetErrorStr();
+      mLibraryErrorStr = reader.GetLibraryErrorStr();
+      return false;
+   }
+
+   XMLFileWriter saveFile{ binaryName, XO("Error Converting File") };
+   binaryFile.WriteTo(saveFile);
+   saveFile.Commit();
+   return true;
+}
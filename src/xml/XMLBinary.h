@@ -0,0 +1,167 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  XMLBinary.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_XML_BINARY__
+#define __AUDACITY_XML_BINARY__
+
+#include "../Audacity.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "XMLTagHandler.h"
+#include "XMLWriter.h"
+#include "Internat.h" // for TranslatableString
+
+#include <wx/defs.h> // for wxBYTE_ORDER
+
+/// Binary files are little-endian on every machine.  Converts a number
+/// between that order and the order of this machine, either way.
+template<typename T> T XMLBinaryLittleEndian(T value)
+{
+#if wxBYTE_ORDER == wxBIG_ENDIAN
+   char bytes[sizeof(T)];
+   memcpy(bytes, &value, sizeof(T));
+   std::reverse(bytes, bytes + sizeof(T));
+   memcpy(&value, bytes, sizeof(T));
+#endif
+   return value;
+}
+
+///
+/// XMLBinaryWriter
+///
+/// Encodes the same tree of tags as XMLWriter, in length-prefixed records
+/// that XMLBinaryReader reads back without parsing text.  The document is
+/// built in memory, then written whole by WriteTo().
+///
+class AUDACITY_DLL_API XMLBinaryWriter final : public XMLWriter {
+
+ public:
+
+   XMLBinaryWriter();
+   virtual ~XMLBinaryWriter();
+
+   void StartTag(const wxString &name) override;
+   void EndTag(const wxString &name) override;
+
+   using XMLWriter::WriteAttr;
+   void WriteAttr(const wxString &name, const wxString &value) override;
+   void WriteAttr(const wxString &name, const wxChar *value) override;
+
+   void WriteAttr(const wxString &name, int value) override;
+   void WriteAttr(const wxString &name, bool value) override;
+   void WriteAttr(const wxString &name, long value) override;
+   void WriteAttr(const wxString &name, long long value) override;
+   void WriteAttr(const wxString &name, size_t value) override;
+   void WriteAttr(const wxString &name, float value, int digits = -1) override;
+   void WriteAttr(const wxString &name, double value, int digits = -1) override;
+
+   void WriteData(const wxString &value) override;
+
+   void WriteSubTree(const wxString &value) override;
+
+   /// Kept as content within a tag; ignored outside of any tag, where
+   /// text writers put the header
+   void Write(const wxString &data) override;
+
+   bool AcceptsBlobs() const override { return true; }
+   /// The bytes are kept as they are; numbers in them should be put in
+   /// order with XMLBinaryLittleEndian()
+   void WriteBlob(
+      const wxString &name, const void *data, size_t len) override;
+
+   /// Write the header and the document to the file. Might throw.
+   void WriteTo(XMLFileWriter &file);
+
+ private:
+   // Add the name to the table if it is NEW, and return its number
+   uint32_t NameId(const wxString &name);
+   void WriteString(const wxString &value);
+   void WriteBytes(const void *data, size_t len);
+   // Numbers are written little-endian on every machine
+   template<typename T> void WriteValue(T value);
+
+   std::vector<char> mBuffer;
+   std::unordered_map<wxString, uint32_t> mNames;
+   // Written as a table before the document, in order of number
+   std::vector<wxString> mNameList;
+   // Where the lengths of the open elements are to be stored
+   std::vector<size_t> mOpen;
+};
+
+///
+/// XMLBinaryReader
+///
+/// Reads a file written by XMLBinaryWriter, and passes the results through
+/// an XMLTagHandler, as XMLFileReader does for text.
+///
+class AUDACITY_DLL_API XMLBinaryReader final {
+ public:
+   XMLBinaryReader();
+   ~XMLBinaryReader();
+
+   /// Whether the file begins as one written by XMLBinaryWriter
+   static bool IsBinary(const FilePath &fname);
+
+   bool Parse(XMLTagHandler *baseHandler,
+              const FilePath &fname);
+
+   const TranslatableString &GetErrorStr() const;
+   const TranslatableString &GetLibraryErrorStr() const;
+
+   /// Blobs have no text form.  Whoever writes a blob should register a
+   /// function to write the same content as tags, for ConvertToXML().
+   using BlobExpander =
+      std::function< void(const void *data, size_t len, XMLWriter &out) >;
+   struct AUDACITY_DLL_API RegisteredBlobExpander {
+      RegisteredBlobExpander(const wxString &name, const BlobExpander &expander);
+   };
+   static const BlobExpander *FindBlobExpander(const wxString &name);
+
+   /// Rewrite a binary file as XML text.  Returns false, with
+   /// GetErrorStr() set, if reading fails.  Might throw if writing fails.
+   bool ConvertToXML(const FilePath &binaryName, const FilePath &xmlName);
+   /// Rewrite an XML file in binary.  Returns false, with GetErrorStr()
+   /// set, if reading fails.  Might throw if writing fails.
+   bool ConvertFromXML(const FilePath &xmlName, const FilePath &binaryName);
+
+ private:
+   class Error {};
+
+   bool ReadFile(const FilePath &fname);
+   void ReadName();
+   bool ReadElement(XMLTagHandler *handler);
+   const wxString &GetName(uint32_t id) const;
+   wxString ReadString();
+   void Need(size_t len) const;
+   template<typename T> T PeekValue(size_t pos) const;
+   template<typename T> T ReadValue()
+   {
+      Need(sizeof(T));
+      const auto value = PeekValue<T>(mPos);
+      mPos += sizeof(T);
+      return value;
+   }
+
+   std::vector<char> mData;
+   size_t mPos{ 0 };
+   std::vector<wxString> mNames;
+   // Reused for the attributes of each tag in turn
+   std::vector<wxString> mValues;
+   std::vector<const wxChar *> mAttrs;
+
+   TranslatableString mErrorStr;
+   TranslatableString mLibraryErrorStr;
+};
+
+#endif
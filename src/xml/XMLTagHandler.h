@@ -108,6 +108,13 @@ class AUDACITY_DLL_API XMLTagHandler /* not final */ {
    // handle this child, return NULL and it will be ignored.
    virtual XMLTagHandler *HandleXMLChild(const wxChar *tag) = 0;
 
+   // This method will be called, by readers of binary files only, with a
+   // run of bytes that XMLWriter::WriteBlob() stored within your tag.
+   // Return false if it is not understood.
+   // It is optional to override this method.
+   virtual bool HandleXMLBlob(const wxChar * WXUNUSED(name),
+      const void * WXUNUSED(data), size_t WXUNUSED(len)) { return false; }
+
    // These functions recieve data from expat.  They do charset
    // conversion and then pass the data to the handlers above.
    bool ReadXMLTag(const char *tag, const char **attrs);
@@ -17,6 +17,10 @@ the general functionality for creating XML in UTF8 encoding.
 \class XMLFileWriter
 \brief Wrapper to output XML data to files.
 
+Output is gathered as UTF-8 in memory and written in large pieces.
+Tags and attributes are composed directly as UTF-8, numbers included,
+without making a wxString for each fragment.
+
 *//****************************************************************//**
 
 \class XMLStringWriter
@@ -31,8 +35,11 @@ the general functionality for creating XML in UTF8 encoding.
 #include <wx/ffile.h>
 #include <wx/intl.h>
 
+#include <stdio.h>
 #include <string.h>
 
+#include "../Internat.h"
+
 //table for xml encoding compatibility with expat decoding
 //see wxWidgets-2.8.12/src/expat/lib/xmltok_impl.h
 //and wxWidgets-2.8.12/src/expat/lib/asciitab.h
@@ -60,6 +67,190 @@ static int charXMLCompatiblity[] =
 #define NONCHARACTER_FFFF static_cast<wxUChar>(0xFFFF)
 
 
+namespace {
+
+void AppendTabs(std::string &out, int count)
+{
+   if (count > 0)
+      out.append(count, '\t');
+}
+
+void AppendCodePoint(std::string &out, unsigned long c)
+{
+   if (c < 0x80)
+      out += (char)c;
+   else if (c < 0x800) {
+      out += (char)(0xC0 | (c >> 6));
+      out += (char)(0x80 | (c & 0x3F));
+   }
+   else if (c < 0x10000) {
+      out += (char)(0xE0 | (c >> 12));
+      out += (char)(0x80 | ((c >> 6) & 0x3F));
+      out += (char)(0x80 | (c & 0x3F));
+   }
+   else {
+      out += (char)(0xF0 | (c >> 18));
+      out += (char)(0x80 | ((c >> 12) & 0x3F));
+      out += (char)(0x80 | ((c >> 6) & 0x3F));
+      out += (char)(0x80 | (c & 0x3F));
+   }
+}
+
+// Combine a surrogate pair, where wxChar is two bytes
+unsigned long CombineSurrogates(wxUChar high, wxUChar low)
+{
+   return 0x10000 +
+      (((unsigned long)high - MIN_HIGH_SURROGATE) << 10) +
+      ((unsigned long)low - MIN_LOW_SURROGATE);
+}
+
+void AppendUTF8(std::string &out, const wxString &s)
+{
+   const wxChar *p = s.wc_str();
+   const size_t len = s.length();
+   for (size_t i = 0; i < len; i++) {
+      const wxUChar c = p[i];
+      if (c < 0x80)
+         out += (char)c;
+      else if (sizeof(c) == 2 &&
+               c >= MIN_HIGH_SURROGATE && c <= MAX_HIGH_SURROGATE &&
+               i < len - 1 &&
+               (wxUChar)p[i + 1] >= MIN_LOW_SURROGATE &&
+               (wxUChar)p[i + 1] <= MAX_LOW_SURROGATE)
+         AppendCodePoint(out, CombineSurrogates(c, p[++i]));
+      else
+         AppendCodePoint(out, c);
+   }
+}
+
+// See http://www.w3.org/TR/REC-xml for reference
+void AppendEscaped(std::string &out, const wxString &s)
+{
+   const wxChar *p = s.wc_str();
+   int len = s.length();
+
+   for(int i=0; i<len; i++) {
+      wxUChar c = p[i];
+
+      switch (c) {
+         case wxT('\''):
+            out += "&apos;";
+         break;
+
+         case wxT('"'):
+            out += "&quot;";
+         break;
+
+         case wxT('&'):
+            out += "&amp;";
+         break;
+
+         case wxT('<'):
+            out += "&lt;";
+         break;
+
+         case wxT('>'):
+            out += "&gt;";
+         break;
+
+         default:
+            if (c >= 0x20 && c < 0x7F) {
+               // Printable ASCII in every locale, so skip wxIsprint()
+               out += (char)c;
+            }
+            else if (sizeof(c) == 2 && c >= MIN_HIGH_SURROGATE && c <= MAX_HIGH_SURROGATE && i < len - 1) {
+               // If wxUChar is 2 bytes, then supplementary characters (those greater than U+FFFF) are represented
+               // with a high surrogate (U+D800..U+DBFF) followed by a low surrogate (U+DC00..U+DFFF).
+               // Handle those here.
+               wxUChar c2 = p[++i];
+               if (c2 >= MIN_LOW_SURROGATE && c2 <= MAX_LOW_SURROGATE) {
+                  // Surrogate pair found; simply add it to the output string.
+                  AppendCodePoint(out, CombineSurrogates(c, c2));
+               }
+               else {
+                  // That high surrogate isn't paired, so ignore it.
+                  i--;
+               }
+            }
+            else if (!wxIsprint(c)) {
+               //ignore several characters such ase eot (0x04) and stx (0x02) because it makes expat parser bail
+               //see xmltok.c in expat checkCharRefNumber() to see how expat bails on these chars.
+               //also see wxWidgets-2.8.12/src/expat/lib/asciitab.h to see which characters are nonxml compatible
+               //post decode (we can still encode '&' and '<' with this table, but it prevents us from encoding eot)
+               //everything is compatible past ascii 0x20 except for surrogates and the noncharacters U+FFFE and U+FFFF,
+               //so we don't check the compatibility table higher than this.
+               if((c> 0x1F || charXMLCompatiblity[c]!=0) &&
+                     (c < MIN_HIGH_SURROGATE || c > MAX_LOW_SURROGATE) &&
+                     c != NONCHARACTER_FFFE && c != NONCHARACTER_FFFF) {
+                  char buffer[16];
+                  snprintf(buffer, sizeof(buffer), "&#x%04x;", (unsigned)c);
+                  out += buffer;
+               }
+            }
+            else {
+               AppendCodePoint(out, c);
+            }
+         break;
+      }
+   }
+}
+
+// As printf's %lld
+void AppendInteger(std::string &out, long long value)
+{
+   char buffer[24];
+   char *const end = buffer + sizeof(buffer);
+   char *p = end;
+   unsigned long long magnitude = value < 0
+      ? 0ull - (unsigned long long)value
+      : (unsigned long long)value;
+   do {
+      *--p = '0' + magnitude % 10;
+      magnitude /= 10;
+   } while (magnitude);
+   if (value < 0)
+      *--p = '-';
+   out.append(p, end);
+}
+
+// The same characters as Internat::ToString(), without making wxStrings
+void AppendDouble(std::string &out, double value, int digits)
+{
+   char buffer[64];
+   int len = (digits == -1)
+      ? snprintf(buffer, sizeof(buffer), "%f", value)
+      : snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+   if (len < 0 || len >= (int)sizeof(buffer)) {
+      // Huge values
+      AppendUTF8(out, Internat::ToString(value, digits));
+      return;
+   }
+
+   // Whatever the locale, the separator is written as a point
+   const wxChar decSep = Internat::GetDecimalSeparator();
+   bool hasPoint = false;
+   for (int i = 0; i < len; i++) {
+      if (buffer[i] == '.' || (wxChar)buffer[i] == decSep) {
+         buffer[i] = '.';
+         hasPoint = true;
+      }
+   }
+
+   if (digits == -1 && hasPoint) {
+      // Strip trailing zeros, but leave one, and decimal separator.
+      int pos = len - 1;
+      while ((pos > 1) &&
+               (buffer[pos] == '0') &&
+               (buffer[pos - 1] != '.'))
+         pos--;
+      len = pos + 1;
+   }
+
+   out.append(buffer, len);
+}
+
+}
+
 ///
 /// XMLWriter base class
 ///
@@ -77,18 +268,18 @@ XMLWriter::~XMLWriter()
 void XMLWriter::StartTag(const wxString &name)
 // may throw
 {
-   int i;
+   auto &out = mFragment;
+   out.clear();
 
    if (mInTag) {
-      Write(wxT(">\n"));
+      out += ">\n";
       mInTag = false;
    }
 
-   for (i = 0; i < mDepth; i++) {
-      Write(wxT("\t"));
-   }
-
-   Write(wxString::Format(wxT("<%s"), name));
+   AppendTabs(out, mDepth);
+   out += '<';
+   AppendUTF8(out, name);
+   WriteUTF8(out.data(), out.size());
 
    mTagstack.insert(mTagstack.begin(), name);
    mHasKids[0] = true;
@@ -100,24 +291,25 @@ void XMLWriter::StartTag(const wxString &name)
 void XMLWriter::EndTag(const wxString &name)
 // may throw
 {
-   int i;
-
    if (mTagstack.size() > 0) {
       if (mTagstack[0] == name) {
+         auto &out = mFragment;
+         out.clear();
          if (mHasKids[1]) {  // There will always be at least 2 at this point
             if (mInTag) {
-               Write(wxT("/>\n"));
+               out += "/>\n";
             }
             else {
-               for (i = 0; i < mDepth - 1; i++) {
-                  Write(wxT("\t"));
-               }
-               Write(wxString::Format(wxT("</%s>\n"), name));
+               AppendTabs(out, mDepth - 1);
+               out += "</";
+               AppendUTF8(out, name);
+               out += ">\n";
             }
          }
          else {
-            Write(wxT(">\n"));
+            out += ">\n";
          }
+         WriteUTF8(out.data(), out.size());
          mTagstack.erase( mTagstack.begin() );
          mHasKids.erase(mHasKids.begin());
       }
@@ -130,9 +322,9 @@ void XMLWriter::EndTag(const wxString &name)
 void XMLWriter::WriteAttr(const wxString &name, const wxString &value)
 // may throw from Write()
 {
-   Write(wxString::Format(wxT(" %s=\"%s\""),
-      name,
-      XMLEsc(value)));
+   auto &out = StartAttr(name);
+   AppendEscaped(out, value);
+   EndAttr();
 }
 
 void XMLWriter::WriteAttr(const wxString &name, const wxChar *value)
@@ -144,69 +336,60 @@ void XMLWriter::WriteAttr(const wxString &name, const wxChar *value)
 void XMLWriter::WriteAttr(const wxString &name, int value)
 // may throw from Write()
 {
-   Write(wxString::Format(wxT(" %s=\"%d\""),
-      name,
-      value));
+   AppendInteger(StartAttr(name), value);
+   EndAttr();
 }
 
 void XMLWriter::WriteAttr(const wxString &name, bool value)
 // may throw from Write()
 {
-   Write(wxString::Format(wxT(" %s=\"%d\""),
-      name,
-      value));
+   AppendInteger(StartAttr(name), value);
+   EndAttr();
 }
 
 void XMLWriter::WriteAttr(const wxString &name, long value)
 // may throw from Write()
 {
-   Write(wxString::Format(wxT(" %s=\"%ld\""),
-      name,
-      value));
+   AppendInteger(StartAttr(name), value);
+   EndAttr();
 }
 
 void XMLWriter::WriteAttr(const wxString &name, long long value)
 // may throw from Write()
 {
-   Write(wxString::Format(wxT(" %s=\"%lld\""),
-      name,
-      value));
+   AppendInteger(StartAttr(name), value);
+   EndAttr();
 }
 
 void XMLWriter::WriteAttr(const wxString &name, size_t value)
 // may throw from Write()
 {
-   Write(wxString::Format(wxT(" %s=\"%lld\""),
-      name,
-      (long long) value));
+   AppendInteger(StartAttr(name), (long long) value);
+   EndAttr();
 }
 
 void XMLWriter::WriteAttr(const wxString &name, float value, int digits)
 // may throw from Write()
 {
-   Write(wxString::Format(wxT(" %s=\"%s\""),
-      name,
-      Internat::ToString(value, digits)));
+   AppendDouble(StartAttr(name), value, digits);
+   EndAttr();
 }
 
 void XMLWriter::WriteAttr(const wxString &name, double value, int digits)
 // may throw from Write()
 {
-   Write(wxString::Format(wxT(" %s=\"%s\""),
-      name,
-      Internat::ToString(value, digits)));
+   AppendDouble(StartAttr(name), value, digits);
+   EndAttr();
 }
 
 void XMLWriter::WriteData(const wxString &value)
 // may throw from Write()
 {
-   int i;
-
-   for (i = 0; i < mDepth; i++) {
-      Write(wxT("\t"));
-   }
-
-   Write(XMLEsc(value));
+   auto &out = mFragment;
+   out.clear();
+   AppendTabs(out, mDepth);
+   AppendEscaped(out, value);
+   WriteUTF8(out.data(), out.size());
 }
 
 void XMLWriter::WriteSubTree(const wxString &value)
@@ -221,77 +404,51 @@ void XMLWriter::WriteSubTree(const wxString &value)
    Write(value);
 }
 
-// See http://www.w3.org/TR/REC-xml for reference
-wxString XMLWriter::XMLEsc(const wxString & s)
+std::string &XMLWriter::StartAttr(const wxString &name)
 {
-   wxString result;
-   int len = s.length();
-
-   for(int i=0; i<len; i++) {
-      wxUChar c = s.GetChar(i);
-
-      switch (c) {
-         case wxT('\''):
-            result += wxT("&apos;");
-         break;
-
-         case wxT('"'):
-            result += wxT("&quot;");
-         break;
-
-         case wxT('&'):
-            result += wxT("&amp;");
-         break;
+   auto &out = mFragment;
+   out.clear();
+   out += ' ';
+   AppendUTF8(out, name);
+   out += "=\"";
+   return out;
+}
 
-         case wxT('<'):
-            result += wxT("&lt;");
-         break;
+void XMLWriter::EndAttr()
+// may throw from Write()
+{
+   mFragment += '"';
+   WriteUTF8(mFragment.data(), mFragment.size());
+}
 
-         case wxT('>'):
-            result += wxT("&gt;");
-         break;
+void XMLWriter::WriteUTF8(const char *data, size_t len)
+// may throw from Write()
+{
+   Write(wxString::FromUTF8(data, len));
+}
 
-         default:
-            if (sizeof(c) == 2 && c >= MIN_HIGH_SURROGATE && c <= MAX_HIGH_SURROGATE && i < len - 1) {
-               // If wxUChar is 2 bytes, then supplementary characters (those greater than U+FFFF) are represented
-               // with a high surrogate (U+D800..U+DBFF) followed by a low surrogate (U+DC00..U+DFFF).
-               // Handle those here.
-               wxUChar c2 = s.GetChar(++i);
-               if (c2 >= MIN_LOW_SURROGATE && c2 <= MAX_LOW_SURROGATE) {
-                  // Surrogate pair found; simply add it to the output string.
-                  result += c;
-                  result += c2;
-               }
-               else {
-                  // That high surrogate isn't paired, so ignore it.
-                  i--;
-               }
-            }
-            else if (!wxIsprint(c)) {
-               //ignore several characters such ase eot (0x04) and stx (0x02) because it makes expat parser bail
-               //see xmltok.c in expat checkCharRefNumber() to see how expat bails on these chars.
-               //also see wxWidgets-2.8.12/src/expat/lib/asciitab.h to see which characters are nonxml compatible
-               //post decode (we can still encode '&' and '<' with this table, but it prevents us from encoding eot)
-               //everything is compatible past ascii 0x20 except for surrogates and the noncharacters U+FFFE and U+FFFF,
-               //so we don't check the compatibility table higher than this.
-               if((c> 0x1F || charXMLCompatiblity[c]!=0) &&
-                     (c < MIN_HIGH_SURROGATE || c > MAX_LOW_SURROGATE) &&
-                     c != NONCHARACTER_FFFE && c != NONCHARACTER_FFFF)
-                  result += wxString::Format(wxT("&#x%04x;"), c);
-            }
-            else {
-               result += c;
-            }
-         break;
-      }
-   }
+void XMLWriter::WriteBlob(const wxString &, const void *, size_t)
+{
+   // Text writers have no representation of blobs
+   wxASSERT(false);
+}
 
-   return result;
+wxString XMLWriter::XMLEsc(const wxString & s)
+{
+   std::string result;
+   AppendEscaped(result, s);
+   return wxString::FromUTF8(result.data(), result.size());
 }
 
 ///
 /// XMLFileWriter class
 ///
+
+namespace {
+// Bytes are written to the file in pieces of about this size
+constexpr size_t BufferSize = 256 * 1024;
+}
+
 XMLFileWriter::XMLFileWriter(
    const FilePath &outputPath, const TranslatableString &caption, bool keepBackup )
    : mOutputPath{ outputPath }
@@ -303,6 +460,8 @@ XMLFileWriter::XMLFileWriter(
    if (!wxFFile::Open(tempPath, wxT("wb")) || !IsOpened())
       ThrowException( outputPath, mCaption );
 
+   mBuffer.reserve(BufferSize + BufferSize / 4);
+
    if (mKeepBackup) {
       int index = 0;
       wxString backupName;
@@ -330,6 +489,8 @@ XMLFileWriter::~XMLFileWriter()
    // Don't let a destructor throw!
    GuardedCall( [&] {
       if (!mCommitted) {
+         // The file is to be removed, so don't write what remains
+         mBuffer.clear();
          auto fileName = GetName();
          if ( IsOpened() )
             CloseWithoutEndingTags();
@@ -385,6 +546,8 @@ void XMLFileWriter::PostCommit()
 void XMLFileWriter::CloseWithoutEndingTags()
 // may throw
 {
+   FlushBuffer();
+
    // Before closing, we first flush it, because if Flush() fails because of a
    // "disk full" condition, we can still at least try to close the file.
    if (!wxFFile::Flush())
@@ -401,7 +564,46 @@ void XMLFileWriter::CloseWithoutEndingTags()
 void XMLFileWriter::Write(const wxString &data)
 // may throw
 {
-   if (!wxFFile::Write(data, wxConvUTF8) || Error())
+   AppendUTF8(mBuffer, data);
+   if (mBuffer.size() >= BufferSize)
+      FlushBuffer();
+}
+
+void XMLFileWriter::WriteUTF8(const char *data, size_t len)
+// may throw
+{
+   mBuffer.append(data, len);
+   if (mBuffer.size() >= BufferSize)
+      FlushBuffer();
+}
+
+void XMLFileWriter::WriteBytes(const void *data, size_t len)
+// may throw
+{
+   if (len < BufferSize) {
+      WriteUTF8(static_cast<const char*>(data), len);
+      return;
+   }
+
+   // Large pieces go straight to the file
+   FlushBuffer();
+   if (wxFFile::Write(data, len) != len || Error())
+   {
+      wxFFile::Close();
+      ThrowException( GetName(), mCaption );
+   }
+}
+
+void XMLFileWriter::FlushBuffer()
+// may throw
+{
+   if (mBuffer.empty())
+      return;
+
+   const auto len = mBuffer.size();
+   const bool failed = wxFFile::Write(mBuffer.data(), len) != len || Error();
+   mBuffer.clear();
+   if (failed)
    {
       // When writing fails, we try to close the file before throwing the
       // exception, so it can at least be deleted.
@@ -10,6 +10,7 @@
 #ifndef __AUDACITY_XML_XML_FILE_WRITER__
 #define __AUDACITY_XML_XML_FILE_WRITER__
 
+#include <string>
 #include <vector>
 #include <wx/ffile.h> // to inherit
 
@@ -53,17 +54,38 @@ class AUDACITY_DLL_API XMLWriter /* not final */ {
 
    virtual void Write(const wxString &data) = 0;
 
+   // Binary writers can store a run of bytes within the current tag, to be
+   // given whole to XMLTagHandler::HandleXMLBlob() when read back.
+   // Don't call WriteBlob() unless AcceptsBlobs().
+   virtual bool AcceptsBlobs() const { return false; }
+   virtual void WriteBlob(
+      const wxString &name, const void *data, size_t len);
+
    // Escape a string, replacing certain characters with their
    // XML encoding, i.e. '<' becomes '&lt;'
    wxString XMLEsc(const wxString & s);
 
  protected:
 
+   // Write text already in UTF-8.  The default converts it back for
+   // Write(); writers of bytes override it to take it as it is.
+   virtual void WriteUTF8(const char *data, size_t len);
+
    bool mInTag;
    int mDepth;
    wxArrayString mTagstack;
    std::vector<int> mHasKids;
 
+ private:
+
+   // Begin and end the fragment for an attribute, written at once
+   std::string &StartAttr(const wxString &name);
+   void EndAttr();
+
+   // Each call composes its output here, to write it at once, and
+   // the capacity is kept for the next
+   std::string mFragment;
+
 };
 
 ///
@@ -106,10 +128,22 @@ class AUDACITY_DLL_API XMLFileWriter final : private wxFFile, public XMLWriter {
    /// Write to file. Might throw.
    void Write(const wxString &data) override;
 
+   /// Write bytes to file without conversion, for binary formats.
+   /// Might throw.
+   void WriteBytes(const void *data, size_t len);
+
    FilePath GetBackupName() const { return mBackupName; }
 
+ protected:
+
+   /// Buffer the bytes, to write them in large pieces. Might throw.
+   void WriteUTF8(const char *data, size_t len) override;
+
  private:
 
+   /// Write the buffered bytes. Might throw.
+   void FlushBuffer();
+
    void ThrowException(
       const wxFileName &fileName, const TranslatableString &caption)
    {
@@ -128,6 +162,8 @@ class AUDACITY_DLL_API XMLFileWriter final : private wxFFile, public XMLWriter {
    wxFFile mBackupFile;
 
    bool mCommitted{ false };
+
+   std::string mBuffer;
 };
 
 ///